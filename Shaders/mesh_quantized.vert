@@ -0,0 +1,36 @@
+#version 450
+
+// VULKRON_MESH_VERTEX_FORMAT_QUANTIZED, see vulkronGetVertexDescriptions
+layout (location = 0) in vec4 vPosition;	// snorm16, the mesh dequantizeMatrix is part of render_matrix
+layout (location = 1) in vec2 vNormal;		// octahedral snorm16
+layout (location = 2) in vec4 vColor;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 texCoord;
+layout (location = 2) out vec3 outNormal;
+
+//push constants block
+layout( push_constant ) uniform constants
+{
+vec4 data;
+mat4 render_matrix;
+} PushConstants;
+
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+void main() 
+{
+	gl_Position = PushConstants.render_matrix * vec4(vPosition.xyz, 1.0f);
+
+	outColor = vColor.rgb;
+	texCoord = vTexCoord;
+	outNormal = octahedralDecode(vNormal);
+}
@@ -1,3 +1,8 @@
 C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V test.vert
 C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V test.frag
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V mesh_quantized.vert -o mesh_quantized.vert.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V depth_reduce.comp -o depth_reduce.comp.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V occlusion_cull.comp -o occlusion_cull.comp.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V gpu_benchmark.comp -o gpu_benchmark.comp.spv
+C:\VulkanSDK\1.2.198.1\Bin\glslangValidator.exe -V shadow_depth.vert -o shadow_depth.vert.spv
 pause
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 450
+
+// Depth only, used for both vertex formats, see vulkronGetVertexDescriptions
+layout (location = 0) in vec4 vPosition;	// float or snorm16, the mesh dequantizeMatrix is part of cascade_matrix
+
+layout( push_constant ) uniform constants
+{
+mat4 cascade_matrix;						// cascade view projection * model * dequantize
+} PushConstants;
+
+void main() 
+{
+	gl_Position = PushConstants.cascade_matrix * vec4(vPosition.xyz, 1.0f);
+}
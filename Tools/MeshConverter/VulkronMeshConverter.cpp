@@ -0,0 +1,1056 @@
+#include "../../VulkronMeshFormat.h"
+
+#define CGLTF_IMPLEMENTATION
+#include "cgltf/cgltf.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+/*
+
+    Offline converter from OBJ / glTF (.gltf, .glb) to the .vmesh container read by vulkronLoadMesh.
+    All the parsing happens here so the runtime never has to.
+
+    usage: VulkronMeshConverter [--float] <input.obj|input.gltf|input.glb> <output.vmesh>
+
+    Vertices are quantized (VulkronMeshPackedVertex) unless --float is passed, indices are
+    reordered for the post transform cache and overdraw, and 16 bit indices are used when they fit.
+    Coarser lods are generated by vertex clustering, they share the vertex blob with lod 0.
+
+*/
+
+typedef struct ImportedMesh {
+    std::vector<VulkronMeshFileVertex>      vertexList;
+    std::vector<uint32_t>                   indexList;                      // every lod, lod 0 first
+    std::vector<VulkronMeshFileLod>         lodList;
+    bool                                    hasNormals          = true;
+} ImportedMesh;
+
+static bool importObj(const std::string& filePath, ImportedMesh* mesh);
+static bool importGltf(const std::string& filePath, ImportedMesh* mesh);
+static void generateNormals(ImportedMesh* mesh);
+static void computeBounds(const ImportedMesh& mesh, VulkronMeshFileHeader* header);
+static void generateLods(ImportedMesh* mesh);
+static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<VulkronMeshFileVertex>& vertexList);
+static void optimizeVertexFetch(ImportedMesh* mesh);
+static std::vector<VulkronMeshPackedVertex> quantizeVertices(const ImportedMesh& mesh, VulkronMeshFileHeader* header);
+static bool writeMesh(const std::string& filePath, const ImportedMesh& mesh, bool quantize);
+
+//-------------------------------------------------------------------------------------
+// SECTION [OBJ] ----------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+typedef struct ObjIndex {
+    int                                     position;
+    int                                     uv;
+    int                                     normal;
+
+    bool operator==(const ObjIndex& other) const {
+        return position == other.position && uv == other.uv && normal == other.normal;
+    }
+} ObjIndex;
+
+struct ObjIndexHash {
+    size_t operator()(const ObjIndex& index) const {
+        size_t hash = std::hash<int>()(index.position);
+        hash ^= std::hash<int>()(index.uv) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<int>()(index.normal) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+// OBJ indices are 1 based, negative ones count back from the end
+static int resolveObjIndex(int index, size_t count) {
+    if (index > 0) {
+        return index - 1;
+    }
+    if (index < 0) {
+        return static_cast<int>(count) + index;
+    }
+    return -1;
+}
+
+static bool importObj(const std::string& filePath, ImportedMesh* mesh) {
+
+    std::ifstream file(filePath);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<float> positionList;        // xyz rgb, colours are the common "v x y z r g b" extension
+    std::vector<float> uvList;
+    std::vector<float> normalList;
+    std::unordered_map<ObjIndex, uint32_t, ObjIndexHash> vertexMap;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string type;
+        stream >> type;
+
+        if (type == "v") {
+            float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+            stream >> values[0] >> values[1] >> values[2];
+            if (stream >> values[3]) {
+                stream >> values[4] >> values[5];
+            }
+            positionList.insert(positionList.end(), values, values + 6);
+        }
+        else if (type == "vt") {
+            float u = 0.0f, v = 0.0f;
+            stream >> u >> v;
+            uvList.push_back(u);
+            uvList.push_back(1.0f - v); // OBJ has v pointing up, images are stored top row first
+        }
+        else if (type == "vn") {
+            float x = 0.0f, y = 0.0f, z = 0.0f;
+            stream >> x >> y >> z;
+            normalList.insert(normalList.end(), { x, y, z });
+        }
+        else if (type == "f") {
+            std::vector<uint32_t> faceList;
+            std::string corner;
+
+            while (stream >> corner) {
+                ObjIndex index = { 0, 0, 0 };
+                sscanf(corner.c_str(), "%d", &index.position);
+
+                size_t firstSlash = corner.find('/');
+                if (firstSlash != std::string::npos) {
+                    size_t secondSlash = corner.find('/', firstSlash + 1);
+                    if (secondSlash != firstSlash + 1) {
+                        sscanf(corner.c_str() + firstSlash + 1, "%d", &index.uv);
+                    }
+                    if (secondSlash != std::string::npos) {
+                        sscanf(corner.c_str() + secondSlash + 1, "%d", &index.normal);
+                    }
+                }
+
+                index.position = resolveObjIndex(index.position, positionList.size() / 6);
+                index.uv = resolveObjIndex(index.uv, uvList.size() / 2);
+                index.normal = resolveObjIndex(index.normal, normalList.size() / 3);
+
+                if (index.position < 0 || static_cast<size_t>(index.position) >= positionList.size() / 6) {
+                    std::cerr << "invalid face index in " << filePath << std::endl;
+                    return false;
+                }
+
+                auto found = vertexMap.find(index);
+                if (found != vertexMap.end()) {
+                    faceList.push_back(found->second);
+                    continue;
+                }
+
+                VulkronMeshFileVertex vertex = {};
+                memcpy(vertex.position, &positionList[index.position * 6], sizeof(vertex.position));
+                memcpy(vertex.color, &positionList[index.position * 6 + 3], sizeof(vertex.color));
+
+                if (index.uv >= 0 && static_cast<size_t>(index.uv) < uvList.size() / 2) {
+                    memcpy(vertex.uv, &uvList[index.uv * 2], sizeof(vertex.uv));
+                }
+
+                if (index.normal >= 0 && static_cast<size_t>(index.normal) < normalList.size() / 3) {
+                    memcpy(vertex.normal, &normalList[index.normal * 3], sizeof(vertex.normal));
+                }
+                else {
+                    mesh->hasNormals = false;
+                }
+
+                uint32_t vertexIndex = static_cast<uint32_t>(mesh->vertexList.size());
+                mesh->vertexList.push_back(vertex);
+                vertexMap.emplace(index, vertexIndex);
+                faceList.push_back(vertexIndex);
+            }
+
+            // polygons are triangulated as a fan
+            for (size_t i = 2; i < faceList.size(); i++) {
+                mesh->indexList.insert(mesh->indexList.end(), { faceList[0], faceList[i - 1], faceList[i] });
+            }
+        }
+    }
+
+    return !mesh->indexList.empty();
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [GLTF] ---------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static void importGltfPrimitive(const cgltf_primitive& primitive, const float* matrix, ImportedMesh* mesh) {
+
+    const cgltf_accessor* positionAccessor = nullptr;
+    const cgltf_accessor* normalAccessor = nullptr;
+    const cgltf_accessor* colorAccessor = nullptr;
+    const cgltf_accessor* uvAccessor = nullptr;
+
+    for (cgltf_size i = 0; i < primitive.attributes_count; i++) {
+        const cgltf_attribute& attribute = primitive.attributes[i];
+
+        if (attribute.type == cgltf_attribute_type_position) {
+            positionAccessor = attribute.data;
+        }
+        else if (attribute.type == cgltf_attribute_type_normal) {
+            normalAccessor = attribute.data;
+        }
+        else if (attribute.type == cgltf_attribute_type_color && attribute.index == 0) {
+            colorAccessor = attribute.data;
+        }
+        else if (attribute.type == cgltf_attribute_type_texcoord && attribute.index == 0) {
+            uvAccessor = attribute.data;
+        }
+    }
+
+    if (nullptr == positionAccessor) {
+        return;
+    }
+
+    if (nullptr == normalAccessor) {
+        mesh->hasNormals = false;
+    }
+
+    uint32_t baseVertex = static_cast<uint32_t>(mesh->vertexList.size());
+
+    for (cgltf_size i = 0; i < positionAccessor->count; i++) {
+        VulkronMeshFileVertex vertex = {};
+        float position[3] = {};
+        float normal[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float color[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        cgltf_accessor_read_float(positionAccessor, i, position, 3);
+
+        // node transforms are baked in, the matrix is column major
+        for (uint32_t row = 0; row < 3; row++) {
+            vertex.position[row] = matrix[row] * position[0] + matrix[4 + row] * position[1] + matrix[8 + row] * position[2] + matrix[12 + row];
+        }
+
+        if (nullptr != normalAccessor) {
+            cgltf_accessor_read_float(normalAccessor, i, normal, 3);
+
+            float length = 0.0f;
+            for (uint32_t row = 0; row < 3; row++) {
+                vertex.normal[row] = matrix[row] * normal[0] + matrix[4 + row] * normal[1] + matrix[8 + row] * normal[2];
+                length += vertex.normal[row] * vertex.normal[row];
+            }
+
+            length = std::sqrt(length);
+            for (uint32_t row = 0; row < 3 && length > 0.0f; row++) {
+                vertex.normal[row] /= length;
+            }
+        }
+
+        if (nullptr != colorAccessor) {
+            cgltf_accessor_read_float(colorAccessor, i, color, cgltf_num_components(colorAccessor->type));
+        }
+        memcpy(vertex.color, color, sizeof(vertex.color));
+
+        if (nullptr != uvAccessor) {
+            cgltf_accessor_read_float(uvAccessor, i, vertex.uv, 2);
+        }
+
+        mesh->vertexList.push_back(vertex);
+    }
+
+    if (nullptr != primitive.indices) {
+        for (cgltf_size i = 0; i < primitive.indices->count; i++) {
+            mesh->indexList.push_back(baseVertex + static_cast<uint32_t>(cgltf_accessor_read_index(primitive.indices, i)));
+        }
+    }
+    else {
+        for (cgltf_size i = 0; i < positionAccessor->count; i++) {
+            mesh->indexList.push_back(baseVertex + static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// Every triangle primitive of every mesh instance in the scene is merged into one mesh
+static bool importGltf(const std::string& filePath, ImportedMesh* mesh) {
+
+    cgltf_options options = {};
+    cgltf_data* data = nullptr;
+
+    if (cgltf_parse_file(&options, filePath.c_str(), &data) != cgltf_result_success) {
+        return false;
+    }
+
+    if (cgltf_load_buffers(&options, data, filePath.c_str()) != cgltf_result_success) {
+        cgltf_free(data);
+        return false;
+    }
+
+    bool hasMeshNodes = false;
+
+    for (cgltf_size i = 0; i < data->nodes_count; i++) {
+        const cgltf_node& node = data->nodes[i];
+
+        if (nullptr == node.mesh) {
+            continue;
+        }
+
+        hasMeshNodes = true;
+
+        float matrix[16];
+        cgltf_node_transform_world(&node, matrix);
+
+        for (cgltf_size j = 0; j < node.mesh->primitives_count; j++) {
+            if (node.mesh->primitives[j].type == cgltf_primitive_type_triangles) {
+                importGltfPrimitive(node.mesh->primitives[j], matrix, mesh);
+            }
+        }
+    }
+
+    // files without a node hierarchy still get their meshes
+    if (!hasMeshNodes) {
+        const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+        for (cgltf_size i = 0; i < data->meshes_count; i++) {
+            for (cgltf_size j = 0; j < data->meshes[i].primitives_count; j++) {
+                if (data->meshes[i].primitives[j].type == cgltf_primitive_type_triangles) {
+                    importGltfPrimitive(data->meshes[i].primitives[j], identity, mesh);
+                }
+            }
+        }
+    }
+
+    cgltf_free(data);
+
+    return !mesh->indexList.empty();
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [PROCESS] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Smooth area weighted normals for meshes that came without them
+static void generateNormals(ImportedMesh* mesh) {
+
+    for (auto& vertex : mesh->vertexList) {
+        vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+    }
+
+    for (size_t i = 0; i + 2 < mesh->indexList.size(); i += 3) {
+        VulkronMeshFileVertex& v0 = mesh->vertexList[mesh->indexList[i]];
+        VulkronMeshFileVertex& v1 = mesh->vertexList[mesh->indexList[i + 1]];
+        VulkronMeshFileVertex& v2 = mesh->vertexList[mesh->indexList[i + 2]];
+
+        float e1[3] = { v1.position[0] - v0.position[0], v1.position[1] - v0.position[1], v1.position[2] - v0.position[2] };
+        float e2[3] = { v2.position[0] - v0.position[0], v2.position[1] - v0.position[1], v2.position[2] - v0.position[2] };
+        float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+
+        for (uint32_t c = 0; c < 3; c++) {
+            v0.normal[c] += normal[c];
+            v1.normal[c] += normal[c];
+            v2.normal[c] += normal[c];
+        }
+    }
+
+    for (auto& vertex : mesh->vertexList) {
+        float length = std::sqrt(vertex.normal[0] * vertex.normal[0] + vertex.normal[1] * vertex.normal[1] + vertex.normal[2] * vertex.normal[2]);
+
+        if (length > 0.0f) {
+            vertex.normal[0] /= length;
+            vertex.normal[1] /= length;
+            vertex.normal[2] /= length;
+        }
+        else {
+            vertex.normal[1] = 1.0f;
+        }
+    }
+}
+
+static void computeBounds(const ImportedMesh& mesh, VulkronMeshFileHeader* header) {
+
+    for (uint32_t c = 0; c < 3; c++) {
+        header->boundsMin[c] = mesh.vertexList[0].position[c];
+        header->boundsMax[c] = mesh.vertexList[0].position[c];
+    }
+
+    for (const auto& vertex : mesh.vertexList) {
+        for (uint32_t c = 0; c < 3; c++) {
+            header->boundsMin[c] = std::min(header->boundsMin[c], vertex.position[c]);
+            header->boundsMax[c] = std::max(header->boundsMax[c], vertex.position[c]);
+        }
+    }
+
+    // sphere around the box center, loose but cheap to test
+    float radiusSquared = 0.0f;
+    for (uint32_t c = 0; c < 3; c++) {
+        header->sphereCenter[c] = (header->boundsMin[c] + header->boundsMax[c]) * 0.5f;
+    }
+
+    for (const auto& vertex : mesh.vertexList) {
+        float dx = vertex.position[0] - header->sphereCenter[0];
+        float dy = vertex.position[1] - header->sphereCenter[1];
+        float dz = vertex.position[2] - header->sphereCenter[2];
+        radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+
+    header->sphereRadius = std::sqrt(radiusSquared);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [LOD] ----------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static const float                          LOD_GRID_SHRINK         = 0.7f;     // roughly halves the triangles per lod
+static const float                          LOD_MIN_REDUCTION       = 0.1f;     // stop once a lod saves less than this
+static const size_t                         LOD_MIN_TRIANGLES       = 16;
+
+static uint64_t clusterKey(const float* position, const float* boundsMin, float cellSize) {
+    uint64_t key = 0;
+
+    for (uint32_t c = 0; c < 3; c++) {
+        key = (key << 21) | static_cast<uint64_t>(std::floor((position[c] - boundsMin[c]) / cellSize));
+    }
+
+    return key;
+}
+
+// Vertex clustering, every vertex in a grid cell collapses onto the original vertex closest to the
+// cell average so lods keep indexing the lod 0 vertex blob. The error is the largest distance a
+// vertex moved. Each lod is simplified from lod 0 so the error doesn't accumulate.
+static bool simplifyLod(const ImportedMesh& mesh, uint32_t lodIndexCount, const float* boundsMin, float cellSize, std::vector<uint32_t>* indexList, float* error) {
+
+    std::unordered_map<uint64_t, uint32_t> cellMap;
+    std::vector<uint32_t> clusterList(mesh.vertexList.size(), UINT32_MAX);
+    std::vector<float> centerList;
+    std::vector<uint32_t> countList;
+
+    for (uint32_t i = 0; i < lodIndexCount; i++) {
+        uint32_t vertex = mesh.indexList[i];
+
+        if (clusterList[vertex] != UINT32_MAX) {
+            continue;
+        }
+
+        auto [cell, isNew] = cellMap.emplace(clusterKey(mesh.vertexList[vertex].position, boundsMin, cellSize), static_cast<uint32_t>(countList.size()));
+
+        if (isNew) {
+            centerList.insert(centerList.end(), { 0.0f, 0.0f, 0.0f });
+            countList.push_back(0);
+        }
+
+        clusterList[vertex] = cell->second;
+
+        for (uint32_t c = 0; c < 3; c++) {
+            centerList[cell->second * 3 + c] += mesh.vertexList[vertex].position[c];
+        }
+        countList[cell->second]++;
+    }
+
+    std::vector<uint32_t> representativeList(countList.size(), UINT32_MAX);
+    std::vector<float> distanceList(countList.size(), FLT_MAX);
+
+    for (uint32_t vertex = 0; vertex < mesh.vertexList.size(); vertex++) {
+        uint32_t cluster = clusterList[vertex];
+
+        if (cluster == UINT32_MAX) {
+            continue;
+        }
+
+        float distance = 0.0f;
+
+        for (uint32_t c = 0; c < 3; c++) {
+            float delta = mesh.vertexList[vertex].position[c] - centerList[cluster * 3 + c] / countList[cluster];
+            distance += delta * delta;
+        }
+
+        if (distance < distanceList[cluster]) {
+            distanceList[cluster] = distance;
+            representativeList[cluster] = vertex;
+        }
+    }
+
+    indexList->clear();
+    float maxDistance = 0.0f;
+
+    for (uint32_t vertex = 0; vertex < mesh.vertexList.size(); vertex++) {
+        if (clusterList[vertex] == UINT32_MAX) {
+            continue;
+        }
+
+        const float* position = mesh.vertexList[vertex].position;
+        const float* representative = mesh.vertexList[representativeList[clusterList[vertex]]].position;
+        float distance = 0.0f;
+
+        for (uint32_t c = 0; c < 3; c++) {
+            distance += (position[c] - representative[c]) * (position[c] - representative[c]);
+        }
+
+        maxDistance = std::max(maxDistance, distance);
+    }
+
+    for (uint32_t i = 0; i + 2 < lodIndexCount; i += 3) {
+        uint32_t a = representativeList[clusterList[mesh.indexList[i + 0]]];
+        uint32_t b = representativeList[clusterList[mesh.indexList[i + 1]]];
+        uint32_t c = representativeList[clusterList[mesh.indexList[i + 2]]];
+
+        // triangles inside a single cell collapse
+        if (a == b || b == c || a == c) {
+            continue;
+        }
+
+        indexList->insert(indexList->end(), { a, b, c });
+    }
+
+    *error = std::sqrt(maxDistance);
+
+    return !indexList->empty();
+}
+
+static void generateLods(ImportedMesh* mesh) {
+
+    uint32_t lodIndexCount = static_cast<uint32_t>(mesh->indexList.size());
+
+    mesh->lodList.assign(1, {});
+    mesh->lodList[0].indexCount = lodIndexCount;
+
+    VulkronMeshFileHeader bounds = {};
+    computeBounds(*mesh, &bounds);
+
+    float extent = 0.0f;
+    for (uint32_t c = 0; c < 3; c++) {
+        extent = std::max(extent, bounds.boundsMax[c] - bounds.boundsMin[c]);
+    }
+
+    if (extent <= 0.0f) {
+        return;
+    }
+
+    // a surface has about gridSize^2 occupied cells, start a little under the vertex density of lod 0
+    float gridSize = std::sqrt(static_cast<float>(mesh->vertexList.size())) * 0.5f;
+    uint32_t previousIndexCount = lodIndexCount;
+    std::vector<uint32_t> indexList;
+
+    while (mesh->lodList.size() < VULKRON_MESH_MAX_LODS && gridSize >= 2.0f && previousIndexCount / 3 > LOD_MIN_TRIANGLES) {
+        float error = 0.0f;
+
+        if (!simplifyLod(*mesh, lodIndexCount, bounds.boundsMin, extent / gridSize, &indexList, &error)) {
+            break;
+        }
+
+        gridSize *= LOD_GRID_SHRINK;
+
+        if (indexList.size() > previousIndexCount * (1.0f - LOD_MIN_REDUCTION)) {
+            continue;
+        }
+
+        VulkronMeshFileLod lod = {};
+        lod.indexOffset = static_cast<uint32_t>(mesh->indexList.size());
+        lod.indexCount = static_cast<uint32_t>(indexList.size());
+        lod.error = error;
+
+        mesh->indexList.insert(mesh->indexList.end(), indexList.begin(), indexList.end());
+        mesh->lodList.push_back(lod);
+        previousIndexCount = lod.indexCount;
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [OPTIMIZE] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static const int32_t                        VERTEX_CACHE_SIZE       = 32;
+static const uint32_t                       FIFO_CACHE_SIZE         = 16;      // used to find cluster boundaries for overdraw sorting
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+static float vertexCacheScore(int32_t cachePosition, uint32_t remainingValence) {
+
+    if (remainingValence == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+
+    if (cachePosition >= 0) {
+        // the last triangle's vertices score the same so the next triangle doesn't just reuse the same edge
+        if (cachePosition < 3) {
+            score = 0.75f;
+        }
+        else {
+            score = std::pow(1.0f - static_cast<float>(cachePosition - 3) / (VERTEX_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+
+    // favour vertices with few triangles left so they don't get stranded
+    return score + 2.0f / std::sqrt(static_cast<float>(remainingValence));
+}
+
+// Reorders the triangles of one index range for the post transform cache
+static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount) {
+
+    size_t triangleCount = indexCount / 3;
+
+    std::vector<uint32_t> valenceList(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; i++) {
+        valenceList[indices[i]]++;
+    }
+
+    // triangles adjacent to every vertex, packed
+    std::vector<uint32_t> adjacencyOffsetList(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsetList[v + 1] = adjacencyOffsetList[v] + valenceList[v];
+    }
+
+    std::vector<uint32_t> adjacencyList(indexCount);
+    std::vector<uint32_t> fillList(adjacencyOffsetList.begin(), adjacencyOffsetList.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            adjacencyList[fillList[indices[t * 3 + c]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<int32_t> cachePositionList(vertexCount, -1);
+    std::vector<float> vertexScoreList(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++) {
+        vertexScoreList[v] = vertexCacheScore(-1, valenceList[v]);
+    }
+
+    std::vector<float> triangleScoreList(triangleCount);
+    std::vector<bool> isEmittedList(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScoreList[t] = vertexScoreList[indices[t * 3]] + vertexScoreList[indices[t * 3 + 1]] + vertexScoreList[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> outputList;
+    outputList.reserve(indexCount);
+
+    std::vector<uint32_t> cache;
+    size_t scanCursor = 0;
+
+    while (outputList.size() < indexCount) {
+
+        // best triangle touching the cache, fall back to a linear scan when the cache has nothing left
+        int64_t bestTriangle = -1;
+        float bestScore = -1.0f;
+
+        for (uint32_t vertex : cache) {
+            for (uint32_t a = adjacencyOffsetList[vertex]; a < adjacencyOffsetList[vertex + 1]; a++) {
+                uint32_t triangle = adjacencyList[a];
+                if (!isEmittedList[triangle] && triangleScoreList[triangle] > bestScore) {
+                    bestScore = triangleScoreList[triangle];
+                    bestTriangle = triangle;
+                }
+            }
+        }
+
+        if (bestTriangle < 0) {
+            while (isEmittedList[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = static_cast<int64_t>(scanCursor);
+        }
+
+        isEmittedList[bestTriangle] = true;
+
+        std::vector<uint32_t> newCache;
+        newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+        for (uint32_t c = 0; c < 3; c++) {
+            uint32_t vertex = indices[bestTriangle * 3 + c];
+            outputList.push_back(vertex);
+            valenceList[vertex]--;
+            newCache.push_back(vertex);
+        }
+
+        for (uint32_t vertex : cache) {
+            if (std::find(newCache.begin(), newCache.end(), vertex) == newCache.end()) {
+                newCache.push_back(vertex);
+            }
+        }
+
+        // vertices pushed out of the cache still need their score updated
+        for (size_t i = 0; i < newCache.size(); i++) {
+            uint32_t vertex = newCache[i];
+            cachePositionList[vertex] = i < static_cast<size_t>(VERTEX_CACHE_SIZE) ? static_cast<int32_t>(i) : -1;
+
+            float newScore = vertexCacheScore(cachePositionList[vertex], valenceList[vertex]);
+            float delta = newScore - vertexScoreList[vertex];
+            vertexScoreList[vertex] = newScore;
+
+            for (uint32_t a = adjacencyOffsetList[vertex]; a < adjacencyOffsetList[vertex + 1]; a++) {
+                triangleScoreList[adjacencyList[a]] += delta;
+            }
+        }
+
+        if (newCache.size() > static_cast<size_t>(VERTEX_CACHE_SIZE)) {
+            newCache.resize(VERTEX_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+    }
+
+    memcpy(indices, outputList.data(), indexCount * sizeof(uint32_t));
+}
+
+// Splits the cache optimized order into clusters wherever the cache restarts, then draws
+// the clusters facing away from the mesh center first so occluders tend to go down early.
+// Clusters stay intact so the cache efficiency is kept.
+static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<VulkronMeshFileVertex>& vertexList) {
+
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2) {
+        return;
+    }
+
+    std::vector<size_t> clusterStartList;
+    std::vector<uint32_t> fifo;
+    uint32_t fifoHead = 0;
+
+    for (size_t t = 0; t < triangleCount; t++) {
+        uint32_t misses = 0;
+
+        for (uint32_t c = 0; c < 3; c++) {
+            uint32_t vertex = indices[t * 3 + c];
+            if (std::find(fifo.begin(), fifo.end(), vertex) == fifo.end()) {
+                misses++;
+                if (fifo.size() < FIFO_CACHE_SIZE) {
+                    fifo.push_back(vertex);
+                }
+                else {
+                    fifo[fifoHead] = vertex;
+                    fifoHead = (fifoHead + 1) % FIFO_CACHE_SIZE;
+                }
+            }
+        }
+
+        if (t == 0 || misses == 3) {
+            clusterStartList.push_back(t);
+        }
+    }
+
+    float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+    for (size_t i = 0; i < indexCount; i++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            meshCenter[c] += vertexList[indices[i]].position[c] / static_cast<float>(indexCount);
+        }
+    }
+
+    typedef struct Cluster {
+        size_t                              firstTriangle;
+        size_t                              triangleCount;
+        float                               sortKey;
+    } Cluster;
+
+    std::vector<Cluster> clusterList;
+
+    for (size_t i = 0; i < clusterStartList.size(); i++) {
+        Cluster cluster = {};
+        cluster.firstTriangle = clusterStartList[i];
+        cluster.triangleCount = (i + 1 < clusterStartList.size() ? clusterStartList[i + 1] : triangleCount) - cluster.firstTriangle;
+
+        float centroid[3] = { 0.0f, 0.0f, 0.0f };
+        float normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+
+        for (size_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++) {
+            const float* p0 = vertexList[indices[t * 3]].position;
+            const float* p1 = vertexList[indices[t * 3 + 1]].position;
+            const float* p2 = vertexList[indices[t * 3 + 2]].position;
+
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (uint32_t c = 0; c < 3; c++) {
+                centroid[c] += (p0[c] + p1[c] + p2[c]) / 3.0f * triangleArea;
+                normal[c] += n[c];
+            }
+            area += triangleArea;
+        }
+
+        float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+        cluster.sortKey = 0.0f;
+        if (area > 0.0f && normalLength > 0.0f) {
+            for (uint32_t c = 0; c < 3; c++) {
+                cluster.sortKey += (centroid[c] / area - meshCenter[c]) * (normal[c] / normalLength);
+            }
+        }
+
+        clusterList.push_back(cluster);
+    }
+
+    std::stable_sort(clusterList.begin(), clusterList.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<uint32_t> outputList;
+    outputList.reserve(indexCount);
+
+    for (const auto& cluster : clusterList) {
+        outputList.insert(outputList.end(), indices + cluster.firstTriangle * 3, indices + (cluster.firstTriangle + cluster.triangleCount) * 3);
+    }
+
+    memcpy(indices, outputList.data(), indexCount * sizeof(uint32_t));
+}
+
+// Vertices are stored in the order the index buffer first uses them, unused vertices are dropped
+static void optimizeVertexFetch(ImportedMesh* mesh) {
+
+    std::vector<uint32_t> remapList(mesh->vertexList.size(), UINT32_MAX);
+    std::vector<VulkronMeshFileVertex> vertexList;
+    vertexList.reserve(mesh->vertexList.size());
+
+    for (auto& index : mesh->indexList) {
+        if (remapList[index] == UINT32_MAX) {
+            remapList[index] = static_cast<uint32_t>(vertexList.size());
+            vertexList.push_back(mesh->vertexList[index]);
+        }
+        index = remapList[index];
+    }
+
+    mesh->vertexList.swap(vertexList);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [QUANTIZE] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static int16_t quantizeSnorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+static uint8_t quantizeUnorm8(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+// Round to nearest even, denormals flush to zero, out of range values clamp to infinity
+static uint16_t quantizeHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF) {
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent <= 0) {
+        return static_cast<uint16_t>(sign);
+    }
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFF;
+
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++; // may carry into the exponent, which is still the correctly rounded value
+    }
+
+    return static_cast<uint16_t>(half);
+}
+
+// Octahedral mapping, the unit sphere folded onto a square
+static void encodeOctahedral(const float* normal, int16_t* encoded) {
+    float l1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    float x = l1 > 0.0f ? normal[0] / l1 : 0.0f;
+    float y = l1 > 0.0f ? normal[1] / l1 : 0.0f;
+
+    if (normal[2] < 0.0f) {
+        float foldedX = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+
+    encoded[0] = quantizeSnorm16(x);
+    encoded[1] = quantizeSnorm16(y);
+}
+
+// Positions are stored relative to the bounds so the full 16 bit range covers the mesh
+static std::vector<VulkronMeshPackedVertex> quantizeVertices(const ImportedMesh& mesh, VulkronMeshFileHeader* header) {
+
+    for (uint32_t c = 0; c < 3; c++) {
+        header->positionBias[c] = (header->boundsMin[c] + header->boundsMax[c]) * 0.5f;
+        header->positionScale[c] = (header->boundsMax[c] - header->boundsMin[c]) * 0.5f;
+
+        if (header->positionScale[c] <= 0.0f) {
+            header->positionScale[c] = 1.0f;
+        }
+    }
+
+    std::vector<VulkronMeshPackedVertex> packedList(mesh.vertexList.size());
+
+    for (size_t i = 0; i < mesh.vertexList.size(); i++) {
+        const VulkronMeshFileVertex& vertex = mesh.vertexList[i];
+        VulkronMeshPackedVertex& packed = packedList[i];
+
+        for (uint32_t c = 0; c < 3; c++) {
+            packed.position[c] = quantizeSnorm16((vertex.position[c] - header->positionBias[c]) / header->positionScale[c]);
+            packed.color[c] = quantizeUnorm8(vertex.color[c]);
+        }
+        packed.position[3] = 32767;
+        packed.color[3] = 255;
+
+        encodeOctahedral(vertex.normal, packed.normal);
+
+        packed.uv[0] = quantizeHalf(vertex.uv[0]);
+        packed.uv[1] = quantizeHalf(vertex.uv[1]);
+    }
+
+    return packedList;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [WRITE] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static uint64_t alignBlob(uint64_t offset) {
+    return (offset + VULKRON_MESH_BLOB_ALIGNMENT - 1) & ~static_cast<uint64_t>(VULKRON_MESH_BLOB_ALIGNMENT - 1);
+}
+
+static bool writeMesh(const std::string& filePath, const ImportedMesh& mesh, bool quantize) {
+
+    const std::vector<VulkronMeshFileLod>& lodList = mesh.lodList;
+
+    VulkronMeshFileHeader header = {};
+    header.magic = VULKRON_MESH_MAGIC;
+    header.version = VULKRON_MESH_VERSION;
+    header.vertexCount = static_cast<uint32_t>(mesh.vertexList.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indexList.size());
+    header.lodCount = static_cast<uint32_t>(lodList.size());
+
+    computeBounds(mesh, &header);
+
+    std::vector<uint8_t> vertexData;
+
+    if (quantize) {
+        std::vector<VulkronMeshPackedVertex> packedList = quantizeVertices(mesh, &header);
+
+        header.vertexFormat = VULKRON_MESH_VERTEX_FORMAT_QUANTIZED;
+        header.vertexStride = sizeof(VulkronMeshPackedVertex);
+        vertexData.assign(reinterpret_cast<const uint8_t*>(packedList.data()), reinterpret_cast<const uint8_t*>(packedList.data() + packedList.size()));
+    }
+    else {
+        for (uint32_t c = 0; c < 3; c++) {
+            header.positionScale[c] = 1.0f;
+            header.positionBias[c] = 0.0f;
+        }
+
+        header.vertexFormat = VULKRON_MESH_VERTEX_FORMAT_FLOAT;
+        header.vertexStride = sizeof(VulkronMeshFileVertex);
+        vertexData.assign(reinterpret_cast<const uint8_t*>(mesh.vertexList.data()), reinterpret_cast<const uint8_t*>(mesh.vertexList.data() + mesh.vertexList.size()));
+    }
+
+    // 16 bit indices whenever every vertex can be addressed with them
+    std::vector<uint8_t> indexData;
+
+    if (mesh.vertexList.size() <= 65536) {
+        std::vector<uint16_t> shortIndexList(mesh.indexList.begin(), mesh.indexList.end());
+
+        header.indexType = VULKRON_MESH_INDEX_TYPE_UINT16;
+        indexData.assign(reinterpret_cast<const uint8_t*>(shortIndexList.data()), reinterpret_cast<const uint8_t*>(shortIndexList.data() + shortIndexList.size()));
+    }
+    else {
+        header.indexType = VULKRON_MESH_INDEX_TYPE_UINT32;
+        indexData.assign(reinterpret_cast<const uint8_t*>(mesh.indexList.data()), reinterpret_cast<const uint8_t*>(mesh.indexList.data() + mesh.indexList.size()));
+    }
+
+    header.lodTableOffset = sizeof(VulkronMeshFileHeader);
+    header.vertexDataOffset = alignBlob(header.lodTableOffset + lodList.size() * sizeof(VulkronMeshFileLod));
+    header.vertexDataSize = vertexData.size();
+    header.indexDataOffset = alignBlob(header.vertexDataOffset + header.vertexDataSize);
+    header.indexDataSize = indexData.size();
+    header.fileSize = header.indexDataOffset + header.indexDataSize;
+
+    std::vector<uint8_t> fileData(header.fileSize, 0);
+    memcpy(fileData.data(), &header, sizeof(header));
+    memcpy(fileData.data() + header.lodTableOffset, lodList.data(), lodList.size() * sizeof(VulkronMeshFileLod));
+    memcpy(fileData.data() + header.vertexDataOffset, vertexData.data(), vertexData.size());
+    memcpy(fileData.data() + header.indexDataOffset, indexData.data(), indexData.size());
+
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+
+    return file.good();
+}
+
+int main(int argc, char** argv) {
+
+    if (argc < 3) {
+        std::cerr << "usage: VulkronMeshConverter [--float] <input.obj|input.gltf|input.glb> <output.vmesh>" << std::endl;
+        return 1;
+    }
+
+    bool quantize = true;
+    int argument = 1;
+
+    if (std::string(argv[argument]) == "--float") {
+        quantize = false;
+        argument++;
+    }
+
+    if (argc - argument < 2) {
+        std::cerr << "usage: VulkronMeshConverter [--float] <input.obj|input.gltf|input.glb> <output.vmesh>" << std::endl;
+        return 1;
+    }
+
+    std::string inputPath = argv[argument];
+    std::string outputPath = argv[argument + 1];
+
+    std::string extension = inputPath.substr(inputPath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    ImportedMesh mesh;
+    bool isImported = false;
+
+    if (extension == "obj") {
+        isImported = importObj(inputPath, &mesh);
+    }
+    else if (extension == "gltf" || extension == "glb") {
+        isImported = importGltf(inputPath, &mesh);
+    }
+    else {
+        std::cerr << "unsupported file type: " << extension << std::endl;
+        return 1;
+    }
+
+    if (!isImported) {
+        std::cerr << "failed to import " << inputPath << std::endl;
+        return 1;
+    }
+
+    if (!mesh.hasNormals) {
+        generateNormals(&mesh);
+    }
+
+    generateLods(&mesh);
+
+    // every lod is its own draw so they are optimized separately, vertex fetch goes over all of them
+    // with lod 0 first so it keeps the tightest vertex order
+    for (const auto& lod : mesh.lodList) {
+        optimizeVertexCache(mesh.indexList.data() + lod.indexOffset, lod.indexCount, mesh.vertexList.size());
+        optimizeOverdraw(mesh.indexList.data() + lod.indexOffset, lod.indexCount, mesh.vertexList);
+    }
+
+    optimizeVertexFetch(&mesh);
+
+    if (!writeMesh(outputPath, mesh, quantize)) {
+        std::cerr << "failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << outputPath << ": " << mesh.vertexList.size() << " vertices, " << mesh.lodList[0].indexCount / 3 << " triangles, " << mesh.lodList.size() << " lods" << std::endl;
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #pragma once
 
 #include "VulkronCore.h"
+#include "VulkronAsync.h"
 
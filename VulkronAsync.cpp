@@ -0,0 +1,266 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Coroutine loading on top of the existing streaming
+
+    1. every async load is an operation with a poll function, polled once per frame on the render thread
+    2. meshes and textures already load on the worker threads, their poll only watches the state
+    3. shaders and compute pipelines are built by a worker job, their poll waits for the job and finishes on the render thread
+    4. a coroutine awaiting an unfinished load waits in the waiter list until its state is done
+
+    Operations and waiters are only touched on the render thread, the one flag a job sets from a worker
+    is its own atomic. Resuming happens in vulkronDrawFrame once the frame's transfer batch went out,
+    so whatever became resident in that submit is seen by the coroutines resumed right after it.
+
+*/
+
+AsyncInternal*  asyncInternal   = new AsyncInternal();
+
+template<typename T>
+static VulkronAsync<T> startAsyncOperation(std::shared_ptr<VulkronAsyncValue<T>> state, std::function<bool()> poll);
+template<typename T>
+static VulkronAsync<T> startAsyncJob(std::function<T()> job, std::function<void(T&)> finish);
+template<typename T>
+static VulkronAsync<T> failAsync(const char* message);
+static void destroySpawnedTasks(bool rethrow);
+
+//-------------------------------------------------------------------------------------
+// SECTION [TASKS] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+void vulkronSpawnTask(VulkronTask<void> task) {
+
+    std::coroutine_handle<VulkronTask<void>::promise_type> handle = task.release();
+
+    if (!handle) {
+        return;
+    }
+
+    asyncInternal->taskList.push_back(handle);
+    handle.resume();
+
+    // the task may have finished, or thrown, without ever waiting
+    destroySpawnedTasks(true);
+}
+
+void vulkronAwaitAsync(std::shared_ptr<VulkronAsyncState> state, std::coroutine_handle<> handle) {
+    asyncInternal->waiterList.push_back({ std::move(state), handle });
+}
+
+// Called once per frame after the transfer batch is submitted
+void resumeAsyncTasks() {
+
+    auto& operationList = asyncInternal->operationList;
+
+    // a poll that throws fails its load, the exception reaches whoever awaits it
+    operationList.erase(std::remove_if(operationList.begin(), operationList.end(), [](AsyncOperation& operation) {
+        try {
+            return operation.poll();
+        }
+        catch (...) {
+            operation.state->exception = std::current_exception();
+            operation.state->isDone = true;
+            return true;
+        }
+    }), operationList.end());
+
+    // resumed coroutines can start waiting again, only the waiters from before are looked at
+    std::vector<AsyncWaiter> waiterList;
+    waiterList.swap(asyncInternal->waiterList);
+
+    for (AsyncWaiter& waiter : waiterList) {
+        if (waiter.state->isDone) {
+            waiter.handle.resume();
+        }
+        else {
+            asyncInternal->waiterList.push_back(std::move(waiter));
+        }
+    }
+
+    destroySpawnedTasks(true);
+}
+
+// Spawned tasks own every task they're awaiting, destroying them takes the whole chain with them
+void destroyAsyncTasks() {
+
+    for (auto handle : asyncInternal->taskList) {
+        handle.destroy();
+    }
+
+    delete asyncInternal;
+    asyncInternal = nullptr;
+}
+
+static void destroySpawnedTasks(bool rethrow) {
+
+    std::exception_ptr exception;
+    auto& taskList = asyncInternal->taskList;
+
+    taskList.erase(std::remove_if(taskList.begin(), taskList.end(), [&](std::coroutine_handle<VulkronTask<void>::promise_type> handle) {
+        if (!handle.done()) {
+            return false;
+        }
+
+        if (!exception) {
+            exception = handle.promise().exception;
+        }
+
+        handle.destroy();
+        return true;
+    }), taskList.end());
+
+    if (rethrow && exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [LOADS] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronAsync<VulkronMesh> vulkronLoadMeshAsync(const std::string& filePath) {
+
+    VulkronMesh mesh = nullptr;
+
+    VulkronMeshCreateInfo meshInfo = {};
+    meshInfo.filePath = filePath;
+    meshInfo.pMesh = &mesh;
+
+    if (vulkronLoadMesh(&meshInfo) != VULKRON_SUCCESS) {
+        return failAsync<VulkronMesh>("failed to load mesh!");
+    }
+
+    auto state = std::make_shared<VulkronAsyncValue<VulkronMesh>>();
+    state->value = mesh;
+
+    return startAsyncOperation<VulkronMesh>(state, [mesh] {
+        return !mesh->isLoading && (mesh->state == VULKRON_MESH_STATE_RESIDENT || mesh->state == VULKRON_MESH_STATE_FAILED);
+    });
+}
+
+VulkronAsync<VulkronTexture> vulkronLoadTextureAsync(const VulkronTextureCreateInfo& info) {
+
+    VulkronTexture texture = nullptr;
+
+    VulkronTextureCreateInfo textureInfo = info;
+    textureInfo.pTexture = &texture;
+
+    if (vulkronCreateTexture(&textureInfo) != VULKRON_SUCCESS) {
+        return failAsync<VulkronTexture>("failed to load texture!");
+    }
+
+    auto state = std::make_shared<VulkronAsyncValue<VulkronTexture>>();
+    state->value = texture;
+
+    return startAsyncOperation<VulkronTexture>(state, [texture] {
+        return texture->state == VULKRON_TEXTURE_STATE_PARTIALLY_RESIDENT || texture->state == VULKRON_TEXTURE_STATE_RESIDENT ||
+            texture->state == VULKRON_TEXTURE_STATE_FAILED;
+    });
+}
+
+// Only the file read and vkCreateShaderModule run on the worker, the module list isn't thread safe
+VulkronAsync<VkPipelineShaderStageCreateInfo> vulkronLoadShaderAsync(const std::string& shaderPath, VkShaderStageFlagBits stage) {
+
+    if (shaderPath.empty()) {
+        return failAsync<VkPipelineShaderStageCreateInfo>("failed to open file!");
+    }
+
+    return startAsyncJob<VkPipelineShaderStageCreateInfo>([shaderPath] {
+        VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+        shaderStageInfo.module = createShaderModule(shaderPath);
+        return shaderStageInfo;
+    }, [stage](VkPipelineShaderStageCreateInfo& shaderStageInfo) {
+        shaderStageInfo = createPipelineShaderStage(shaderStageInfo.module, stage);
+    });
+}
+
+// vulkronCreateComputePipeline doesn't touch any shared state, it can run on the worker as it is
+VulkronAsync<VulkronComputePipeline> vulkronCreateComputePipelineAsync(const VulkronComputePipelineCreateInfo& info) {
+
+    if (info.shaderPath.empty()) {
+        return failAsync<VulkronComputePipeline>("failed to create compute pipeline!");
+    }
+
+    // the caller's arrays only have to live until this returns
+    std::vector<VkDescriptorSetLayout> setLayoutList(info.pSetLayouts, info.pSetLayouts + (nullptr == info.pSetLayouts ? 0 : info.setLayoutCount));
+    std::vector<VkPushConstantRange> pushConstantRangeList(info.pPushConstantRanges, info.pPushConstantRanges + (nullptr == info.pPushConstantRanges ? 0 : info.pushConstantRangeCount));
+    std::string shaderPath = info.shaderPath;
+
+    return startAsyncJob<VulkronComputePipeline>([shaderPath, setLayoutList, pushConstantRangeList] {
+        VulkronComputePipeline computePipeline = nullptr;
+
+        VulkronComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.shaderPath = shaderPath;
+        pipelineInfo.pSetLayouts = setLayoutList.data();
+        pipelineInfo.setLayoutCount = static_cast<uint32_t>(setLayoutList.size());
+        pipelineInfo.pPushConstantRanges = pushConstantRangeList.data();
+        pipelineInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRangeList.size());
+        pipelineInfo.pPipeline = &computePipeline;
+
+        vulkronCreateComputePipeline(&pipelineInfo);
+
+        return computePipeline;
+    }, nullptr);
+}
+
+template<typename T>
+static VulkronAsync<T> startAsyncOperation(std::shared_ptr<VulkronAsyncValue<T>> state, std::function<bool()> poll) {
+
+    asyncInternal->operationList.push_back({ state, [state, poll] {
+        if (!poll()) {
+            return false;
+        }
+
+        state->isDone = true;
+        return true;
+    } });
+
+    return VulkronAsync<T>(state);
+}
+
+// The job runs on a worker thread, finish runs on the render thread once it's done and didn't throw
+template<typename T>
+static VulkronAsync<T> startAsyncJob(std::function<T()> job, std::function<void(T&)> finish) {
+
+    auto state = std::make_shared<VulkronAsyncValue<T>>();
+    auto isJobDone = std::make_shared<std::atomic<bool>>(false);
+
+    workerThreadPool->addJob([state, isJobDone, job] {
+        try {
+            state->value = job();
+        }
+        catch (...) {
+            state->exception = std::current_exception();
+        }
+
+        isJobDone->store(true, std::memory_order_release);
+    });
+
+    asyncInternal->operationList.push_back({ state, [state, isJobDone, finish] {
+        if (!isJobDone->load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        if (!state->exception && finish) {
+            finish(state->value);
+        }
+
+        state->isDone = true;
+        return true;
+    } });
+
+    return VulkronAsync<T>(state);
+}
+
+// Bad arguments surface where the result is awaited, like a failed load would
+template<typename T>
+static VulkronAsync<T> failAsync(const char* message) {
+
+    auto state = std::make_shared<VulkronAsyncValue<T>>();
+    state->exception = std::make_exception_ptr(std::runtime_error(message));
+    state->isDone = true;
+
+    return VulkronAsync<T>(state);
+}
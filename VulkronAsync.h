@@ -0,0 +1,164 @@
+#pragma once
+
+#ifndef VULKRON_ASYNC
+#define VULKRON_ASYNC
+
+#include "VulkronCore.h"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+
+// Coroutine loading, needs C++20. Every coroutine here runs on the render thread: vulkronSpawnTask starts it
+// right away and each co_await on a load resumes it inside vulkronDrawFrame, after the frame's uploads went out
+// and before anything is culled or recorded, so objects added from it are drawn that same frame.
+//
+//	VulkronTask<void> loadLevel() {
+//		VulkronAsync<VulkronMesh> rock = vulkronLoadMeshAsync("rock.vmesh");		// loads start when called
+//		VulkronAsync<VulkronMesh> tree = vulkronLoadMeshAsync("tree.vmesh");
+//		VulkronBaseObject object = {};
+//		object.mesh = co_await rock;												// and are waited on here
+//		...
+//	}
+//	vulkronSpawnTask(loadLevel());
+//
+// Exceptions from a load or a spawned task are rethrown from vulkronSpawnTask or vulkronDrawFrame, the same
+// place the synchronous calls would have thrown from. Tasks still waiting are destroyed by vulkronShutdown.
+
+// Shared between a load and whoever awaits it, only touched on the render thread
+typedef struct VulkronAsyncState {
+	bool									isDone					= false;
+	std::exception_ptr						exception;
+
+	virtual ~VulkronAsyncState() = default;
+} VulkronAsyncState;
+
+template<typename T>
+struct VulkronAsyncValue : VulkronAsyncState {
+	T										value					= {};
+};
+
+// Resumes handle in the first vulkronDrawFrame that finds the state done
+void vulkronAwaitAsync(std::shared_ptr<VulkronAsyncState> state, std::coroutine_handle<> handle);
+
+// Result of a load, co_await it from a VulkronTask or poll isDone from plain code
+template<typename T>
+class VulkronAsync {
+public:
+	explicit VulkronAsync(std::shared_ptr<VulkronAsyncValue<T>> state) : state(std::move(state)) {}
+
+	bool isDone() const { return state->isDone; }
+
+	bool await_ready() const noexcept { return state->isDone; }
+	void await_suspend(std::coroutine_handle<> handle) { vulkronAwaitAsync(state, handle); }
+
+	T await_resume() {
+		if (state->exception) {
+			std::rethrow_exception(state->exception);
+		}
+		return state->value;
+	}
+
+private:
+	std::shared_ptr<VulkronAsyncValue<T>>	state;
+};
+
+// Hands control straight back to the awaiting task instead of growing the stack
+struct VulkronTaskFinalAwaiter {
+	bool await_ready() noexcept { return false; }
+
+	template<typename Promise>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+		std::coroutine_handle<> continuation = handle.promise().continuation;
+		return continuation ? continuation : std::noop_coroutine();
+	}
+
+	void await_resume() noexcept {}
+};
+
+struct VulkronTaskPromiseBase {
+	std::coroutine_handle<>					continuation;			// the task awaiting this one, none for spawned tasks
+	std::exception_ptr						exception;
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	VulkronTaskFinalAwaiter final_suspend() noexcept { return {}; }
+
+	void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template<typename T>
+struct VulkronTaskPromise : VulkronTaskPromiseBase {
+	std::optional<T>						value;
+
+	void return_value(T result) { value = std::move(result); }
+
+	T result() {
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+		return std::move(*value);
+	}
+};
+
+template<>
+struct VulkronTaskPromise<void> : VulkronTaskPromiseBase {
+	void return_void() {}
+
+	void result() {
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+};
+
+// A coroutine that starts when it's awaited or spawned, owns its frame until then
+template<typename T = void>
+class VulkronTask {
+public:
+	struct promise_type : VulkronTaskPromise<T> {
+		VulkronTask get_return_object() { return VulkronTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	VulkronTask(VulkronTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	VulkronTask(const VulkronTask&) = delete;
+	VulkronTask& operator=(const VulkronTask&) = delete;
+
+	~VulkronTask() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	bool await_ready() const noexcept { return false; }
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaitingHandle) noexcept {
+		handle.promise().continuation = awaitingHandle;
+		return handle;
+	}
+
+	T await_resume() { return handle.promise().result(); }
+
+	// gives up ownership of the frame, vulkronSpawnTask takes it from here
+	std::coroutine_handle<promise_type> release() { return std::exchange(handle, nullptr); }
+
+private:
+	explicit VulkronTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+	std::coroutine_handle<promise_type>		handle;
+};
+
+// Runs the task until its first co_await, the engine keeps it alive until it returns
+void vulkronSpawnTask(VulkronTask<void> task);
+
+// The mesh is resident or failed when this resumes, check with vulkronGetMeshInfo. Don't destroy it before then.
+VulkronAsync<VulkronMesh> vulkronLoadMeshAsync(const std::string& filePath);
+// Resumes once the texture can be sampled (partially resident is enough) or failed, info.pTexture is ignored
+VulkronAsync<VulkronTexture> vulkronLoadTextureAsync(const VulkronTextureCreateInfo& info);
+// The module is read and created on a worker thread, kept until shutdown like vulkronCreatePipelineShaderStage's
+VulkronAsync<VkPipelineShaderStageCreateInfo> vulkronLoadShaderAsync(const std::string& shaderPath, VkShaderStageFlagBits stage);
+// Built on a worker thread, the layout and push constant arrays are copied and info.pPipeline is ignored
+VulkronAsync<VulkronComputePipeline> vulkronCreateComputePipelineAsync(const VulkronComputePipelineCreateInfo& info);
+
+#endif // VULKRON_ASYNC
@@ -0,0 +1,368 @@
+#include "VulkronInternal.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+/*
+
+    Batch offscreen rendering, thumbnails and previews in bulk
+
+    1. every frame in flight gets its own offscreen color and depth target plus a host visible copy buffer
+    2. a job is recorded like a window frame but into its frame's target, the color attachment is copied
+       into the copy buffer at the end of the same command buffer
+    3. nothing is acquired or presented, the next job starts as soon as a frame in flight is free
+    4. once a frame's fence has signaled, its pixels are copied out and a worker thread swizzles, encodes and writes them
+
+    The render thread only waits on the gpu and, once maxPendingWrites images are queued, on the writers.
+    Which of the two it waits on shows up in VulkronBatchStatistics, images per second is what this is tuned for.
+
+*/
+
+BatchInternal*  batchInternal   = new BatchInternal();
+
+static void createBatchTarget(RenderTarget* pTarget, BatchFrame* pFrame);
+static void createTargetImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage* pImage, VkImageView* pView, MemoryAllocation* pMemory);
+static void destroyBatchTargets();
+static void writeBatchImage(const BatchJob& job, std::vector<uint8_t>& pixelList, VkExtent2D extent, bool isBgra);
+
+//-------------------------------------------------------------------------------------
+// SECTION [TARGETS] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronCreateBatchRenderer(const VulkronBatchRendererCreateInfo* pInfo) {
+
+    if (nullptr == pInfo || pInfo->width == 0 || pInfo->height == 0 || pInfo->maxPendingWrites == 0) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // the frames in flight and the pipelines the jobs are drawn with have to exist already
+    if (drawInternal->frameContextList.empty() || (!deviceInternal->hasDynamicRendering && (nullptr == pipeline || nullptr == pipeline->pRenderPass))) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // the pipelines were built for the swapchain format, the writers only know 8 bit rgba
+    switch (swapchainInternal->swapChainImageFormat) {
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        batchInternal->isBgra = true;
+        break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        batchInternal->isBgra = false;
+        break;
+    default:
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    destroyBatchTargets();
+
+    batchInternal->extent = { pInfo->width, pInfo->height };
+    batchInternal->maxPendingWrites = pInfo->maxPendingWrites;
+    batchInternal->targetList.resize(MAX_FRAMES_IN_FLIGHT);
+    batchInternal->frameList.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        createBatchTarget(&batchInternal->targetList[i], &batchInternal->frameList[i]);
+    }
+
+    batchInternal->isCreated = true;
+
+    return VULKRON_SUCCESS;
+}
+
+// Queued jobs are dropped. vulkronRunBatchJobs retires every frame it rendered, none of them is still on the gpu.
+VulkronResult vulkronDestroyBatchRenderer() {
+
+    batchInternal->jobList.clear();
+    destroyBatchTargets();
+
+    return VULKRON_SUCCESS;
+}
+
+void destroyBatchRenderer() {
+    vulkronDestroyBatchRenderer();
+
+    delete batchInternal;
+    batchInternal = nullptr;
+}
+
+static void destroyBatchTargets() {
+
+    if (!batchInternal->isCreated) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    for (uint32_t i = 0; i < batchInternal->targetList.size(); i++) {
+        RenderTarget& target = batchInternal->targetList[i];
+        BatchFrame& frame = batchInternal->frameList[i];
+
+        if (target.frameBuffer != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(logicalDevice, target.frameBuffer, nullptr);
+        }
+
+        vkDestroyImageView(logicalDevice, target.view, nullptr);
+        vkDestroyImage(logicalDevice, target.image, nullptr);
+        freeMemory(&frame.colorMemory);
+        vkDestroyImageView(logicalDevice, target.depthView, nullptr);
+        vkDestroyImage(logicalDevice, target.depthImage, nullptr);
+        freeMemory(&frame.depthMemory);
+        destroyBuffer(&frame.copyBuffer);
+    }
+
+    batchInternal->targetList.clear();
+    batchInternal->frameList.clear();
+    batchInternal->isCreated = false;
+}
+
+static void createBatchTarget(RenderTarget* pTarget, BatchFrame* pFrame) {
+
+    VkExtent2D extent = batchInternal->extent;
+
+    pTarget->extent = extent;
+    pTarget->isSwapchain = false;
+
+    createTargetImage(swapchainInternal->swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+        &pTarget->image, &pTarget->view, &pFrame->colorMemory);
+    createTargetImage(swapchainInternal->depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT,
+        &pTarget->depthImage, &pTarget->depthView, &pFrame->depthMemory);
+
+    // same attachments in the same order as the swapchain framebuffers, so the pipelines' render pass is compatible
+    if (!deviceInternal->hasDynamicRendering) {
+        VkImageView attachments[] = { pTarget->view, pTarget->depthView };
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = *pipeline->pRenderPass;
+        framebufferInfo.attachmentCount = 2;
+        framebufferInfo.pAttachments = attachments;
+        framebufferInfo.width = extent.width;
+        framebufferInfo.height = extent.height;
+        framebufferInfo.layers = 1;
+
+        if (vkCreateFramebuffer(deviceInternal->logicalDevice, &framebufferInfo, nullptr, &pTarget->frameBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create batch framebuffer!");
+        }
+    }
+
+    createBuffer(static_cast<VkDeviceSize>(extent.width) * extent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, getReadbackMemoryFlags(), &pFrame->copyBuffer);
+    pTarget->copyBuffer = pFrame->copyBuffer.buffer;
+
+    VkMemoryPropertyFlags typeFlags = deviceInternal->gpuMemoryProperties.memoryTypes[pFrame->copyBuffer.memory.memoryTypeIndex].propertyFlags;
+    pFrame->isCoherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+static void createTargetImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect, VkImage* pImage, VkImageView* pView, MemoryAllocation* pMemory) {
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { batchInternal->extent.width, batchInternal->extent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(deviceInternal->logicalDevice, &imageInfo, nullptr, pImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(deviceInternal->logicalDevice, *pImage, &requirements);
+    allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pMemory);
+    vkBindImageMemory(deviceInternal->logicalDevice, *pImage, pMemory->memory, pMemory->offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = *pImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = aspect;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(deviceInternal->logicalDevice, &viewInfo, nullptr, pView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create batch image view!");
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [JOBS] ---------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronQueueBatchJob(const VulkronBatchJob* pJob, uint64_t* pJobIndex) {
+
+    if (nullptr == pJob || !batchInternal->isCreated || (pJob->outputPath.empty() && nullptr == pJob->pfnImageCallback)) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint64_t jobIndex = batchInternal->nextJobIndex++;
+    batchInternal->jobList.push_back({ jobIndex, *pJob });
+
+    if (nullptr != pJobIndex) {
+        *pJobIndex = jobIndex;
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronRunBatchJobs(VulkronBatchStatistics* pStatistics) {
+
+    if (!batchInternal->isCreated) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    batchInternal->imageCount = 0;
+    batchInternal->writerWaitSeconds = 0.0;
+
+    {
+        std::lock_guard<std::mutex> lock(batchInternal->writeMutex);
+        batchInternal->failedWriteCount = 0;
+    }
+
+    VulkronCamera windowCamera = cullingInternal->camera;
+    bool hasWindowCamera = cullingInternal->hasCamera;
+
+    // the prepare callback may queue more jobs, they're rendered in this run as well
+    while (!batchInternal->jobList.empty()) {
+        BatchJob job = std::move(batchInternal->jobList.front());
+        batchInternal->jobList.pop_front();
+
+        if (nullptr != job.job.pfnPrepareCallback) {
+            job.job.pfnPrepareCallback(job.jobIndex, job.job.pUserData);
+        }
+
+        VulkronCamera camera = job.job.camera;
+
+        if (camera.viewportHeight <= 0.0f) {
+            camera.viewportHeight = static_cast<float>(batchInternal->extent.height);
+        }
+
+        vulkronSetCamera(&camera);
+
+        // the frame's previous job was retired while it waited on the fence
+        uint32_t frameIndex = drawOffscreenFrame(batchInternal->targetList, job.job.clearColor);
+
+        BatchFrame& frame = batchInternal->frameList[frameIndex];
+        frame.job = std::move(job);
+        frame.isInFlight = true;
+    }
+
+    // the last frames aren't reused by another job, they're retired here
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (batchInternal->frameList[i].isInFlight) {
+            vkWaitForFences(deviceInternal->logicalDevice, 1, &drawInternal->inFlightFences[i], VK_TRUE, UINT64_MAX);
+            retireBatchFrame(i);
+        }
+    }
+
+    vulkronSetCamera(hasWindowCamera ? &windowCamera : nullptr);
+
+    uint32_t failedWriteCount = 0;
+
+    {
+        std::unique_lock<std::mutex> lock(batchInternal->writeMutex);
+        batchInternal->writeCondition.wait(lock, [] { return batchInternal->pendingWriteCount == 0; });
+        failedWriteCount = batchInternal->failedWriteCount;
+    }
+
+    if (nullptr != pStatistics) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        pStatistics->imageCount = batchInternal->imageCount;
+        pStatistics->failedWriteCount = failedWriteCount;
+        pStatistics->seconds = seconds;
+        pStatistics->imagesPerSecond = seconds > 0.0 ? batchInternal->imageCount / seconds : 0.0;
+        pStatistics->writerWaitSeconds = batchInternal->writerWaitSeconds;
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [WRITERS] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called once the frame's fence was waited on, window frames never have a batch job in flight
+void retireBatchFrame(uint32_t frameIndex) {
+
+    if (!batchInternal->isCreated || !batchInternal->frameList[frameIndex].isInFlight) {
+        return;
+    }
+
+    BatchFrame& frame = batchInternal->frameList[frameIndex];
+    frame.isInFlight = false;
+
+    // slow writers hold back rendering instead of piling up pixels
+    {
+        std::unique_lock<std::mutex> lock(batchInternal->writeMutex);
+
+        if (batchInternal->pendingWriteCount >= batchInternal->maxPendingWrites) {
+            auto waitTime = std::chrono::steady_clock::now();
+
+            batchInternal->writeCondition.wait(lock, [] { return batchInternal->pendingWriteCount < batchInternal->maxPendingWrites; });
+            batchInternal->writerWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitTime).count();
+        }
+
+        batchInternal->pendingWriteCount++;
+    }
+
+    VkExtent2D extent = batchInternal->extent;
+    VkDeviceSize size = frame.copyBuffer.size;
+
+    if (!frame.isCoherent) {
+        invalidateMemory(frame.copyBuffer.memory, 0, size);
+    }
+
+    // the copy buffer is recorded into again by the next job, the writer gets its own pixels
+    const uint8_t* pMappedData = static_cast<const uint8_t*>(frame.copyBuffer.memory.pMappedData);
+    auto pixelList = std::make_shared<std::vector<uint8_t>>(pMappedData, pMappedData + size);
+    bool isBgra = batchInternal->isBgra;
+
+    workerThreadPool->addJob([job = frame.job, pixelList, extent, isBgra] {
+        writeBatchImage(job, *pixelList, extent, isBgra);
+    });
+
+    batchInternal->imageCount++;
+}
+
+// Runs on a worker thread, only the write counts are shared
+static void writeBatchImage(const BatchJob& job, std::vector<uint8_t>& pixelList, VkExtent2D extent, bool isBgra) {
+    VULKRON_TRACE_SCOPE("batch", "writeBatchImage");
+
+    if (isBgra) {
+        for (size_t i = 0; i < pixelList.size(); i += 4) {
+            std::swap(pixelList[i], pixelList[i + 2]);
+        }
+    }
+
+    bool isWritten = true;
+
+    if (nullptr != job.job.pfnImageCallback) {
+        job.job.pfnImageCallback(job.jobIndex, pixelList.data(), extent.width, extent.height, job.job.pUserData);
+    }
+    else {
+        isWritten = stbi_write_png(job.job.outputPath.c_str(), extent.width, extent.height, 4, pixelList.data(), extent.width * 4) != 0;
+    }
+
+    // notified under the lock, once the waiter sees the count reach 0 batchInternal may be deleted
+    std::lock_guard<std::mutex> lock(batchInternal->writeMutex);
+    batchInternal->pendingWriteCount--;
+
+    if (!isWritten) {
+        batchInternal->failedWriteCount++;
+    }
+
+    batchInternal->writeCondition.notify_all();
+}
@@ -1,3 +1,103 @@
-
 #include "VulkronInternal.h"
 
+UploadRing*     uploadRing      = new UploadRing();
+
+//-------------------------------------------------------------------------------------
+// SECTION [BUFFER] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags propertyFlags, BufferAllocation* buffer, bool isMovable) {
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(deviceInternal->logicalDevice, &bufferInfo, nullptr, &buffer->buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetBufferMemoryRequirements(deviceInternal->logicalDevice, buffer->buffer, &memoryRequirements);
+
+    allocateMemory(memoryRequirements, propertyFlags, &buffer->memory, isMovable);
+
+    if (vkBindBufferMemory(deviceInternal->logicalDevice, buffer->buffer, buffer->memory.memory, buffer->memory.offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind buffer memory!");
+    }
+
+    buffer->size = size;
+}
+
+void destroyBuffer(BufferAllocation* buffer) {
+    if (buffer->buffer != VULKRON_NULL_HANDLE) {
+        vkDestroyBuffer(deviceInternal->logicalDevice, buffer->buffer, nullptr);
+    }
+
+    freeMemory(&buffer->memory);
+
+    *buffer = {};
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [UPLOAD RING] --------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// The upload ring is one persistently mapped staging buffer shared by every upload (textures, meshes).
+// head and tail are virtual offsets that only ever grow, the physical offset is (virtual % size).
+// Space is handed back when the transfer batch that consumed it has finished on the gpu.
+
+void createUploadRing(VkDeviceSize size) {
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &uploadRing->staging);
+
+    uploadRing->pMappedData = static_cast<uint8_t*>(uploadRing->staging.memory.pMappedData);
+    uploadRing->alignment = std::max<VkDeviceSize>(16, deviceInternal->gpuProperties.limits.optimalBufferCopyOffsetAlignment);
+    uploadRing->head = 0;
+    uploadRing->tail = 0;
+}
+
+void destroyUploadRing() {
+    destroyBuffer(&uploadRing->staging);
+
+    delete uploadRing;
+    uploadRing = nullptr;
+}
+
+bool uploadRingAllocate(VkDeviceSize size, VkDeviceSize* pOffset) {
+    return ringAllocate(uploadRing, size, uploadRing->alignment, pOffset);
+}
+
+// Readbacks run the same ring the other way round. The alignment needn't be a power of two,
+// image readbacks also need a multiple of their texel size.
+bool ringAllocate(UploadRing* ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset) {
+
+    VkDeviceSize ringSize = ring->staging.size;
+
+    if (size > ringSize) {
+        return false;
+    }
+
+    uint64_t head = ring->head;
+    VkDeviceSize physicalOffset = head % ringSize;
+    VkDeviceSize alignedOffset = (physicalOffset + alignment - 1) / alignment * alignment;
+
+    // allocations never straddle the end of the buffer, skip the remainder and wrap around
+    if (alignedOffset + size > ringSize) {
+        head += ringSize - physicalOffset;
+        alignedOffset = 0;
+    }
+    else {
+        head += alignedOffset - physicalOffset;
+    }
+
+    if (head + size - ring->tail > ringSize) {
+        return false; // ring is full until in flight batches retire, caller retries next frame
+    }
+
+    ring->head = head + size;
+    *pOffset = alignedOffset;
+
+    return true;
+}
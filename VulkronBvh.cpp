@@ -0,0 +1,582 @@
+#include "VulkronInternal.h"
+
+/*
+    Bounding volume hierarchy over object bounding spheres, one for the static and one for the dynamic objects:
+
+    1. built top down with binned SAH on the sphere centers, the first levels are split on the calling thread
+       until there are enough subtrees to hand one to each frame thread, those are built in parallel and spliced in
+    2. nodes are stored depth first, children always come after their parent, a refit walks the list backwards
+    3. leaves hold handles, not object indices, removed objects stay in the tree until the next build and are
+       skipped by whoever resolves the handle
+*/
+
+static const uint32_t                       BVH_BIN_COUNT           = 12;
+static const uint32_t                       BVH_MAX_LEAF_SIZE       = 8;       // leaves are split past this even when SAH says otherwise
+static const uint32_t                       BVH_MIN_TASK_SIZE       = 4096;    // smaller subtrees aren't worth a job of their own
+static const float                          BVH_TRAVERSAL_COST      = 1.0f;    // relative to testing one sphere
+
+typedef struct BvhBuildTask {
+    uint32_t                                nodeIndex;
+    uint32_t                                begin;
+    uint32_t                                end;
+} BvhBuildTask;
+
+static void buildBvhNode(std::vector<BvhNode>& nodeList, uint32_t nodeIndex, std::vector<BvhBuildItem>& itemList, uint32_t begin, uint32_t end,
+    uint32_t taskSize, std::vector<BvhBuildTask>* pTaskList);
+static bool findBvhSplit(const std::vector<BvhBuildItem>& itemList, uint32_t begin, uint32_t end, float parentArea, uint32_t* pAxis, float* pSplit);
+static float getSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+static bool isSphereOverlappingBox(const glm::vec4& sphere, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+static bool intersectRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+static bool intersectRaySphere(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const glm::vec4& sphere, float* pDistance);
+
+//-------------------------------------------------------------------------------------
+// SECTION [BUILD] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// itemList is reordered, leaves end up pointing at contiguous ranges of it
+void buildBvh(Bvh* bvh, std::vector<BvhBuildItem>& itemList) {
+
+    bvh->nodeList.clear();
+    bvh->itemList.clear();
+    bvh->sphereList.clear();
+
+    uint32_t itemCount = static_cast<uint32_t>(itemList.size());
+
+    if (itemCount == 0) {
+        bvh->builtCost = 0.0f;
+        return;
+    }
+
+    bvh->nodeList.emplace_back();
+
+    uint32_t threadCount = static_cast<uint32_t>(frameThreadPool->threads.size());
+    uint32_t taskSize = std::max(BVH_MIN_TASK_SIZE, itemCount / (threadCount * 4));
+
+    std::vector<BvhBuildTask> taskList;
+    buildBvhNode(bvh->nodeList, 0, itemList, 0, itemCount, taskSize, &taskList);
+
+    // every task owns a disjoint item range and builds into nodes of its own
+    std::vector<std::vector<BvhNode>> taskNodeList(taskList.size());
+
+    frameThreadPool->parallelFor(static_cast<uint32_t>(taskList.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const BvhBuildTask& task = taskList[i];
+            taskNodeList[i].emplace_back();
+            buildBvhNode(taskNodeList[i], 0, itemList, task.begin, task.end, 0, nullptr);
+        }
+    });
+
+    // the task root replaces its placeholder, the rest is appended with the child indices moved along
+    for (uint32_t i = 0; i < taskList.size(); i++) {
+        const std::vector<BvhNode>& localList = taskNodeList[i];
+        uint32_t base = static_cast<uint32_t>(bvh->nodeList.size()) - 1;
+
+        for (uint32_t j = 0; j < localList.size(); j++) {
+            BvhNode node = localList[j];
+
+            if (node.count == 0) {
+                node.first += base;
+            }
+
+            if (j == 0) {
+                bvh->nodeList[taskList[i].nodeIndex] = node;
+            }
+            else {
+                bvh->nodeList.push_back(node);
+            }
+        }
+    }
+
+    bvh->itemList.resize(itemCount);
+    bvh->sphereList.resize(itemCount);
+
+    for (uint32_t i = 0; i < itemCount; i++) {
+        bvh->itemList[i] = itemList[i].handle;
+        bvh->sphereList[i] = itemList[i].sphere;
+    }
+
+    bvh->builtCost = getBvhCost(*bvh);
+}
+
+// Leaf bounds from the current spheres, parents grown around their children. Spheres with a negative
+// radius are left out, that's how removed objects are parked until the next build.
+void refitBvh(Bvh* bvh) {
+
+    for (size_t i = bvh->nodeList.size(); i-- > 0;) {
+        BvhNode& node = bvh->nodeList[i];
+
+        node.boundsMin = glm::vec3(FLT_MAX);
+        node.boundsMax = glm::vec3(-FLT_MAX);
+
+        if (node.count == 0) {
+            for (uint32_t child = node.first; child < node.first + 2; child++) {
+                node.boundsMin = glm::min(node.boundsMin, bvh->nodeList[child].boundsMin);
+                node.boundsMax = glm::max(node.boundsMax, bvh->nodeList[child].boundsMax);
+            }
+            continue;
+        }
+
+        for (uint32_t item = node.first; item < node.first + node.count; item++) {
+            const glm::vec4& sphere = bvh->sphereList[item];
+
+            if (sphere.w < 0.0f) {
+                continue;
+            }
+
+            node.boundsMin = glm::min(node.boundsMin, glm::vec3(sphere) - sphere.w);
+            node.boundsMax = glm::max(node.boundsMax, glm::vec3(sphere) + sphere.w);
+        }
+    }
+}
+
+// SAH cost of the whole tree relative to its root, refits that let it grow too far are rebuilt
+float getBvhCost(const Bvh& bvh) {
+
+    if (bvh.nodeList.empty()) {
+        return 0.0f;
+    }
+
+    float rootArea = getSurfaceArea(bvh.nodeList[0].boundsMin, bvh.nodeList[0].boundsMax);
+    float cost = 0.0f;
+
+    for (const BvhNode& node : bvh.nodeList) {
+        if (node.boundsMin.x > node.boundsMax.x) {
+            continue;
+        }
+
+        float area = getSurfaceArea(node.boundsMin, node.boundsMax);
+        cost += node.count == 0 ? area * BVH_TRAVERSAL_COST : area * node.count;
+    }
+
+    return rootArea > 0.0f ? cost / rootArea : 0.0f;
+}
+
+static void buildBvhNode(std::vector<BvhNode>& nodeList, uint32_t nodeIndex, std::vector<BvhBuildItem>& itemList, uint32_t begin, uint32_t end,
+    uint32_t taskSize, std::vector<BvhBuildTask>* pTaskList) {
+
+    if (nullptr != pTaskList && end - begin <= taskSize) {
+        pTaskList->push_back({ nodeIndex, begin, end });
+        return;
+    }
+
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+
+    for (uint32_t i = begin; i < end; i++) {
+        boundsMin = glm::min(boundsMin, itemList[i].boundsMin);
+        boundsMax = glm::max(boundsMax, itemList[i].boundsMax);
+    }
+
+    nodeList[nodeIndex].boundsMin = boundsMin;
+    nodeList[nodeIndex].boundsMax = boundsMax;
+
+    uint32_t count = end - begin;
+    uint32_t axis = 0;
+    float split = 0.0f;
+    uint32_t middle = begin;
+
+    if (count > 1 && findBvhSplit(itemList, begin, end, getSurfaceArea(boundsMin, boundsMax), &axis, &split)) {
+        middle = static_cast<uint32_t>(std::partition(itemList.begin() + begin, itemList.begin() + end, [axis, split](const BvhBuildItem& item) {
+            return item.center[axis] < split;
+        }) - itemList.begin());
+    }
+
+    // SAH prefers a leaf, or every center is in the same place
+    if (middle == begin || middle == end) {
+        if (count <= BVH_MAX_LEAF_SIZE) {
+            nodeList[nodeIndex].first = begin;
+            nodeList[nodeIndex].count = count;
+            return;
+        }
+
+        middle = begin + count / 2;
+    }
+
+    uint32_t left = static_cast<uint32_t>(nodeList.size());
+    nodeList.emplace_back();
+    nodeList.emplace_back();
+
+    nodeList[nodeIndex].first = left;
+    nodeList[nodeIndex].count = 0;
+
+    buildBvhNode(nodeList, left, itemList, begin, middle, taskSize, pTaskList);
+    buildBvhNode(nodeList, left + 1, itemList, middle, end, taskSize, pTaskList);
+}
+
+// Cheapest bin boundary along the longest axis of the centers, false when a leaf costs less
+static bool findBvhSplit(const std::vector<BvhBuildItem>& itemList, uint32_t begin, uint32_t end, float parentArea, uint32_t* pAxis, float* pSplit) {
+
+    glm::vec3 centerMin = glm::vec3(FLT_MAX);
+    glm::vec3 centerMax = glm::vec3(-FLT_MAX);
+
+    for (uint32_t i = begin; i < end; i++) {
+        centerMin = glm::min(centerMin, itemList[i].center);
+        centerMax = glm::max(centerMax, itemList[i].center);
+    }
+
+    glm::vec3 extent = centerMax - centerMin;
+    uint32_t axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    if (extent[axis] <= 0.0f) {
+        return false;
+    }
+
+    struct Bin {
+        glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+        glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+        uint32_t count = 0;
+    } binList[BVH_BIN_COUNT];
+
+    float scale = BVH_BIN_COUNT / extent[axis];
+
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t bin = std::min(BVH_BIN_COUNT - 1, static_cast<uint32_t>((itemList[i].center[axis] - centerMin[axis]) * scale));
+        binList[bin].boundsMin = glm::min(binList[bin].boundsMin, itemList[i].boundsMin);
+        binList[bin].boundsMax = glm::max(binList[bin].boundsMax, itemList[i].boundsMax);
+        binList[bin].count++;
+    }
+
+    // sweep from the right first so every boundary knows the cost of both sides
+    float rightCostList[BVH_BIN_COUNT] = {};
+    glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+    glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+    uint32_t count = 0;
+
+    for (uint32_t i = BVH_BIN_COUNT - 1; i > 0; i--) {
+        boundsMin = glm::min(boundsMin, binList[i].boundsMin);
+        boundsMax = glm::max(boundsMax, binList[i].boundsMax);
+        count += binList[i].count;
+        rightCostList[i] = count > 0 ? getSurfaceArea(boundsMin, boundsMax) * count : 0.0f;
+    }
+
+    float bestCost = FLT_MAX;
+    uint32_t bestBin = 0;
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    count = 0;
+
+    for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++) {
+        boundsMin = glm::min(boundsMin, binList[i].boundsMin);
+        boundsMax = glm::max(boundsMax, binList[i].boundsMax);
+        count += binList[i].count;
+
+        float cost = (count > 0 ? getSurfaceArea(boundsMin, boundsMax) * count : 0.0f) + rightCostList[i + 1];
+
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestBin = i + 1;
+        }
+    }
+
+    float leafCost = static_cast<float>(end - begin);
+    float splitCost = BVH_TRAVERSAL_COST + (parentArea > 0.0f ? bestCost / parentArea : 0.0f);
+
+    *pAxis = axis;
+    *pSplit = centerMin[axis] + bestBin / scale;
+
+    return splitCost < leafCost || end - begin > BVH_MAX_LEAF_SIZE;
+}
+
+static float getSurfaceArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+    return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [TRAVERSAL] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Every item in a leaf that isn't fully outside, isInside tells the caller the sphere test can be skipped.
+// planeMask picks the planes to test, 0 takes everything.
+void queryBvhFrustum(const Bvh& bvh, const glm::vec4* planeList, uint32_t planeMask, std::vector<BvhHit>& hitList) {
+
+    if (bvh.nodeList.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.push_back({ 0, planeMask });
+
+    while (!stack.empty()) {
+        auto [nodeIndex, mask] = stack.back();
+        stack.pop_back();
+
+        const BvhNode& node = bvh.nodeList[nodeIndex];
+
+        if (node.boundsMin.x > node.boundsMax.x) {
+            continue;
+        }
+
+        glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+        glm::vec3 extent = (node.boundsMax - node.boundsMin) * 0.5f;
+        bool isOutside = false;
+
+        // planes the box is fully in front of don't have to be tested again further down
+        for (uint32_t i = 0; i < 6 && mask != 0; i++) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+
+            const glm::vec4& plane = planeList[i];
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+
+            if (distance + radius < 0.0f) {
+                isOutside = true;
+                break;
+            }
+
+            if (distance - radius >= 0.0f) {
+                mask &= ~(1u << i);
+            }
+        }
+
+        if (isOutside) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack.push_back({ node.first + 1, mask });
+            stack.push_back({ node.first, mask });
+            continue;
+        }
+
+        for (uint32_t item = node.first; item < node.first + node.count; item++) {
+            hitList.push_back({ item, mask == 0 });
+        }
+    }
+}
+
+static void querySphere(const Bvh& bvh, const glm::vec4& sphere, std::vector<VulkronObjectHandle>* pHandles) {
+
+    if (bvh.nodeList.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> stack = { 0 };
+
+    while (!stack.empty()) {
+        const BvhNode& node = bvh.nodeList[stack.back()];
+        stack.pop_back();
+
+        if (!isSphereOverlappingBox(sphere, node.boundsMin, node.boundsMax)) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+            continue;
+        }
+
+        for (uint32_t item = node.first; item < node.first + node.count; item++) {
+            const glm::vec4& itemSphere = bvh.sphereList[item];
+
+            if (itemSphere.w >= 0.0f && glm::length(glm::vec3(itemSphere) - glm::vec3(sphere)) <= itemSphere.w + sphere.w) {
+                pHandles->push_back(bvh.itemList[item]);
+            }
+        }
+    }
+}
+
+static void queryRay(const Bvh& bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<std::pair<float, VulkronObjectHandle>>& hitList) {
+
+    if (bvh.nodeList.empty()) {
+        return;
+    }
+
+    glm::vec3 inverseDirection = 1.0f / direction;
+    std::vector<uint32_t> stack = { 0 };
+
+    while (!stack.empty()) {
+        const BvhNode& node = bvh.nodeList[stack.back()];
+        stack.pop_back();
+
+        if (!intersectRayBox(origin, inverseDirection, maxDistance, node.boundsMin, node.boundsMax)) {
+            continue;
+        }
+
+        if (node.count == 0) {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+            continue;
+        }
+
+        for (uint32_t item = node.first; item < node.first + node.count; item++) {
+            float distance;
+
+            if (bvh.sphereList[item].w >= 0.0f && intersectRaySphere(origin, direction, maxDistance, bvh.sphereList[item], &distance)) {
+                hitList.push_back({ distance, bvh.itemList[item] });
+            }
+        }
+    }
+}
+
+static bool isSphereOverlappingBox(const glm::vec4& sphere, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 closest = glm::clamp(glm::vec3(sphere), boundsMin, boundsMax);
+    glm::vec3 offset = glm::vec3(sphere) - closest;
+
+    return boundsMin.x <= boundsMax.x && glm::dot(offset, offset) <= sphere.w * sphere.w;
+}
+
+// Slab test, inverseDirection may hold infinities for axis aligned rays
+static bool intersectRayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance, const glm::vec3& boundsMin, const glm::vec3& boundsMax) {
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+    return enter <= exit;
+}
+
+static bool intersectRaySphere(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const glm::vec4& sphere, float* pDistance) {
+    glm::vec3 offset = origin - glm::vec3(sphere);
+    float b = glm::dot(offset, direction);
+    float c = glm::dot(offset, offset) - sphere.w * sphere.w;
+    float discriminant = b * b - c;
+
+    if (discriminant < 0.0f) {
+        return false;
+    }
+
+    // a ray starting inside the sphere hits it at 0
+    float distance = std::max(-b - std::sqrt(discriminant), 0.0f);
+
+    if (c > 0.0f && b > 0.0f) {
+        return false;
+    }
+
+    *pDistance = distance;
+
+    return distance <= maxDistance;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [QUERIES] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Objects outside the trees (no bounds yet when the tree was built, or frustum culling turned off) are tested one by one
+static void forEachLinearObject(const std::function<void(VulkronObjectHandle handle, const glm::vec4& sphere)>& function) {
+
+    for (bool isStatic : { true, false }) {
+        for (VulkronObjectHandle handle : isStatic ? cullingInternal->staticLinearList : cullingInternal->dynamicLinearList) {
+            VulkronBaseObject* object = getSceneObject(handle, isStatic);
+            glm::vec4 sphere;
+
+            if (nullptr != object && getObjectSphere(*object, &sphere)) {
+                function(handle, sphere);
+            }
+        }
+    }
+}
+
+// Tree items whose object was removed since the build are dropped here
+static void appendValidHandles(const std::vector<VulkronObjectHandle>& handleList, bool isStatic, std::vector<VulkronObjectHandle>* pHandles) {
+    for (VulkronObjectHandle handle : handleList) {
+        if (nullptr != getSceneObject(handle, isStatic)) {
+            pHandles->push_back(handle);
+        }
+    }
+}
+
+VulkronResult vulkronQueryObjectsInFrustum(const glm::mat4& viewProjection, std::vector<VulkronObjectHandle>* pHandles) {
+
+    if (nullptr == pHandles) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    glm::vec4 planeList[6];
+    extractFrustumPlanes(viewProjection, planeList);
+
+    for (bool isStatic : { true, false }) {
+        const Bvh& bvh = isStatic ? cullingInternal->staticBvh : cullingInternal->dynamicBvh;
+        std::vector<BvhHit> hitList;
+        std::vector<VulkronObjectHandle> handleList;
+
+        queryBvhFrustum(bvh, planeList, 0x3F, hitList);
+
+        for (const BvhHit& hit : hitList) {
+            if (hit.isInside || isSphereInFrustum(bvh.sphereList[hit.item], planeList)) {
+                handleList.push_back(bvh.itemList[hit.item]);
+            }
+        }
+
+        appendValidHandles(handleList, isStatic, pHandles);
+    }
+
+    forEachLinearObject([&](VulkronObjectHandle handle, const glm::vec4& sphere) {
+        if (isSphereInFrustum(sphere, planeList)) {
+            pHandles->push_back(handle);
+        }
+    });
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronQueryObjectsInSphere(glm::vec3 center, float radius, std::vector<VulkronObjectHandle>* pHandles) {
+
+    if (nullptr == pHandles || radius < 0.0f) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    glm::vec4 sphere = glm::vec4(center, radius);
+
+    for (bool isStatic : { true, false }) {
+        std::vector<VulkronObjectHandle> handleList;
+        querySphere(isStatic ? cullingInternal->staticBvh : cullingInternal->dynamicBvh, sphere, &handleList);
+        appendValidHandles(handleList, isStatic, pHandles);
+    }
+
+    forEachLinearObject([&](VulkronObjectHandle handle, const glm::vec4& objectSphere) {
+        if (glm::length(glm::vec3(objectSphere) - center) <= objectSphere.w + radius) {
+            pHandles->push_back(handle);
+        }
+    });
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronRaycastObjects(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<VulkronObjectHandle>* pHandles) {
+
+    if (nullptr == pHandles || glm::length(direction) == 0.0f) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    direction = glm::normalize(direction);
+
+    std::vector<std::pair<float, VulkronObjectHandle>> hitList;
+
+    for (bool isStatic : { true, false }) {
+        std::vector<std::pair<float, VulkronObjectHandle>> treeHitList;
+        queryRay(isStatic ? cullingInternal->staticBvh : cullingInternal->dynamicBvh, origin, direction, maxDistance, treeHitList);
+
+        for (const auto& hit : treeHitList) {
+            if (nullptr != getSceneObject(hit.second, isStatic)) {
+                hitList.push_back(hit);
+            }
+        }
+    }
+
+    forEachLinearObject([&](VulkronObjectHandle handle, const glm::vec4& sphere) {
+        float distance;
+
+        if (intersectRaySphere(origin, direction, maxDistance, sphere, &distance)) {
+            hitList.push_back({ distance, handle });
+        }
+    });
+
+    std::stable_sort(hitList.begin(), hitList.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    for (const auto& hit : hitList) {
+        pHandles->push_back(hit.second);
+    }
+
+    return VULKRON_SUCCESS;
+}
@@ -0,0 +1,433 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Async compute scheduler
+
+    Dispatches queued with vulkronDispatchCompute are recorded into one command buffer per frame
+    in flight and submitted to the compute queue before the frame's draws are recorded, so they run
+    next to the previous frame's raster work instead of in front of it on the graphics queue.
+
+    Two timeline semaphores order the queues:
+      graphics timeline  signaled by every frame submit, compute waits on the previous frame when
+                         a dispatch reads what it rendered (waitForGraphics)
+      compute timeline   signaled by every compute submit, the frame submit waits on it at the
+                         earliest graphicsWaitStage any of the frame's dispatches asked for
+
+    When compute and graphics end up on the same VkQueue, or without timeline semaphores, there is nothing to overlap with,
+    the same dispatches are recorded on the frame's primary command buffer before the render pass.
+
+*/
+
+ComputeInternal*    computeInternal     = new ComputeInternal();
+
+static void recordComputeDispatches(VkCommandBuffer commandBuffer);
+static VkSemaphore createTimelineSemaphore();
+
+void createComputeScheduler() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    // a second queue of the graphics family overlaps just as well as a dedicated family
+    computeInternal->isAsync = getThreadQueue(VULKRON_QUEUE_COMPUTE_BIT) != getThreadQueue(VULKRON_QUEUE_GRAPHICS_BIT)
+        && deviceInternal->hasTimelineSemaphore;
+
+    if (!computeInternal->isAsync) {
+        return;
+    }
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.computeQueueIndex;
+
+    if (vkCreateCommandPool(logicalDevice, &commandPoolInfo, nullptr, &computeInternal->commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool");
+    }
+
+    computeInternal->submissionList.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (auto& submission : computeInternal->submissionList) {
+        VkCommandBufferAllocateInfo commandBufferAllocate = {};
+        commandBufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocate.commandPool = computeInternal->commandPool;
+        commandBufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocate.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(logicalDevice, &commandBufferAllocate, &submission.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate compute command buffer!");
+        }
+    }
+
+    computeInternal->computeTimeline = createTimelineSemaphore();
+    computeInternal->graphicsTimeline = createTimelineSemaphore();
+}
+
+void destroyComputeScheduler() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    if (computeInternal->isAsync) {
+        vkDestroySemaphore(logicalDevice, computeInternal->computeTimeline, nullptr);
+        vkDestroySemaphore(logicalDevice, computeInternal->graphicsTimeline, nullptr);
+        vkDestroyCommandPool(logicalDevice, computeInternal->commandPool, nullptr);
+    }
+
+    delete computeInternal;
+    computeInternal = nullptr;
+}
+
+VkPipeline createComputePipeline(const std::string& shaderPath, VkPipelineLayout layout) {
+
+    VkShaderModule shaderModule = createShaderModule(shaderPath);
+    VkPipeline computePipeline = createComputePipeline(shaderModule, layout);
+
+    destroyShaderModule(shaderModule);
+
+    return computePipeline;
+}
+
+// The caller still owns the module
+VkPipeline createComputePipeline(VkShaderModule shaderModule, VkPipelineLayout layout) {
+    VULKRON_TRACE_SCOPE("pipeline", "vkCreateComputePipelines");
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = layout;
+
+    VkPipeline computePipeline;
+    if (vkCreateComputePipelines(deviceInternal->logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    return computePipeline;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [COMPUTE] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronCreateComputePipeline(VulkronComputePipelineCreateInfo* info) {
+
+    if (nullptr == info || nullptr == info->pPipeline || info->shaderPath.empty()) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    ComputePipelineInternal* computePipeline = new ComputePipelineInternal();
+
+    // nothing given, the layout comes from the shader and is shared through the layout cache
+    if (info->setLayoutCount == 0 && info->pushConstantRangeCount == 0) {
+        VkShaderModule shaderModule = createShaderModule(info->shaderPath);
+
+        VkPipelineShaderStageCreateInfo shaderStage = {};
+        shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        shaderStage.module = shaderModule;
+        shaderStage.pName = "main";
+
+        VulkronPipelineLayoutReflection reflection;
+
+        if (vulkronReflectPipelineLayout(&shaderStage, 1, &reflection) != VULKRON_SUCCESS) {
+            destroyShaderModule(shaderModule);
+            delete computePipeline;
+            return VULKRON_ERROR_INVALID_ARGUMENT;
+        }
+
+        computePipeline->layout = reflection.pipelineLayout;
+        computePipeline->isLayoutCached = true;
+        computePipeline->pipeline = createComputePipeline(shaderModule, computePipeline->layout);
+
+        if (!reflection.pushConstantRangeList.empty()) {
+            computePipeline->pushConstantStages = reflection.pushConstantRangeList[0].stageFlags;
+        }
+
+        destroyShaderModule(shaderModule);
+
+        *info->pPipeline = computePipeline;
+
+        return VULKRON_SUCCESS;
+    }
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = info->setLayoutCount;
+    layoutInfo.pSetLayouts = info->pSetLayouts;
+    layoutInfo.pushConstantRangeCount = info->pushConstantRangeCount;
+    layoutInfo.pPushConstantRanges = info->pPushConstantRanges;
+
+    if (vkCreatePipelineLayout(deviceInternal->logicalDevice, &layoutInfo, nullptr, &computePipeline->layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline layout!");
+    }
+
+    computePipeline->pipeline = createComputePipeline(info->shaderPath, computePipeline->layout);
+
+    for (uint32_t i = 0; i < info->pushConstantRangeCount; i++) {
+        computePipeline->pushConstantStages |= info->pPushConstantRanges[i].stageFlags;
+    }
+
+    *info->pPipeline = computePipeline;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDestroyComputePipeline(VulkronComputePipeline pipeline) {
+
+    if (nullptr == pipeline) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // dispatches the graphics queue never waited on can outlive the frames in flight
+    uint64_t computeValue = computeInternal->computeValue;
+
+    enqueueFrameDeletion([pipeline, computeValue] {
+        if (computeInternal->isAsync) {
+            VkSemaphoreWaitInfo waitInfo = {};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &computeInternal->computeTimeline;
+            waitInfo.pValues = &computeValue;
+
+            vkWaitSemaphores(deviceInternal->logicalDevice, &waitInfo, UINT64_MAX);
+        }
+
+        vkDestroyPipeline(deviceInternal->logicalDevice, pipeline->pipeline, nullptr);
+        if (!pipeline->isLayoutCached) {
+            vkDestroyPipelineLayout(deviceInternal->logicalDevice, pipeline->layout, nullptr);
+        }
+        delete pipeline;
+    });
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDispatchCompute(VulkronComputeDispatchInfo* info) {
+
+    if (nullptr == info || nullptr == info->pipeline) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if ((info->descriptorSetCount > 0 && nullptr == info->pDescriptorSets) || (info->pushConstantSize > 0 && nullptr == info->pPushConstants)) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    ComputeDispatch dispatch = {};
+    dispatch.pipeline = info->pipeline;
+    dispatch.descriptorSetList.assign(info->pDescriptorSets, info->pDescriptorSets + info->descriptorSetCount);
+    dispatch.pushConstants.resize(info->pushConstantSize);
+    dispatch.groupCountX = info->groupCountX;
+    dispatch.groupCountY = info->groupCountY;
+    dispatch.groupCountZ = info->groupCountZ;
+
+    if (info->pushConstantSize > 0) {
+        std::memcpy(dispatch.pushConstants.data(), info->pPushConstants, info->pushConstantSize);
+    }
+
+    computeInternal->pendingList.push_back(std::move(dispatch));
+    computeInternal->pendingWaitStage |= info->graphicsWaitStage;
+    computeInternal->pendingWaitForGraphics |= info->waitForGraphics;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronGetComputeQueueInfo(VulkronComputeQueueInfo* pInfo) {
+
+    if (nullptr == pInfo) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    pInfo->isAsync = computeInternal->isAsync;
+    pInfo->graphicsQueueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+    pInfo->computeQueueFamilyIndex = deviceInternal->queuefamily.computeQueueIndex;
+
+    return VULKRON_SUCCESS;
+}
+
+// Called once per frame before the frame's command buffers are recorded
+void submitComputeWork(uint32_t frameIndex) {
+    VULKRON_TRACE_SCOPE("frame", "submitComputeWork");
+
+    if (!computeInternal->isAsync || computeInternal->pendingList.empty()) {
+        return;
+    }
+
+    ComputeSubmission& submission = computeInternal->submissionList[frameIndex];
+
+    // the frame submit usually waited on this already, it doesn't when nothing read the results
+    if (submission.timelineValue > 0) {
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &computeInternal->computeTimeline;
+        waitInfo.pValues = &submission.timelineValue;
+
+        vkWaitSemaphores(deviceInternal->logicalDevice, &waitInfo, UINT64_MAX);
+    }
+
+    VkCommandBufferBeginInfo commandBufferBegin = {};
+    commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBegin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(submission.commandBuffer, &commandBufferBegin) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording compute command buffer!");
+    }
+
+    recordComputeDispatches(submission.commandBuffer);
+
+    if (vkEndCommandBuffer(submission.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record compute command buffer!");
+    }
+
+    uint64_t waitValue = computeInternal->graphicsValue;
+    uint64_t signalValue = ++computeInternal->computeValue;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &submission.commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &computeInternal->computeTimeline;
+
+    // the previous frame is the last graphics submit, nothing to wait on before the first one
+    if (computeInternal->pendingWaitForGraphics && waitValue > 0) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &computeInternal->graphicsTimeline;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    else {
+        timelineInfo.waitSemaphoreValueCount = 0;
+    }
+
+    if (queueSubmit(getThreadQueue(VULKRON_QUEUE_COMPUTE_BIT), 1, &submitInfo, VULKRON_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit compute command buffer!");
+    }
+
+    submission.timelineValue = signalValue;
+
+    computeInternal->graphicsWaitStage |= computeInternal->pendingWaitStage;
+    computeInternal->pendingWaitStage = 0;
+    computeInternal->pendingWaitForGraphics = false;
+    computeInternal->pendingList.clear();
+}
+
+// Inline fallback, recorded on the primary command buffer before the render pass begins
+void recordComputeWork(VkCommandBuffer commandBuffer) {
+
+    if (computeInternal->isAsync || computeInternal->pendingList.empty()) {
+        return;
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+    // the previous frame is earlier on the same queue
+    if (computeInternal->pendingWaitForGraphics) {
+        barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    recordComputeDispatches(commandBuffer);
+
+    if (computeInternal->pendingWaitStage != 0) {
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, computeInternal->pendingWaitStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    computeInternal->pendingWaitStage = 0;
+    computeInternal->pendingWaitForGraphics = false;
+    computeInternal->pendingList.clear();
+}
+
+// Compute work the frame submit has to wait on, only set once per submitted compute batch
+bool getComputeWait(VkSemaphore* pSemaphore, uint64_t* pValue, VkPipelineStageFlags* pStage) {
+
+    if (!computeInternal->isAsync || computeInternal->graphicsWaitStage == 0) {
+        return false;
+    }
+
+    *pSemaphore = computeInternal->computeTimeline;
+    *pValue = computeInternal->computeValue;
+    *pStage = computeInternal->graphicsWaitStage;
+
+    computeInternal->graphicsWaitStage = 0;
+
+    return true;
+}
+
+// Every frame submit advances the graphics timeline so compute can wait on a specific frame
+bool getGraphicsTimelineSignal(VkSemaphore* pSemaphore, uint64_t* pValue) {
+
+    if (!computeInternal->isAsync) {
+        return false;
+    }
+
+    *pSemaphore = computeInternal->graphicsTimeline;
+    *pValue = ++computeInternal->graphicsValue;
+
+    return true;
+}
+
+static void recordComputeDispatches(VkCommandBuffer commandBuffer) {
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    for (size_t i = 0; i < computeInternal->pendingList.size(); i++) {
+        const ComputeDispatch& dispatch = computeInternal->pendingList[i];
+
+        // dispatches run in the order they were queued and see each other's writes
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dispatch.pipeline->pipeline);
+
+        if (!dispatch.descriptorSetList.empty()) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dispatch.pipeline->layout, 0,
+                static_cast<uint32_t>(dispatch.descriptorSetList.size()), dispatch.descriptorSetList.data(), 0, nullptr);
+        }
+
+        if (!dispatch.pushConstants.empty()) {
+            vkCmdPushConstants(commandBuffer, dispatch.pipeline->layout, dispatch.pipeline->pushConstantStages, 0,
+                static_cast<uint32_t>(dispatch.pushConstants.size()), dispatch.pushConstants.data());
+        }
+
+        vkCmdDispatch(commandBuffer, dispatch.groupCountX, dispatch.groupCountY, dispatch.groupCountZ);
+    }
+}
+
+static VkSemaphore createTimelineSemaphore() {
+
+    VkSemaphoreTypeCreateInfo typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(deviceInternal->logicalDevice, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+
+    return semaphore;
+}
@@ -7,6 +7,8 @@
 #include "Glfw/glfw3.h"
 #include "glm/glm.hpp"
 
+#include "VulkronMeshFormat.h"
+
 #include <vector>
 #include <string>
 
@@ -27,6 +29,8 @@
 #define VULKRON_NULLPTR_HANDLE			nullptr
 #define VULKRON_FALSE					VK_FALSE
 #define VULKRON_DEFINE_U32TYPE(type)	typedef uint32_t type;
+#define VULKRON_DEFINE_HANDLE(object)	typedef struct object##_T* object;
+#define VULKRON_MAX_SHADOW_CASCADES		4
 
 #if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
 	#define LOG(x) std::cout << x << std::endl;
@@ -35,22 +39,28 @@
 VULKRON_DEFINE_U32TYPE(VulkronFlags)
 VULKRON_DEFINE_U32TYPE(VulkronBool32)
 
+VULKRON_DEFINE_HANDLE(VulkronTexture)
+VULKRON_DEFINE_HANDLE(VulkronMesh)
+VULKRON_DEFINE_HANDLE(VulkronComputePipeline)
+
 typedef enum VulkronResult {
 	VULKRON_SUCCESS = 0,
 	VULKRON_SUCCESS_MEMORY_DEALLOCATED = 1,
+	VULKRON_NOT_READY = 2,
 	VULKRON_ERROR_MEMORY_ALLOCATE = -1,
-	VULKRON_ERROR_INVALID_ARGUMENT = -1
+	VULKRON_ERROR_INVALID_ARGUMENT = -2
 } VulkronResult;
 
+// The base usages are bits so the combined ones stay distinct, each bit asks for one memory property
 typedef enum VulkronMemoryUsage {
-	VULKRON_MEMORY_USAGE_GPU_STORAGE = 0,
-	VULKRON_MEMORY_USAGE_CPU_VISIBLE,
-	VULKRON_MEMORY_USAGE_CPU_COHERENT,
-	VULKRON_MEMORY_USAGE_CPU_CACHED,
+	VULKRON_MEMORY_USAGE_GPU_STORAGE = 0x00000001,
+	VULKRON_MEMORY_USAGE_CPU_VISIBLE = 0x00000002,
+	VULKRON_MEMORY_USAGE_CPU_COHERENT = 0x00000004,
+	VULKRON_MEMORY_USAGE_CPU_CACHED = 0x00000008,
 	VULKRON_MEMORY_USAGE_UPLOAD_ONCE = VULKRON_MEMORY_USAGE_GPU_STORAGE,
 	VULKRON_MEMORY_USAGE_STAGING_TO_VRAM = VULKRON_MEMORY_USAGE_CPU_VISIBLE | VULKRON_MEMORY_USAGE_CPU_COHERENT,
 	VULKRON_MEMORY_USAGE_DYNAMIC_READ_ONCE = VULKRON_MEMORY_USAGE_CPU_VISIBLE | VULKRON_MEMORY_USAGE_CPU_COHERENT | VULKRON_MEMORY_USAGE_CPU_CACHED,
-	VULKRON_MEMORY_USAGE_GPU_WRITE_CPU_READ = VULKRON_MEMORY_USAGE_GPU_STORAGE | VULKRON_MEMORY_USAGE_CPU_VISIBLE | VULKRON_MEMORY_USAGE_CPU_COHERENT
+	VULKRON_MEMORY_USAGE_GPU_WRITE_CPU_READ = VULKRON_MEMORY_USAGE_CPU_VISIBLE | VULKRON_MEMORY_USAGE_CPU_CACHED		// uncached reads are slow, readbacks want cached memory
 } VulkronMemoryUsage;
 
 typedef enum VulkronAttachmentFlagBits {
@@ -71,6 +81,49 @@ typedef enum VulkronAllocatorFlagBits {
 } VulkronAllocatorFlagBits;
 typedef VulkronFlags VulkronAllocatorFlags;
 
+typedef enum VulkronTextureState {
+	VULKRON_TEXTURE_STATE_PENDING = 0,			// waiting on a worker thread to decode
+	VULKRON_TEXTURE_STATE_DECODED,				// decoded, waiting for upload space
+	VULKRON_TEXTURE_STATE_PARTIALLY_RESIDENT,	// low resolution mips can be sampled
+	VULKRON_TEXTURE_STATE_RESIDENT,				// every mip level can be sampled
+	VULKRON_TEXTURE_STATE_FAILED
+} VulkronTextureState;
+
+typedef enum VulkronMeshState {
+	VULKRON_MESH_STATE_PENDING = 0,				// file is being mapped and paged in on a worker thread
+	VULKRON_MESH_STATE_UPLOADING,				// copying from the mapped file into gpu buffers
+	VULKRON_MESH_STATE_RESIDENT,
+	VULKRON_MESH_STATE_EVICTED,					// buffers dropped under memory pressure, streamed again once it's visible
+	VULKRON_MESH_STATE_FAILED
+} VulkronMeshState;
+
+typedef enum VulkronMemoryPressure {
+	VULKRON_MEMORY_PRESSURE_NONE = 0,
+	VULKRON_MEMORY_PRESSURE_HIGH,				// past evictionThreshold, least recently used streamed resources are demoted or dropped
+	VULKRON_MEMORY_PRESSURE_CRITICAL			// past criticalThreshold, full resolution texture streaming waits as well
+} VulkronMemoryPressure;
+
+typedef enum VulkronGpuScoreSource {
+	VULKRON_GPU_SCORE_SOURCE_BENCHMARK = 0,		// measured while creating the device
+	VULKRON_GPU_SCORE_SOURCE_CACHE,				// measured on an earlier run with the same driver
+	VULKRON_GPU_SCORE_SOURCE_HEURISTIC,			// benchmark disabled or failed, device type and limits
+	VULKRON_GPU_SCORE_SOURCE_NONE				// only one gpu was given, nothing to compare
+} VulkronGpuScoreSource;
+
+// Called on the render thread each time more detailed mips become resident
+typedef void (*PFN_vulkronTextureResidencyCallback)(VulkronTexture texture, uint32_t residentMipLevel, void* pUserData);
+
+struct VulkronMemoryHeapBudget;
+
+// Called on the render thread when a heap moves to another pressure level
+typedef void (*PFN_vulkronMemoryPressureCallback)(const VulkronMemoryHeapBudget* pBudget, void* pUserData);
+
+// Called on the render thread right before a batch job is culled and recorded, the scene can be set up for it here
+typedef void (*PFN_vulkronBatchPrepareCallback)(uint64_t jobIndex, void* pUserData);
+
+// Called on a writer thread with the finished image, RGBA8 with tightly packed rows, instead of writing outputPath
+typedef void (*PFN_vulkronBatchImageCallback)(uint64_t jobIndex, const uint8_t* pPixels, uint32_t width, uint32_t height, void* pUserData);
+
 // ---------------------------------- 
 // Data Ext Structs -----------------
 // ----------------------------------
@@ -124,6 +177,15 @@ typedef struct VulkronGpuFeatures {
 	VulkronBool32							inheritedQueries;
 } VulkronGpuFeatures;
 
+// Vulkan 1.2 and 1.3 features, each one is enabled only if the gpu supports it, vulkronGetEnabledGpuFeatures says which were
+typedef struct VulkronGpuExtendedFeatures {
+	bool									dynamicRendering		= false;		// 1.3, draws without VkRenderPass and VkFramebuffer objects
+	bool									synchronization2		= false;		// 1.3, frame barriers use vkCmdPipelineBarrier2
+	bool									timelineSemaphore		= true;			// 1.2, async compute runs on the graphics queue without it
+	bool									descriptorIndexing		= false;		// 1.2, non uniform indexing, partially bound, runtime sized and update after bind arrays
+	bool									bufferDeviceAddress		= false;		// 1.2, every allocation can back a buffer with SHADER_DEVICE_ADDRESS usage
+} VulkronGpuExtendedFeatures;
+
 typedef struct VulkronGraphicsPipeline {
 	VkPipelineShaderStageCreateInfo*		pShaderStage;
 	uint32_t								shaderStageCount;
@@ -145,9 +207,9 @@ typedef struct VulkronVertex {
 } VulkronVertex;
 
 typedef struct VulkronVertexDescriptions {
-	VkVertexInputBindingDescription*		pBindings;
+	const VkVertexInputBindingDescription*	pBindings;
 	uint32_t								bindingsCount;
-	VkVertexInputAttributeDescription		pAttributes;
+	const VkVertexInputAttributeDescription*	pAttributes;
 	uint32_t								attributesCount;
 } VulkronVertexDescriptions;
 
@@ -168,11 +230,22 @@ typedef struct VulkronBaseObject {
 	bool									castShadow			= false;
 	bool									receiveShadow		= false;
 	bool									frustumCulling		= false;
+	bool									occlusionCulling	= false;				// drawn indirectly and tested against the depth pyramid once enabled
 	bool									isStatic			= true;
+	bool									isCulled			= false;				// set by the visibility pass each frame
+	uint32_t								lodIndex			= 0;					// set by the visibility pass each frame
+	VulkronMesh								mesh				= nullptr;				// drawn once resident, nothing is drawn before that
 	VulkronBaseObject*						parent				= nullptr;
 	VulkronBaseObject*						child				= nullptr;
 } VulkronBaseObject;
 
+typedef uint64_t VulkronReadbackTicket;											// 0 is never handed out
+
+typedef struct VulkronObjectHandle {
+	uint32_t								index				= 0;
+	uint32_t								generation			= 0;					// 0 is never handed out, a default handle is always invalid
+} VulkronObjectHandle;
+
 typedef struct VulkronGraphicsCommands {
 	std::vector<VulkronBaseObject>			staticObjectlist;
 	std::vector<VulkronBaseObject>			dynamicObjectsList;
@@ -195,10 +268,32 @@ typedef struct VulkronDeviceCreateInfo {
 	uint32_t								computeQueueCount;
 	VulkronQueueFlag						transferQueueFlag;
 	uint32_t								transferQueueCount;
+	std::vector<float>						graphicsQueuePriorities;	// one per queue 0.0 - 1.0, missing entries are 0.0
+	std::vector<float>						computeQueuePriorities;
+	std::vector<float>						transferQueuePriorities;
 	VulkronGpuFeatures						gpuEnabledFeatures;
+	VulkronGpuExtendedFeatures				gpuExtendedFeatures;
 	std::vector<VkPhysicalDevice>			gpuList;
+	bool									useGpuBenchmark			= true;			// false rates gpus by device type and limits
+	std::string								gpuBenchmarkShaderPath	= "Shaders/gpu_benchmark.comp.spv";
+	std::string								gpuBenchmarkCachePath	= "vulkron_gpu_benchmark.cache";	// empty disables the cache
 } VulkronDeviceCreateInfo;
 
+typedef struct VulkronGpuCandidate {
+	VkPhysicalDevice						gpu;
+	std::string								name;
+	VkPhysicalDeviceType					deviceType;
+	uint32_t								driverVersion;
+	bool									isSuitable;
+	bool									isSelected;
+	std::string								reason;					// why it was rejected or picked
+	VulkronGpuScoreSource					scoreSource;
+	float									fillRate;				// GB/s
+	float									computeThroughput;		// GFLOPS, 0 when the benchmark shader is missing
+	float									copyBandwidth;			// GB/s
+	float									score;
+} VulkronGpuCandidate;
+
 typedef struct VulkronSwapchainCreateInfo {
 	uint32_t*								width;
 	uint32_t*								height;
@@ -208,12 +303,258 @@ typedef struct VulkronSwapchainCreateInfo {
 typedef struct VulkronGraphicsPipelineCreateInfo {
 	VulkronAttachmentFlags					flag;
 	VkRenderPass*							pRenderPass;
-	VkPipeline*								pPipeline;
-	VkPipelineLayout*						pPipelineLayout;
+	VkPipeline*								pPipeline;				// owned by the pipeline cache, identical state gets the same handle back
+	VkPipelineLayout*						pPipelineLayout;		// owned by the layout cache, kept across swapchain recreation
 	VulkronGraphicsPipeline*				pPipelineData;
+	bool									reflectLayout			= false;		// derive the layout from the shader stages, pPipelineLayoutInfo is ignored
 } VulkronGraphicsPipelineCreateInfo;
 
+typedef struct VulkronTextureCreateInfo {
+	std::string								filePath;
+	VulkronTexture*							pTexture;
+	bool									srgb					= true;
+	bool									generateMipmaps			= true;
+	PFN_vulkronTextureResidencyCallback		pfnResidencyCallback	= nullptr;
+	void*									pUserData				= nullptr;
+} VulkronTextureCreateInfo;
+
+typedef struct VulkronTextureInfo {
+	VulkronTextureState						state;
+	VkImage									image;
+	VkImageView								view;					// only covers resident mips, changes as more mips arrive
+	uint32_t								width;
+	uint32_t								height;
+	uint32_t								mipLevels;
+	uint32_t								residentMipLevel;
+} VulkronTextureInfo;
+
+typedef struct VulkronMeshCreateInfo {
+	std::string								filePath;				// .vmesh written by Tools/MeshConverter
+	VulkronMesh*							pMesh;
+} VulkronMeshCreateInfo;
+
+typedef struct VulkronMeshInfo {
+	VulkronMeshState						state;
+	VulkronMeshVertexFormat					vertexFormat;
+	uint32_t								vertexCount;
+	uint32_t								indexCount;
+	uint32_t								lodCount;
+	glm::vec3								boundsMin;
+	glm::vec3								boundsMax;
+	glm::vec4								boundingSphere;			// xyz center, w radius, object space
+	glm::mat4								dequantizeMatrix;		// multiply into the model matrix, identity for float vertices
+} VulkronMeshInfo;
+
+typedef struct VulkronMemoryHeapBudget {
+	uint32_t								heapIndex;
+	VkMemoryHeapFlags						flags;
+	VkDeviceSize							size;
+	VkDeviceSize							budget;					// what the os lets this process use, 80% of size without VK_EXT_memory_budget
+	VkDeviceSize							usage;					// whole process, same as engineUsage without VK_EXT_memory_budget
+	VkDeviceSize							engineUsage;			// allocations made by the engine
+	VulkronMemoryPressure					pressure;
+} VulkronMemoryHeapBudget;
+
+typedef struct VulkronMemoryBudgetInfo {
+	float									evictionThreshold		= 0.90f;		// fraction of the budget
+	float									criticalThreshold		= 0.97f;
+	uint32_t								minUnusedFrames			= 120;			// anything used more recently is never evicted
+	VkDeviceSize							defragmentationBudget	= 8 * 1024 * 1024;	// bytes moved per frame to compact streamed resources, 0 turns it off
+	PFN_vulkronMemoryPressureCallback		pfnPressureCallback		= nullptr;
+	void*									pUserData				= nullptr;
+} VulkronMemoryBudgetInfo;
+
+typedef struct VulkronCamera {
+	glm::mat4								view;
+	glm::mat4								projection;				// vulkan clip space, depth 0..1
+	float									viewportHeight;			// pixels, used to turn lod errors into screen space
+} VulkronCamera;
+
+// Compiled from Shaders/depth_reduce.comp and Shaders/occlusion_cull.comp
+typedef struct VulkronOcclusionCullingCreateInfo {
+	std::string								depthReduceShaderPath	= "Shaders/depth_reduce.comp.spv";
+	std::string								cullShaderPath			= "Shaders/occlusion_cull.comp.spv";
+} VulkronOcclusionCullingCreateInfo;
+
+// Compiled from Shaders/shadow_depth.vert. Objects with castShadow are drawn into one depth layer per cascade,
+// static ones into a cache that is only redrawn when the light, the static objects or the cascade move.
+typedef struct VulkronShadowCreateInfo {
+	std::string								depthShaderPath			= "Shaders/shadow_depth.vert.spv";
+	uint32_t								resolution				= 2048;			// width and height of every cascade
+	uint32_t								cascadeCount			= 4;			// up to VULKRON_MAX_SHADOW_CASCADES
+	float									maxDistance				= 100.0f;		// from the camera, receivers further away aren't shadowed
+	float									splitLambda				= 0.75f;		// 0 splits the distance evenly, 1 logarithmically
+	float									casterDistance			= 200.0f;		// how far towards the light casters are still picked up
+	float									depthBiasConstant		= 1.25f;
+	float									depthBiasSlope			= 1.75f;
+} VulkronShadowCreateInfo;
+
+// Valid for the frame recorded after the last vulkronDrawFrame, the view and sampler stay the same until shadows are disabled
+typedef struct VulkronShadowInfo {
+	bool									isEnabled;
+	VkImageView								view;					// 2D array, one layer per cascade, SHADER_READ_ONLY_OPTIMAL for fragment shaders
+	VkSampler								sampler;				// depth compare LESS_OR_EQUAL, linear gives 2x2 pcf
+	uint32_t								cascadeCount;
+	uint32_t								activeCascadeMask;		// cascades with visible receivers, the others are cleared to 1.0
+	glm::mat4								viewProjection[VULKRON_MAX_SHADOW_CASCADES];	// world to cascade clip space, depth 0..1
+	float									splitDistance[VULKRON_MAX_SHADOW_CASCADES];		// view space distance each cascade ends at
+} VulkronShadowInfo;
+
+typedef struct VulkronComputePipelineCreateInfo {
+	std::string								shaderPath;				// compiled compute shader, entry point main
+	const VkDescriptorSetLayout*			pSetLayouts				= nullptr;
+	uint32_t								setLayoutCount			= 0;
+	const VkPushConstantRange*				pPushConstantRanges		= nullptr;
+	uint32_t								pushConstantRangeCount	= 0;			// with no set layouts either, the layout is reflected from the shader
+	VulkronComputePipeline*					pPipeline;
+} VulkronComputePipelineCreateInfo;
+
+// Queued for the next frame, dispatches run in the order they were queued.
+// Resources shared with the draws need VK_SHARING_MODE_CONCURRENT over both families from vulkronGetComputeQueueInfo
+// and one copy per frame in flight, the async queue runs next to the previous frame.
+typedef struct VulkronComputeDispatchInfo {
+	VulkronComputePipeline					pipeline;
+	const VkDescriptorSet*					pDescriptorSets			= nullptr;
+	uint32_t								descriptorSetCount		= 0;
+	const void*								pPushConstants			= nullptr;		// copied, written from offset 0
+	uint32_t								pushConstantSize		= 0;
+	uint32_t								groupCountX				= 1;
+	uint32_t								groupCountY				= 1;
+	uint32_t								groupCountZ				= 1;
+	VkPipelineStageFlags					graphicsWaitStage		= 0;			// first stage of the frame's draws that reads the results, 0 if none
+	bool									waitForGraphics			= false;		// reads what the previous frame rendered
+} VulkronComputeDispatchInfo;
+
+typedef struct VulkronComputeQueueInfo {
+	bool									isAsync;				// false when dispatches are recorded on the graphics queue
+	uint32_t								graphicsQueueFamilyIndex;
+	uint32_t								computeQueueFamilyIndex;
+} VulkronComputeQueueInfo;
+
+// What the last frame's buffer writes turned into, writeCount against copyCount is what batching saved
+typedef struct VulkronUploadBatchInfo {
+	uint32_t								writeCount;				// vulkronUploadBuffer calls
+	uint32_t								regionCount;			// after adjacent and overlapping writes were merged
+	uint32_t								copyCount;				// vkCmdCopyBuffer calls, one per destination buffer and flush
+	VkDeviceSize							byteCount;				// staging memory used
+} VulkronUploadBatchInfo;
+
+// Copied at the end of the next frame, whatever that frame wrote is in the result
+typedef struct VulkronBufferReadbackInfo {
+	VkBuffer								buffer;					// needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+	VkDeviceSize							offset					= 0;
+	VkDeviceSize							size;
+} VulkronBufferReadbackInfo;
+
+typedef struct VulkronImageReadbackInfo {
+	VkImage									image					= VK_NULL_HANDLE;	// null reads the swapchain image the next frame presents
+	VkImageLayout							layout					= VK_IMAGE_LAYOUT_GENERAL;	// layout at the end of the frame, the image is left in it
+	VkImageAspectFlags						aspect					= VK_IMAGE_ASPECT_COLOR_BIT;
+	uint32_t								mipLevel				= 0;
+	uint32_t								arrayLayer				= 0;
+	VkOffset3D								offset					= { 0, 0, 0 };
+	VkExtent3D								extent					= { 0, 0, 1 };	// a zero width reads the whole swapchain image
+	uint32_t								texelSize				= 4;			// bytes per texel, rows are tightly packed in the result
+} VulkronImageReadbackInfo;
+
+// Offscreen targets in the swapchain's color format, which has to be 8 bit RGBA or BGRA, one per frame in flight
+typedef struct VulkronBatchRendererCreateInfo {
+	uint32_t								width					= 256;
+	uint32_t								height					= 256;
+	uint32_t								maxPendingWrites		= 32;			// finished images waiting for a writer, rendering waits past this
+} VulkronBatchRendererCreateInfo;
+
+typedef struct VulkronBatchJob {
+	VulkronCamera							camera;									// a zero viewportHeight uses the target height
+	VkClearColorValue						clearColor				= { { 0.0f, 0.0f, 0.0f, 1.0f } };
+	std::string								outputPath;								// written as png
+	PFN_vulkronBatchPrepareCallback			pfnPrepareCallback		= nullptr;
+	PFN_vulkronBatchImageCallback			pfnImageCallback		= nullptr;
+	void*									pUserData				= nullptr;
+} VulkronBatchJob;
+
+// Throughput of the last vulkronRunBatchJobs
+typedef struct VulkronBatchStatistics {
+	uint32_t								imageCount;
+	uint32_t								failedWriteCount;
+	double									seconds;				// from the first job recorded to the last image written
+	double									imagesPerSecond;
+	double									writerWaitSeconds;		// rendering blocked on maxPendingWrites, the writers are the bottleneck
+} VulkronBatchStatistics;
+
+// The parts of a frame's command buffer, in the order they're recorded
+typedef enum VulkronFramePass {
+	VULKRON_FRAME_PASS_COMPUTE = 0,			// vulkronDispatchCompute work recorded into the frame
+	VULKRON_FRAME_PASS_OCCLUSION,			// depth pyramid and occlusion culling dispatches
+	VULKRON_FRAME_PASS_SHADOW,				// shadow cascades
+	VULKRON_FRAME_PASS_MAIN,				// the render pass with every object
+	VULKRON_FRAME_PASS_COPY,				// offscreen target copies and readbacks
+	VULKRON_FRAME_PASS_COUNT
+} VulkronFramePass;
+
+// Counters that need a device feature stay 0 without it. The main pass runs in secondary command buffers,
+// its pipeline statistics and samples also need inheritedQueries.
+typedef struct VulkronPassStatistics {
+	double									gpuMilliseconds;		// 0 when the graphics queue has no timestamps
+	uint64_t								vertexInvocations;		// pipelineStatisticsQuery
+	uint64_t								clippingInvocations;	// primitives that reached clipping
+	uint64_t								clippingPrimitives;		// primitives that left it, far fewer means most were culled
+	uint64_t								fragmentInvocations;	// divided by the pixels covered this is the overdraw
+	uint64_t								computeInvocations;
+	uint64_t								samplesPassed;			// occlusionQueryPrecise, graphics passes only
+} VulkronPassStatistics;
+
+// One frame, read back without waiting once its fence was signaled, so MAX_FRAMES_IN_FLIGHT frames behind
+typedef struct VulkronFrameStatistics {
+	uint64_t								frameNumber;
+	double									cpuFrameMilliseconds;	// from the previous frame's start to this one's
+	double									cpuRecordMilliseconds;	// recording the command buffers, secondaries included
+	double									gpuMilliseconds;		// first pass start to last pass end
+	VkExtent2D								extent;					// of the main pass target
+	VulkronPassStatistics					passList[VULKRON_FRAME_PASS_COUNT];
+} VulkronFrameStatistics;
+
+// Layouts derived from the SPIR-V of shader modules created by the engine. Identical layouts are created once and
+// shared, so pipelines reflected from shaders with the same interface keep their descriptor sets bound across switches.
+typedef struct VulkronPipelineLayoutReflection {
+	VkPipelineLayout						pipelineLayout;			// owned by the layout cache
+	std::vector<VkDescriptorSetLayout>		setLayoutList;			// indexed by set number, unused sets get an empty layout
+	std::vector<VkPushConstantRange>		pushConstantRangeList;	// one range over every stage's block
+	std::vector<VkVertexInputAttributeDescription>	vertexAttributeList;	// vertex stage inputs by location, packed into binding 0
+	VkVertexInputBindingDescription			vertexBinding;
+} VulkronPipelineLayoutReflection;
+
+// One constant_id of a shader, 64 bit constants get the value zero extended
+typedef struct VulkronSpecializationConstant {
+	uint32_t								constantID;
+	uint32_t								value;					// VkBool32, an int or the bits of a float, as the shader declares it
+} VulkronSpecializationConstant;
+
+typedef struct VulkronSamplerCreateInfo {
+	VkSampler*								pSampler;
+	VkFilter								filter					= VK_FILTER_LINEAR;
+	VkSamplerAddressMode					addressMode				= VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	float									maxAnisotropy			= 1.0f;			// > 1.0 requires samplerAnisotropy
+} VulkronSamplerCreateInfo;
+
 void vulkronDrawFrame();
+void vulkronSetCamera(VulkronCamera* camera);
+void vulkronSetLodBias(float bias);				// 0 is default, every +1 allows twice the error on screen
+VulkronResult vulkronEnableOcclusionCulling(VulkronOcclusionCullingCreateInfo* info);
+VulkronResult vulkronDisableOcclusionCulling();
+VulkronResult vulkronEnableShadows(VulkronShadowCreateInfo* info);
+VulkronResult vulkronDisableShadows();
+void vulkronSetLightDirection(glm::vec3 direction);		// direction the light travels in, world space
+VulkronResult vulkronGetShadowInfo(VulkronShadowInfo* pInfo);
+// Query pools are created for the features the device has, see VulkronPassStatistics. Offscreen batch frames are counted too.
+VulkronResult vulkronEnableFrameStatistics();
+VulkronResult vulkronDisableFrameStatistics();
+VulkronResult vulkronGetFrameStatistics(VulkronFrameStatistics* pStatistics);		// VULKRON_NOT_READY until a measured frame finished
+#ifdef VULKRON_TRACING
+// Chrome trace JSON (chrome://tracing, ui.perfetto.dev) of the events still held by every thread's ring.
+// GPU passes are only on it while frame statistics are enabled.
+VulkronResult vulkronWriteTrace(const std::string& filePath);
+#endif // VULKRON_TRACING
 
 VulkronResult vulkronCreateInstance(VulkronInstanceCreateInfo* info);
 VulkronResult vulkronCreateDevice(VulkronDeviceCreateInfo* info);
@@ -222,7 +563,68 @@ VulkronResult vulkronCreateGraphicsPipeline(VulkronGraphicsPipelineCreateInfo* i
 VulkronResult vulkronCreateRendererCommandBuffers(VulkronGraphicsCommands* info);
 VulkronResult vulkronShutdown();
 
+// Objects can be added and removed at any time between frames, isStatic picks the list they're drawn from.
+// A handle stays valid until its object is removed, the pointer from vulkronGetObject only until the next add or remove.
+// Static objects are moved with vulkronUpdateObject, the static BVH and the cached shadows don't see moves made through the pointer.
+VulkronResult vulkronAddObject(VulkronBaseObject* pObject, VulkronObjectHandle* pHandle);
+VulkronResult vulkronUpdateObject(VulkronObjectHandle handle, VulkronBaseObject* pObject);
+VulkronResult vulkronRemoveObject(VulkronObjectHandle handle);
+VulkronBaseObject* vulkronGetObject(VulkronObjectHandle handle);		// nullptr once the object was removed
+
+// Bounding sphere queries against the culling BVHs as of the last vulkronDrawFrame, objects without a loaded mesh aren't found
+VulkronResult vulkronQueryObjectsInFrustum(const glm::mat4& viewProjection, std::vector<VulkronObjectHandle>* pHandles);
+VulkronResult vulkronQueryObjectsInSphere(glm::vec3 center, float radius, std::vector<VulkronObjectHandle>* pHandles);
+VulkronResult vulkronRaycastObjects(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<VulkronObjectHandle>* pHandles);	// nearest first
+
+// Each thread submits to its own pick of queue per type, queue 0 until changed. The render thread's
+// graphics, compute and transfer queues are the ones the frame, async compute and streaming submit to.
+uint32_t vulkronGetQueueCount(VulkronQueueFlag type);
+VulkronResult vulkronSetThreadQueue(VulkronQueueFlag type, uint32_t queueIndex);
+VulkronResult vulkronQueueSubmit(VulkronQueueFlag type, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+
+VulkronResult vulkronCreateTexture(VulkronTextureCreateInfo* info);
+VulkronResult vulkronGetTextureInfo(VulkronTexture texture, VulkronTextureInfo* pInfo);
+void vulkronTouchTexture(VulkronTexture texture);		// call when the texture is drawn with, keeps it off the eviction list and streams it back in
+VulkronResult vulkronDestroyTexture(VulkronTexture texture);
+VulkronResult vulkronLoadMesh(VulkronMeshCreateInfo* info);
+VulkronResult vulkronGetMeshInfo(VulkronMesh mesh, VulkronMeshInfo* pInfo);
+VulkronResult vulkronDestroyMesh(VulkronMesh mesh);
+VulkronResult vulkronGetVertexDescriptions(VulkronMeshVertexFormat format, VulkronVertexDescriptions* pDescriptions);
+VulkronResult vulkronCreateSampler(VulkronSamplerCreateInfo* info);
+void vulkronDestroySampler(VkSampler sampler);
+std::vector<VulkronMemoryHeapBudget> vulkronGetMemoryBudget();
+VulkronResult vulkronSetMemoryBudgetInfo(VulkronMemoryBudgetInfo* info);
+// The data is copied right away and lands before the next frame reads the buffer. Writes are merged and copied
+// together once per frame, where they overlap the later one wins. The buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+VulkronResult vulkronUploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* pData, VkDeviceSize size);
+VulkronResult vulkronGetUploadBatchInfo(VulkronUploadBatchInfo* pInfo);
+// Never stall, a request that doesn't fit the readback ring waits for a later frame. Swapchain reads need
+// VK_IMAGE_USAGE_TRANSFER_SRC_BIT support from the surface, the result is in the swapchain format.
+VulkronResult vulkronReadbackBuffer(const VulkronBufferReadbackInfo* pInfo, VulkronReadbackTicket* pTicket);
+VulkronResult vulkronReadbackImage(const VulkronImageReadbackInfo* pInfo, VulkronReadbackTicket* pTicket);
+// VULKRON_NOT_READY until the frame that copied it has finished on the gpu, the data is handed over once
+VulkronResult vulkronGetReadbackResult(VulkronReadbackTicket ticket, std::vector<uint8_t>* pData);
+// Renders queued jobs into offscreen targets with every frame in flight busy, nothing is acquired or presented.
+// Images are copied back once their frame is done and encoded and written on the worker threads. The scene,
+// pipelines and streaming are the window's, only the camera changes per job and is restored afterwards.
+// Needs vulkronCreateRendererCommandBuffers, and vulkronCreateGraphicsPipeline without dynamic rendering.
+VulkronResult vulkronCreateBatchRenderer(const VulkronBatchRendererCreateInfo* pInfo);
+VulkronResult vulkronDestroyBatchRenderer();
+VulkronResult vulkronQueueBatchJob(const VulkronBatchJob* pJob, uint64_t* pJobIndex);		// pJobIndex can be null
+VulkronResult vulkronRunBatchJobs(VulkronBatchStatistics* pStatistics);						// returns once every image is written
+VulkronResult vulkronCreateComputePipeline(VulkronComputePipelineCreateInfo* info);
+VulkronResult vulkronDestroyComputePipeline(VulkronComputePipeline pipeline);
+VulkronResult vulkronDispatchCompute(VulkronComputeDispatchInfo* info);
+VulkronResult vulkronGetComputeQueueInfo(VulkronComputeQueueInfo* pInfo);
+
+// Only modules from vulkronCreatePipelineShaderStage and vulkronLoadShaderAsync can be reflected, others throw like a module the reflection can't handle.
+// Uniform buffers are never reflected as dynamic, build those layouts by hand and pass them through vulkronGetCachedPipelineLayout.
+VulkronResult vulkronReflectPipelineLayout(const VkPipelineShaderStageCreateInfo* pStages, uint32_t stageCount, VulkronPipelineLayoutReflection* pReflection);
+VulkronResult vulkronGetCachedPipelineLayout(const VkPipelineLayoutCreateInfo* pInfo, VkPipelineLayout* pLayout);
+
 std::vector<VkPhysicalDevice> vulkronGetGpuDevicesList();
+std::vector<VulkronGpuCandidate> vulkronGetGpuSelection();								// every gpu considered by the last vulkronCreateDevice
+VulkronResult vulkronGetEnabledGpuFeatures(VulkronGpuExtendedFeatures* pFeatures);		// 1.2 and 1.3 features enabled on the selected gpu
 #if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
 void vulkronGpuProperties();
 void vulkronGpuFeatures();
@@ -305,8 +707,18 @@ VkPipelineLayoutCreateInfo vulkronPipelineLayoutInfo(
 	uint32_t									pushConstantRangeCount	= 0,
 	VkPushConstantRange*						pPushConstantRanges		= nullptr);
 
+// Each file is loaded once. Constants the shader doesn't declare are dropped, the rest pick a cached permutation
+// whose specialization info stays valid until shutdown. Without constants the shader's defaults are used.
 VkPipelineShaderStageCreateInfo vulkronCreatePipelineShaderStage(
 	std::string									shaderPath, 
-	VkShaderStageFlagBits						stage);
+	VkShaderStageFlagBits						stage,
+	const VulkronSpecializationConstant*		pConstants				= nullptr,
+	uint32_t									constantCount			= 0);
+
+// Same for a stage that's already built, vulkronLoadShaderAsync's for one
+VkPipelineShaderStageCreateInfo vulkronSpecializeShaderStage(
+	const VkPipelineShaderStageCreateInfo&		stageInfo,
+	const VulkronSpecializationConstant*		pConstants,
+	uint32_t									constantCount);
 
 #endif // !VULKRON_CORE
\ No newline at end of file
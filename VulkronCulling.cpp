@@ -0,0 +1,390 @@
+#include "VulkronInternal.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+CullingInternal*    cullingInternal     = new CullingInternal();
+VulkronThreadPool*  frameThreadPool     = nullptr;
+
+static const uint32_t                       OBJECTS_PER_JOB         = 256;
+static const uint64_t                       STATIC_BUILD_INTERVAL   = 30;      // frames between static rebuilds for meshes that finished loading
+static const float                          DYNAMIC_REBUILD_COST    = 2.0f;    // refit cost over build cost at which the dynamic tree is rebuilt
+
+static void updateStaticBvh();
+static void updateDynamicBvh();
+static void buildObjectBvh(Bvh* bvh, std::vector<VulkronObjectHandle>& linearList, bool isStatic);
+static bool hasObjectBounds(const VulkronBaseObject& object);
+static void cullObject(VulkronBaseObject& object, const glm::vec4* pSphere, bool isInsideFrustum);
+static uint32_t selectLod(const MeshInternal* mesh, float pixelsPerUnit, float objectScale, float pixelError);
+
+//-------------------------------------------------------------------------------------
+// SECTION [CAMERA] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+void vulkronSetCamera(VulkronCamera* camera) {
+
+    if (nullptr == camera) {
+        cullingInternal->hasCamera = false;
+        return;
+    }
+
+    cullingInternal->camera = *camera;
+    cullingInternal->cameraPosition = glm::vec3(glm::inverse(camera->view)[3]);
+    cullingInternal->hasCamera = true;
+
+    // Gribb/Hartmann plane extraction, near is row 2 alone since vulkan depth goes from 0 to 1
+    extractFrustumPlanes(camera->projection * camera->view, cullingInternal->frustumPlaneList);
+}
+
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planeList) {
+
+    glm::vec4 rowList[4];
+
+    for (uint32_t i = 0; i < 4; i++) {
+        rowList[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    planeList[0] = rowList[3] + rowList[0];     // left
+    planeList[1] = rowList[3] - rowList[0];     // right
+    planeList[2] = rowList[3] + rowList[1];     // bottom
+    planeList[3] = rowList[3] - rowList[1];     // top
+    planeList[4] = rowList[2];                  // near
+    planeList[5] = rowList[3] - rowList[2];     // far
+
+    for (uint32_t i = 0; i < 6; i++) {
+        planeList[i] /= glm::length(glm::vec3(planeList[i]));
+    }
+}
+
+void vulkronSetLodBias(float bias) {
+    cullingInternal->lodBias = bias;
+}
+
+// Objects are placed by position, rotation (degrees, applied x then y then z) and a uniform scale
+glm::mat4 getObjectMatrix(const VulkronBaseObject& object) {
+    glm::mat4 matrix = glm::translate(glm::mat4(1.0f), object.position);
+    matrix = glm::rotate(matrix, glm::radians(object.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    matrix = glm::rotate(matrix, glm::radians(object.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    matrix = glm::rotate(matrix, glm::radians(object.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+
+    return glm::scale(matrix, glm::vec3(object.scale));
+}
+
+// World space bounding sphere of the object's mesh, false while the mesh has no bounds yet
+bool getObjectSphere(const VulkronBaseObject& object, glm::vec4* pSphere) {
+
+    if (!hasObjectBounds(object)) {
+        return false;
+    }
+
+    const VulkronMeshFileHeader& header = object.mesh->header;
+    glm::vec4 center = getObjectMatrix(object) * glm::vec4(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2], 1.0f);
+
+    *pSphere = glm::vec4(glm::vec3(center), header.sphereRadius * object.scale);
+
+    return true;
+}
+
+bool isSphereInFrustum(const glm::vec4& sphere, const glm::vec4* planeList) {
+
+    for (uint32_t i = 0; i < 6; i++) {
+        if (glm::dot(glm::vec3(planeList[i]), glm::vec3(sphere)) + planeList[i].w < -sphere.w) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// evicted meshes keep their bounds, being visible is what streams them back in
+static bool hasObjectBounds(const VulkronBaseObject& object) {
+    MeshInternal* mesh = object.mesh;
+    return nullptr != mesh && (mesh->state == VULKRON_MESH_STATE_RESIDENT || mesh->state == VULKRON_MESH_STATE_EVICTED);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [VISIBILITY] ---------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Static and dynamic objects each have a BVH, a frustum walk over both finds the objects that can be visible
+// and subtrees fully outside are dropped without looking at their objects. Only those objects get the per
+// object pass, in parallel, every object is only touched by one thread. Objects culled this way keep the
+// isCulled they were given when the tree was built or when they were last visible.
+void updateVisibility(std::vector<VulkronBaseObject>& staticObjectsList, std::vector<VulkronBaseObject>& dynamicObjectsList) {
+    VULKRON_TRACE_SCOPE("frame", "updateVisibility");
+
+    updateStaticBvh();
+    updateDynamicBvh();
+
+    // whatever was visible last frame starts out culled, the objects still visible are found again below
+    for (VulkronObjectHandle handle : cullingInternal->previousVisibleList) {
+        VulkronBaseObject* object = vulkronGetObject(handle);
+
+        if (nullptr != object) {
+            object->isCulled = true;
+        }
+    }
+
+    auto& candidateList = cullingInternal->candidateList;
+    candidateList.clear();
+
+    // without a camera every object is visible
+    uint32_t planeMask = cullingInternal->hasCamera ? 0x3F : 0;
+
+    for (bool isStatic : { true, false }) {
+        const Bvh& bvh = isStatic ? cullingInternal->staticBvh : cullingInternal->dynamicBvh;
+        auto& hitList = cullingInternal->hitList;
+
+        hitList.clear();
+        queryBvhFrustum(bvh, cullingInternal->frustumPlaneList, planeMask, hitList);
+
+        for (const BvhHit& hit : hitList) {
+            VulkronObjectHandle handle = bvh.itemList[hit.item];
+            VulkronBaseObject* object = getSceneObject(handle, isStatic);
+
+            if (nullptr != object) {
+                candidateList.push_back({ handle, object, &bvh.sphereList[hit.item], hit.isInside, isStatic });
+            }
+        }
+
+        for (VulkronObjectHandle handle : isStatic ? cullingInternal->staticLinearList : cullingInternal->dynamicLinearList) {
+            VulkronBaseObject* object = getSceneObject(handle, isStatic);
+
+            if (nullptr == object) {
+                continue;
+            }
+
+            // its mesh loaded, it joins the static tree with the next batched rebuild
+            if (isStatic && object->frustumCulling && hasObjectBounds(*object)) {
+                cullingInternal->hasPendingStatic = true;
+            }
+
+            candidateList.push_back({ handle, object, nullptr, false, isStatic });
+        }
+    }
+
+    frameThreadPool->parallelFor(static_cast<uint32_t>(candidateList.size()), OBJECTS_PER_JOB, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            cullObject(*candidateList[i].pObject, candidateList[i].pSphere, candidateList[i].isInside);
+        }
+    });
+
+    cullingInternal->visibleStaticList.clear();
+    cullingInternal->visibleDynamicList.clear();
+    cullingInternal->previousVisibleList.clear();
+
+    for (const VisibilityCandidate& candidate : candidateList) {
+        if (candidate.pObject->isCulled) {
+            continue;
+        }
+
+        if (candidate.isStatic) {
+            cullingInternal->visibleStaticList.push_back(static_cast<uint32_t>(candidate.pObject - staticObjectsList.data()));
+        }
+        else {
+            cullingInternal->visibleDynamicList.push_back(static_cast<uint32_t>(candidate.pObject - dynamicObjectsList.data()));
+        }
+
+        cullingInternal->previousVisibleList.push_back(candidate.handle);
+    }
+}
+
+// Rebuilt when static objects were added or moved. Meshes that finish loading are batched, until the
+// rebuild their objects are tested one by one.
+static void updateStaticBvh() {
+
+    bool isChanged = cullingInternal->staticVersion != sceneInternal->staticVersion;
+    bool isPendingDue = cullingInternal->hasPendingStatic && frameNumber >= cullingInternal->nextStaticBuildFrame;
+
+    if (!isChanged && !isPendingDue) {
+        return;
+    }
+
+    buildObjectBvh(&cullingInternal->staticBvh, cullingInternal->staticLinearList, true);
+
+    cullingInternal->staticVersion = sceneInternal->staticVersion;
+    cullingInternal->hasPendingStatic = false;
+    cullingInternal->nextStaticBuildFrame = frameNumber + STATIC_BUILD_INTERVAL;
+}
+
+// Refit every frame for the new positions, rebuilt when objects were added, when one can't stay in the tree
+// or once moving objects have spread the nodes out too far
+static void updateDynamicBvh() {
+
+    Bvh& bvh = cullingInternal->dynamicBvh;
+
+    if (cullingInternal->dynamicVersion != sceneInternal->dynamicVersion) {
+        buildObjectBvh(&bvh, cullingInternal->dynamicLinearList, false);
+        cullingInternal->dynamicVersion = sceneInternal->dynamicVersion;
+        return;
+    }
+
+    std::atomic<bool> isRebuildNeeded = false;
+
+    frameThreadPool->parallelFor(static_cast<uint32_t>(bvh.itemList.size()), OBJECTS_PER_JOB, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            VulkronBaseObject* object = getSceneObject(bvh.itemList[i], false);
+
+            bvh.sphereList[i].w = -1.0f;
+
+            if (nullptr == object) {
+                continue;
+            }
+
+            if (!object->frustumCulling || !getObjectSphere(*object, &bvh.sphereList[i])) {
+                isRebuildNeeded.store(true, std::memory_order_relaxed);
+            }
+        }
+    });
+
+    for (VulkronObjectHandle handle : cullingInternal->dynamicLinearList) {
+        VulkronBaseObject* object = getSceneObject(handle, false);
+
+        if (nullptr != object && object->frustumCulling && hasObjectBounds(*object)) {
+            isRebuildNeeded = true;
+            break;
+        }
+    }
+
+    if (!isRebuildNeeded) {
+        refitBvh(&bvh);
+        isRebuildNeeded = getBvhCost(bvh) > bvh.builtCost * DYNAMIC_REBUILD_COST;
+    }
+
+    if (isRebuildNeeded) {
+        buildObjectBvh(&bvh, cullingInternal->dynamicLinearList, false);
+    }
+}
+
+// Objects with bounds and frustum culling go into the tree and start out culled, the rest into linearList
+static void buildObjectBvh(Bvh* bvh, std::vector<VulkronObjectHandle>& linearList, bool isStatic) {
+
+    auto& objectList = isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+    auto& slotIndexList = isStatic ? sceneInternal->staticSlotList : sceneInternal->dynamicSlotList;
+    uint32_t objectCount = static_cast<uint32_t>(objectList.size());
+
+    std::vector<BvhBuildItem> itemList(objectCount);
+    std::vector<uint8_t> isBoundedList(objectCount);
+
+    frameThreadPool->parallelFor(objectCount, OBJECTS_PER_JOB, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            VulkronBaseObject& object = objectList[i];
+            BvhBuildItem& item = itemList[i];
+
+            isBoundedList[i] = object.frustumCulling && getObjectSphere(object, &item.sphere);
+
+            if (!isBoundedList[i]) {
+                continue;
+            }
+
+            item.center = glm::vec3(item.sphere);
+            item.boundsMin = item.center - item.sphere.w;
+            item.boundsMax = item.center + item.sphere.w;
+            object.isCulled = true;
+        }
+    });
+
+    linearList.clear();
+
+    uint32_t itemCount = 0;
+
+    for (uint32_t i = 0; i < objectCount; i++) {
+        uint32_t slotIndex = slotIndexList[i];
+        VulkronObjectHandle handle = { slotIndex, sceneInternal->slotList[slotIndex].generation };
+
+        if (!isBoundedList[i]) {
+            linearList.push_back(handle);
+            continue;
+        }
+
+        itemList[itemCount] = itemList[i];
+        itemList[itemCount].handle = handle;
+        itemCount++;
+    }
+
+    itemList.resize(itemCount);
+    buildBvh(bvh, itemList);
+}
+
+// pSphere is the bounding sphere cached in the tree, null to compute it here
+static void cullObject(VulkronBaseObject& object, const glm::vec4* pSphere, bool isInsideFrustum) {
+
+    object.isCulled = false;
+
+    MeshInternal* mesh = object.mesh;
+
+    if (nullptr == mesh) {
+        object.lodIndex = 0;
+        return;
+    }
+
+    glm::vec4 sphere;
+
+    if (nullptr != pSphere) {
+        sphere = *pSphere;
+    }
+    else if (!getObjectSphere(object, &sphere)) {
+        mesh->lastUsedFrame.store(frameNumber, std::memory_order_relaxed);
+        object.lodIndex = 0;
+        return;
+    }
+
+    if (!cullingInternal->hasCamera) {
+        mesh->lastUsedFrame.store(frameNumber, std::memory_order_relaxed);
+        object.lodIndex = 0;
+        return;
+    }
+
+    glm::vec3 center = glm::vec3(sphere);
+    float radius = sphere.w;
+
+    if (object.frustumCulling && !isInsideFrustum && !isSphereInFrustum(sphere, cullingInternal->frustumPlaneList)) {
+        object.isCulled = true;
+        return;
+    }
+
+    mesh->lastUsedFrame.store(frameNumber, std::memory_order_relaxed);
+
+    if (mesh->lodList.size() == 1) {
+        object.lodIndex = 0;
+        return;
+    }
+
+    // distance to the front of the sphere, inside the sphere always gets full detail
+    float distance = glm::length(center - cullingInternal->cameraPosition) - radius;
+
+    if (distance <= 0.0f) {
+        object.lodIndex = 0;
+        return;
+    }
+
+    // projected size of the bounding sphere, lod errors are measured against it
+    float pixelsPerUnit = cullingInternal->camera.projection[1][1] * cullingInternal->camera.viewportHeight * 0.5f / distance;
+    float pixelError = cullingInternal->lodPixelError * std::exp2(cullingInternal->lodBias);
+
+    uint32_t currentLod = std::min(object.lodIndex, static_cast<uint32_t>(mesh->lodList.size()) - 1);
+    uint32_t targetLod = selectLod(mesh, pixelsPerUnit, object.scale, pixelError);
+
+    // hysteresis, the error has to move clearly past the threshold before the lod changes so
+    // objects sitting right on the boundary don't pop back and forth
+    if (targetLod > currentLod) {
+        targetLod = std::max(currentLod, selectLod(mesh, pixelsPerUnit, object.scale, pixelError * (1.0f - cullingInternal->lodHysteresis)));
+    }
+    else if (targetLod < currentLod) {
+        targetLod = std::min(currentLod, selectLod(mesh, pixelsPerUnit, object.scale, pixelError * (1.0f + cullingInternal->lodHysteresis)));
+    }
+
+    object.lodIndex = targetLod;
+}
+
+// Coarsest lod whose error stays under pixelError on screen
+static uint32_t selectLod(const MeshInternal* mesh, float pixelsPerUnit, float objectScale, float pixelError) {
+
+    for (uint32_t i = static_cast<uint32_t>(mesh->lodList.size()) - 1; i > 0; i--) {
+        if (mesh->lodList[i].error * objectScale * pixelsPerUnit <= pixelError) {
+            return i;
+        }
+    }
+
+    return 0;
+}
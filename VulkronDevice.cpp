@@ -5,15 +5,35 @@ DeviceInternal*		        deviceInternal	= new DeviceInternal();
 QueueFamily*		        queueFamily		= new QueueFamily();
 Queue*                      queue           = new Queue();
 
+static const VkDeviceSize   UPLOAD_RING_SIZE    = 64 * 1024 * 1024;
+static const VkDeviceSize   READBACK_RING_SIZE  = 64 * 1024 * 1024;     // fits a 4k screenshot
+
+// Queue each thread submits to, per type, every thread starts on queue 0
+static thread_local uint32_t    threadGraphicsQueue     = 0;
+static thread_local uint32_t    threadComputeQueue      = 0;
+static thread_local uint32_t    threadTransferQueue     = 0;
+
 // Device
 static void userPickGpu();
 static void pickMostEfficientGpu();
 static void createLogicalDevice();
 static VkPhysicalDeviceFeatures* getFeatures(VulkronGpuFeatures features);
+static void* getExtendedFeatures(VkPhysicalDeviceVulkan12Features* vulkan12Features, VkPhysicalDeviceVulkan13Features* vulkan13Features);
 static int rateGpuSuitability(VkPhysicalDevice gpu);
+static VulkronGpuCandidate makeGpuCandidate(VkPhysicalDevice gpu);
+static bool checkGpuRequirements(VkPhysicalDevice gpu, std::string* pReason);
 static void getSupportedDeviceExtensions();
+static bool isDeviceExtensionSupported(const char* extensionName);
 static uint32_t findQueueFamilies(VkQueueFlagBits queueFlag);
+static void reserveQueues(uint32_t familyIndex, uint32_t count, const std::vector<float>& priorityList, std::map<uint32_t, std::vector<float>>& familyPriorityMap,
+    std::vector<uint32_t>& queueIndexList);
+static DeviceQueue* findDeviceQueue(uint32_t familyIndex, uint32_t queueIndex);
+static std::vector<DeviceQueue*>* getQueueList(VulkronQueueFlag type);
+static uint32_t* getThreadQueueIndex(VulkronQueueFlag type);
 static void getGpuProperties();
+#ifdef VULKRON_TRACING
+static bool hasDeviceTimeDomain();
+#endif // VULKRON_TRACING
 
 VulkronResult vulkronCreateDevice(VulkronDeviceCreateInfo* info) {
     device = info;
@@ -35,6 +55,13 @@ VulkronResult vulkronCreateDevice(VulkronDeviceCreateInfo* info) {
 
     createLogicalDevice();
 
+    workerThreadPool = new VulkronThreadPool("worker");
+    frameThreadPool = new VulkronThreadPool("frame worker");
+    createUploadRing(UPLOAD_RING_SIZE);
+    createReadbackRing(READBACK_RING_SIZE);
+    createTransferBatches();
+    createComputeScheduler();
+
     return VULKRON_SUCCESS;
 }
 
@@ -52,44 +79,192 @@ void destroyDevice() {
 
 static void userPickGpu() {
 
-    // get selected gpu features geometry shader to make sure application runs
-    VkPhysicalDeviceFeatures gpuFeatures;
-    vkGetPhysicalDeviceFeatures(device->gpuList.at(0), &gpuFeatures);
+    VulkronGpuCandidate candidate = makeGpuCandidate(device->gpuList.at(0));
 
-    if (!gpuFeatures.geometryShader) {
-        throw std::runtime_error("Gpu doesn't support geometry shaders");
+    if (!candidate.isSuitable) {
+        throw std::runtime_error("Gpu " + candidate.name + " can't be used: " + candidate.reason);
     }
 
-    deviceInternal->gpu = device->gpuList.at(0);
+    candidate.isSelected = true;
+    candidate.reason = "only gpu given";
+    deviceInternal->gpuCandidateList = { candidate };
+
+    deviceInternal->gpu = candidate.gpu;
 
     getGpuProperties();
 }
 
 static void pickMostEfficientGpu() {
 
-    std::multimap<int, VkPhysicalDevice> candidates;
+    std::vector<VulkronGpuCandidate>& candidateList = deviceInternal->gpuCandidateList;
+    candidateList.clear();
 
     for (auto gpu : device->gpuList) {
-        uint32_t score = rateGpuSuitability(gpu);
-        candidates.insert(std::make_pair(score, gpu));
+        candidateList.push_back(makeGpuCandidate(gpu));
     }
 
-    // Check if the best candidate is suitable at all
-    if (candidates.rbegin()->first > 0) {
-        deviceInternal->gpu = candidates.rbegin()->second;
+    // Measure every suitable gpu, if one can't be measured the scores aren't comparable so all fall back
+    bool isBenchmarked = device->useGpuBenchmark;
+
+    for (auto& candidate : candidateList) {
+        if (!isBenchmarked || !candidate.isSuitable) {
+            continue;
+        }
+
+        try {
+            benchmarkGpu(candidate.gpu, &candidate);
+        }
+        catch (const std::exception& e) {
+            isBenchmarked = false;
+#if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
+            LOG("gpu benchmark failed on " << candidate.name << ": " << e.what());
+#endif // _DEBUG || VULKRON_ENGINE_DEBUGGING
+        }
     }
-    else {
+
+    if (!isBenchmarked) {
+        for (auto& candidate : candidateList) {
+            if (candidate.isSuitable) {
+                candidate.scoreSource = VULKRON_GPU_SCORE_SOURCE_HEURISTIC;
+                candidate.fillRate = 0.0f;
+                candidate.computeThroughput = 0.0f;
+                candidate.copyBandwidth = 0.0f;
+                candidate.score = static_cast<float>(rateGpuSuitability(candidate.gpu));
+            }
+        }
+    }
+
+    VulkronGpuCandidate* selected = nullptr;
+
+    for (auto& candidate : candidateList) {
+        if (candidate.isSuitable && (nullptr == selected || candidate.score > selected->score)) {
+            selected = &candidate;
+        }
+    }
+
+    // Check if the best candidate is suitable at all
+    if (nullptr == selected) {
         throw std::runtime_error("failed to find a suitable GPU!");
     }
 
+    selected->isSelected = true;
+    selected->reason = isBenchmarked ? "highest benchmark score" : "highest heuristic score";
+
+#if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
+    for (const auto& candidate : candidateList) {
+        LOG("gpu " << candidate.name << (candidate.isSelected ? " [selected]" : "") << " score " << candidate.score
+            << " fill " << candidate.fillRate << " GB/s compute " << candidate.computeThroughput << " GFLOPS copy " << candidate.copyBandwidth
+            << " GB/s, " << candidate.reason);
+    }
+#endif // _DEBUG || VULKRON_ENGINE_DEBUGGING
+
+    deviceInternal->gpu = selected->gpu;
+
     getGpuProperties();
 
 }
 
-static void createLogicalDevice() {
+// Fills the requirement part of the candidate, the score is left for the caller
+static VulkronGpuCandidate makeGpuCandidate(VkPhysicalDevice gpu) {
 
-    float defaultQueuePriority = 0.0f;
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    VkPhysicalDeviceProperties gpuProperties;
+    vkGetPhysicalDeviceProperties(gpu, &gpuProperties);
+
+    VulkronGpuCandidate candidate = {};
+    candidate.gpu = gpu;
+    candidate.name = gpuProperties.deviceName;
+    candidate.deviceType = gpuProperties.deviceType;
+    candidate.driverVersion = gpuProperties.driverVersion;
+    candidate.scoreSource = VULKRON_GPU_SCORE_SOURCE_NONE;
+    candidate.isSuitable = checkGpuRequirements(gpu, &candidate.reason);
+
+    return candidate;
+}
+
+// What the engine needs from a gpu, reason says what's missing
+static bool checkGpuRequirements(VkPhysicalDevice gpu, std::string* pReason) {
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, queueFamilyList.data());
+
+    uint32_t graphicsFamily = UINT32_MAX;
+
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        if (queueFamilyList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            graphicsFamily = i;
+            break;
+        }
+    }
+
+    if (graphicsFamily == UINT32_MAX) {
+        *pReason = "no graphics queue family";
+        return false;
+    }
+
+    if (device->isUsingSwapchain) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> extensionList(extensionCount);
+        vkEnumerateDeviceExtensionProperties(gpu, nullptr, &extensionCount, extensionList.data());
+
+        bool hasSwapchain = std::any_of(extensionList.begin(), extensionList.end(), [](const VkExtensionProperties& extension) {
+            return strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+        });
+
+        if (!hasSwapchain) {
+            *pReason = "VK_KHR_swapchain not supported";
+            return false;
+        }
+
+        // the swapchain presents from the graphics queue
+        VkBool32 presentSupport = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(gpu, graphicsFamily, instanceInternal->surface, &presentSupport);
+
+        if (!presentSupport) {
+            *pReason = "graphics queue can't present to the surface";
+            return false;
+        }
+    }
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(gpu, &supportedFeatures);
+
+    VkPhysicalDeviceFeatures* requestedFeatures = getFeatures(device->gpuEnabledFeatures);
+
+    // VkPhysicalDeviceFeatures is nothing but VkBool32 members
+    const VkBool32* requested = reinterpret_cast<const VkBool32*>(requestedFeatures);
+    const VkBool32* supported = reinterpret_cast<const VkBool32*>(&supportedFeatures);
+    uint32_t featureCount = sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32);
+
+    bool hasFeatures = true;
+
+    for (uint32_t i = 0; i < featureCount; i++) {
+        if (requested[i] && !supported[i]) {
+            hasFeatures = false;
+            break;
+        }
+    }
+
+    delete requestedFeatures;
+
+    if (!hasFeatures) {
+        *pReason = "requested gpu features not supported";
+        return false;
+    }
+
+    *pReason = "suitable";
+    return true;
+}
+
+std::vector<VulkronGpuCandidate> vulkronGetGpuSelection() {
+    return deviceInternal->gpuCandidateList;
+}
+
+static void createLogicalDevice() {
 
     if (device->graphicsQueueCount == 0) {
         throw std::runtime_error("queue count of 0 is not allowed");
@@ -99,12 +274,6 @@ static void createLogicalDevice() {
     // Graphics queue
     if (device->graphicsQueueFlag & VK_QUEUE_GRAPHICS_BIT) {
         deviceInternal->queuefamily.graphicsQueueIndex = findQueueFamilies(VK_QUEUE_GRAPHICS_BIT);
-        VkDeviceQueueCreateInfo queueInfo = {};
-        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queueInfo.queueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
-        queueInfo.queueCount = device->graphicsQueueCount;
-        queueInfo.pQueuePriorities = &defaultQueuePriority;
-        queueCreateInfos.push_back(queueInfo);
     }
     else {
         deviceInternal->queuefamily.graphicsQueueIndex = 0;
@@ -113,42 +282,43 @@ static void createLogicalDevice() {
     // Dedicated compute queue
     if (device->computeQueueFlag & VK_QUEUE_COMPUTE_BIT) {
         deviceInternal->queuefamily.computeQueueIndex = findQueueFamilies(VK_QUEUE_COMPUTE_BIT);
-
-        if (deviceInternal->queuefamily.computeQueueIndex != deviceInternal->queuefamily.graphicsQueueIndex) {
-            // If compute family index differs, we need an additional queue create info for the compute queue
-            VkDeviceQueueCreateInfo queueInfo = {};
-            queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueInfo.queueFamilyIndex = deviceInternal->queuefamily.computeQueueIndex;
-            queueInfo.queueCount = device->computeQueueCount;
-            queueInfo.pQueuePriorities = &defaultQueuePriority;
-            queueCreateInfos.push_back(queueInfo);
-        }
     }
     else {
-        // Else we use the same queue
+        // Else we use the same family
         deviceInternal->queuefamily.computeQueueIndex = deviceInternal->queuefamily.graphicsQueueIndex;
     }
 
     // Dedicated transfer queue
     if (device->transferQueueFlag & VK_QUEUE_TRANSFER_BIT) {
         deviceInternal->queuefamily.transferQueueIndex = findQueueFamilies(VK_QUEUE_TRANSFER_BIT);
-
-        if ((deviceInternal->queuefamily.transferQueueIndex != deviceInternal->queuefamily.graphicsQueueIndex)
-            && (deviceInternal->queuefamily.transferQueueIndex != deviceInternal->queuefamily.computeQueueIndex)) {
-            // If compute family index differs, we need an additional queue create info for the compute queue
-            VkDeviceQueueCreateInfo queueInfo = {};
-            queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-            queueInfo.queueFamilyIndex = deviceInternal->queuefamily.transferQueueIndex;
-            queueInfo.queueCount = device->transferQueueCount;
-            queueInfo.pQueuePriorities = &defaultQueuePriority;
-            queueCreateInfos.push_back(queueInfo);
-        }
     }
     else {
-        // Else we use the same queue
+        // Else we use the same family
         deviceInternal->queuefamily.transferQueueIndex = deviceInternal->queuefamily.graphicsQueueIndex;
     }
 
+    // Roles sharing a family get their own queues as long as the family has enough of them,
+    // so streaming uploads and frame submits stop serializing on a single VkQueue
+    std::map<uint32_t, std::vector<float>> familyPriorityMap;
+    std::vector<uint32_t> graphicsQueueIndexList;
+    std::vector<uint32_t> computeQueueIndexList;
+    std::vector<uint32_t> transferQueueIndexList;
+
+    reserveQueues(deviceInternal->queuefamily.graphicsQueueIndex, device->graphicsQueueCount, device->graphicsQueuePriorities, familyPriorityMap, graphicsQueueIndexList);
+    reserveQueues(deviceInternal->queuefamily.computeQueueIndex, std::max(1u, device->computeQueueCount), device->computeQueuePriorities, familyPriorityMap, computeQueueIndexList);
+    reserveQueues(deviceInternal->queuefamily.transferQueueIndex, std::max(1u, device->transferQueueCount), device->transferQueuePriorities, familyPriorityMap, transferQueueIndexList);
+
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+
+    for (const auto& [familyIndex, priorityList] : familyPriorityMap) {
+        VkDeviceQueueCreateInfo queueInfo = {};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = familyIndex;
+        queueInfo.queueCount = static_cast<uint32_t>(priorityList.size());
+        queueInfo.pQueuePriorities = priorityList.data();
+        queueCreateInfos.push_back(queueInfo);
+    }
+
     VkPhysicalDeviceFeatures* features = getFeatures(device->gpuEnabledFeatures);
 
     VkDeviceCreateInfo deviceCreateInfo = {};
@@ -164,6 +334,30 @@ static void createLogicalDevice() {
         deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
 
+    // lets occlusion culling compact its draws on the gpu, it falls back to zero instance draws without it
+    if (isDeviceExtensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+        deviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        deviceInternal->hasDrawIndirectCount = true;
+    }
+
+    // real heap budgets for eviction, without it the engine only knows about its own allocations
+    if (isDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        deviceInternal->hasMemoryBudget = true;
+    }
+
+#ifdef VULKRON_TRACING
+    // samples the gpu clock without a submit, traces line gpu passes up with the cpu events through it
+    if (isDeviceExtensionSupported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) && hasDeviceTimeDomain()) {
+        deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        deviceInternal->hasCalibratedTimestamps = true;
+    }
+#endif // VULKRON_TRACING
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    VkPhysicalDeviceVulkan13Features vulkan13Features = {};
+    deviceCreateInfo.pNext = getExtendedFeatures(&vulkan12Features, &vulkan13Features);
+
     deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -178,13 +372,125 @@ static void createLogicalDevice() {
         throw std::runtime_error("failed to create logical device!");
     }
 
-    vkGetDeviceQueue(deviceInternal->logicalDevice, deviceInternal->queuefamily.graphicsQueueIndex, 0, &queue->graphics);
-    vkGetDeviceQueue(deviceInternal->logicalDevice, deviceInternal->queuefamily.computeQueueIndex, 0, &queue->compute);
-    vkGetDeviceQueue(deviceInternal->logicalDevice, deviceInternal->queuefamily.transferQueueIndex, 0, &queue->transfer);
+    for (const auto& [familyIndex, priorityList] : familyPriorityMap) {
+        for (uint32_t i = 0; i < priorityList.size(); i++) {
+            DeviceQueue* deviceQueue = new DeviceQueue();
+            deviceQueue->familyIndex = familyIndex;
+            deviceQueue->queueIndex = i;
+            deviceQueue->priority = priorityList[i];
+            vkGetDeviceQueue(deviceInternal->logicalDevice, familyIndex, i, &deviceQueue->queue);
+
+            queue->deviceQueueList.emplace_back(deviceQueue);
+        }
+    }
+
+    for (uint32_t queueIndex : graphicsQueueIndexList) {
+        queue->graphicsList.push_back(findDeviceQueue(deviceInternal->queuefamily.graphicsQueueIndex, queueIndex));
+    }
+
+    for (uint32_t queueIndex : computeQueueIndexList) {
+        queue->computeList.push_back(findDeviceQueue(deviceInternal->queuefamily.computeQueueIndex, queueIndex));
+    }
+
+    for (uint32_t queueIndex : transferQueueIndexList) {
+        queue->transferList.push_back(findDeviceQueue(deviceInternal->queuefamily.transferQueueIndex, queueIndex));
+    }
+
+    if (deviceInternal->hasDrawIndirectCount) {
+        deviceInternal->pfnCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(vkGetDeviceProcAddr(deviceInternal->logicalDevice, "vkCmdDrawIndexedIndirectCountKHR"));
+        deviceInternal->hasDrawIndirectCount = deviceInternal->pfnCmdDrawIndexedIndirectCount != nullptr;
+    }
+
+    if (deviceInternal->hasCalibratedTimestamps) {
+        deviceInternal->pfnGetCalibratedTimestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(deviceInternal->logicalDevice, "vkGetCalibratedTimestampsEXT"));
+        deviceInternal->hasCalibratedTimestamps = deviceInternal->pfnGetCalibratedTimestamps != nullptr;
+    }
 
     delete features;
 }
 
+// Chains the 1.2 and 1.3 features the application asked for and the gpu supports, nullptr on a 1.0/1.1 gpu
+static void* getExtendedFeatures(VkPhysicalDeviceVulkan12Features* vulkan12Features, VkPhysicalDeviceVulkan13Features* vulkan13Features) {
+
+    const VulkronGpuExtendedFeatures& requested = device->gpuExtendedFeatures;
+    uint32_t apiVersion = deviceInternal->gpuProperties.apiVersion;
+
+    if (apiVersion < VK_API_VERSION_1_2) {
+        return nullptr;
+    }
+
+    VkPhysicalDeviceVulkan12Features supported12 = {};
+    supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    VkPhysicalDeviceVulkan13Features supported13 = {};
+    supported13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+
+    VkPhysicalDeviceFeatures2 supportedFeatures = {};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supported12;
+
+    if (apiVersion >= VK_API_VERSION_1_3) {
+        supported12.pNext = &supported13;
+    }
+
+    vkGetPhysicalDeviceFeatures2(deviceInternal->gpu, &supportedFeatures);
+
+    *vulkan12Features = {};
+    vulkan12Features->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    // timeline semaphores order async compute against the graphics queue
+    vulkan12Features->timelineSemaphore = requested.timelineSemaphore && supported12.timelineSemaphore;
+    vulkan12Features->bufferDeviceAddress = requested.bufferDeviceAddress && supported12.bufferDeviceAddress;
+
+    // bindless style descriptor arrays need the whole group, enable every part the gpu has
+    if (requested.descriptorIndexing && supported12.descriptorIndexing) {
+        vulkan12Features->descriptorIndexing = VK_TRUE;
+        vulkan12Features->shaderSampledImageArrayNonUniformIndexing = supported12.shaderSampledImageArrayNonUniformIndexing;
+        vulkan12Features->shaderStorageBufferArrayNonUniformIndexing = supported12.shaderStorageBufferArrayNonUniformIndexing;
+        vulkan12Features->descriptorBindingSampledImageUpdateAfterBind = supported12.descriptorBindingSampledImageUpdateAfterBind;
+        vulkan12Features->descriptorBindingStorageBufferUpdateAfterBind = supported12.descriptorBindingStorageBufferUpdateAfterBind;
+        vulkan12Features->descriptorBindingUpdateUnusedWhilePending = supported12.descriptorBindingUpdateUnusedWhilePending;
+        vulkan12Features->descriptorBindingPartiallyBound = supported12.descriptorBindingPartiallyBound;
+        vulkan12Features->descriptorBindingVariableDescriptorCount = supported12.descriptorBindingVariableDescriptorCount;
+        vulkan12Features->runtimeDescriptorArray = supported12.runtimeDescriptorArray;
+    }
+
+    deviceInternal->hasTimelineSemaphore = vulkan12Features->timelineSemaphore;
+    deviceInternal->hasBufferDeviceAddress = vulkan12Features->bufferDeviceAddress;
+    deviceInternal->hasDescriptorIndexing = vulkan12Features->descriptorIndexing;
+
+    if (apiVersion < VK_API_VERSION_1_3) {
+        return vulkan12Features;
+    }
+
+    *vulkan13Features = {};
+    vulkan13Features->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features->dynamicRendering = requested.dynamicRendering && supported13.dynamicRendering;
+    vulkan13Features->synchronization2 = requested.synchronization2 && supported13.synchronization2;
+
+    deviceInternal->hasDynamicRendering = vulkan13Features->dynamicRendering;
+    deviceInternal->hasSynchronization2 = vulkan13Features->synchronization2;
+
+    vulkan12Features->pNext = vulkan13Features;
+
+    return vulkan12Features;
+}
+
+VulkronResult vulkronGetEnabledGpuFeatures(VulkronGpuExtendedFeatures* pFeatures) {
+
+    if (nullptr == pFeatures) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    pFeatures->dynamicRendering = deviceInternal->hasDynamicRendering;
+    pFeatures->synchronization2 = deviceInternal->hasSynchronization2;
+    pFeatures->timelineSemaphore = deviceInternal->hasTimelineSemaphore;
+    pFeatures->descriptorIndexing = deviceInternal->hasDescriptorIndexing;
+    pFeatures->bufferDeviceAddress = deviceInternal->hasBufferDeviceAddress;
+
+    return VULKRON_SUCCESS;
+}
+
 static VkPhysicalDeviceFeatures* getFeatures(VulkronGpuFeatures features) {
     VkPhysicalDeviceFeatures* vkFeatures = new VkPhysicalDeviceFeatures();
 
@@ -247,15 +553,13 @@ static VkPhysicalDeviceFeatures* getFeatures(VulkronGpuFeatures features) {
     return vkFeatures;
 }
 
+// Used when the benchmark is off or failed, requirements are already checked
 static int rateGpuSuitability(VkPhysicalDevice gpu) {
     int score = 0;
 
     VkPhysicalDeviceProperties gpuProperties;
     vkGetPhysicalDeviceProperties(gpu, &gpuProperties);
 
-    VkPhysicalDeviceFeatures gpuFeatures;
-    vkGetPhysicalDeviceFeatures(gpu, &gpuFeatures);
-
     // Discrete GPUs have a significant performance advantage
     if (gpuProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
         score += 1000;
@@ -264,11 +568,6 @@ static int rateGpuSuitability(VkPhysicalDevice gpu) {
     // Maximum possible size of textures affects graphics quality
     score += gpuProperties.limits.maxImageDimension2D;
 
-    // Application can't function without geometry shaders
-    if (!gpuFeatures.geometryShader) {
-        return 0;
-    }
-
     return score;
 }
 
@@ -286,6 +585,32 @@ static void getSupportedDeviceExtensions() {
     }
 }
 
+static bool isDeviceExtensionSupported(const char* extensionName) {
+    const auto& extensionList = deviceInternal->supportedExtensionsList;
+    return std::find(extensionList.begin(), extensionList.end(), extensionName) != extensionList.end();
+}
+
+#ifdef VULKRON_TRACING
+// The extension only helps if the gpu clock is one of the domains it can sample
+static bool hasDeviceTimeDomain() {
+
+    auto getTimeDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+        vkGetInstanceProcAddr(*instance->pInstance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+
+    if (nullptr == getTimeDomains) {
+        return false;
+    }
+
+    uint32_t timeDomainCount = 0;
+    getTimeDomains(deviceInternal->gpu, &timeDomainCount, nullptr);
+
+    std::vector<VkTimeDomainEXT> timeDomainList(timeDomainCount);
+    getTimeDomains(deviceInternal->gpu, &timeDomainCount, timeDomainList.data());
+
+    return std::find(timeDomainList.begin(), timeDomainList.end(), VK_TIME_DOMAIN_DEVICE_EXT) != timeDomainList.end();
+}
+#endif // VULKRON_TRACING
+
 static uint32_t findQueueFamilies(VkQueueFlagBits queueFlag) {
 
     uint32_t queueFamilySize = static_cast<uint32_t>(deviceInternal->queuefamily.queueFamilyPropertiesList.size());
@@ -313,7 +638,9 @@ static uint32_t findQueueFamilies(VkQueueFlagBits queueFlag) {
                 return i;
             }
         }
-        break;
+
+        // no async compute family, a graphics family always supports compute as well
+        return findQueueFamilies(VK_QUEUE_GRAPHICS_BIT);
 
     case VK_QUEUE_TRANSFER_BIT:
         for (uint32_t i = 0; i < queueFamilySize; i++) {
@@ -326,7 +653,9 @@ static uint32_t findQueueFamilies(VkQueueFlagBits queueFlag) {
                 return i;
             }
         }
-        break;
+
+        // no transfer only family, compute and graphics families can always transfer
+        return findQueueFamilies(VK_QUEUE_COMPUTE_BIT);
 
     default:
         throw std::runtime_error("Could not find a matching queue family index");
@@ -334,6 +663,38 @@ static uint32_t findQueueFamilies(VkQueueFlagBits queueFlag) {
     }
 }
 
+static void reserveQueues(uint32_t familyIndex, uint32_t count, const std::vector<float>& priorityList, std::map<uint32_t, std::vector<float>>& familyPriorityMap,
+    std::vector<uint32_t>& queueIndexList) {
+
+    uint32_t familyQueueCount = deviceInternal->queuefamily.queueFamilyPropertiesList[familyIndex].queueCount;
+    std::vector<float>& familyPriorityList = familyPriorityMap[familyIndex];
+
+    for (uint32_t i = 0; i < count; i++) {
+        float priority = i < priorityList.size() ? std::clamp(priorityList[i], 0.0f, 1.0f) : 0.0f;
+
+        if (familyPriorityList.size() < familyQueueCount) {
+            queueIndexList.push_back(static_cast<uint32_t>(familyPriorityList.size()));
+            familyPriorityList.push_back(priority);
+        }
+        else {
+            // family is out of queues, share one that was already handed out
+            uint32_t queueIndex = i % familyQueueCount;
+            familyPriorityList[queueIndex] = std::max(familyPriorityList[queueIndex], priority);
+            queueIndexList.push_back(queueIndex);
+        }
+    }
+}
+
+static DeviceQueue* findDeviceQueue(uint32_t familyIndex, uint32_t queueIndex) {
+    for (const auto& deviceQueue : queue->deviceQueueList) {
+        if (deviceQueue->familyIndex == familyIndex && deviceQueue->queueIndex == queueIndex) {
+            return deviceQueue.get();
+        }
+    }
+
+    throw std::runtime_error("failed to find a created queue!");
+}
+
 static void getGpuProperties() {
     vkGetPhysicalDeviceProperties(deviceInternal->gpu, &deviceInternal->gpuProperties);
     vkGetPhysicalDeviceMemoryProperties(deviceInternal->gpu, &deviceInternal->gpuMemoryProperties);
@@ -345,4 +706,82 @@ static void getGpuProperties() {
     vkGetPhysicalDeviceQueueFamilyProperties(deviceInternal->gpu, &queueFamilyCount, deviceInternal->queuefamily.queueFamilyPropertiesList.data());
 
     getSupportedDeviceExtensions();
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [QUEUE] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Every VkQueue has its own lock, vkQueueSubmit and vkQueuePresentKHR need external synchronization
+// per queue. Threads that picked different queues never wait on each other.
+
+uint32_t vulkronGetQueueCount(VulkronQueueFlag type) {
+    std::vector<DeviceQueue*>* queueList = getQueueList(type);
+    return nullptr != queueList ? static_cast<uint32_t>(queueList->size()) : 0;
+}
+
+VulkronResult vulkronSetThreadQueue(VulkronQueueFlag type, uint32_t queueIndex) {
+    std::vector<DeviceQueue*>* queueList = getQueueList(type);
+
+    if (nullptr == queueList || queueIndex >= queueList->size()) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *getThreadQueueIndex(type) = queueIndex;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronQueueSubmit(VulkronQueueFlag type, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+    if (nullptr == getQueueList(type) || (submitCount > 0 && nullptr == pSubmits)) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (queueSubmit(getThreadQueue(type), submitCount, pSubmits, fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit to queue!");
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+DeviceQueue* getThreadQueue(VulkronQueueFlag type) {
+    return getQueueList(type)->at(*getThreadQueueIndex(type));
+}
+
+// Traced with the wait for the queue's lock, time spent behind another thread's submit shows up here
+VkResult queueSubmit(DeviceQueue* deviceQueue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence) {
+    VULKRON_TRACE_SCOPE("queue", "vkQueueSubmit");
+    std::lock_guard<std::mutex> lock(deviceQueue->mutex);
+    return vkQueueSubmit(deviceQueue->queue, submitCount, pSubmits, fence);
+}
+
+VkResult queuePresent(DeviceQueue* deviceQueue, const VkPresentInfoKHR* pPresentInfo) {
+    VULKRON_TRACE_SCOPE("queue", "vkQueuePresentKHR");
+    std::lock_guard<std::mutex> lock(deviceQueue->mutex);
+    return vkQueuePresentKHR(deviceQueue->queue, pPresentInfo);
+}
+
+static std::vector<DeviceQueue*>* getQueueList(VulkronQueueFlag type) {
+    switch (type) {
+    case VULKRON_QUEUE_GRAPHICS_BIT:
+        return &queue->graphicsList;
+    case VULKRON_QUEUE_COMPUTE_BIT:
+        return &queue->computeList;
+    case VULKRON_QUEUE_TRANSFER_BIT:
+        return &queue->transferList;
+    default:
+        return nullptr;
+    }
+}
+
+static uint32_t* getThreadQueueIndex(VulkronQueueFlag type) {
+    switch (type) {
+    case VULKRON_QUEUE_COMPUTE_BIT:
+        return &threadComputeQueue;
+    case VULKRON_QUEUE_TRANSFER_BIT:
+        return &threadTransferQueue;
+    default:
+        return &threadGraphicsQueue;
+    }
 }
\ No newline at end of file
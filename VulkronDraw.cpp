@@ -1,97 +1,6 @@
 
 #include "VulkronInternal.h"
 
-#include <thread>
-#include <mutex>
-#include <functional>
-#include <queue>
-
-// Source
-// https://github.com/SaschaWillems/Vulkan/blob/master/base/threadpool.hpp
-
-class VulrkonThread {
-private:
-    bool destroying = false;
-    std::thread worker;
-    std::queue<std::function<void()>> jobQueue;
-    std::mutex queueMutex;
-    std::condition_variable condition;
-
-    // Loop through all remaining jobs
-    void queueLoop() {
-        while (true) {
-
-            std::function<void()> job;
-
-            {
-                std::unique_lock<std::mutex> lock(queueMutex);
-                condition.wait(lock, [this] { return !jobQueue.empty() || destroying; });
-                if (destroying)
-                {
-                    break;
-                }
-                job = jobQueue.front();
-            }
-
-            job();
-
-            {
-                std::lock_guard<std::mutex> lock(queueMutex);
-                jobQueue.pop();
-                condition.notify_one();
-            }
-        }
-    }
-
-public:
-    VulrkonThread() {
-        worker = std::thread(&VulrkonThread::queueLoop, this);
-    }
-
-    ~VulrkonThread() {
-        if (worker.joinable()) {
-            wait();
-            queueMutex.lock();
-            destroying = true;
-            condition.notify_one();
-            queueMutex.unlock();
-            worker.join();
-        }
-    }
-
-    // Add a new job to the thread's queue
-    void addJob(std::function<void()> function) {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        jobQueue.push(std::move(function));
-        condition.notify_one();
-    }
-
-    // Wait until all work items have been finished
-    void wait() {
-        std::unique_lock<std::mutex> lock(queueMutex);
-        condition.wait(lock, [this]() { return jobQueue.empty(); });
-    }
-};
-
-struct VulkronThreadPool {
-    std::vector<std::unique_ptr<VulrkonThread>> threads;
-
-    // Sets the number of threads to be allocated in this pool
-    VulkronThreadPool() {
-        threads.clear();
-        for (auto i = 0; i < std::thread::hardware_concurrency(); i++) {
-            threads.push_back(std::make_unique<VulrkonThread>());
-        }
-    }
-
-    // Wait until all threads have finished their work items
-    void wait() {
-        for (auto& thread : threads) {
-            thread->wait();
-        }
-    }
-};
-
 /*
 
     NOTE: If there are no draw commands, and empty buffers are being submitted. You'll get a validation error for a invalid presentable image
@@ -101,23 +10,62 @@ struct VulkronThreadPool {
 DrawInternal* drawInternal = new DrawInternal();
 
 const uint32_t                              MAX_FRAMES_IN_FLIGHT = 2;
-VkCommandPool                               primaryCommandPool;
-static const uint32_t                       NUMBER_OF_THREADS       = std::thread::hardware_concurrency();
+uint64_t                                    frameNumber             = 0;
+static const uint32_t                       DRAWS_PER_BUFFER        = 64;      // dynamic objects per secondary buffer, fewer than this are recorded on one thread
 static size_t                               currentFrame            = 0;
-static std::vector<CommandBufferData>       drawData;
 static std::vector<VulkronBaseObject>       tempStaticObjectsList;
 static std::vector<VulkronBaseObject>       tempDynamicObjectsList;
 
 
 static void createSyncObjects();
-static void updateRendererCommandBuffers(uint32_t imageIndex);
-static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo, VkCommandBuffer staticBuffer, std::vector<VulkronBaseObject>& objectsList);
-static void threadJobs(uint32_t imageIndex, std::vector<ThreadData> threadBufferList, std::vector<VulkronBaseObject> objectsList, VkCommandBufferInheritanceInfo inheritanceInfo);
-static void resetFrameCommandPool(uint32_t imageIndex);
+static void beginFrame();
+static void submitFrame(const FrameContext& frameContext, VkSemaphore acquireSemaphore, VkSemaphore presentSemaphore);
+static void updateRendererCommandBuffers(FrameContext& frameContext, const RenderTarget& target, const VkClearColorValue& clearColor);
+static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo, VkCommandBuffer staticBuffer, std::vector<VulkronBaseObject>& objectsList,
+    VkExtent2D extent);
+static VkCommandBuffer recordDynamicObjects(FrameThreadContext& threadContext, const std::vector<const VulkronBaseObject*>& drawList, uint32_t begin, uint32_t end,
+    VkCommandBufferInheritanceInfo inheritanceInfo, VkExtent2D extent);
+static void createFrameContexts();
+static void resetFrameContext(FrameContext& frameContext);
+static VkCommandBuffer getFrameCommandBuffer(FrameThreadContext& threadContext);
+static RenderTarget getSwapchainTarget(uint32_t imageIndex);
+static void beginDynamicRendering(VkCommandBuffer commandBuffer, const RenderTarget& target, const std::array<VkClearValue, 2>& clearValues);
+static void endDynamicRendering(VkCommandBuffer commandBuffer, const RenderTarget& target);
+static void recordTargetCopy(VkCommandBuffer commandBuffer, const RenderTarget& target);
+static void recordAttachmentBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout);
 static void recreateSwapchain();
 
+// Destroying the pools frees every buffer allocated from them
 void destroyCommands() {
 
+    for (FrameContext& frameContext : drawInternal->frameContextList) {
+        for (FrameThreadContext& threadContext : frameContext.threadContextList) {
+            vkDestroyCommandPool(deviceInternal->logicalDevice, threadContext.commandPool, nullptr);
+        }
+
+        vkDestroyCommandPool(deviceInternal->logicalDevice, frameContext.commandPool, nullptr);
+    }
+
+    drawInternal->frameContextList.clear();
+}
+
+// Resources that recorded command buffers may still reference are destroyed once every frame in flight has moved past them
+void enqueueFrameDeletion(std::function<void()> deletion) {
+    drawInternal->deletionQueue.push_back({ frameNumber, std::move(deletion) });
+}
+
+void flushFrameDeletionQueue(bool flushAll) {
+    while (!drawInternal->deletionQueue.empty()) {
+        FrameDeletion& deletion = drawInternal->deletionQueue.front();
+
+        if (!flushAll && deletion.frameNumber + MAX_FRAMES_IN_FLIGHT > frameNumber) {
+            break;
+        }
+
+        deletion.destroy();
+        drawInternal->deletionQueue.pop_front();
+    }
 }
 
 //-------------------------------------------------------------------------------------
@@ -139,24 +87,28 @@ static void recreateSwapchain() { // work on
     uint32_t uwidth = static_cast<uint32_t>(width);
     uint32_t uheight = static_cast<uint32_t>(height);
 
-    VulkronGraphicsCommands commands = {};
-    commands.staticObjectlist = drawData.at(0).staticObjectsList;
-    commands.dynamicObjectsList = drawData.at(0).dynamicObjectsList;
-
     vkDeviceWaitIdle(deviceInternal->logicalDevice);
     cleanUpSwapchain();
 
     createSwapchain(&uwidth, &uheight, swapchainInternal->vsync);
     createRenderPass(renderPassInternal->flag);
     createGraphicsPipeline();
-    vulkronCreateRendererCommandBuffers(&commands);
+
+    // frame contexts don't depend on the swapchain, only the per image fences follow its image count
+    drawInternal->imagesInFlight.assign(swapchainInternal->swapChainImagesList.size(), VK_NULL_HANDLE);
 }
 
 void vulkronDrawFrame() {
-    vkWaitForFences(deviceInternal->logicalDevice, 1, &drawInternal->inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    VULKRON_TRACE_SCOPE("frame", "vulkronDrawFrame");
+
+    beginFrame();
 
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(deviceInternal->logicalDevice, swapchainInternal->swapChain, UINT64_MAX, drawInternal->imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult result = VK_SUCCESS;
+    {
+        VULKRON_TRACE_SCOPE("queue", "vkAcquireNextImageKHR");
+        result = vkAcquireNextImageKHR(deviceInternal->logicalDevice, swapchainInternal->swapChain, UINT64_MAX, drawInternal->imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         recreateSwapchain();
@@ -166,46 +118,39 @@ void vulkronDrawFrame() {
         throw std::runtime_error("failed to acquire swap chain image!");
     }
 
-    resetFrameCommandPool(imageIndex);
-    updateRendererCommandBuffers(imageIndex);
+    // the fence above covers everything this frame context recorded last time around
+    FrameContext& frameContext = drawInternal->frameContextList[currentFrame];
+
+    // Test
+    float flash = sin(imageIndex * 2) * 0.3 + 0.5;
+
+    resetFrameContext(frameContext);
+    updateVisibility(sceneInternal->staticObjectsList, sceneInternal->dynamicObjectsList);
+    updateOcclusionCulling(sceneInternal->staticObjectsList, sceneInternal->dynamicObjectsList, static_cast<uint32_t>(currentFrame));
+    updateShadows();
+    updateRendererCommandBuffers(frameContext, getSwapchainTarget(imageIndex), { {flash, 0.0f, 0.0f, 1.0f} });
 
     if (drawInternal->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
+        VULKRON_TRACE_SCOPE("frame", "waitForImageFence");
         vkWaitForFences(deviceInternal->logicalDevice, 1, &drawInternal->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
     }
 
     drawInternal->imagesInFlight[imageIndex] = drawInternal->inFlightFences[currentFrame];
-    
-    VkSemaphore waitSemaphores[] = { drawInternal->imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSemaphore signalSemaphores[] = { drawInternal->renderFinishedSemaphores[currentFrame] };
-
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = drawData.size();
-    submitInfo.pCommandBuffers = &drawData.data()->primaryBuffer;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
-
-    vkResetFences(deviceInternal->logicalDevice, 1, &drawInternal->inFlightFences[currentFrame]);
 
-    if (vkQueueSubmit(queue->graphics, 1, &submitInfo, drawInternal->inFlightFences[currentFrame]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to submit draw command buffer!");
-    }
+    submitFrame(frameContext, drawInternal->imageAvailableSemaphores[currentFrame], drawInternal->renderFinishedSemaphores[currentFrame]);
 
     VkSwapchainKHR swapChains[] = { swapchainInternal->swapChain };
+    DeviceQueue* graphicsQueue = getThreadQueue(VULKRON_QUEUE_GRAPHICS_BIT);
 
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &drawInternal->renderFinishedSemaphores[currentFrame];
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(queue->graphics, &presentInfo);
+    result = queuePresent(graphicsQueue, &presentInfo);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
         recreateSwapchain();
@@ -215,178 +160,424 @@ void vulkronDrawFrame() {
     }
 
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
 }
 
-VulkronResult vulkronCreateRendererCommandBuffers(VulkronGraphicsCommands* info) {
+// A frame like vulkronDrawFrame's that renders into targetList[frame in flight] instead of the swapchain.
+// Nothing is acquired or presented, so it runs as fast as the gpu retires frames. Returns the frame in flight it used.
+uint32_t drawOffscreenFrame(const std::vector<RenderTarget>& targetList, const VkClearColorValue& clearColor) {
+    VULKRON_TRACE_SCOPE("frame", "drawOffscreenFrame");
 
-    if (nullptr == info) {
-        return VULKRON_ERROR_INVALID_ARGUMENT;
-    }
+    beginFrame();
 
-    createSyncObjects();
+    uint32_t frameIndex = static_cast<uint32_t>(currentFrame);
+    FrameContext& frameContext = drawInternal->frameContextList[frameIndex];
+
+    // the depth history belongs to the swapchain's camera, the target is culled without it and leaves none behind
+    resetOcclusionHistory();
+    resetFrameContext(frameContext);
+    updateVisibility(sceneInternal->staticObjectsList, sceneInternal->dynamicObjectsList);
+    updateOcclusionCulling(sceneInternal->staticObjectsList, sceneInternal->dynamicObjectsList, frameIndex);
+    updateShadows();
+    updateRendererCommandBuffers(frameContext, targetList[frameIndex], clearColor);
+    resetOcclusionHistory();
+
+    submitFrame(frameContext, VK_NULL_HANDLE, VK_NULL_HANDLE);
 
-    // create command pool for primary command buffers (non resetable)
-    VkCommandPoolCreateInfo primaryCommandPoolInfo = {};
-    primaryCommandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    primaryCommandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frameNumber++;
+
+    return frameIndex;
+}
 
-    if (vkCreateCommandPool(deviceInternal->logicalDevice, &primaryCommandPoolInfo, nullptr, &primaryCommandPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create command pool");
+// Everything a frame does before it acquires, once the frame in flight it reuses has finished
+static void beginFrame() {
+    VULKRON_TRACE_THREAD("render thread");
+    VULKRON_TRACE_SCOPE("frame", "beginFrame");
+    {
+        VULKRON_TRACE_SCOPE("frame", "waitForFrameFence");
+        vkWaitForFences(deviceInternal->logicalDevice, 1, &drawInternal->inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
     }
 
-    CommandBufferData* commandBufferData = new CommandBufferData();
+    flushFrameDeletionQueue(false);
+    retireReadbacks(static_cast<uint32_t>(currentFrame));
+    retireBatchFrame(static_cast<uint32_t>(currentFrame));
+    retireFrameStatistics(static_cast<uint32_t>(currentFrame));
 
-    for (auto object : info->staticObjectlist) {
-        commandBufferData->staticObjectsList.push_back(object);
+    // uploads go out before the frame so anything that became resident can be sampled by it
+    retireTransferBatches();
+    updateMemoryBudget();
+    flushUploadBatch(true);
+    updateMeshStreaming();
+    updateTextureStreaming();
+    submitTransferBatch();
+
+    // loads that finished with this submit resume their coroutines before anything is culled or recorded
+    resumeAsyncTasks();
+
+    // async compute goes out before recording so it overlaps with the previous frame still on the gpu
+    submitComputeWork(static_cast<uint32_t>(currentFrame));
+}
+
+// The binary semaphores are left out of offscreen frames, nothing would ever wait on them
+static void submitFrame(const FrameContext& frameContext, VkSemaphore acquireSemaphore, VkSemaphore presentSemaphore) {
+
+    VkSemaphore waitSemaphores[2] = {};
+    VkPipelineStageFlags waitStages[2] = {};
+    uint64_t waitValues[2] = {};
+    uint32_t waitCount = 0;
+    VkSemaphore signalSemaphores[2] = {};
+    uint64_t signalValues[2] = {};
+    uint32_t signalCount = 0;
+    bool hasTimeline = false;
+
+    if (VK_NULL_HANDLE != acquireSemaphore) {
+        waitSemaphores[waitCount] = acquireSemaphore;
+        waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     }
 
-    for (auto object : info->dynamicObjectsList) {
-        commandBufferData->dynamicObjectsList.push_back(object);
+    if (VK_NULL_HANDLE != presentSemaphore) {
+        signalSemaphores[signalCount++] = presentSemaphore;
     }
 
-    // create primary command buffers
-    VkCommandBufferAllocateInfo commandbufferAllocate = {};
-    commandbufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    commandbufferAllocate.commandPool = primaryCommandPool;
-    commandbufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    commandbufferAllocate.commandBufferCount = 1;
+    // timeline values are ignored for the binary semaphores
+    if (getComputeWait(&waitSemaphores[waitCount], &waitValues[waitCount], &waitStages[waitCount])) {
+        waitCount++;
+        hasTimeline = true;
+    }
 
-    if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandbufferAllocate, &commandBufferData->primaryBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate command buffer!");
+    if (getGraphicsTimelineSignal(&signalSemaphores[signalCount], &signalValues[signalCount])) {
+        signalCount++;
+        hasTimeline = true;
     }
 
-    // create 1 static secondary command buffer
-    commandbufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitCount;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+    timelineInfo.signalSemaphoreValueCount = signalCount;
+    timelineInfo.pSignalSemaphoreValues = signalValues;
 
-    if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandbufferAllocate, &commandBufferData->secondaryStaticBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate secondary command buffer!");
-    }
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = hasTimeline ? &timelineInfo : nullptr;
+    submitInfo.waitSemaphoreCount = waitCount;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frameContext.primaryBuffer;
+    submitInfo.signalSemaphoreCount = signalCount;
+    submitInfo.pSignalSemaphores = signalSemaphores;
 
-    for (uint32_t threadIndex = 0; threadIndex < NUMBER_OF_THREADS; threadIndex++) {
-        std::vector<ThreadData> tempThreadData;
+    vkResetFences(deviceInternal->logicalDevice, 1, &drawInternal->inFlightFences[currentFrame]);
 
-        // for each thread, we have 3 command pools per thread per 3 frames, cycled in a ring buffer
-        for (uint32_t i = 0; i < swapchainInternal->imageCount; i++) {
-            ThreadData* threadData = new ThreadData();
+    DeviceQueue* graphicsQueue = getThreadQueue(VULKRON_QUEUE_GRAPHICS_BIT);
 
-            // create resetable command pool
-            VkCommandPoolCreateInfo commandPoolInfo = {};
-            commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-            commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-            commandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+    if (queueSubmit(graphicsQueue, 1, &submitInfo, drawInternal->inFlightFences[currentFrame]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit draw command buffer!");
+    }
+}
 
-            if (vkCreateCommandPool(deviceInternal->logicalDevice, &commandPoolInfo, nullptr, &threadData->commandPool) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create command pool");
-            }
+VulkronResult vulkronCreateRendererCommandBuffers(VulkronGraphicsCommands* info) {
 
-            // create N disposable (dynamic) secondary command buffers
-            VkCommandBufferAllocateInfo secondaryCommandBuffers = {};
-            secondaryCommandBuffers.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-            secondaryCommandBuffers.commandPool = threadData->commandPool;
-            secondaryCommandBuffers.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
-            secondaryCommandBuffers.commandBufferCount = commandBufferData->dynamicObjectsList.size(); // 1 buffer per dynamic object
+    if (nullptr == info) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
 
-            if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &secondaryCommandBuffers, threadData->secondarydynamicBufferList.data()) != VK_SUCCESS) {
-                throw std::runtime_error("failed to allocate secondary command buffer!");
-            }
+    createSyncObjects();
+    createFrameContexts();
 
-            tempThreadData.push_back(*threadData);
-        }
+    // the initial objects go into the scene like any other, use vulkronAddObject to keep a handle to them
+    VulkronObjectHandle handle;
 
-        commandBufferData->threadBuffersMap.insert(std::make_pair(threadIndex, tempThreadData));
+    for (auto object : info->staticObjectlist) {
+        object.isStatic = true;
+        vulkronAddObject(&object, &handle);
     }
 
-    // scene will always be index 0
-    drawData.push_back(*commandBufferData);
+    for (auto object : info->dynamicObjectsList) {
+        object.isStatic = false;
+        vulkronAddObject(&object, &handle);
+    }
 
     return VULKRON_SUCCESS;
 
 }
 
-static void updateRendererCommandBuffers(uint32_t imageIndex) {
+static void updateRendererCommandBuffers(FrameContext& frameContext, const RenderTarget& target, const VkClearColorValue& clearColor) {
+    VULKRON_TRACE_SCOPE("frame", "recordCommandBuffers");
 
     std::vector<VkCommandBuffer> executableCommandBuffers;
-    CommandBufferData commandBuffers = drawData.at(0); // grab scene buffers
-
-    // Test
-    float flash = sin(imageIndex * 2) * 0.3 + 0.5;
+    SceneInternal& scene = *sceneInternal;
+    VkCommandBuffer primaryBuffer = frameContext.primaryBuffer;
+    uint32_t frameIndex = static_cast<uint32_t>(currentFrame);
 
     std::array<VkClearValue, 2> clearValues = {};
-    clearValues[0].color = { {flash, 0.0f, 0.0f, 1.0f} };
+    clearValues[0].color = clearColor;
     clearValues[1].depthStencil = { 1.0f, 0 };
 
     VkCommandBufferBeginInfo commandBufferBegin = {};
     commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-    if (vkBeginCommandBuffer(commandBuffers.primaryBuffer, &commandBufferBegin) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(primaryBuffer, &commandBufferBegin) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
 
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = *pipeline->pRenderPass;
-    renderPassInfo.renderArea.offset.x = 0;
-    renderPassInfo.renderArea.offset.y = 0;
-    renderPassInfo.renderArea.extent = swapchainInternal->swapChainExtent;
-    renderPassInfo.clearValueCount = clearValues.size();
-    renderPassInfo.pClearValues = clearValues.data();
-    renderPassInfo.framebuffer = swapchainInternal->bufferList[imageIndex].frameBuffer;
+    beginFrameStatistics(primaryBuffer, frameIndex, target.extent);
+
+    // compute work can't be recorded inside the render pass
+    beginPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_COMPUTE, frameIndex);
+    recordComputeWork(primaryBuffer);
+    endPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_COMPUTE, frameIndex);
 
-    vkCmdBeginRenderPass(commandBuffers.primaryBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    beginPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_OCCLUSION, frameIndex);
+    recordTransientBarriers(primaryBuffer, TRANSIENT_PASS_OCCLUSION);
+    recordOcclusionCulling(primaryBuffer, frameIndex);
+    endPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_OCCLUSION, frameIndex);
+
+    beginPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_SHADOW, frameIndex);
+    recordShadows(primaryBuffer);
+    endPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_SHADOW, frameIndex);
+
+    // queries can't begin inside the render pass, the main pass' are active over all of it
+    beginPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_MAIN, frameIndex);
+    recordTransientBarriers(primaryBuffer, TRANSIENT_PASS_MAIN);
 
     VkCommandBufferInheritanceInfo inheritanceInfo = {};
     inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-    inheritanceInfo.renderPass = *pipeline->pRenderPass;
-    inheritanceInfo.framebuffer = swapchainInternal->bufferList[imageIndex].frameBuffer;
+    setStatisticsInheritance(&inheritanceInfo);
+
+    // secondary buffers inherit the attachment formats instead of a render pass
+    VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo = {};
+    inheritanceRenderingInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+    inheritanceRenderingInfo.colorAttachmentCount = 1;
+    inheritanceRenderingInfo.pColorAttachmentFormats = &swapchainInternal->swapChainImageFormat;
+    inheritanceRenderingInfo.depthAttachmentFormat = swapchainInternal->depthFormat;
+    inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    if (deviceInternal->hasDynamicRendering) {
+        beginDynamicRendering(primaryBuffer, target, clearValues);
+        inheritanceInfo.pNext = &inheritanceRenderingInfo;
+    }
+    else {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = *pipeline->pRenderPass;
+        renderPassInfo.renderArea.offset.x = 0;
+        renderPassInfo.renderArea.offset.y = 0;
+        renderPassInfo.renderArea.extent = target.extent;
+        renderPassInfo.clearValueCount = clearValues.size();
+        renderPassInfo.pClearValues = clearValues.data();
+        renderPassInfo.framebuffer = target.frameBuffer;
+
+        vkCmdBeginRenderPass(primaryBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+        inheritanceInfo.renderPass = *pipeline->pRenderPass;
+        inheritanceInfo.framebuffer = target.frameBuffer;
+    }
 
-    if (!commandBuffers.staticObjectsList.empty()) {
-        updateStaticSecondaryCommandBuffers(inheritanceInfo, commandBuffers.secondaryStaticBuffer, commandBuffers.staticObjectsList);
+    if (!scene.staticObjectsList.empty() || hasOcclusionDraws(frameIndex)) {
+        updateStaticSecondaryCommandBuffers(inheritanceInfo, frameContext.secondaryStaticBuffer, scene.staticObjectsList, target.extent);
+        executableCommandBuffers.push_back(frameContext.secondaryStaticBuffer);
     }
 
-    if (!commandBuffers.dynamicObjectsList.empty()) {
-        VulkronThreadPool threadPool;
+    // only what survived culling is recorded, in fixed size ranges that each get one buffer from their thread's pool
+    std::vector<const VulkronBaseObject*> drawList;
 
-        for (uint32_t threadIndex = 0; threadIndex < NUMBER_OF_THREADS; threadIndex++) {
-            threadPool.threads[threadIndex]->addJob([=] {
-                threadJobs(imageIndex, commandBuffers.threadBuffersMap.at(threadIndex), commandBuffers.dynamicObjectsList, inheritanceInfo);
-                });
-        }
+    for (uint32_t index : cullingInternal->visibleDynamicList) {
+        const VulkronBaseObject& object = scene.dynamicObjectsList[index];
 
-        threadPool.wait();
+        if (object.isVisible) {
+            drawList.push_back(&object);
+        }
+    }
 
-        // Submit if object is within the current view frustum
-        for (auto& [threadIndex, threadList] : commandBuffers.threadBuffersMap) {
-            
-            // we grab the vector in that thread and return the object that is associated with the current frame
-            std::vector<VkCommandBuffer> dynamicThreadBuffer;
+    if (!drawList.empty()) {
+        std::vector<VkCommandBuffer> dynamicBufferList(frameThreadPool->threads.size(), VK_NULL_HANDLE);
 
-            for (const auto& data : threadList) {
-                if (data.imageIndex == imageIndex) {
-                    dynamicThreadBuffer = data.secondarydynamicBufferList;
-                }
+        frameThreadPool->parallelForRanges(static_cast<uint32_t>(drawList.size()), DRAWS_PER_BUFFER, [&](uint32_t rangeIndex, uint32_t begin, uint32_t end) {
+            if (begin < end) {
+                dynamicBufferList[rangeIndex] = recordDynamicObjects(frameContext.threadContextList[rangeIndex], drawList, begin, end, inheritanceInfo, target.extent);
             }
+        });
 
-            // for every dynamic buffer we check if the object is visible, if true then the buffer is can be executed
-            for (uint32_t j = 0; j < dynamicThreadBuffer.size(); j++) {
-
-                // check the visibility of the object in every buffer
-                if (commandBuffers.dynamicObjectsList.at(j).isVisible) {
-                    executableCommandBuffers.push_back(dynamicThreadBuffer.at(j));
-                }
+        // range order keeps the draw order stable from frame to frame
+        for (VkCommandBuffer dynamicBuffer : dynamicBufferList) {
+            if (dynamicBuffer != VK_NULL_HANDLE) {
+                executableCommandBuffers.push_back(dynamicBuffer);
             }
         }
+    }
+
+    if (!executableCommandBuffers.empty()) {
+        vkCmdExecuteCommands(primaryBuffer, executableCommandBuffers.size(), executableCommandBuffers.data());
+    }
+
+    if (deviceInternal->hasDynamicRendering) {
+        endDynamicRendering(primaryBuffer, target);
+    }
+    else {
+        vkCmdEndRenderPass(primaryBuffer);
+    }
+
+    endPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_MAIN, frameIndex);
+    beginPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_COPY, frameIndex);
 
-        vkCmdExecuteCommands(commandBuffers.primaryBuffer, executableCommandBuffers.size(), executableCommandBuffers.data());
+    if (!target.isSwapchain) {
+        recordTargetCopy(primaryBuffer, target);
     }
 
-    vkCmdEndRenderPass(commandBuffers.primaryBuffer);
+    // after the main pass so everything the frame wrote can be read, swapchain reads wait for a presented frame
+    recordReadbacks(primaryBuffer, target.isSwapchain ? target.image : VK_NULL_HANDLE, frameIndex);
 
-    if (vkEndCommandBuffer(commandBuffers.primaryBuffer) != VK_SUCCESS) {
+    endPassStatistics(primaryBuffer, VULKRON_FRAME_PASS_COPY, frameIndex);
+    endFrameStatistics(frameIndex);
+
+    if (vkEndCommandBuffer(primaryBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to execute commands!");
     }
 }
 
-static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo, VkCommandBuffer staticBuffer, std::vector<VulkronBaseObject>& objectsList) {
+static RenderTarget getSwapchainTarget(uint32_t imageIndex) {
+
+    RenderTarget target = {};
+    target.image = swapchainInternal->bufferList[imageIndex].image;
+    target.view = swapchainInternal->bufferList[imageIndex].view;
+    target.frameBuffer = swapchainInternal->bufferList[imageIndex].frameBuffer;
+    target.depthImage = swapchainInternal->depthImage;
+    target.depthView = swapchainInternal->depthView;
+    target.extent = swapchainInternal->swapChainExtent;
+    target.isSwapchain = true;
+
+    return target;
+}
+
+// Without a render pass the frame moves its own attachments into and out of their rendering layouts
+static void beginDynamicRendering(VkCommandBuffer commandBuffer, const RenderTarget& target, const std::array<VkClearValue, 2>& clearValues) {
+
+    // both attachments are cleared, the previous contents are discarded
+    recordAttachmentBarrier(commandBuffer, target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    // the occlusion pyramid may still be reading last frame's depth
+    recordAttachmentBarrier(commandBuffer, target.depthImage, VK_IMAGE_ASPECT_DEPTH_BIT,
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    VkRenderingAttachmentInfo colorAttachment = {};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = target.view;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValues[0];
+
+    // depth is stored so the next frame can build its occlusion pyramid from it
+    VkRenderingAttachmentInfo depthAttachment = {};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = target.depthView;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.clearValue = clearValues[1];
+
+    VkRenderingInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+    renderingInfo.renderArea.offset = { 0, 0 };
+    renderingInfo.renderArea.extent = target.extent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+
+    vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+static void endDynamicRendering(VkCommandBuffer commandBuffer, const RenderTarget& target) {
+
+    vkCmdEndRendering(commandBuffer);
+
+    // offscreen targets stay in COLOR_ATTACHMENT_OPTIMAL like they do after a render pass, the copy moves them on
+    if (!target.isSwapchain) {
+        return;
+    }
+
+    // present waits on the submit semaphore, no destination stage needed
+    recordAttachmentBarrier(commandBuffer, target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+// Color attachment into the target's copy buffer, rows tightly packed. The host reads it once the frame's fence has signaled.
+static void recordTargetCopy(VkCommandBuffer commandBuffer, const RenderTarget& target) {
+
+    recordAttachmentBarrier(commandBuffer, target.image, VK_IMAGE_ASPECT_COLOR_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { target.extent.width, target.extent.height, 1 };
+
+    vkCmdCopyImageToBuffer(commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.copyBuffer, 1, &region);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// One image barrier, synchronization2 when enabled so only the stages named here are waited on
+static void recordAttachmentBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+    if (deviceInternal->hasSynchronization2) {
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        // the legacy stage and access bits have the same values in the 2 variants, bottom of pipe becomes none
+        barrier.srcStageMask = srcStage;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = dstStage == VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT ? VK_PIPELINE_STAGE_2_NONE : dstStage;
+        barrier.dstAccessMask = dstAccess;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+
+        VkDependencyInfo dependencyInfo = {};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.imageMemoryBarrierCount = 1;
+        dependencyInfo.pImageMemoryBarriers = &barrier;
+
+        vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+        return;
+    }
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo inheritanceInfo, VkCommandBuffer staticBuffer, std::vector<VulkronBaseObject>& objectsList,
+    VkExtent2D extent) {
+    VULKRON_TRACE_SCOPE("frame", "recordStaticObjects");
 
     VkCommandBufferBeginInfo commandBufferBegin = {};
     commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -396,14 +587,14 @@ static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo i
     VkViewport viewport = {};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = (float)swapchainInternal->swapChainExtent.width;
-    viewport.height = (float)swapchainInternal->swapChainExtent.height;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
     VkRect2D scissor = {};
     scissor.offset = { 0, 0 };
-    scissor.extent = swapchainInternal->swapChainExtent;
+    scissor.extent = extent;
 
     if (vkBeginCommandBuffer(staticBuffer, &commandBufferBegin) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin command buffer!");
@@ -412,75 +603,159 @@ static void updateStaticSecondaryCommandBuffers(VkCommandBufferInheritanceInfo i
     vkCmdSetViewport(staticBuffer, 0, 1, &viewport);
     vkCmdSetScissor(staticBuffer, 0, 1, &scissor);
 
-    for (auto object : objectsList) {
+    // only what the visibility pass found, culled subtrees are never walked
+    for (uint32_t index : cullingInternal->visibleStaticList) {
+        const VulkronBaseObject& object = objectsList[index];
+
         vkCmdBindPipeline(staticBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *object.pPipeline);
         
         // update static objects here
+        recordMeshDraw(staticBuffer, object);
     }
 
+    // occlusion culled objects from both lists, drawn from the compacted indirect buffer
+    recordOcclusionDraws(staticBuffer, static_cast<uint32_t>(currentFrame));
+
     if (vkEndCommandBuffer(staticBuffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to record command buffer!");
     }
 }
 
-static void threadJobs(uint32_t imageIndex, std::vector<ThreadData> threadBufferList, std::vector<VulkronBaseObject> objectsList, VkCommandBufferInheritanceInfo inheritanceInfo) {
-    
-    ThreadData threadData = threadBufferList.at(imageIndex);
-    threadData.imageIndex = imageIndex;
+// Objects [begin, end) of drawList go into one secondary buffer taken from the recording thread's pool
+static VkCommandBuffer recordDynamicObjects(FrameThreadContext& threadContext, const std::vector<const VulkronBaseObject*>& drawList, uint32_t begin, uint32_t end,
+    VkCommandBufferInheritanceInfo inheritanceInfo, VkExtent2D extent) {
+    VULKRON_TRACE_SCOPE("frame", "recordDynamicObjects");
 
-    // for each buffer we update an object
-    for (uint32_t i = 0; i < threadData.secondarydynamicBufferList.size(); i++) {
+    VkCommandBuffer dynamicBuffer = getFrameCommandBuffer(threadContext);
 
-        VkCommandBufferBeginInfo commandBufferBegin = {};
-        commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        commandBufferBegin.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
-        commandBufferBegin.pInheritanceInfo = &inheritanceInfo;
+    VkCommandBufferBeginInfo commandBufferBegin = {};
+    commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBegin.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    commandBufferBegin.pInheritanceInfo = &inheritanceInfo;
 
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float)swapchainInternal->swapChainExtent.width;
-        viewport.height = (float)swapchainInternal->swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
+    VkViewport viewport = {};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float)extent.width;
+    viewport.height = (float)extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
 
-        VkRect2D scissor = {};
-        scissor.offset = { 0, 0 };
-        scissor.extent = swapchainInternal->swapChainExtent;
+    VkRect2D scissor = {};
+    scissor.offset = { 0, 0 };
+    scissor.extent = extent;
 
-        VkCommandBuffer dynamicBuffer = threadData.secondarydynamicBufferList.at(i);
+    if (vkBeginCommandBuffer(dynamicBuffer, &commandBufferBegin) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin command buffer!");
+    }
 
-        if (vkBeginCommandBuffer(dynamicBuffer, &commandBufferBegin) != VK_SUCCESS) {
-            throw std::runtime_error("failed to begin command buffer!");
-        }
+    vkCmdSetViewport(dynamicBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(dynamicBuffer, 0, 1, &scissor);
 
-        vkCmdSetViewport(dynamicBuffer, 0, 1, &viewport);
-        vkCmdSetScissor(dynamicBuffer, 0, 1, &scissor);
+    for (uint32_t i = begin; i < end; i++) {
+        vkCmdBindPipeline(dynamicBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *drawList[i]->pPipeline);
 
-        vkCmdBindPipeline(dynamicBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *objectsList.at(i).pPipeline);
-        
         // update dynamic objects here
+        recordMeshDraw(dynamicBuffer, *drawList[i]);
+    }
 
-        if (vkEndCommandBuffer(dynamicBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
-        }
+    if (vkEndCommandBuffer(dynamicBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
     }
 
+    return dynamicBuffer;
 }
 
-static void resetFrameCommandPool(uint32_t imageIndex) {
-    // first index is always the scene
-    auto sceneThreadMap = drawData.at(0).threadBuffersMap;
 
-    for (const auto& [threadIndex, threadData] : sceneThreadMap) {
-        for (auto data : threadData) {
-            if (data.imageIndex == imageIndex) {
-                vkResetCommandPool(deviceInternal->logicalDevice, data.commandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
+//-------------------------------------------------------------------------------------
+// SECTION [FRAME CONTEXT] ------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// One context per frame in flight with a pool of its own for every frame thread. Nothing in here
+// depends on the swapchain or the object count, so a resize or a bigger scene keeps them.
+static void createFrameContexts() {
+
+    if (!drawInternal->frameContextList.empty()) {
+        return;
+    }
+
+    // pools are only ever reset whole, buffers never individually
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+
+    drawInternal->frameContextList.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (FrameContext& frameContext : drawInternal->frameContextList) {
+        if (vkCreateCommandPool(deviceInternal->logicalDevice, &commandPoolInfo, nullptr, &frameContext.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool");
+        }
+
+        VkCommandBufferAllocateInfo commandbufferAllocate = {};
+        commandbufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandbufferAllocate.commandPool = frameContext.commandPool;
+        commandbufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandbufferAllocate.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandbufferAllocate, &frameContext.primaryBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffer!");
+        }
+
+        commandbufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+        if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandbufferAllocate, &frameContext.secondaryStaticBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+
+        frameContext.threadContextList.resize(frameThreadPool->threads.size());
+
+        for (FrameThreadContext& threadContext : frameContext.threadContextList) {
+            if (vkCreateCommandPool(deviceInternal->logicalDevice, &commandPoolInfo, nullptr, &threadContext.commandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool");
             }
         }
     }
 }
 
+// Runs once the frame's fence has signaled. The pools keep their memory, so a scene that records
+// the same amount every frame stops allocating after the first time round the ring.
+static void resetFrameContext(FrameContext& frameContext) {
+
+    vkResetCommandPool(deviceInternal->logicalDevice, frameContext.commandPool, 0);
+
+    for (FrameThreadContext& threadContext : frameContext.threadContextList) {
+        if (threadContext.usedCount == 0) {
+            continue;
+        }
+
+        vkResetCommandPool(deviceInternal->logicalDevice, threadContext.commandPool, 0);
+        threadContext.usedCount = 0;
+    }
+}
+
+// Next free secondary buffer of the thread, a new one is only allocated when it records more ranges than ever before
+static VkCommandBuffer getFrameCommandBuffer(FrameThreadContext& threadContext) {
+
+    if (threadContext.usedCount == threadContext.secondaryBufferList.size()) {
+        VkCommandBufferAllocateInfo commandbufferAllocate = {};
+        commandbufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandbufferAllocate.commandPool = threadContext.commandPool;
+        commandbufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        commandbufferAllocate.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+        if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandbufferAllocate, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+
+        threadContext.secondaryBufferList.push_back(commandBuffer);
+    }
+
+    return threadContext.secondaryBufferList[threadContext.usedCount++];
+}
+
 static void createSyncObjects() {
     drawInternal->imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
     drawInternal->renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
@@ -0,0 +1,666 @@
+#include "VulkronInternal.h"
+
+/*
+
+    GPU benchmark, picks the device when gpuList has more than one suitable candidate
+
+    Every candidate gets a throwaway logical device with a single graphics queue and runs three short
+    tests, timed with timestamp queries (cpu time when the queue family has no timestamps):
+      fill rate     linear filtered blits into a 4096x4096 RGBA8 image, GB/s written
+      compute       Shaders/gpu_benchmark.comp, independent fma chains per invocation, GFLOPS
+      copy          device local buffer to buffer copies, GB/s
+
+    The score is the geometric mean so no single test dominates. Results are cached on disk keyed by
+    device UUID and driver version, a driver update or a new BENCHMARK_VERSION measures again.
+
+*/
+
+static const uint32_t                       BENCHMARK_VERSION               = 1;        // bump when a test changes, older cache entries are ignored
+static const uint32_t                       FILL_SOURCE_SIZE                = 2048;
+static const uint32_t                       FILL_TARGET_SIZE                = 4096;
+static const uint32_t                       FILL_REPEAT                     = 8;
+static const uint32_t                       COMPUTE_GROUP_SIZE              = 256;      // gpu_benchmark.comp local_size_x
+static const uint32_t                       COMPUTE_GROUP_COUNT             = 4096;
+static const uint32_t                       COMPUTE_FLOPS_PER_INVOCATION    = 8192;     // gpu_benchmark.comp, 128 iterations of 8 vec4 fma
+static const uint32_t                       COMPUTE_REPEAT                  = 4;
+static const VkDeviceSize                   COPY_SIZE                       = 32 * 1024 * 1024;
+static const uint32_t                       COPY_REPEAT                     = 16;
+
+typedef struct BenchmarkContext {
+    VkPhysicalDevice                        gpu;
+    VkPhysicalDeviceProperties              properties;
+    VkPhysicalDeviceMemoryProperties        memoryProperties;
+    VkDevice                                device              = VK_NULL_HANDLE;
+    uint32_t                                familyIndex;
+    uint32_t                                timestampValidBits;
+    VkQueue                                 queue;
+    VkCommandPool                           commandPool         = VK_NULL_HANDLE;
+    VkCommandBuffer                         commandBuffer;
+    VkQueryPool                             queryPool           = VK_NULL_HANDLE;
+} BenchmarkContext;
+
+typedef struct BenchmarkResult {
+    float                                   fillRate;
+    float                                   computeThroughput;
+    float                                   copyBandwidth;
+} BenchmarkResult;
+
+static std::string getBenchmarkCacheKey(VkPhysicalDevice gpu, const VkPhysicalDeviceProperties& properties);
+static std::map<std::string, BenchmarkResult> loadBenchmarkCache();
+static void saveBenchmarkCache(const std::map<std::string, BenchmarkResult>& cache);
+static BenchmarkResult runBenchmark(VkPhysicalDevice gpu);
+static void createBenchmarkContext(VkPhysicalDevice gpu, BenchmarkContext* context);
+static void destroyBenchmarkContext(BenchmarkContext* context);
+static float runFillTest(BenchmarkContext* context);
+static float runComputeTest(BenchmarkContext* context);
+static float runCopyTest(BenchmarkContext* context);
+static void beginTimedCommands(BenchmarkContext* context);
+static void writeStartTimestamp(BenchmarkContext* context);
+static double submitTimedCommands(BenchmarkContext* context);
+static VkDeviceMemory allocateBenchmarkMemory(BenchmarkContext* context, VkMemoryRequirements requirements, VkMemoryPropertyFlags propertyFlags);
+static void transferBarrier(VkCommandBuffer commandBuffer);
+
+// Fills the measured part of the candidate, throws if the device can't run the tests
+void benchmarkGpu(VkPhysicalDevice gpu, VulkronGpuCandidate* pCandidate) {
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(gpu, &properties);
+
+    std::string key = getBenchmarkCacheKey(gpu, properties);
+    std::map<std::string, BenchmarkResult> cache = loadBenchmarkCache();
+
+    BenchmarkResult result;
+    auto cached = cache.find(key);
+
+    if (cached != cache.end()) {
+        result = cached->second;
+        pCandidate->scoreSource = VULKRON_GPU_SCORE_SOURCE_CACHE;
+    }
+    else {
+        result = runBenchmark(gpu);
+        pCandidate->scoreSource = VULKRON_GPU_SCORE_SOURCE_BENCHMARK;
+
+        // without the shader the compute score is missing, measure again once it's there
+        if (result.computeThroughput > 0.0f) {
+            cache[key] = result;
+            saveBenchmarkCache(cache);
+        }
+    }
+
+    pCandidate->fillRate = result.fillRate;
+    pCandidate->computeThroughput = result.computeThroughput;
+    pCandidate->copyBandwidth = result.copyBandwidth;
+
+    if (result.computeThroughput > 0.0f) {
+        pCandidate->score = std::cbrt(result.fillRate * result.computeThroughput * result.copyBandwidth);
+    }
+    else {
+        pCandidate->score = std::sqrt(result.fillRate * result.copyBandwidth);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [CACHE] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// One line per device, "<key> <fill rate> <compute> <copy>"
+static std::string getBenchmarkCacheKey(VkPhysicalDevice gpu, const VkPhysicalDeviceProperties& properties) {
+
+    char key[128];
+
+    if (properties.apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceIDProperties idProperties = {};
+        idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &idProperties;
+        vkGetPhysicalDeviceProperties2(gpu, &properties2);
+
+        int length = 0;
+        for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+            length += snprintf(key + length, sizeof(key) - length, "%02x", idProperties.deviceUUID[i]);
+        }
+
+        snprintf(key + length, sizeof(key) - length, "-%08x-%u", properties.driverVersion, BENCHMARK_VERSION);
+    }
+    else {
+        // no uuid before vulkan 1.1, vendor and device id still tell models apart
+        snprintf(key, sizeof(key), "%04x%04x-%08x-%u", properties.vendorID, properties.deviceID, properties.driverVersion, BENCHMARK_VERSION);
+    }
+
+    return key;
+}
+
+static std::map<std::string, BenchmarkResult> loadBenchmarkCache() {
+
+    std::map<std::string, BenchmarkResult> cache;
+
+    if (device->gpuBenchmarkCachePath.empty()) {
+        return cache;
+    }
+
+    std::ifstream file(device->gpuBenchmarkCachePath);
+
+    std::string key;
+    BenchmarkResult result;
+
+    while (file >> key >> result.fillRate >> result.computeThroughput >> result.copyBandwidth) {
+        cache[key] = result;
+    }
+
+    return cache;
+}
+
+static void saveBenchmarkCache(const std::map<std::string, BenchmarkResult>& cache) {
+
+    if (device->gpuBenchmarkCachePath.empty()) {
+        return;
+    }
+
+    std::ofstream file(device->gpuBenchmarkCachePath, std::ios::trunc);
+
+    for (const auto& [key, result] : cache) {
+        file << key << " " << result.fillRate << " " << result.computeThroughput << " " << result.copyBandwidth << "\n";
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [BENCHMARK] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static BenchmarkResult runBenchmark(VkPhysicalDevice gpu) {
+
+    BenchmarkContext context = {};
+    BenchmarkResult result = {};
+
+    createBenchmarkContext(gpu, &context);
+
+    try {
+        result.fillRate = runFillTest(&context);
+        result.computeThroughput = runComputeTest(&context);
+        result.copyBandwidth = runCopyTest(&context);
+    }
+    catch (...) {
+        destroyBenchmarkContext(&context);
+        throw;
+    }
+
+    destroyBenchmarkContext(&context);
+
+    return result;
+}
+
+static void createBenchmarkContext(VkPhysicalDevice gpu, BenchmarkContext* context) {
+
+    context->gpu = gpu;
+    vkGetPhysicalDeviceProperties(gpu, &context->properties);
+    vkGetPhysicalDeviceMemoryProperties(gpu, &context->memoryProperties);
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, nullptr);
+
+    std::vector<VkQueueFamilyProperties> queueFamilyList(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queueFamilyCount, queueFamilyList.data());
+
+    context->familyIndex = UINT32_MAX;
+
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+        if (queueFamilyList[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            context->familyIndex = i;
+            context->timestampValidBits = queueFamilyList[i].timestampValidBits;
+            break;
+        }
+    }
+
+    if (context->familyIndex == UINT32_MAX) {
+        throw std::runtime_error("benchmark needs a graphics queue!");
+    }
+
+    float queuePriority = 1.0f;
+
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = context->familyIndex;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &queuePriority;
+
+    VkDeviceCreateInfo deviceCreateInfo = {};
+    deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.queueCreateInfoCount = 1;
+    deviceCreateInfo.pQueueCreateInfos = &queueInfo;
+
+    if (vkCreateDevice(gpu, &deviceCreateInfo, nullptr, &context->device) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark device!");
+    }
+
+    vkGetDeviceQueue(context->device, context->familyIndex, 0, &context->queue);
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = context->familyIndex;
+
+    if (vkCreateCommandPool(context->device, &commandPoolInfo, nullptr, &context->commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark command pool!");
+    }
+
+    VkCommandBufferAllocateInfo commandBufferAllocate = {};
+    commandBufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferAllocate.commandPool = context->commandPool;
+    commandBufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocate.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(context->device, &commandBufferAllocate, &context->commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate benchmark command buffer!");
+    }
+
+    if (context->timestampValidBits > 0) {
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = 2;
+
+        if (vkCreateQueryPool(context->device, &queryPoolInfo, nullptr, &context->queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create benchmark query pool!");
+        }
+    }
+}
+
+static void destroyBenchmarkContext(BenchmarkContext* context) {
+
+    if (context->device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDeviceWaitIdle(context->device);
+
+    if (context->queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(context->device, context->queryPool, nullptr);
+    }
+
+    if (context->commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(context->device, context->commandPool, nullptr);
+    }
+
+    vkDestroyDevice(context->device, nullptr);
+    context->device = VK_NULL_HANDLE;
+}
+
+// Texture sampling and pixel writes, a 2x upscale so the blit can't turn into a plain copy
+static float runFillTest(BenchmarkContext* context) {
+
+    VkDevice logicalDevice = context->device;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = { FILL_SOURCE_SIZE, FILL_SOURCE_SIZE, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage sourceImage;
+    VkImage targetImage;
+
+    if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &sourceImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark image!");
+    }
+
+    imageInfo.extent = { FILL_TARGET_SIZE, FILL_TARGET_SIZE, 1 };
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &targetImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(logicalDevice, sourceImage, &requirements);
+    VkDeviceMemory sourceMemory = allocateBenchmarkMemory(context, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vkBindImageMemory(logicalDevice, sourceImage, sourceMemory, 0);
+
+    vkGetImageMemoryRequirements(logicalDevice, targetImage, &requirements);
+    VkDeviceMemory targetMemory = allocateBenchmarkMemory(context, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vkBindImageMemory(logicalDevice, targetImage, targetMemory, 0);
+
+    beginTimedCommands(context);
+
+    // contents don't matter, only the layouts
+    VkImageMemoryBarrier barriers[2] = {};
+    for (auto& barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    }
+
+    barriers[0].image = sourceImage;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[1].image = targetImage;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(context->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+    writeStartTimestamp(context);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    blit.srcOffsets[1] = { static_cast<int32_t>(FILL_SOURCE_SIZE), static_cast<int32_t>(FILL_SOURCE_SIZE), 1 };
+    blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    blit.dstOffsets[1] = { static_cast<int32_t>(FILL_TARGET_SIZE), static_cast<int32_t>(FILL_TARGET_SIZE), 1 };
+
+    for (uint32_t i = 0; i < FILL_REPEAT; i++) {
+        if (i > 0) {
+            transferBarrier(context->commandBuffer);
+        }
+
+        vkCmdBlitImage(context->commandBuffer, sourceImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, targetImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+    }
+
+    double seconds = submitTimedCommands(context);
+
+    vkDestroyImage(logicalDevice, sourceImage, nullptr);
+    vkDestroyImage(logicalDevice, targetImage, nullptr);
+    vkFreeMemory(logicalDevice, sourceMemory, nullptr);
+    vkFreeMemory(logicalDevice, targetMemory, nullptr);
+
+    double bytesWritten = double(FILL_TARGET_SIZE) * FILL_TARGET_SIZE * 4 * FILL_REPEAT;
+    return static_cast<float>(bytesWritten / seconds / 1e9);
+}
+
+static float runComputeTest(BenchmarkContext* context) {
+
+    // a missing shader only costs the compute score
+    if (!std::ifstream(device->gpuBenchmarkShaderPath).good()) {
+        return 0.0f;
+    }
+
+    VkDevice logicalDevice = context->device;
+    VkDeviceSize outputSize = VkDeviceSize(COMPUTE_GROUP_SIZE) * COMPUTE_GROUP_COUNT * sizeof(float) * 4;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = outputSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer outputBuffer;
+    if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &outputBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark buffer!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(logicalDevice, outputBuffer, &requirements);
+    VkDeviceMemory outputMemory = allocateBenchmarkMemory(context, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    vkBindBufferMemory(logicalDevice, outputBuffer, outputMemory, 0);
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 1;
+    setLayoutInfo.pBindings = &binding;
+
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(logicalDevice, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 };
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    VkDescriptorPool descriptorPool;
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = descriptorPool;
+    allocateInfo.descriptorSetCount = 1;
+    allocateInfo.pSetLayouts = &setLayout;
+
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(logicalDevice, &allocateInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate benchmark descriptor set!");
+    }
+
+    VkDescriptorBufferInfo descriptorBuffer = { outputBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet write = {};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &descriptorBuffer;
+    vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = createShaderModule(logicalDevice, device->gpuBenchmarkShaderPath);
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    VkPipeline computePipeline;
+    if (vkCreateComputePipelines(logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create benchmark pipeline!");
+    }
+
+    vkDestroyShaderModule(logicalDevice, shaderModule, nullptr);
+
+    beginTimedCommands(context);
+
+    vkCmdBindPipeline(context->commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    vkCmdBindDescriptorSets(context->commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    writeStartTimestamp(context);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    for (uint32_t i = 0; i < COMPUTE_REPEAT; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(context->commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+
+        vkCmdDispatch(context->commandBuffer, COMPUTE_GROUP_COUNT, 1, 1);
+    }
+
+    double seconds = submitTimedCommands(context);
+
+    vkDestroyPipeline(logicalDevice, computePipeline, nullptr);
+    vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(logicalDevice, setLayout, nullptr);
+    vkDestroyBuffer(logicalDevice, outputBuffer, nullptr);
+    vkFreeMemory(logicalDevice, outputMemory, nullptr);
+
+    double flops = double(COMPUTE_FLOPS_PER_INVOCATION) * COMPUTE_GROUP_SIZE * COMPUTE_GROUP_COUNT * COMPUTE_REPEAT;
+    return static_cast<float>(flops / seconds / 1e9);
+}
+
+static float runCopyTest(BenchmarkContext* context) {
+
+    VkDevice logicalDevice = context->device;
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = COPY_SIZE;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer bufferList[2];
+    VkDeviceMemory memoryList[2];
+
+    for (uint32_t i = 0; i < 2; i++) {
+        if (vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &bufferList[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create benchmark buffer!");
+        }
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(logicalDevice, bufferList[i], &requirements);
+        memoryList[i] = allocateBenchmarkMemory(context, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        vkBindBufferMemory(logicalDevice, bufferList[i], memoryList[i], 0);
+    }
+
+    beginTimedCommands(context);
+    writeStartTimestamp(context);
+
+    VkBufferCopy region = { 0, 0, COPY_SIZE };
+
+    for (uint32_t i = 0; i < COPY_REPEAT; i++) {
+        if (i > 0) {
+            transferBarrier(context->commandBuffer);
+        }
+
+        // ping pong so every copy reads what the previous one wrote
+        vkCmdCopyBuffer(context->commandBuffer, bufferList[i % 2], bufferList[(i + 1) % 2], 1, &region);
+    }
+
+    double seconds = submitTimedCommands(context);
+
+    for (uint32_t i = 0; i < 2; i++) {
+        vkDestroyBuffer(logicalDevice, bufferList[i], nullptr);
+        vkFreeMemory(logicalDevice, memoryList[i], nullptr);
+    }
+
+    double bytesCopied = double(COPY_SIZE) * COPY_REPEAT;
+    return static_cast<float>(bytesCopied / seconds / 1e9);
+}
+
+// The caller records its setup, then the first timestamp, then the timed work
+static void beginTimedCommands(BenchmarkContext* context) {
+
+    VkCommandBufferBeginInfo commandBufferBegin = {};
+    commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    vkResetCommandBuffer(context->commandBuffer, 0);
+
+    if (vkBeginCommandBuffer(context->commandBuffer, &commandBufferBegin) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin benchmark command buffer!");
+    }
+
+    if (context->queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(context->commandBuffer, context->queryPool, 0, 2);
+    }
+}
+
+// Without timestamp bits there's no pool, submitTimedCommands falls back to cpu time
+static void writeStartTimestamp(BenchmarkContext* context) {
+
+    if (context->queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(context->commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, context->queryPool, 0);
+    }
+}
+
+// Runs the commands twice, the first run warms up clocks and caches, the second is measured
+static double submitTimedCommands(BenchmarkContext* context) {
+
+    if (context->queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(context->commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, context->queryPool, 1);
+    }
+
+    if (vkEndCommandBuffer(context->commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record benchmark command buffer!");
+    }
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &context->commandBuffer;
+
+    double cpuSeconds = 0.0;
+
+    for (uint32_t run = 0; run < 2; run++) {
+        auto start = std::chrono::steady_clock::now();
+
+        if (vkQueueSubmit(context->queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS || vkQueueWaitIdle(context->queue) != VK_SUCCESS) {
+            throw std::runtime_error("failed to run benchmark!");
+        }
+
+        cpuSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    if (context->queryPool == VK_NULL_HANDLE) {
+        return cpuSeconds;
+    }
+
+    uint64_t timestamps[2] = {};
+    vkGetQueryPoolResults(context->device, context->queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    uint64_t mask = context->timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << context->timestampValidBits) - 1;
+    double gpuSeconds = double((timestamps[1] - timestamps[0]) & mask) * context->properties.limits.timestampPeriod * 1e-9;
+
+    return gpuSeconds > 0.0 ? gpuSeconds : cpuSeconds;
+}
+
+static VkDeviceMemory allocateBenchmarkMemory(BenchmarkContext* context, VkMemoryRequirements requirements, VkMemoryPropertyFlags propertyFlags) {
+
+    uint32_t memoryTypeIndex = UINT32_MAX;
+
+    for (uint32_t i = 0; i < context->memoryProperties.memoryTypeCount; i++) {
+        if ((requirements.memoryTypeBits & (1 << i)) && (context->memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+            memoryTypeIndex = i;
+            break;
+        }
+    }
+
+    if (memoryTypeIndex == UINT32_MAX) {
+        throw std::runtime_error("failed to find benchmark memory type!");
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(context->device, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate benchmark memory!");
+    }
+
+    return memory;
+}
+
+static void transferBarrier(VkCommandBuffer commandBuffer) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
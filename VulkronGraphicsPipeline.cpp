@@ -2,6 +2,7 @@
 
 VulkronGraphicsPipelineCreateInfo*	pipeline	        = new VulkronGraphicsPipelineCreateInfo();
 RenderPassInternal*		            renderPassInternal	= new RenderPassInternal();
+GraphicsPipelineCacheInternal*      graphicsPipelineCache   = new GraphicsPipelineCacheInternal();
 
 static std::vector<VkShaderModule> shaderModuleList;
 
@@ -9,17 +10,53 @@ static void createRenderPass(RenderPassInternal* info, VulkronAttachmentFlags fl
 static void pipelineCache(std::string* filePath);
 static void createFrameBuffers(VulkronAttachmentFlags flag);
 static void createImageViews(VulkronAttachmentFlags flag, std::vector<VkImageView>* attachments);
+static void createDepthAttachment();
+static VkFormat findDepthFormat();
+static VkPipeline getGraphicsPipeline(const VulkronGraphicsPipelineCreateInfo& info);
+static std::vector<uint32_t> getGraphicsPipelineKey(const VkGraphicsPipelineCreateInfo& pipelineInfo, size_t* pBaseKeySize);
+static void appendBytes(std::vector<uint32_t>& key, const void* pData, size_t size);
+static uint32_t getFloatBits(float value);
 
 
+// Can be called for every material, identical state returns the pipeline that's already built
 VulkronResult vulkronCreateGraphicsPipeline(VulkronGraphicsPipelineCreateInfo* info) {
-    pipeline = info;
 
-    if (nullptr == pipeline) {
+    if (nullptr == info) {
         return VULKRON_ERROR_MEMORY_ALLOCATE;
     }
 
-    createRenderPass(pipeline->flag);
-    createGraphicsPipeline();
+    if (nullptr == info->pPipelineData || nullptr == info->pPipelineLayout) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    VulkronGraphicsPipeline& graphics = *info->pPipelineData;
+
+    // created once here instead of with every pipeline, swapchain recreation reuses it
+    if (info->reflectLayout) {
+        VulkronPipelineLayoutReflection reflection;
+
+        if (vulkronReflectPipelineLayout(graphics.pShaderStage, graphics.shaderStageCount, &reflection) != VULKRON_SUCCESS) {
+            return VULKRON_ERROR_INVALID_ARGUMENT;
+        }
+
+        *info->pPipelineLayout = reflection.pipelineLayout;
+    }
+    else {
+        vulkronGetCachedPipelineLayout(&graphics.pPipelineLayoutInfo, info->pPipelineLayout);
+    }
+
+    // the first pipeline sets up the frame's attachments and is the one rebuilt with the swapchain,
+    // later ones render into the same pass
+    if (!graphicsPipelineCache->hasRenderPass) {
+        pipeline = info;
+        createRenderPass(info->flag);
+        graphicsPipelineCache->hasRenderPass = true;
+    }
+    else {
+        *info->pRenderPass = *pipeline->pRenderPass;
+    }
+
+    *info->pPipeline = getGraphicsPipeline(*info);
 
     return VULKRON_SUCCESS;
 }
@@ -44,6 +81,17 @@ void createRenderPass(VulkronAttachmentFlags flag) {
     uint32_t index = 0;
 
     renderPassInfo.flag = flag;
+    renderPassInternal->flag = flag;
+
+    // depth is stored so the next frame can build its occlusion pyramid from it
+    swapchainInternal->depthFormat = findDepthFormat();
+
+    // dynamic rendering names its attachments when recording, only the images and views are rebuilt on resize
+    if (deviceInternal->hasDynamicRendering) {
+        *pipeline->pRenderPass = VK_NULL_HANDLE;
+        createFrameBuffers(flag);
+        return;
+    }
 
     VkAttachmentDescription colorAttachment = {};
     colorAttachment.format = swapchainInternal->swapChainImageFormat;
@@ -62,19 +110,37 @@ void createRenderPass(VulkronAttachmentFlags flag) {
     colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     index++;
 
+    VkAttachmentDescription depthAttachment = {};
+    depthAttachment.format = swapchainInternal->depthFormat;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    renderPassInfo.attachmentsList.push_back(depthAttachment);
+
+    VkAttachmentReference depthAttachmentRef = {};
+    depthAttachmentRef.attachment = index;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    index++;
+
     VkSubpassDescription subpass = {};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
     renderPassInfo.subpassList.push_back(subpass);
 
     VkSubpassDependency dependency = {};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
     renderPassInfo.dependencyList.push_back(dependency);
@@ -259,8 +325,114 @@ VkPipelineLayoutCreateInfo vulkronPipelineLayoutInfo(uint32_t setLayoutCount, Vk
     return pipelineLayoutInfo;
 }
 
-VkPipelineShaderStageCreateInfo vulkronCreatePipelineShaderStage(std::string shaderPath, VkShaderStageFlagBits stage) {
-    
+VkPipelineShaderStageCreateInfo vulkronCreatePipelineShaderStage(std::string shaderPath, VkShaderStageFlagBits stage, const VulkronSpecializationConstant* pConstants, uint32_t constantCount) {
+
+    // modules live until shutdown, every permutation of an uber shader shares the one load
+    auto it = graphicsPipelineCache->shaderPathMap.find(shaderPath);
+
+    if (it == graphicsPipelineCache->shaderPathMap.end()) {
+        VkShaderModule shaderModule = createShaderModule(shaderPath);
+        shaderModuleList.push_back(shaderModule);
+        it = graphicsPipelineCache->shaderPathMap.emplace(shaderPath, shaderModule).first;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo = createPipelineShaderStage(it->second, stage, false);
+
+    return vulkronSpecializeShaderStage(shaderStageInfo, pConstants, constantCount);
+}
+
+// Permutations are keyed by the module and the values the shader actually declares, so the same
+// features switched on in a different order, or with extra unknown ids, share the specialization info
+// and through it the pipeline
+VkPipelineShaderStageCreateInfo vulkronSpecializeShaderStage(const VkPipelineShaderStageCreateInfo& stageInfo, const VulkronSpecializationConstant* pConstants, uint32_t constantCount) {
+
+    VkPipelineShaderStageCreateInfo specializedInfo = stageInfo;
+    specializedInfo.pSpecializationInfo = nullptr;
+
+    std::map<uint32_t, uint32_t> sizeMap;
+    bool isReflected = getShaderSpecConstants(stageInfo.module, &sizeMap);
+
+    // a later value for the same id wins
+    std::map<uint32_t, uint32_t> valueMap;
+
+    for (uint32_t i = 0; nullptr != pConstants && i < constantCount; i++) {
+        if (!isReflected || sizeMap.count(pConstants[i].constantID) != 0) {
+            valueMap[pConstants[i].constantID] = pConstants[i].value;
+        }
+    }
+
+    if (valueMap.empty()) {
+        return specializedInfo;
+    }
+
+    std::vector<uint32_t> key;
+    appendHandle(key, stageInfo.module);
+
+    for (const auto& [constantID, value] : valueMap) {
+        key.insert(key.end(), { constantID, value });
+    }
+
+    auto it = graphicsPipelineCache->permutationMap.find(key);
+
+    if (it == graphicsPipelineCache->permutationMap.end()) {
+        it = graphicsPipelineCache->permutationMap.emplace(std::move(key), ShaderPermutation()).first;
+        ShaderPermutation& permutation = it->second;
+
+        for (const auto& [constantID, value] : valueMap) {
+            uint32_t size = isReflected ? sizeMap[constantID] : sizeof(uint32_t);
+
+            VkSpecializationMapEntry entry = {};
+            entry.constantID = constantID;
+            entry.offset = static_cast<uint32_t>(permutation.dataList.size() * sizeof(uint32_t));
+            entry.size = size;
+
+            permutation.mapEntryList.push_back(entry);
+            permutation.dataList.push_back(value);
+
+            if (size > sizeof(uint32_t)) {
+                permutation.dataList.push_back(0);
+            }
+        }
+
+        permutation.specializationInfo.mapEntryCount = static_cast<uint32_t>(permutation.mapEntryList.size());
+        permutation.specializationInfo.pMapEntries = permutation.mapEntryList.data();
+        permutation.specializationInfo.dataSize = permutation.dataList.size() * sizeof(uint32_t);
+        permutation.specializationInfo.pData = permutation.dataList.data();
+    }
+
+    specializedInfo.pSpecializationInfo = &it->second.specializationInfo;
+
+    return specializedInfo;
+}
+
+// Takes ownership of the module, it is kept until shutdown so the pipeline can be rebuilt and matched by its code
+VkPipelineShaderStageCreateInfo createPipelineShaderStage(VkShaderModule shaderModule, VkShaderStageFlagBits stage, bool takeOwnership) {
+
+    if (takeOwnership) {
+        shaderModuleList.push_back(shaderModule);
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.pNext = nullptr;
+    shaderStageInfo.flags = 0;
+    shaderStageInfo.stage = stage;
+    shaderStageInfo.module = shaderModule;
+    shaderStageInfo.pName = "main";
+    shaderStageInfo.pSpecializationInfo = nullptr;
+
+    return shaderStageInfo;
+}
+
+// The caller owns the module
+VkShaderModule createShaderModule(const std::string& shaderPath) {
+    return createShaderModule(deviceInternal->logicalDevice, shaderPath);
+}
+
+// Same for a device that isn't the engine's, the gpu benchmark creates its own
+VkShaderModule createShaderModule(VkDevice logicalDevice, const std::string& shaderPath) {
+    VULKRON_TRACE_SCOPE("pipeline", "createShaderModule");
+
     std::ifstream file(shaderPath, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -279,57 +451,58 @@ VkPipelineShaderStageCreateInfo vulkronCreatePipelineShaderStage(std::string sha
     shaderCreateInfo.codeSize = buffer.size();
     shaderCreateInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
 
-    buffer.clear();
-
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(deviceInternal->logicalDevice, &shaderCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(logicalDevice, &shaderCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
         throw std::runtime_error("failed to create shader module!");
     }
 
-    shaderModuleList.push_back(shaderModule);
-
-    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
-    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageInfo.pNext = nullptr;
-    shaderStageInfo.flags = 0;
-    shaderStageInfo.stage = stage;
-    shaderStageInfo.module = shaderModule;
-    shaderStageInfo.pName = "main";
-    shaderStageInfo.pSpecializationInfo = nullptr;
+    // the benchmark's modules live on a device of their own and are never reflected
+    if (logicalDevice == deviceInternal->logicalDevice) {
+        reflectShaderModule(shaderModule, shaderCreateInfo.pCode, buffer.size() / sizeof(uint32_t));
+    }
 
-    return shaderStageInfo;
+    return shaderModule;
 }
 
+// Swapchain recreation, the cache hands the same pipeline back as long as the attachment formats stay
 void createGraphicsPipeline() {
+    *pipeline->pPipeline = getGraphicsPipeline(*pipeline);
+}
 
-    VulkronGraphicsPipeline graphics = *pipeline->pPipelineData;
+static VkPipeline getGraphicsPipeline(const VulkronGraphicsPipelineCreateInfo& info) {
 
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapchainInternal->swapChainExtent.width;
-    viewport.height = (float)swapchainInternal->swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    VulkronGraphicsPipeline graphics = *info.pPipelineData;
 
-    VkRect2D scissor = {};
-    scissor.offset = { 0, 0 };
-    scissor.extent = swapchainInternal->swapChainExtent;
+    // every draw sets the viewport and scissor from the frame's extent, baking them in would leave
+    // a pipeline per window size in the cache
+    std::vector<VkDynamicState> dynamicStateList(graphics.pDynamicState.pDynamicStates, graphics.pDynamicState.pDynamicStates + graphics.pDynamicState.dynamicStateCount);
+
+    for (VkDynamicState state : { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR }) {
+        if (std::find(dynamicStateList.begin(), dynamicStateList.end(), state) == dynamicStateList.end()) {
+            dynamicStateList.push_back(state);
+        }
+    }
+
+    VkPipelineDynamicStateCreateInfo dynamicState = graphics.pDynamicState;
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStateList.size());
+    dynamicState.pDynamicStates = dynamicStateList.data();
 
     VkPipelineViewportStateCreateInfo viewportState = {};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
 
-    if (vkCreatePipelineLayout(deviceInternal->logicalDevice, &graphics.pPipelineLayoutInfo, nullptr, pipeline->pPipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
+    // same attachments the frame begins rendering with
+    VkPipelineRenderingCreateInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &swapchainInternal->swapChainImageFormat;
+    renderingInfo.depthAttachmentFormat = swapchainInternal->depthFormat;
 
     VkGraphicsPipelineCreateInfo pipelineInfoCreate = {};
     pipelineInfoCreate.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfoCreate.pNext = nullptr;
+    pipelineInfoCreate.pNext = deviceInternal->hasDynamicRendering ? &renderingInfo : nullptr;
     pipelineInfoCreate.flags = 0;
     pipelineInfoCreate.stageCount = graphics.shaderStageCount;
     pipelineInfoCreate.pStages = graphics.pShaderStage;
@@ -341,21 +514,59 @@ void createGraphicsPipeline() {
     pipelineInfoCreate.pMultisampleState = &graphics.pMultisampleState;
     pipelineInfoCreate.pDepthStencilState = &graphics.pDepthStencilState;
     pipelineInfoCreate.pColorBlendState = &graphics.pColorBlendState;
-    pipelineInfoCreate.pDynamicState = &graphics.pDynamicState;
-    pipelineInfoCreate.layout = *pipeline->pPipelineLayout;
-    pipelineInfoCreate.renderPass = *pipeline->pRenderPass;
+    pipelineInfoCreate.pDynamicState = &dynamicState;
+    pipelineInfoCreate.layout = *info.pPipelineLayout;
+    pipelineInfoCreate.renderPass = *info.pRenderPass;
     pipelineInfoCreate.subpass = 0;
     pipelineInfoCreate.basePipelineHandle = VULKRON_NULL_HANDLE;
+    pipelineInfoCreate.basePipelineIndex = -1;
+
+    size_t baseKeySize = 0;
+    std::vector<uint32_t> key = getGraphicsPipelineKey(pipelineInfoCreate, &baseKeySize);
+
+    auto it = graphicsPipelineCache->pipelineMap.find(key);
+
+    if (it != graphicsPipelineCache->pipelineMap.end()) {
+        return it->second;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
 
+    if (VK_NULL_HANDLE == graphicsPipelineCache->pipelineCache) {
+        VkPipelineCacheCreateInfo cacheInfo = {};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        if (vkCreatePipelineCache(logicalDevice, &cacheInfo, nullptr, &graphicsPipelineCache->pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    // variants that only differ in fixed function state derive from the first one built with the same shaders
+    std::vector<uint32_t> baseKey(key.begin(), key.begin() + baseKeySize);
+    auto baseIt = graphicsPipelineCache->baseMap.find(baseKey);
+
+    if (baseIt != graphicsPipelineCache->baseMap.end()) {
+        pipelineInfoCreate.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+        pipelineInfoCreate.basePipelineHandle = baseIt->second;
+    }
+    else {
+        pipelineInfoCreate.flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+    }
 
-    if (vkCreateGraphicsPipelines(deviceInternal->logicalDevice, VULKRON_NULL_HANDLE, 1, &pipelineInfoCreate, nullptr, pipeline->pPipeline) != VK_SUCCESS) {
+    VULKRON_TRACE_SCOPE("pipeline", "vkCreateGraphicsPipelines");
+
+    VkPipeline graphicsPipeline;
+    if (vkCreateGraphicsPipelines(logicalDevice, graphicsPipelineCache->pipelineCache, 1, &pipelineInfoCreate, nullptr, &graphicsPipeline) != VK_SUCCESS) {
         throw std::runtime_error("failed to create graphics pipeline!");
     }
 
-    for (VkShaderModule shaderModule : shaderModuleList) {
-        vkDestroyShaderModule(deviceInternal->logicalDevice, shaderModule, nullptr);
+    if (baseIt == graphicsPipelineCache->baseMap.end()) {
+        graphicsPipelineCache->baseMap.emplace(std::move(baseKey), graphicsPipeline);
     }
 
+    graphicsPipelineCache->pipelineMap.emplace(std::move(key), graphicsPipeline);
+
+    return graphicsPipeline;
 }
 
 static void pipelineCache(std::string* filePath) {
@@ -363,6 +574,246 @@ static void pipelineCache(std::string* filePath) {
 }
 
 
+//-------------------------------------------------------------------------------------
+//	SECTION [PIPELINE STATE] ----------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// The key is built field by field so padding, pNext and state Vulkan ignores can't tell two equal pipelines apart.
+// Shaders, layout and attachments come first, that prefix is the key of the pipeline's derivative base.
+static std::vector<uint32_t> getGraphicsPipelineKey(const VkGraphicsPipelineCreateInfo& pipelineInfo, size_t* pBaseKeySize) {
+
+    std::vector<uint32_t> key;
+    key.push_back(pipelineInfo.flags);
+
+    // the stage order in the array doesn't change the pipeline
+    std::vector<const VkPipelineShaderStageCreateInfo*> stageList;
+    bool hasTessellation = false;
+
+    for (uint32_t i = 0; i < pipelineInfo.stageCount; i++) {
+        stageList.push_back(&pipelineInfo.pStages[i]);
+        hasTessellation |= (pipelineInfo.pStages[i].stage & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT) != 0;
+    }
+
+    std::sort(stageList.begin(), stageList.end(), [](const VkPipelineShaderStageCreateInfo* a, const VkPipelineShaderStageCreateInfo* b) {
+        return a->stage < b->stage;
+    });
+
+    key.push_back(pipelineInfo.stageCount);
+
+    for (const VkPipelineShaderStageCreateInfo* stage : stageList) {
+        key.insert(key.end(), { static_cast<uint32_t>(stage->stage), stage->flags });
+
+        // separately loaded copies of a shader match by their code, unknown modules only by their handle
+        uint64_t codeId = getShaderCodeId(stage->module);
+
+        if (codeId != 0) {
+            key.insert(key.end(), { 0u, static_cast<uint32_t>(codeId), static_cast<uint32_t>(codeId >> 32) });
+        }
+        else {
+            key.push_back(1u);
+            appendHandle(key, stage->module);
+        }
+
+        appendBytes(key, stage->pName, strlen(stage->pName));
+
+        const VkSpecializationInfo* pSpecialization = stage->pSpecializationInfo;
+
+        if (nullptr == pSpecialization) {
+            key.push_back(UINT32_MAX);
+            continue;
+        }
+
+        key.push_back(pSpecialization->mapEntryCount);
+
+        for (uint32_t i = 0; i < pSpecialization->mapEntryCount; i++) {
+            const VkSpecializationMapEntry& entry = pSpecialization->pMapEntries[i];
+            key.insert(key.end(), { entry.constantID, entry.offset, static_cast<uint32_t>(entry.size) });
+        }
+
+        appendBytes(key, pSpecialization->pData, pSpecialization->dataSize);
+    }
+
+    // layouts come from the layout cache, equal layouts are the same handle
+    appendHandle(key, pipelineInfo.layout);
+
+    // render passes are rebuilt with the swapchain, a pipeline stays valid for any pass with the same attachments
+    key.insert(key.end(), { static_cast<uint32_t>(renderPassInternal->flag), static_cast<uint32_t>(swapchainInternal->swapChainImageFormat),
+        static_cast<uint32_t>(swapchainInternal->depthFormat), pipelineInfo.subpass });
+
+    *pBaseKeySize = key.size();
+
+    std::vector<VkDynamicState> dynamicStateList;
+
+    if (nullptr != pipelineInfo.pDynamicState) {
+        const VkPipelineDynamicStateCreateInfo& dynamicState = *pipelineInfo.pDynamicState;
+        dynamicStateList.assign(dynamicState.pDynamicStates, dynamicState.pDynamicStates + dynamicState.dynamicStateCount);
+        std::sort(dynamicStateList.begin(), dynamicStateList.end());
+    }
+
+    key.push_back(static_cast<uint32_t>(dynamicStateList.size()));
+
+    for (VkDynamicState dynamicState : dynamicStateList) {
+        key.push_back(static_cast<uint32_t>(dynamicState));
+    }
+
+    auto isDynamic = [&](VkDynamicState state) {
+        return std::binary_search(dynamicStateList.begin(), dynamicStateList.end(), state);
+    };
+
+    const VkPipelineVertexInputStateCreateInfo& vertexInput = *pipelineInfo.pVertexInputState;
+
+    std::vector<VkVertexInputBindingDescription> bindingList(vertexInput.pVertexBindingDescriptions, vertexInput.pVertexBindingDescriptions + vertexInput.vertexBindingDescriptionCount);
+    std::vector<VkVertexInputAttributeDescription> attributeList(vertexInput.pVertexAttributeDescriptions, vertexInput.pVertexAttributeDescriptions + vertexInput.vertexAttributeDescriptionCount);
+
+    std::sort(bindingList.begin(), bindingList.end(), [](const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b) {
+        return a.binding < b.binding;
+    });
+
+    std::sort(attributeList.begin(), attributeList.end(), [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+        return a.location < b.location;
+    });
+
+    key.push_back(static_cast<uint32_t>(bindingList.size()));
+
+    for (const VkVertexInputBindingDescription& binding : bindingList) {
+        key.insert(key.end(), { binding.binding, binding.stride, static_cast<uint32_t>(binding.inputRate) });
+    }
+
+    key.push_back(static_cast<uint32_t>(attributeList.size()));
+
+    for (const VkVertexInputAttributeDescription& attribute : attributeList) {
+        key.insert(key.end(), { attribute.location, attribute.binding, static_cast<uint32_t>(attribute.format), attribute.offset });
+    }
+
+    const VkPipelineInputAssemblyStateCreateInfo& inputAssembly = *pipelineInfo.pInputAssemblyState;
+    key.insert(key.end(), { static_cast<uint32_t>(inputAssembly.topology), inputAssembly.primitiveRestartEnable });
+
+    // only read with tessellation shaders
+    key.push_back(hasTessellation && nullptr != pipelineInfo.pTessellationState ? pipelineInfo.pTessellationState->patchControlPoints : 0);
+
+    // baked viewports and scissors only matter when they aren't set while recording
+    const VkPipelineViewportStateCreateInfo& viewportState = *pipelineInfo.pViewportState;
+    key.insert(key.end(), { viewportState.viewportCount, viewportState.scissorCount });
+
+    if (!isDynamic(VK_DYNAMIC_STATE_VIEWPORT)) {
+        for (uint32_t i = 0; i < viewportState.viewportCount; i++) {
+            const VkViewport& viewport = viewportState.pViewports[i];
+            key.insert(key.end(), { getFloatBits(viewport.x), getFloatBits(viewport.y), getFloatBits(viewport.width), getFloatBits(viewport.height),
+                getFloatBits(viewport.minDepth), getFloatBits(viewport.maxDepth) });
+        }
+    }
+
+    if (!isDynamic(VK_DYNAMIC_STATE_SCISSOR)) {
+        for (uint32_t i = 0; i < viewportState.scissorCount; i++) {
+            const VkRect2D& scissor = viewportState.pScissors[i];
+            key.insert(key.end(), { static_cast<uint32_t>(scissor.offset.x), static_cast<uint32_t>(scissor.offset.y), scissor.extent.width, scissor.extent.height });
+        }
+    }
+
+    const VkPipelineRasterizationStateCreateInfo& rasterization = *pipelineInfo.pRasterizationState;
+    key.insert(key.end(), { rasterization.depthClampEnable, rasterization.rasterizerDiscardEnable, static_cast<uint32_t>(rasterization.polygonMode),
+        rasterization.cullMode, static_cast<uint32_t>(rasterization.frontFace), rasterization.depthBiasEnable, getFloatBits(rasterization.lineWidth) });
+
+    if (rasterization.depthBiasEnable) {
+        key.insert(key.end(), { getFloatBits(rasterization.depthBiasConstantFactor), getFloatBits(rasterization.depthBiasClamp),
+            getFloatBits(rasterization.depthBiasSlopeFactor) });
+    }
+
+    const VkPipelineMultisampleStateCreateInfo& multisample = *pipelineInfo.pMultisampleState;
+    key.insert(key.end(), { static_cast<uint32_t>(multisample.rasterizationSamples), multisample.sampleShadingEnable,
+        multisample.sampleShadingEnable ? getFloatBits(multisample.minSampleShading) : 0, multisample.alphaToCoverageEnable, multisample.alphaToOneEnable });
+
+    // no sample mask is the same as every sample enabled
+    uint32_t sampleMaskCount = (static_cast<uint32_t>(multisample.rasterizationSamples) + 31) / 32;
+
+    for (uint32_t i = 0; i < sampleMaskCount; i++) {
+        key.push_back(nullptr != multisample.pSampleMask ? multisample.pSampleMask[i] : UINT32_MAX);
+    }
+
+    // depth writes and the compare op do nothing without the depth test, same for the stencil and bounds state
+    const VkPipelineDepthStencilStateCreateInfo& depthStencil = *pipelineInfo.pDepthStencilState;
+    key.insert(key.end(), { depthStencil.depthTestEnable, depthStencil.depthTestEnable ? depthStencil.depthWriteEnable : 0,
+        depthStencil.depthTestEnable ? static_cast<uint32_t>(depthStencil.depthCompareOp) : 0, depthStencil.depthBoundsTestEnable, depthStencil.stencilTestEnable });
+
+    if (depthStencil.depthBoundsTestEnable) {
+        key.insert(key.end(), { getFloatBits(depthStencil.minDepthBounds), getFloatBits(depthStencil.maxDepthBounds) });
+    }
+
+    if (depthStencil.stencilTestEnable) {
+        for (const VkStencilOpState& stencil : { depthStencil.front, depthStencil.back }) {
+            key.insert(key.end(), { static_cast<uint32_t>(stencil.failOp), static_cast<uint32_t>(stencil.passOp), static_cast<uint32_t>(stencil.depthFailOp),
+                static_cast<uint32_t>(stencil.compareOp), stencil.compareMask, stencil.writeMask, stencil.reference });
+        }
+    }
+
+    const VkPipelineColorBlendStateCreateInfo& colorBlend = *pipelineInfo.pColorBlendState;
+    key.insert(key.end(), { colorBlend.logicOpEnable, colorBlend.logicOpEnable ? static_cast<uint32_t>(colorBlend.logicOp) : 0, colorBlend.attachmentCount });
+
+    for (uint32_t i = 0; i < colorBlend.attachmentCount; i++) {
+        const VkPipelineColorBlendAttachmentState& attachment = colorBlend.pAttachments[i];
+        key.insert(key.end(), { attachment.blendEnable, attachment.colorWriteMask });
+
+        if (attachment.blendEnable) {
+            key.insert(key.end(), { static_cast<uint32_t>(attachment.srcColorBlendFactor), static_cast<uint32_t>(attachment.dstColorBlendFactor),
+                static_cast<uint32_t>(attachment.colorBlendOp), static_cast<uint32_t>(attachment.srcAlphaBlendFactor),
+                static_cast<uint32_t>(attachment.dstAlphaBlendFactor), static_cast<uint32_t>(attachment.alphaBlendOp) });
+        }
+    }
+
+    for (float blendConstant : colorBlend.blendConstants) {
+        key.push_back(getFloatBits(blendConstant));
+    }
+
+    return key;
+}
+
+// Length first so two byte strings can't run into each other, the last word is zero padded
+static void appendBytes(std::vector<uint32_t>& key, const void* pData, size_t size) {
+
+    key.push_back(static_cast<uint32_t>(size));
+
+    size_t offset = key.size();
+    key.resize(offset + (size + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+
+    if (size > 0) {
+        memcpy(key.data() + offset, pData, size);
+    }
+}
+
+// -0.0 and 0.0 compare equal, they give the same pipeline
+static uint32_t getFloatBits(float value) {
+
+    uint32_t bits = 0;
+    value = (value == 0.0f) ? 0.0f : value;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+// Pipelines, the shared pipeline cache and every module handed to createPipelineShaderStage
+void destroyGraphicsPipelines() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    for (const auto& [key, graphicsPipeline] : graphicsPipelineCache->pipelineMap) {
+        vkDestroyPipeline(logicalDevice, graphicsPipeline, nullptr);
+    }
+
+    if (VK_NULL_HANDLE != graphicsPipelineCache->pipelineCache) {
+        vkDestroyPipelineCache(logicalDevice, graphicsPipelineCache->pipelineCache, nullptr);
+    }
+
+    for (VkShaderModule shaderModule : shaderModuleList) {
+        destroyShaderModule(shaderModule);
+    }
+
+    shaderModuleList.clear();
+
+    delete graphicsPipelineCache;
+    graphicsPipelineCache = nullptr;
+}
+
+
 //-------------------------------------------------------------------------------------
 //	SECTION [FRAME BUFFER] ------------------------------------------------------------
 //-------------------------------------------------------------------------------------
@@ -376,6 +827,8 @@ static void createFrameBuffers(VulkronAttachmentFlags flag) {
 
     swapchainInternal->bufferList.resize(swapchainInternal->imageCount);
 
+    createDepthAttachment();
+
     for (uint32_t i = 0; i < swapchainInternal->imageCount; i++) {
         VkImageViewCreateInfo defaultColorImageView = {};
         defaultColorImageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -406,9 +859,15 @@ static void createFrameBuffers(VulkronAttachmentFlags flag) {
 
         //}
 
-        std::vector<VkImageView> attachments = {};// Render pass attachments for frame buffer
+        swapchainInternal->bufferList[i].frameBuffer = VK_NULL_HANDLE;
+
+        if (deviceInternal->hasDynamicRendering) {
+            continue;
+        }
+
+        // Render pass attachments for frame buffer, same order as the render pass
+        std::vector<VkImageView> attachments = { swapchainInternal->bufferList[i].view };
         createImageViews(flag, &attachments);
-        attachments.push_back(swapchainInternal->bufferList[i].view);
 
         VkFramebufferCreateInfo framebufferInfo = {};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -426,7 +885,79 @@ static void createFrameBuffers(VulkronAttachmentFlags flag) {
 }
 
 static void createImageViews(VulkronAttachmentFlags flag, std::vector<VkImageView>* attachments) {
+    attachments->push_back(swapchainInternal->depthView);
+}
+
+static VkFormat findDepthFormat() {
+
+    // D16 is guaranteed to support both, D32 keeps the occlusion pyramid precise
+    const VkFormat candidateList[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+    const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+    for (VkFormat format : candidateList) {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(deviceInternal->gpu, format, &properties);
+
+        if ((properties.optimalTilingFeatures & requiredFeatures) == requiredFeatures) {
+            return format;
+        }
+    }
+
+    throw std::runtime_error("failed to find a supported depth format!");
+}
+
+// One depth image shared by every swapchain image, frames in flight are ordered on the graphics queue
+static void createDepthAttachment() {
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = swapchainInternal->depthFormat;
+    imageInfo.extent = { swapchainInternal->swapChainExtent.width, swapchainInternal->swapChainExtent.height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(deviceInternal->logicalDevice, &imageInfo, nullptr, &swapchainInternal->depthImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(deviceInternal->logicalDevice, swapchainInternal->depthImage, &requirements);
+    allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &swapchainInternal->depthMemory);
+    vkBindImageMemory(deviceInternal->logicalDevice, swapchainInternal->depthImage, swapchainInternal->depthMemory.memory, swapchainInternal->depthMemory.offset);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = swapchainInternal->depthImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = swapchainInternal->depthFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(deviceInternal->logicalDevice, &viewInfo, nullptr, &swapchainInternal->depthView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth image view!");
+    }
+}
+
+void destroyDepthAttachment() {
+    if (swapchainInternal->depthImage == VK_NULL_HANDLE) {
+        return;
+    }
+
+    vkDestroyImageView(deviceInternal->logicalDevice, swapchainInternal->depthView, nullptr);
+    vkDestroyImage(deviceInternal->logicalDevice, swapchainInternal->depthImage, nullptr);
+    freeMemory(&swapchainInternal->depthMemory);
 
+    swapchainInternal->depthView = VK_NULL_HANDLE;
+    swapchainInternal->depthImage = VK_NULL_HANDLE;
 }
 
 //-------------------------------------------------------------------------------------
@@ -54,7 +54,30 @@ VulkronResult vulkronShutdown() {
         vkDestroyFence(deviceInternal->logicalDevice, drawInternal->inFlightFences[i], nullptr);
     }
 
-    vkDestroyCommandPool(deviceInternal->logicalDevice, primaryCommandPool, nullptr);
+    destroyCommands();
+
+    delete workerThreadPool; // joins the workers, nothing is decoding after this
+    workerThreadPool = nullptr;
+    delete frameThreadPool;
+    frameThreadPool = nullptr;
+
+    destroyAsyncTasks();
+    destroyScene();
+    destroyTextures();
+    destroyMeshes();
+    destroyOcclusionCulling();
+    destroyShadows();
+    destroyFrameStatistics();
+    destroyBatchRenderer();
+    destroyGraphicsPipelines();
+    destroyLayoutCache();
+    flushFrameDeletionQueue(true);
+    destroyTransferBatches();
+    destroyComputeScheduler();
+    destroyUploadRing();
+    destroyReadbackRing();
+    destroyTransientHeaps();
+    destroyMemoryBlocks();
 
     vkDestroyDevice(deviceInternal->logicalDevice, nullptr);
 
@@ -87,7 +110,7 @@ static void createApplicationInstance() {
     applicationInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     applicationInfo.pEngineName = "Vulkron Engine";
     applicationInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    applicationInfo.apiVersion = VK_API_VERSION_1_2;
+    applicationInfo.apiVersion = VK_API_VERSION_1_3; // highest the engine uses, older devices still work at their own version
 
     VkInstanceCreateInfo instanceCreateInfo = {};
     instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
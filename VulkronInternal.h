@@ -1,6 +1,8 @@
 #pragma once
 
 #include "VulkronCore.h"
+#include "VulkronAsync.h"
+#include "VulkronThreadPool.h"
 
 #include <map>
 #include <unordered_map>
@@ -10,6 +12,76 @@
 #include <stdint.h>
 #include <memory>
 #include <array>
+#include <deque>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+
+struct QueueFamily;
+struct Queue;
+struct DeviceQueue;
+struct SwapchainSupportDetails;
+struct SwapchainBuffers;
+struct FrameThreadContext;
+struct FrameContext;
+struct RenderTarget;
+struct ObjectSlot;
+struct BvhNode;
+struct BvhBuildItem;
+struct BvhHit;
+struct Bvh;
+struct SceneInternal;
+
+struct InstanceInternal;
+struct DeviceInternal;
+struct SwapchainInternal;
+struct RenderPassInternal;
+struct DrawInternal;
+struct MemoryAllocation;
+struct MemoryBlock;
+struct MemoryAllocatorInternal;
+struct TransientHeap;
+struct TransientImage;
+struct TransientInternal;
+struct BufferAllocation;
+struct UploadRing;
+struct TransferBatch;
+struct TransferInternal;
+struct TextureStreamingInternal;
+struct MeshStreamingInternal;
+struct CullingInternal;
+struct OcclusionInternal;
+struct ShadowDraw;
+struct ShadowCascade;
+struct ShadowInternal;
+struct ComputeDispatch;
+struct ComputeSubmission;
+struct ComputeInternal;
+struct MemoryBudgetInternal;
+struct EvictionCandidate;
+struct AsyncOperation;
+struct AsyncWaiter;
+struct AsyncInternal;
+struct ReflectedBinding;
+struct ShaderReflection;
+struct LayoutKeyHash;
+struct LayoutCacheInternal;
+struct GraphicsPipelineCacheInternal;
+struct ReadbackInternal;
+struct BatchJob;
+struct BatchFrame;
+struct BatchInternal;
+struct StatisticsFrame;
+struct StatisticsInternal;
+struct TraceInternal;
+
+typedef enum TransientPass {                                                // passes in the order a frame records them
+    TRANSIENT_PASS_OCCLUSION = 0,                                           // depth pyramid and occlusion culling
+    TRANSIENT_PASS_SHADOW,                                                  // cascaded shadow maps, sampled again in the main pass
+    TRANSIENT_PASS_MAIN,
+    TRANSIENT_PASS_COUNT
+} TransientPass;
 
 void destroyInstance();
 void destroyDevice();
@@ -18,25 +90,137 @@ void destroyPipeline();
 void destroyFrameBuffer();
 void destroyCommands();
 
+DeviceQueue* getThreadQueue(VulkronQueueFlag type);
+VkResult queueSubmit(DeviceQueue* deviceQueue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence fence);
+VkResult queuePresent(DeviceQueue* deviceQueue, const VkPresentInfoKHR* pPresentInfo);
+
 void createSwapchain(uint32_t* width, uint32_t* height, bool vsync);
 void cleanUpSwapchain();
 void createRenderPass(VulkronAttachmentFlags flag);
 void createGraphicsPipeline();
+void destroyDepthAttachment();
+VkShaderModule createShaderModule(const std::string& shaderPath);
+VkShaderModule createShaderModule(VkDevice logicalDevice, const std::string& shaderPath);
+VkPipelineShaderStageCreateInfo createPipelineShaderStage(VkShaderModule shaderModule, VkShaderStageFlagBits stage, bool takeOwnership = true);
+VkPipeline createComputePipeline(const std::string& shaderPath, VkPipelineLayout layout);
+VkPipeline createComputePipeline(VkShaderModule shaderModule, VkPipelineLayout layout);
 
-struct QueueFamily;
-struct Queue;
-struct SwapchainSupportDetails;
-struct SwapchainBuffers;
-struct ThreadData;
-struct CommandBufferData;
+void reflectShaderModule(VkShaderModule shaderModule, const uint32_t* pCode, size_t wordCount);
+void destroyShaderModule(VkShaderModule shaderModule);
+uint64_t getShaderCodeId(VkShaderModule shaderModule);
+bool getShaderSpecConstants(VkShaderModule shaderModule, std::map<uint32_t, uint32_t>* pSizeMap);
+void destroyLayoutCache();
+void destroyGraphicsPipelines();
 
-struct InstanceInternal;
-struct DeviceInternal;
-struct SwapchainInternal;
-struct RenderPassInternal;
-struct DrawInternal;
+uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags);
+VkMemoryPropertyFlags getMemoryPropertyFlags(VulkronMemoryUsage usage);
+void allocateMemory(VkMemoryRequirements requirements, VkMemoryPropertyFlags propertyFlags, MemoryAllocation* allocation, bool isMovable = false);
+void freeMemory(MemoryAllocation* allocation);
+void invalidateMemory(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+void destroyMemoryBlocks();
+void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags propertyFlags, BufferAllocation* buffer, bool isMovable = false);
+void destroyBuffer(BufferAllocation* buffer);
+
+VkImage createTransientImage(const VkImageCreateInfo& imageInfo, TransientPass firstPass, TransientPass lastPass, VkPipelineStageFlags stageMask, VkAccessFlags accessMask);
+void destroyTransientImage(VkImage image);
+void recordTransientBarriers(VkCommandBuffer commandBuffer, TransientPass pass);
+void destroyTransientHeaps();
+
+void updateMemoryBudget();
+bool hasMemoryPressure(VulkronMemoryPressure pressure);
+
+void createUploadRing(VkDeviceSize size);
+void destroyUploadRing();
+bool uploadRingAllocate(VkDeviceSize size, VkDeviceSize* pOffset);
+bool ringAllocate(UploadRing* ring, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset);
+void createReadbackRing(VkDeviceSize size);
+void destroyReadbackRing();
+void retireReadbacks(uint32_t frameIndex);
+void recordReadbacks(VkCommandBuffer commandBuffer, VkImage presentImage, uint32_t frameIndex);
+VkMemoryPropertyFlags getReadbackMemoryFlags();
 
-typedef std::unordered_map<uint32_t, std::vector<ThreadData>> threadDataMap;
+void createTransferBatches();
+void destroyTransferBatches();
+TransferBatch* getTransferBatch();
+bool hasTransferBudget(VkDeviceSize size);
+void submitTransferBatch();
+void retireTransferBatches();
+void flushUploadBatch(bool isEndOfFrame);
+void recordQueueOwnershipTransfer(TransferBatch* batch, VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+void recordQueueOwnershipTransfer(TransferBatch* batch, VkBuffer buffer, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+void updateTextureStreaming();
+void destroyTextures();
+void getTextureEvictionCandidates(std::vector<EvictionCandidate>& candidateList);
+bool demoteTexture(VulkronTexture texture);
+void moveTextures(const MemoryBlock* block, VkDeviceSize* pBudget);
+
+void updateMeshStreaming();
+void destroyMeshes();
+void getMeshEvictionCandidates(std::vector<EvictionCandidate>& candidateList);
+void evictMesh(VulkronMesh mesh);
+void moveMeshes(const MemoryBlock* block, VkDeviceSize* pBudget);
+void recordMeshDraw(VkCommandBuffer commandBuffer, const VulkronBaseObject& object);
+
+void updateVisibility(std::vector<VulkronBaseObject>& staticObjectsList, std::vector<VulkronBaseObject>& dynamicObjectsList);
+glm::mat4 getObjectMatrix(const VulkronBaseObject& object);
+bool getObjectSphere(const VulkronBaseObject& object, glm::vec4* pSphere);
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planeList);
+bool isSphereInFrustum(const glm::vec4& sphere, const glm::vec4* planeList);
+
+void buildBvh(Bvh* bvh, std::vector<BvhBuildItem>& itemList);
+void refitBvh(Bvh* bvh);
+float getBvhCost(const Bvh& bvh);
+void queryBvhFrustum(const Bvh& bvh, const glm::vec4* planeList, uint32_t planeMask, std::vector<BvhHit>& hitList);
+
+void updateOcclusionCulling(std::vector<VulkronBaseObject>& staticObjectsList, std::vector<VulkronBaseObject>& dynamicObjectsList, uint32_t frameIndex);
+void recordOcclusionCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+void recordOcclusionDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+bool hasOcclusionDraws(uint32_t frameIndex);
+bool isDrawnIndirect(const VulkronBaseObject& object);
+void resetOcclusionHistory();
+void destroyOcclusionPyramid();
+void destroyOcclusionCulling();
+
+void updateShadows();
+void recordShadows(VkCommandBuffer commandBuffer);
+void destroyShadows();
+
+void createComputeScheduler();
+void destroyComputeScheduler();
+void submitComputeWork(uint32_t frameIndex);
+void recordComputeWork(VkCommandBuffer commandBuffer);
+bool getComputeWait(VkSemaphore* pSemaphore, uint64_t* pValue, VkPipelineStageFlags* pStage);
+bool getGraphicsTimelineSignal(VkSemaphore* pSemaphore, uint64_t* pValue);
+
+void benchmarkGpu(VkPhysicalDevice gpu, VulkronGpuCandidate* pCandidate);
+
+VulkronBaseObject* getSceneObject(VulkronObjectHandle handle, bool isStatic);
+void destroyScene();
+
+void enqueueFrameDeletion(std::function<void()> deletion);
+void flushFrameDeletionQueue(bool flushAll);
+uint32_t drawOffscreenFrame(const std::vector<RenderTarget>& targetList, const VkClearColorValue& clearColor);
+
+void retireBatchFrame(uint32_t frameIndex);
+void destroyBatchRenderer();
+
+void retireFrameStatistics(uint32_t frameIndex);
+void beginFrameStatistics(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D extent);
+void endFrameStatistics(uint32_t frameIndex);
+void beginPassStatistics(VkCommandBuffer commandBuffer, VulkronFramePass pass, uint32_t frameIndex);
+void endPassStatistics(VkCommandBuffer commandBuffer, VulkronFramePass pass, uint32_t frameIndex);
+void setStatisticsInheritance(VkCommandBufferInheritanceInfo* inheritanceInfo);
+void destroyFrameStatistics();
+
+#ifdef VULKRON_TRACING
+void calibrateTraceGpuClock(uint64_t frameEndTicks);
+void writeTraceGpuEvent(const char* name, uint64_t beginTicks, uint64_t endTicks);
+#endif // VULKRON_TRACING
+
+void resumeAsyncTasks();
+void destroyAsyncTasks();
 
 extern VulkronInstanceCreateInfo*           instance;
 extern InstanceInternal*                    instanceInternal;
@@ -48,11 +232,33 @@ extern SwapchainInternal*                   swapchainInternal;
 extern SwapchainSupportDetails*             swapchainSupportDetails;
 extern VulkronGraphicsPipelineCreateInfo*   pipeline;
 extern RenderPassInternal*                  renderPassInternal;
-extern CommandBufferData*                   commandBufferData;
 extern DrawInternal*                        drawInternal;
+extern UploadRing*                          uploadRing;
+extern ReadbackInternal*                    readbackInternal;
+extern TransferInternal*                    transferInternal;
+extern TextureStreamingInternal*            textureStreaming;
+extern MeshStreamingInternal*               meshStreaming;
+extern VulkronThreadPool*                   workerThreadPool;
+extern VulkronThreadPool*                   frameThreadPool;
+extern CullingInternal*                     cullingInternal;
+extern OcclusionInternal*                   occlusionInternal;
+extern ShadowInternal*                      shadowInternal;
+extern ComputeInternal*                     computeInternal;
+extern MemoryBudgetInternal*                memoryBudget;
+extern MemoryAllocatorInternal*             memoryAllocator;
+extern TransientInternal*                   transientInternal;
+extern SceneInternal*                       sceneInternal;
+extern AsyncInternal*                       asyncInternal;
+extern LayoutCacheInternal*                 layoutCache;
+extern GraphicsPipelineCacheInternal*       graphicsPipelineCache;
+extern BatchInternal*                       batchInternal;
+extern StatisticsInternal*                  statisticsInternal;
+#ifdef VULKRON_TRACING
+extern TraceInternal*                       traceInternal;
+#endif // VULKRON_TRACING
 
 extern const uint32_t                       MAX_FRAMES_IN_FLIGHT;
-extern VkCommandPool                        primaryCommandPool;
+extern uint64_t                             frameNumber;
 
 
 // ---------------------------------- 
@@ -66,10 +272,19 @@ typedef struct QueueFamily {
     uint32_t								transferQueueIndex;				// Transfer queues can perform transfer (copy) operations from vkCmdCopy*
 } QueueFamily;
 
+typedef struct DeviceQueue {
+    VkQueue                                 queue               = VK_NULL_HANDLE;
+    uint32_t                                familyIndex         = 0;
+    uint32_t                                queueIndex          = 0;
+    float                                   priority            = 0.0f;
+    std::mutex                              mutex;                          // held while submitting or presenting on this queue only
+} DeviceQueue;
+
 typedef struct Queue {
-    VkQueue                                 graphics;
-    VkQueue                                 compute;
-    VkQueue                                 transfer;
+    std::vector<std::unique_ptr<DeviceQueue>>   deviceQueueList;            // every queue created with the device
+    std::vector<DeviceQueue*>               graphicsList;                   // queues handed to each role, roles sharing a family may share queues
+    std::vector<DeviceQueue*>               computeList;
+    std::vector<DeviceQueue*>               transferList;
 } Queue;
 
 typedef struct SwapchainSupportDetails {
@@ -84,19 +299,130 @@ typedef struct SwapchainBuffers {
     VkFramebuffer                           frameBuffer;
 } SwapchainBuffers;
 
-typedef struct ThreadData {
-    uint32_t                                imageIndex;                     // track to reset frame pool
-    VkCommandPool                           commandPool;                    // command pool per frame
-    std::vector<VkCommandBuffer>            secondarydynamicBufferList;     // Dynamic command buffers, used for batches
-} ThreadData;
+typedef struct FrameThreadContext {                                         // only touched by one frame thread while recording
+    VkCommandPool                           commandPool         = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer>            secondaryBufferList;            // allocated on demand, reused after every reset
+    uint32_t                                usedCount           = 0;
+} FrameThreadContext;
+
+typedef struct FrameContext {                                               // everything recorded for one frame in flight
+    VkCommandPool                           commandPool         = VK_NULL_HANDLE;
+    VkCommandBuffer                         primaryBuffer       = VK_NULL_HANDLE;
+    VkCommandBuffer                         secondaryStaticBuffer = VK_NULL_HANDLE;
+    std::vector<FrameThreadContext>         threadContextList;              // one per frameThreadPool thread
+} FrameContext;
+
+typedef struct RenderTarget {                                               // what the main pass draws into
+    VkImage                                 image               = VK_NULL_HANDLE;
+    VkImageView                             view                = VK_NULL_HANDLE;
+    VkFramebuffer                           frameBuffer         = VK_NULL_HANDLE;   // only without dynamic rendering
+    VkImage                                 depthImage          = VK_NULL_HANDLE;
+    VkImageView                             depthView           = VK_NULL_HANDLE;
+    VkExtent2D                              extent              = {};
+    bool                                    isSwapchain         = false;        // presented, otherwise offscreen
+    VkBuffer                                copyBuffer          = VK_NULL_HANDLE;   // offscreen, the color attachment is copied in here at the end of the frame
+} RenderTarget;
+
+typedef struct MemoryAllocation {
+    VkDeviceMemory                          memory              = VK_NULL_HANDLE;
+    VkDeviceSize                            offset              = 0;
+    VkDeviceSize                            size                = 0;
+    uint32_t                                memoryTypeIndex     = 0;
+    void*                                   pMappedData         = nullptr;      // persistently mapped when host visible
+    MemoryBlock*                            block               = nullptr;      // null when the allocation has its own VkDeviceMemory
+} MemoryAllocation;
+
+typedef struct BufferAllocation {
+    VkBuffer                                buffer              = VK_NULL_HANDLE;
+    VkDeviceSize                            size                = 0;
+    MemoryAllocation                        memory;
+} BufferAllocation;
+
+typedef struct TransferBatch {
+    VkCommandBuffer                         transferCommandBuffer;          // copies, recorded for queue->transfer
+    VkCommandBuffer                         graphicsCommandBuffer;          // ownership acquire, layout changes and blits on queue->graphics
+    VkSemaphore                             transferFinishedSemaphore;
+    VkFence                                 fence;                          // signaled when the graphics half has finished
+    uint64_t                                ringHead;                       // upload ring head at submit, becomes the tail once retired
+    bool                                    isRecording         = false;
+    bool                                    isInFlight          = false;
+    std::vector<std::function<void()>>      onSubmitList;                   // run right after submission
+    std::vector<std::function<void()>>      onCompleteList;                 // run once the fence has signaled
+} TransferBatch;
+
+typedef struct MipLevelData {
+    uint32_t                                width;
+    uint32_t                                height;
+    size_t                                  offset;                         // offset into tailPixels
+    size_t                                  size;
+} MipLevelData;
+
+typedef struct VulkronTexture_T {
+    std::string                             filePath;
+    VkFormat                                format;
+    VulkronTextureState                     state               = VULKRON_TEXTURE_STATE_PENDING;
+    uint32_t                                width               = 0;
+    uint32_t                                height              = 0;
+    bool                                    generateMipmaps     = true;
+    uint32_t                                mipLevels           = 1;
+    uint32_t                                tailMipLevel        = 0;            // first mip level that was built on the cpu
+    uint32_t                                imageMipOffset      = 0;            // mip level held in image level 0, tailMipLevel once demoted
+    uint32_t                                residentMipLevel    = UINT32_MAX;   // most detailed mip level that can be sampled
+    uint32_t                                baseRowsUploaded    = 0;
+    std::vector<uint8_t>                    basePixels;                     // level 0, freed once uploaded
+    std::vector<uint8_t>                    tailPixels;                     // levels tailMipLevel.. mipLevels - 1
+    std::vector<MipLevelData>               tailMipList;
+    VkImage                                 image               = VK_NULL_HANDLE;
+    MemoryAllocation                        memory;
+    VkImageView                             view                = VK_NULL_HANDLE;
+    VkImage                                 previousImage       = VK_NULL_HANDLE;   // demoted image, sampled until the promoted one is resident
+    MemoryAllocation                        previousMemory;
+    std::atomic<uint64_t>                   lastUsedFrame       { 0 };
+    PFN_vulkronTextureResidencyCallback     pfnResidencyCallback = nullptr;
+    void*                                   pUserData           = nullptr;
+    bool                                    isDecoding          = false;        // a worker thread is decoding its file
+    bool                                    destroyRequested    = false;
+} TextureInternal;
+
+// What a worker thread decoded, copied into the texture on the render thread
+typedef struct DecodedTexture {
+    TextureInternal*                        texture;
+    bool                                    isFailed            = false;
+    uint32_t                                width               = 0;
+    uint32_t                                height              = 0;
+    uint32_t                                mipLevels           = 1;
+    uint32_t                                tailMipLevel        = 0;
+    std::vector<uint8_t>                    basePixels;
+    std::vector<uint8_t>                    tailPixels;
+    std::vector<MipLevelData>               tailMipList;
+} DecodedTexture;
+
+typedef struct FrameDeletion {
+    uint64_t                                frameNumber;                    // frame the resource was last used in
+    std::function<void()>                   destroy;
+} FrameDeletion;
+
+typedef struct MappedFile {
+    const uint8_t*                          pData               = nullptr;      // read only view of the whole file
+    size_t                                  size                = 0;
+} MappedFile;
 
-typedef struct CommandBufferData {
-    threadDataMap                           threadBuffersMap;               // dynamic command buffers
-    VkCommandBuffer                         primaryBuffer;
-    VkCommandBuffer                         secondaryStaticBuffer;
-    std::vector<VulkronBaseObject>          staticObjectsList;              // static objects to draw on screen
-    std::vector<VulkronBaseObject>          dynamicObjectsList;             // dynamic objects to draw on screen
-} CommandBufferData;
+typedef struct VulkronMesh_T {
+    std::string                             filePath;
+    VulkronMeshState                        state               = VULKRON_MESH_STATE_PENDING;
+    MappedFile                              file;                           // unmapped once everything is in staging memory
+    VulkronMeshFileHeader                   header              = {};
+    std::vector<VulkronMeshFileLod>         lodList;
+    VkIndexType                             indexType           = VK_INDEX_TYPE_UINT32;
+    BufferAllocation                        vertexBuffer;
+    BufferAllocation                        indexBuffer;
+    VkDeviceSize                            vertexBytesUploaded = 0;
+    VkDeviceSize                            indexBytesUploaded  = 0;
+    std::atomic<uint64_t>                   lastUsedFrame       { 0 };          // written by the culling threads
+    uint64_t                                evictedFrame        = 0;
+    bool                                    isLoading           = false;        // owned by a worker thread while set
+    bool                                    destroyRequested    = false;
+} MeshInternal;
 
 // ---------------------------------- 
 // Internal Structs -----------------
@@ -112,8 +438,19 @@ typedef struct DeviceInternal {
     VkDevice								logicalDevice;					// applications view of the device
     VkPhysicalDeviceProperties				gpuProperties;					// The properties of the GPU, that includes the limits that the application can check against
     VkPhysicalDeviceMemoryProperties		gpuMemoryProperties;			// Memory types and heaps of the physical device
-    std::vector<const char*>				supportedExtensionsList;		// logical device supported extensions
+    std::vector<std::string>				supportedExtensionsList;		// logical device supported extensions
     QueueFamily								queuefamily;
+    bool                                    hasDrawIndirectCount            = false;    // VK_KHR_draw_indirect_count enabled
+    bool                                    hasMemoryBudget                 = false;    // VK_EXT_memory_budget enabled
+    bool                                    hasTimelineSemaphore            = false;    // vulkan 1.2 timelineSemaphore enabled
+    bool                                    hasDescriptorIndexing           = false;    // vulkan 1.2 descriptorIndexing enabled
+    bool                                    hasBufferDeviceAddress          = false;    // vulkan 1.2 bufferDeviceAddress enabled
+    bool                                    hasDynamicRendering             = false;    // vulkan 1.3 dynamicRendering enabled, no render pass or framebuffers
+    bool                                    hasSynchronization2             = false;    // vulkan 1.3 synchronization2 enabled
+    bool                                    hasCalibratedTimestamps         = false;    // VK_EXT_calibrated_timestamps enabled, only asked for when tracing
+    PFN_vkCmdDrawIndexedIndirectCount       pfnCmdDrawIndexedIndirectCount  = nullptr;
+    PFN_vkGetCalibratedTimestampsEXT        pfnGetCalibratedTimestamps      = nullptr;
+    std::vector<VulkronGpuCandidate>        gpuCandidateList;                           // every gpu vulkronCreateDevice considered
 } DeviceInternal;
 
 typedef struct SwapchainInternal {
@@ -124,6 +461,10 @@ typedef struct SwapchainInternal {
     uint32_t								imageCount;
     VkFormat								swapChainImageFormat;
     std::vector<SwapchainBuffers>			bufferList;
+    VkFormat                                depthFormat;
+    VkImage                                 depthImage          = VK_NULL_HANDLE;
+    MemoryAllocation                        depthMemory;
+    VkImageView                             depthView           = VK_NULL_HANDLE;
 } SwapchainInternal;
 
 typedef struct RenderPassInternal {
@@ -139,6 +480,480 @@ typedef struct DrawInternal {
     std::vector<VkSemaphore>				renderFinishedSemaphores;	    // Present an image
     std::vector<VkFence>					inFlightFences;
     std::vector<VkFence>					imagesInFlight;
+    std::vector<FrameContext>               frameContextList;               // indexed by frame in flight, reset once its fence has signaled
+    std::deque<FrameDeletion>               deletionQueue;
 } DrawInternal;
 
+typedef struct UploadRing {
+    BufferAllocation                        staging;
+    uint8_t*                                pMappedData;
+    VkDeviceSize                            alignment;
+    uint64_t                                head;                           // virtual offsets, physical offset is (offset % staging.size)
+    uint64_t                                tail;
+} UploadRing;
+
+typedef struct PendingUpload {
+    VkBuffer                                buffer;
+    VkDeviceSize                            offset;
+    VkDeviceSize                            size;
+    size_t                                  dataOffset;                     // into pendingUploadData
+} PendingUpload;
+
+typedef struct TransferInternal {
+    VkCommandPool                           transferCommandPool;
+    VkCommandPool                           graphicsCommandPool;
+    std::vector<TransferBatch>              batchList;
+    uint32_t                                currentBatch;
+    std::deque<uint32_t>                    inFlightBatchList;              // submission order
+    VkDeviceSize                            frameBudget         = 32 * 1024 * 1024;    // bytes copied per frame before uploads wait for the next frame
+    VkDeviceSize                            frameBytesRecorded;
+    std::vector<PendingUpload>              pendingUploadList;              // in the order they were written
+    std::vector<uint8_t>                    pendingUploadData;
+    VulkronUploadBatchInfo                  uploadBatchInfo     = {};       // this frame so far
+    VulkronUploadBatchInfo                  lastUploadBatchInfo = {};
+} TransferInternal;
+
+typedef struct TextureStreamingInternal {
+    std::mutex                              decodedMutex;
+    std::vector<DecodedTexture>             decodedList;                    // filled by worker threads
+    std::deque<TextureInternal*>            tailQueue;                      // small mips, every texture gets these first
+    std::deque<TextureInternal*>            baseQueue;                      // full resolution, streamed in row chunks
+    std::vector<TextureInternal*>           textureList;
+} TextureStreamingInternal;
+
+typedef struct BvhNode {                                                    // 32 bytes, two to a cache line
+    glm::vec3                               boundsMin           = glm::vec3(0.0f);
+    uint32_t                                first               = 0;            // left child for inner nodes (right is first + 1), first item for leaves
+    glm::vec3                               boundsMax           = glm::vec3(0.0f);
+    uint32_t                                count               = 0;            // 0 for inner nodes
+} BvhNode;
+
+typedef struct BvhBuildItem {
+    glm::vec3                               boundsMin;
+    glm::vec3                               boundsMax;
+    glm::vec3                               center;
+    glm::vec4                               sphere;
+    VulkronObjectHandle                     handle;
+} BvhBuildItem;
+
+typedef struct BvhHit {
+    uint32_t                                item;                           // into Bvh::itemList
+    bool                                    isInside;                       // the whole leaf is inside the frustum
+} BvhHit;
+
+typedef struct Bvh {
+    std::vector<BvhNode>                    nodeList;                       // depth first, children come after their parent
+    std::vector<VulkronObjectHandle>        itemList;                       // leaves point at ranges of it
+    std::vector<glm::vec4>                  sphereList;                     // world space bounds per item, negative radius once removed
+    float                                   builtCost           = 0.0f;     // SAH cost right after the build
+} Bvh;
+
+typedef struct VisibilityCandidate {
+    VulkronObjectHandle                     handle;
+    VulkronBaseObject*                      pObject;
+    const glm::vec4*                        pSphere;                        // cached in the tree, null for objects tested one by one
+    bool                                    isInside;                       // frustum test already passed for the whole leaf
+    bool                                    isStatic;
+} VisibilityCandidate;
+
+typedef struct CullingInternal {
+    VulkronCamera                           camera              = {};
+    glm::vec3                               cameraPosition;
+    bool                                    hasCamera           = false;        // nothing is culled and lod 0 is drawn until a camera is set
+    glm::vec4                               frustumPlaneList[6];
+    float                                   lodBias             = 0.0f;
+    float                                   lodPixelError       = 1.0f;         // error allowed on screen at bias 0
+    float                                   lodHysteresis       = 0.25f;        // fraction the error has to move past the threshold before switching
+    Bvh                                     staticBvh;
+    Bvh                                     dynamicBvh;                     // refit every frame, rebuilt when objects are added
+    std::vector<VulkronObjectHandle>        staticLinearList;               // no bounds when the tree was built or never frustum culled
+    std::vector<VulkronObjectHandle>        dynamicLinearList;
+    uint64_t                                staticVersion       = UINT64_MAX;   // scene versions the trees were built from
+    uint64_t                                dynamicVersion      = UINT64_MAX;
+    uint64_t                                nextStaticBuildFrame = 0;       // objects whose mesh loaded since wait for this frame to join the tree
+    bool                                    hasPendingStatic    = false;
+    std::vector<BvhHit>                     hitList;                        // scratch
+    std::vector<VisibilityCandidate>        candidateList;                  // scratch
+    std::vector<uint32_t>                   visibleStaticList;              // indices into the object lists, valid until the scene changes
+    std::vector<uint32_t>                   visibleDynamicList;
+    std::vector<VulkronObjectHandle>        previousVisibleList;            // marked culled again before the next pass
+} CullingInternal;
+
+typedef struct MeshStreamingInternal {
+    std::mutex                              mappedMutex;
+    std::vector<MeshInternal*>              mappedList;                     // filled by worker threads
+    std::deque<MeshInternal*>               uploadQueue;
+    std::vector<MeshInternal*>              meshList;
+} MeshStreamingInternal;
+
+typedef struct OcclusionObject {                                            // std430, matches Shaders/occlusion_cull.comp
+    glm::vec4                               sphere;                         // world space center and radius
+    uint32_t                                indexCount;
+    uint32_t                                instanceCount;
+    uint32_t                                firstIndex;
+    uint32_t                                drawGroup;
+    uint32_t                                commandIndex;                   // slot used when draws can't be compacted
+    uint32_t                                groupFirstCommand;              // compacted draws are appended from here
+    uint32_t                                padding[2];
+} OcclusionObject;
+
+typedef struct OcclusionDrawGroup {                                         // objects sharing a pipeline and mesh, one indirect draw
+    VkPipeline                              pipeline;
+    MeshInternal*                           mesh;
+    uint32_t                                firstCommand;
+    uint32_t                                commandCount;
+} OcclusionDrawGroup;
+
+typedef struct OcclusionFrame {
+    BufferAllocation                        objectBuffer;                   // host visible, written every frame
+    BufferAllocation                        commandBuffer;                  // VkDrawIndexedIndirectCommand, written by the cull shader
+    BufferAllocation                        countBuffer;                    // one draw count per group
+    uint32_t                                capacity            = 0;
+    uint32_t                                objectCount         = 0;
+    VkDescriptorSet                         cullSet             = VK_NULL_HANDLE;
+    std::vector<OcclusionDrawGroup>         drawGroupList;
+} OcclusionFrame;
+
+typedef struct OcclusionInternal {
+    bool                                    isEnabled           = false;
+    bool                                    isCompacting        = false;        // draw indirect count and multi draw indirect are available
+    bool                                    hasDepthHistory     = false;        // the depth attachment holds a rendered frame
+    glm::mat4                               previousViewProjection;          // camera the depth attachment was rendered with
+    VkDescriptorSetLayout                   reduceSetLayout     = VK_NULL_HANDLE;
+    VkDescriptorSetLayout                   cullSetLayout       = VK_NULL_HANDLE;
+    VkPipelineLayout                        reducePipelineLayout = VK_NULL_HANDLE;
+    VkPipelineLayout                        cullPipelineLayout  = VK_NULL_HANDLE;
+    VkPipeline                              reducePipeline      = VK_NULL_HANDLE;
+    VkPipeline                              cullPipeline        = VK_NULL_HANDLE;
+    VkDescriptorPool                        descriptorPool      = VK_NULL_HANDLE;
+    VkSampler                               sampler             = VK_NULL_HANDLE;   // nearest, the shaders take the max themselves
+    VkImage                                 pyramidImage        = VK_NULL_HANDLE;   // transient, only alive in TRANSIENT_PASS_OCCLUSION
+    VkImageView                             pyramidView         = VK_NULL_HANDLE;   // every mip, sampled by the cull shader
+    std::vector<VkImageView>                pyramidMipViewList;
+    std::vector<VkDescriptorSet>            reduceSetList;                  // one per mip level
+    uint32_t                                pyramidWidth        = 0;
+    uint32_t                                pyramidHeight       = 0;
+    std::vector<OcclusionFrame>             frameList;                      // one per frame in flight
+    std::vector<const VulkronBaseObject*>   objectList;                     // scratch, sorted into draw groups
+} OcclusionInternal;
+
+typedef struct VulkronComputePipeline_T {
+    VkPipeline                              pipeline            = VK_NULL_HANDLE;
+    VkPipelineLayout                        layout              = VK_NULL_HANDLE;
+    VkShaderStageFlags                      pushConstantStages  = 0;
+    bool                                    isLayoutCached      = false;        // reflected, the layout cache owns the layout
+} ComputePipelineInternal;
+
+typedef struct ComputeDispatch {
+    ComputePipelineInternal*                pipeline;
+    std::vector<VkDescriptorSet>            descriptorSetList;
+    std::vector<uint8_t>                    pushConstants;                  // copied when queued
+    uint32_t                                groupCountX;
+    uint32_t                                groupCountY;
+    uint32_t                                groupCountZ;
+} ComputeDispatch;
+
+typedef struct ComputeSubmission {                                          // one per frame in flight
+    VkCommandBuffer                         commandBuffer       = VK_NULL_HANDLE;
+    uint64_t                                timelineValue       = 0;            // compute timeline value signaled when it finished
+} ComputeSubmission;
+
+typedef struct ComputeInternal {
+    bool                                    isAsync             = false;        // dedicated compute family and timeline semaphores
+    VkCommandPool                           commandPool         = VK_NULL_HANDLE;
+    std::vector<ComputeSubmission>          submissionList;
+    VkSemaphore                             computeTimeline     = VK_NULL_HANDLE;
+    VkSemaphore                             graphicsTimeline    = VK_NULL_HANDLE;
+    uint64_t                                computeValue        = 0;            // last value signaled by a compute submit
+    uint64_t                                graphicsValue       = 0;            // last value signaled by a frame submit
+    std::vector<ComputeDispatch>            pendingList;                    // queued since the last submit
+    VkPipelineStageFlags                    pendingWaitStage    = 0;
+    bool                                    pendingWaitForGraphics = false;
+    VkPipelineStageFlags                    graphicsWaitStage   = 0;            // handed to the next frame submit
+} ComputeInternal;
+
+typedef struct EvictionCandidate {
+    uint64_t                                lastUsedFrame;
+    std::array<MemoryAllocation, 2>         memoryList;                         // what the eviction releases, the second one only for meshes
+    uint32_t                                heapIndex;
+    TextureInternal*                        texture             = nullptr;      // one of texture or mesh is set
+    MeshInternal*                           mesh                = nullptr;
+} EvictionCandidate;
+
+typedef struct MemoryBudgetInternal {
+    VulkronMemoryBudgetInfo                 info;
+    std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS>  engineUsageList {};   // allocateMemory and freeMemory run on any thread
+    std::array<VulkronMemoryHeapBudget, VK_MAX_MEMORY_HEAPS>    heapList        {};
+    VulkronMemoryPressure                   pressure            = VULKRON_MEMORY_PRESSURE_NONE;     // worst device local heap
+    uint64_t                                nextEvictionFrame   = 0;            // frees are deferred, evicting again before then double counts
+} MemoryBudgetInternal;
+
+typedef struct MemoryBlock {
+    VkDeviceMemory                          memory              = VK_NULL_HANDLE;
+    VkDeviceSize                            size                = 0;
+    VkDeviceSize                            usedSize            = 0;
+    uint32_t                                memoryTypeIndex     = 0;
+    void*                                   pMappedData         = nullptr;      // the whole block, mapped when host visible
+    bool                                    isMovable           = false;        // only holds resources defragmentation can relocate
+    bool                                    isDraining          = false;        // being emptied, nothing new is placed in it
+    std::map<VkDeviceSize, VkDeviceSize>    freeRangeMap;                   // offset to size, neighbours are merged on free
+} MemoryBlock;
+
+typedef struct MemoryAllocatorInternal {
+    std::mutex                              mutex;
+    std::vector<std::unique_ptr<MemoryBlock>>   blockList;
+    MemoryBlock*                            drainingBlock       = nullptr;
+    uint64_t                                drainProgressFrame  = 0;            // last frame something was moved out of drainingBlock
+} MemoryAllocatorInternal;
+
+typedef struct TransientImage {
+    VkImage                                 image               = VK_NULL_HANDLE;
+    TransientHeap*                          heap                = nullptr;
+    VkDeviceSize                            offset              = 0;            // from the start of the heap
+    VkDeviceSize                            size                = 0;
+    TransientPass                           firstPass;
+    TransientPass                           lastPass;
+    VkPipelineStageFlags                    stageMask;                      // every stage and access it's used with
+    VkAccessFlags                           accessMask;
+} TransientImage;
+
+typedef struct TransientHeap {
+    MemoryAllocation                        memory;
+    std::vector<TransientImage*>            imageList;
+} TransientHeap;
+
+typedef struct TransientInternal {
+    std::vector<std::unique_ptr<TransientHeap>>     heapList;
+    std::vector<std::unique_ptr<TransientImage>>    imageList;
+} TransientInternal;
+
+typedef struct ObjectSlot {
+    uint32_t                                generation          = 1;            // bumped on remove, stale handles stop matching
+    uint32_t                                objectIndex         = 0;            // into the object list, next free slot while unused
+    bool                                    isStatic            = false;
+    bool                                    isUsed              = false;
+} ObjectSlot;
+
+typedef struct SceneInternal {
+    std::vector<VulkronBaseObject>          staticObjectsList;              // dense, what culling and recording walk every frame
+    std::vector<VulkronBaseObject>          dynamicObjectsList;
+    std::vector<uint32_t>                   staticSlotList;                 // slot of each object, parallel to the object lists
+    std::vector<uint32_t>                   dynamicSlotList;
+    std::vector<ObjectSlot>                 slotList;
+    uint32_t                                freeSlot            = UINT32_MAX;   // head of the free list threaded through objectIndex
+    uint64_t                                staticVersion       = 0;            // bumped when static objects are added or moved, the static tree is rebuilt
+    uint64_t                                dynamicVersion      = 0;            // bumped when dynamic objects are added
+} SceneInternal;
+
+typedef struct ShadowDraw {
+    glm::mat4                               matrix;                         // cascade view projection * model * dequantize
+    MeshInternal*                           mesh;
+    uint32_t                                firstIndex;
+    uint32_t                                indexCount;
+    uint32_t                                instanceCount;
+} ShadowDraw;
+
+typedef struct ShadowCascade {
+    glm::mat4                               viewProjection      = glm::mat4(1.0f);
+    glm::vec4                               planeList[6];
+    glm::vec4                               sphere;                         // world space, covers the camera frustum slice
+    glm::vec3                               lightCenter;                    // snapped center in light space
+    float                                   halfExtent          = 0.0f;
+    float                                   texelSize           = 0.0f;         // world space, picks the caster lods
+    float                                   splitDistance       = 0.0f;
+    bool                                    isActive            = false;        // a visible receiver overlaps the slice
+    bool                                    isStaticStale       = false;        // the cached layer is redrawn this frame
+    uint64_t                                staticKey           = 0;            // what the cached layer was drawn with, 0 before the first draw
+    std::vector<ShadowDraw>                 staticDrawList;                 // only kept while the cached layer is stale
+    std::vector<ShadowDraw>                 dynamicDrawList;
+    std::vector<BvhHit>                     hitList;                        // scratch, cascades are gathered in parallel
+    VkImageView                             staticView          = VK_NULL_HANDLE;
+    VkImageView                             shadowView          = VK_NULL_HANDLE;
+    VkFramebuffer                           staticFrameBuffer   = VK_NULL_HANDLE;   // without dynamic rendering only
+    VkFramebuffer                           shadowFrameBuffer   = VK_NULL_HANDLE;
+} ShadowCascade;
+
+typedef struct ShadowInternal {
+    bool                                    isEnabled           = false;
+    VulkronShadowCreateInfo                 info;
+    glm::vec3                               lightDirection      = glm::vec3(0.0f, -1.0f, 0.0f);
+    bool                                    hasDepthClamp       = false;        // casters towards the light are flattened instead of clipped
+    VkImage                                 staticImage         = VK_NULL_HANDLE;   // static casters only, kept from frame to frame
+    MemoryAllocation                        staticMemory;
+    VkImage                                 shadowImage         = VK_NULL_HANDLE;   // transient, static layer copied in and dynamic casters drawn on top
+    VkImageView                             shadowView          = VK_NULL_HANDLE;   // every layer, what the main pass samples
+    VkSampler                               sampler             = VK_NULL_HANDLE;
+    VkRenderPass                            clearRenderPass     = VK_NULL_HANDLE;   // without dynamic rendering only
+    VkRenderPass                            loadRenderPass      = VK_NULL_HANDLE;
+    VkPipelineLayout                        pipelineLayout      = VK_NULL_HANDLE;
+    VkPipeline                              pipelineList[2]     = {};           // indexed by VulkronMeshVertexFormat
+    uint32_t                                activeCascadeMask   = 0;
+    std::array<ShadowCascade, VULKRON_MAX_SHADOW_CASCADES>  cascadeList;
+} ShadowInternal;
+
+typedef struct AsyncOperation {
+    std::shared_ptr<VulkronAsyncState>      state;
+    std::function<bool()>                   poll;                           // completes the state and returns true once the load is done
+} AsyncOperation;
+
+typedef struct AsyncWaiter {
+    std::shared_ptr<VulkronAsyncState>      state;
+    std::coroutine_handle<>                 handle;
+} AsyncWaiter;
+
+typedef struct AsyncInternal {
+    std::vector<AsyncOperation>             operationList;
+    std::vector<AsyncWaiter>                waiterList;
+    std::vector<std::coroutine_handle<VulkronTask<void>::promise_type>> taskList;  // spawned tasks, destroyed once they return
+} AsyncInternal;
+
+typedef struct ReflectedBinding {
+    uint32_t                                set;
+    uint32_t                                binding;
+    VkDescriptorType                        type;
+    uint32_t                                count;
+} ReflectedBinding;
+
+typedef struct ShaderReflection {
+    std::vector<ReflectedBinding>           bindingList;
+    uint32_t                                pushConstantOffset  = 0;
+    uint32_t                                pushConstantSize    = 0;            // 0 without a push constant block
+    std::vector<VkVertexInputAttributeDescription>  inputList;              // binding 0, offset is the attribute's size
+    uint64_t                                codeId              = 0;            // identical SPIR-V gives the same id, never 0
+    size_t                                  codeHash            = 0;            // bucket of codeMap the code is in
+    std::map<uint32_t, uint32_t>            specConstantSizeMap;                // SpecId -> size in bytes, bools are a VkBool32
+    std::string                             error;                              // why the module can't be reflected, empty if it can
+} ShaderReflection;
+
+struct LayoutKeyHash {
+    size_t operator()(const std::vector<uint32_t>& key) const;
+};
+
+// Non dispatchable handles are pointers or 64 bit integers depending on the platform
+template<typename Handle>
+inline void appendHandle(std::vector<uint32_t>& key, Handle handle) {
+
+    uint64_t value = 0;
+    memcpy(&value, &handle, std::min(sizeof(handle), sizeof(value)));
+
+    key.push_back(static_cast<uint32_t>(value));
+    key.push_back(static_cast<uint32_t>(value >> 32));
+}
+
+// The code of live modules, compared when a new module lands in the same bucket
+typedef struct ShaderCode {
+    std::vector<uint32_t>                   code;
+    uint64_t                                id;
+    uint32_t                                moduleCount;
+} ShaderCode;
+
+typedef struct LayoutCacheInternal {
+    std::mutex                              mutex;                          // compute pipelines are built on worker threads too
+    std::unordered_map<VkShaderModule, ShaderReflection>    reflectionMap;
+    std::unordered_map<size_t, std::vector<ShaderCode>>     codeMap;        // by the hash of the code, an entry goes with its last module
+    uint64_t                                nextCodeId          = 1;            // ids aren't reused, pipeline keys outlive the modules
+    std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, LayoutKeyHash>   setLayoutMap;     // keyed by the full description
+    std::unordered_map<std::vector<uint32_t>, VkPipelineLayout, LayoutKeyHash>        pipelineLayoutMap;
+} LayoutCacheInternal;
+
+typedef struct ShaderPermutation {
+    VkSpecializationInfo                    specializationInfo  = {};          // points into the two lists below
+    std::vector<VkSpecializationMapEntry>   mapEntryList;
+    std::vector<uint32_t>                   dataList;
+} ShaderPermutation;
+
+typedef struct GraphicsPipelineCacheInternal {
+    VkPipelineCache                         pipelineCache       = VK_NULL_HANDLE;   // shared by every compile so variants can reuse the driver's work
+    std::unordered_map<std::vector<uint32_t>, VkPipeline, LayoutKeyHash>  pipelineMap;     // keyed by the canonical state
+    std::unordered_map<std::vector<uint32_t>, VkPipeline, LayoutKeyHash>  baseMap;         // shaders, layout and attachments, first pipeline built with them
+    bool                                    hasRenderPass       = false;        // set by the first vulkronCreateGraphicsPipeline
+    std::unordered_map<std::string, VkShaderModule>                       shaderPathMap;   // every file vulkronCreatePipelineShaderStage loaded
+    std::unordered_map<std::vector<uint32_t>, ShaderPermutation, LayoutKeyHash>  permutationMap;  // module and constant values, nodes never move
+} GraphicsPipelineCacheInternal;
+
+typedef struct PendingReadback {
+    VulkronReadbackTicket                   ticket;
+    VkBuffer                                buffer              = VK_NULL_HANDLE;   // a buffer read, otherwise an image
+    VkDeviceSize                            bufferOffset        = 0;
+    VulkronImageReadbackInfo                image;
+    VkDeviceSize                            size;
+    VkDeviceSize                            ringOffset          = 0;            // set once recorded
+} PendingReadback;
+
+typedef struct ReadbackInternal {
+    UploadRing                              ring;                           // same ring as uploads, the gpu writes and the cpu reads
+    bool                                    isCoherent          = true;
+    uint64_t                                nextTicket          = 1;
+    std::deque<PendingReadback>             pendingList;                    // copied by the next frame that has room
+    std::vector<std::vector<PendingReadback>>   frameList;                  // per frame in flight, recorded into it
+    std::vector<uint64_t>                   frameRingHead;                  // ring head after the frame recorded, the tail once it's done
+    std::unordered_map<VulkronReadbackTicket, std::vector<uint8_t>> resultMap;     // finished, until the caller takes them
+    bool                                    canReadSwapchain    = false;
+} ReadbackInternal;
+
+typedef struct BatchJob {
+    uint64_t                                jobIndex;
+    VulkronBatchJob                         job;
+} BatchJob;
+
+typedef struct BatchFrame {                                                 // the offscreen target of one frame in flight
+    MemoryAllocation                        colorMemory;
+    MemoryAllocation                        depthMemory;
+    BufferAllocation                        copyBuffer;                     // host visible, cached when the device has it
+    bool                                    isCoherent          = true;
+    bool                                    isInFlight          = false;        // rendered, not yet handed to a writer
+    BatchJob                                job;
+} BatchFrame;
+
+typedef struct BatchInternal {
+    bool                                    isCreated           = false;
+    VkExtent2D                              extent              = {};
+    bool                                    isBgra              = false;        // swapped to RGBA on the writer threads
+    uint32_t                                maxPendingWrites    = 0;
+    std::vector<RenderTarget>               targetList;                     // indexed by frame in flight
+    std::vector<BatchFrame>                 frameList;
+    std::deque<BatchJob>                    jobList;                        // queued, rendered by the next vulkronRunBatchJobs
+    uint64_t                                nextJobIndex        = 0;
+    uint32_t                                imageCount          = 0;        // handed to the writers this run
+    double                                  writerWaitSeconds   = 0.0;
+    std::mutex                              writeMutex;                     // guards the two counts below, writers finish on worker threads
+    std::condition_variable                 writeCondition;
+    uint32_t                                pendingWriteCount   = 0;
+    uint32_t                                failedWriteCount    = 0;
+} BatchInternal;
+
+typedef struct StatisticsFrame {                                            // the queries of one frame in flight
+    bool                                    isRecorded          = false;        // queries were written, results pending
+    uint64_t                                frameNumber         = 0;
+    uint32_t                                statisticsPassMask  = 0;        // passes with a pipeline statistics query, by VulkronFramePass bit
+    uint32_t                                occlusionPassMask   = 0;
+    double                                  cpuFrameMilliseconds    = 0.0;
+    double                                  cpuRecordMilliseconds   = 0.0;
+    std::chrono::steady_clock::time_point   recordStart;
+    VkExtent2D                              extent              = {};
+} StatisticsFrame;
+
+typedef struct StatisticsInternal {
+    bool                                    isEnabled           = false;
+    VkQueryPool                             timestampPool       = VK_NULL_HANDLE;   // two per pass and frame in flight
+    VkQueryPool                             pipelineStatisticsPool  = VK_NULL_HANDLE;   // one per pass and frame in flight
+    VkQueryPool                             occlusionPool       = VK_NULL_HANDLE;
+    bool                                    hasInheritedQueries = false;        // queries can stay active over the main pass' secondaries
+    uint64_t                                timestampMask       = 0;        // timestampValidBits of the graphics family
+    double                                  timestampPeriod     = 0.0;      // nanoseconds per tick
+    std::vector<StatisticsFrame>            frameList;
+    std::chrono::steady_clock::time_point   lastRecordStart;
+    bool                                    hasResult           = false;
+    VulkronFrameStatistics                  result              = {};       // the last frame that was read back
+} StatisticsInternal;
 
+#ifdef VULKRON_TRACING
+typedef struct TraceInternal {
+    std::mutex                              ringMutex;                      // only taken when a thread writes its first event, and by dumps
+    std::vector<std::unique_ptr<TraceRing>> ringList;                       // kept after their thread exits, its last events are still dumped
+    TraceRing                               gpuRing;                        // the graphics queue, written on the render thread as frame statistics come back
+    bool                                    hasGpuCalibration   = false;
+    int64_t                                 gpuCalibrationTime  = 0;        // trace clock time of gpuCalibrationTicks
+    uint64_t                                gpuCalibrationTicks = 0;
+} TraceInternal;
+#endif // VULKRON_TRACING
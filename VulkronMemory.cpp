@@ -1,10 +1,31 @@
-#pragma once
-
 #include "VulkronInternal.h"
 
-static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags);
+MemoryBudgetInternal*       memoryBudget        = new MemoryBudgetInternal();
+MemoryAllocatorInternal*    memoryAllocator     = new MemoryAllocatorInternal();
+
+static const float                          FALLBACK_BUDGET_FRACTION    = 0.8f;     // share of a heap assumed usable without VK_EXT_memory_budget
+static const float                          EVICTION_HEADROOM           = 0.05f;    // evicts this far below evictionThreshold so it doesn't run every frame
+static const VkDeviceSize                   BLOCK_SIZE                  = 64 * 1024 * 1024;
+static const float                          DEFRAGMENT_THRESHOLD        = 0.5f;     // movable blocks used less than this are drained
+
+static void allocateDedicatedMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryPropertyFlags propertyFlags, MemoryAllocation* allocation);
+static VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex);
+static void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, bool isMapped);
+static VkDeviceSize getBlockSize(uint32_t memoryTypeIndex);
+static MemoryBlock* createMemoryBlock(uint32_t memoryTypeIndex, bool isMovable);
+static bool allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset);
+static void releaseToBlock(MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size);
+static void updateDefragmentation();
+static MemoryBlock* getDrainCandidate();
+static VulkronMemoryPressure getPressure(const VulkronMemoryHeapBudget& heap);
+static void evictLeastRecentlyUsed();
+static VkDeviceSize getReturnedSize(const MemoryAllocation& allocation, std::map<const MemoryBlock*, VkDeviceSize>& releasedMap);
+
+//-------------------------------------------------------------------------------------
+// SECTION [MEMORY] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
 
-static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) {
+uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags propertyFlags) {
 
     for (uint32_t i = 0; i < deviceInternal->gpuMemoryProperties.memoryTypeCount; i++) {
 
@@ -20,4 +41,553 @@ static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags proper
     }
 
     throw std::runtime_error("failed to find suitable memory type!");
-}
\ No newline at end of file
+}
+
+// Every bit of a usage asks for its property, cached memory is only ever host visible
+VkMemoryPropertyFlags getMemoryPropertyFlags(VulkronMemoryUsage usage) {
+
+    VkMemoryPropertyFlags propertyFlags = 0;
+
+    if (usage & VULKRON_MEMORY_USAGE_GPU_STORAGE) {
+        propertyFlags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    }
+    if (usage & VULKRON_MEMORY_USAGE_CPU_VISIBLE) {
+        propertyFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+    if (usage & VULKRON_MEMORY_USAGE_CPU_COHERENT) {
+        propertyFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+    if (usage & VULKRON_MEMORY_USAGE_CPU_CACHED) {
+        propertyFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    }
+
+    return propertyFlags;
+}
+
+// Makes gpu writes to [offset, offset + size) of a mapped allocation visible, only needed without HOST_COHERENT
+void invalidateMemory(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+
+    VkDeviceSize atomSize = deviceInternal->gpuProperties.limits.nonCoherentAtomSize;
+    VkDeviceSize begin = allocation.offset + offset;
+    VkDeviceSize end = begin + size;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin / atomSize * atomSize;
+    range.size = (end + atomSize - 1) / atomSize * atomSize - range.offset;
+
+    // past the allocation the rounded range could run off the memory object
+    if (range.offset + range.size > allocation.offset + allocation.size) {
+        range.size = VK_WHOLE_SIZE;
+    }
+
+    vkInvalidateMappedMemoryRanges(deviceInternal->logicalDevice, 1, &range);
+}
+
+// Small allocations are placed in shared blocks, anything over half a block gets its own VkDeviceMemory
+void allocateMemory(VkMemoryRequirements requirements, VkMemoryPropertyFlags propertyFlags, MemoryAllocation* allocation, bool isMovable) {
+
+    uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, propertyFlags);
+
+    if (requirements.size > getBlockSize(memoryTypeIndex) / 2) {
+        allocateDedicatedMemory(requirements.size, memoryTypeIndex, propertyFlags, allocation);
+        return;
+    }
+
+    // linear and optimal resources may share a block, keeping every offset on the granularity keeps them apart
+    VkDeviceSize alignment = std::max(requirements.alignment, deviceInternal->gpuProperties.limits.bufferImageGranularity);
+
+    std::lock_guard<std::mutex> lock(memoryAllocator->mutex);
+
+    MemoryBlock* block = nullptr;
+    VkDeviceSize offset = 0;
+
+    for (auto& candidate : memoryAllocator->blockList) {
+        if (candidate->memoryTypeIndex == memoryTypeIndex && candidate->isMovable == isMovable && !candidate->isDraining &&
+            allocateFromBlock(candidate.get(), requirements.size, alignment, &offset)) {
+            block = candidate.get();
+            break;
+        }
+    }
+
+    if (nullptr == block) {
+        block = createMemoryBlock(memoryTypeIndex, isMovable);
+        allocateFromBlock(block, requirements.size, alignment, &offset);
+    }
+
+    allocation->memory = block->memory;
+    allocation->offset = offset;
+    allocation->size = requirements.size;
+    allocation->memoryTypeIndex = memoryTypeIndex;
+    allocation->pMappedData = nullptr != block->pMappedData ? static_cast<uint8_t*>(block->pMappedData) + offset : nullptr;
+    allocation->block = block;
+}
+
+void freeMemory(MemoryAllocation* allocation) {
+    if (allocation->memory == VULKRON_NULL_HANDLE) {
+        return;
+    }
+
+    if (nullptr == allocation->block) {
+        freeDeviceMemory(allocation->memory, allocation->size, allocation->memoryTypeIndex, allocation->pMappedData != nullptr);
+        *allocation = {};
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(memoryAllocator->mutex);
+
+    MemoryBlock* block = allocation->block;
+    releaseToBlock(block, allocation->offset, allocation->size);
+
+    // empty blocks go straight back to the driver
+    if (block->usedSize == 0) {
+        if (memoryAllocator->drainingBlock == block) {
+            memoryAllocator->drainingBlock = nullptr;
+        }
+
+        freeDeviceMemory(block->memory, block->size, block->memoryTypeIndex, block->pMappedData != nullptr);
+
+        auto& blockList = memoryAllocator->blockList;
+        blockList.erase(std::remove_if(blockList.begin(), blockList.end(), [block](const std::unique_ptr<MemoryBlock>& candidate) {
+            return candidate.get() == block;
+        }), blockList.end());
+    }
+
+    *allocation = {};
+}
+
+static void allocateDedicatedMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkMemoryPropertyFlags propertyFlags, MemoryAllocation* allocation) {
+
+    allocation->memory = allocateDeviceMemory(size, memoryTypeIndex);
+    allocation->offset = 0;
+    allocation->size = size;
+    allocation->memoryTypeIndex = memoryTypeIndex;
+    allocation->pMappedData = nullptr;
+    allocation->block = nullptr;
+
+    // host visible memory stays mapped for its whole lifetime
+    if (propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(deviceInternal->logicalDevice, allocation->memory, 0, size, 0, &allocation->pMappedData) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+}
+
+static VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex) {
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryTypeIndex;
+
+    // any allocation may back a buffer whose address is read in a shader
+    VkMemoryAllocateFlagsInfo allocateFlags = {};
+    allocateFlags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    allocateFlags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+    if (deviceInternal->hasBufferDeviceAddress) {
+        allocateInfo.pNext = &allocateFlags;
+    }
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+
+    if (vkAllocateMemory(deviceInternal->logicalDevice, &allocateInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    uint32_t heapIndex = deviceInternal->gpuMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    memoryBudget->engineUsageList[heapIndex] += size;
+
+    return memory;
+}
+
+static void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, bool isMapped) {
+
+    if (isMapped) {
+        vkUnmapMemory(deviceInternal->logicalDevice, memory);
+    }
+
+    vkFreeMemory(deviceInternal->logicalDevice, memory, nullptr);
+
+    uint32_t heapIndex = deviceInternal->gpuMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    memoryBudget->engineUsageList[heapIndex] -= size;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [BLOCKS] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Small heaps like the host visible part of vram get smaller blocks so one block can't take most of it
+static VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) {
+    uint32_t heapIndex = deviceInternal->gpuMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    return std::min(BLOCK_SIZE, deviceInternal->gpuMemoryProperties.memoryHeaps[heapIndex].size / 8);
+}
+
+// Called with the allocator mutex held
+static MemoryBlock* createMemoryBlock(uint32_t memoryTypeIndex, bool isMovable) {
+
+    std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+    block->size = getBlockSize(memoryTypeIndex);
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->isMovable = isMovable;
+    block->memory = allocateDeviceMemory(block->size, memoryTypeIndex);
+    block->freeRangeMap[0] = block->size;
+
+    // mapped once for every allocation placed in it
+    if (deviceInternal->gpuMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(deviceInternal->logicalDevice, block->memory, 0, block->size, 0, &block->pMappedData) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+
+    memoryAllocator->blockList.push_back(std::move(block));
+
+    return memoryAllocator->blockList.back().get();
+}
+
+// First fit, the alignment padding in front of the allocation stays a free range of its own
+static bool allocateFromBlock(MemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* pOffset) {
+
+    if (block->size - block->usedSize < size) {
+        return false;
+    }
+
+    for (auto it = block->freeRangeMap.begin(); it != block->freeRangeMap.end(); ++it) {
+        VkDeviceSize rangeOffset = it->first;
+        VkDeviceSize rangeEnd = it->first + it->second;
+        VkDeviceSize offset = (rangeOffset + alignment - 1) / alignment * alignment;
+
+        if (offset + size > rangeEnd) {
+            continue;
+        }
+
+        block->freeRangeMap.erase(it);
+
+        if (offset > rangeOffset) {
+            block->freeRangeMap[rangeOffset] = offset - rangeOffset;
+        }
+        if (offset + size < rangeEnd) {
+            block->freeRangeMap[offset + size] = rangeEnd - (offset + size);
+        }
+
+        block->usedSize += size;
+        *pOffset = offset;
+
+        return true;
+    }
+
+    return false;
+}
+
+// Merges with the free ranges on either side so the block doesn't splinter
+static void releaseToBlock(MemoryBlock* block, VkDeviceSize offset, VkDeviceSize size) {
+
+    auto& freeRangeMap = block->freeRangeMap;
+    auto it = freeRangeMap.emplace(offset, size).first;
+
+    auto next = std::next(it);
+    if (next != freeRangeMap.end() && it->first + it->second == next->first) {
+        it->second += next->second;
+        freeRangeMap.erase(next);
+    }
+
+    if (it != freeRangeMap.begin()) {
+        auto previous = std::prev(it);
+        if (previous->first + previous->second == it->first) {
+            previous->second += it->second;
+            freeRangeMap.erase(it);
+        }
+    }
+
+    block->usedSize -= size;
+}
+
+// Only the blocks left at shutdown, everything placed in them has been freed by now
+void destroyMemoryBlocks() {
+
+    for (auto& block : memoryAllocator->blockList) {
+        freeDeviceMemory(block->memory, block->size, block->memoryTypeIndex, block->pMappedData != nullptr);
+    }
+
+    delete memoryAllocator;
+    memoryAllocator = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [DEFRAGMENTATION] ----------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Streamed textures and meshes live in movable blocks. The emptiest one is drained a few moves per frame,
+// every move copies the resource into another block on the gpu and swaps the handles over, the old
+// allocation is released with the deferred deletions and the block is freed once the last one is gone.
+static void updateDefragmentation() {
+
+    VkDeviceSize budget = memoryBudget->info.defragmentationBudget;
+
+    if (budget == 0) {
+        return;
+    }
+
+    MemoryBlock* block = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(memoryAllocator->mutex);
+
+        if (nullptr == memoryAllocator->drainingBlock) {
+            memoryAllocator->drainingBlock = getDrainCandidate();
+
+            if (nullptr != memoryAllocator->drainingBlock) {
+                memoryAllocator->drainingBlock->isDraining = true;
+                memoryAllocator->drainProgressFrame = frameNumber;
+            }
+        }
+
+        block = memoryAllocator->drainingBlock;
+    }
+
+    if (nullptr == block) {
+        return;
+    }
+
+    VkDeviceSize startBudget = budget;
+
+    moveTextures(block, &budget);
+    moveMeshes(block, &budget);
+
+    std::lock_guard<std::mutex> lock(memoryAllocator->mutex);
+
+    // the block is freed by freeMemory once the last move's old allocation is released. If what's left
+    // never becomes movable (a texture still streaming in) it would stay draining for good, so once
+    // the deletions of the last move have run it is given up and may be picked again later
+    if (budget < startBudget) {
+        memoryAllocator->drainProgressFrame = frameNumber;
+    }
+    else if (memoryAllocator->drainingBlock == block && frameNumber > memoryAllocator->drainProgressFrame + MAX_FRAMES_IN_FLIGHT + 1) {
+        block->isDraining = false;
+        memoryAllocator->drainingBlock = nullptr;
+    }
+}
+
+// The least used movable block, as long as the other blocks of its type have room for what is in it.
+// Called with the allocator mutex held.
+static MemoryBlock* getDrainCandidate() {
+
+    MemoryBlock* candidate = nullptr;
+
+    for (auto& block : memoryAllocator->blockList) {
+        if (!block->isMovable || static_cast<float>(block->usedSize) > static_cast<float>(block->size) * DEFRAGMENT_THRESHOLD) {
+            continue;
+        }
+
+        if (nullptr != candidate && block->usedSize >= candidate->usedSize) {
+            continue;
+        }
+
+        VkDeviceSize freeElsewhere = 0;
+        for (auto& other : memoryAllocator->blockList) {
+            if (other.get() != block.get() && other->isMovable && other->memoryTypeIndex == block->memoryTypeIndex) {
+                freeElsewhere += other->size - other->usedSize;
+            }
+        }
+
+        if (freeElsewhere >= block->usedSize) {
+            candidate = block.get();
+        }
+    }
+
+    return candidate;
+}
+
+//-------------------------------------------------------------------------------------
+// SECTION [BUDGET] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Runs once a frame on the render thread, before any streaming work is recorded
+void updateMemoryBudget() {
+
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = deviceInternal->gpuMemoryProperties;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    if (deviceInternal->hasMemoryBudget) {
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &budgetProperties;
+
+        vkGetPhysicalDeviceMemoryProperties2(deviceInternal->gpu, &memoryProperties2);
+    }
+
+    VulkronMemoryPressure worstPressure = VULKRON_MEMORY_PRESSURE_NONE;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+
+        VulkronMemoryHeapBudget& heap = memoryBudget->heapList[i];
+        VulkronMemoryPressure previousPressure = heap.pressure;
+
+        heap.heapIndex = i;
+        heap.flags = memoryProperties.memoryHeaps[i].flags;
+        heap.size = memoryProperties.memoryHeaps[i].size;
+        heap.engineUsage = memoryBudget->engineUsageList[i];
+
+        if (deviceInternal->hasMemoryBudget) {
+            heap.budget = budgetProperties.heapBudget[i];
+            heap.usage = budgetProperties.heapUsage[i];
+        }
+        else {
+            heap.budget = static_cast<VkDeviceSize>(heap.size * FALLBACK_BUDGET_FRACTION);
+            heap.usage = heap.engineUsage;
+        }
+
+        heap.pressure = getPressure(heap);
+
+        if (heap.pressure != previousPressure && nullptr != memoryBudget->info.pfnPressureCallback) {
+            memoryBudget->info.pfnPressureCallback(&heap, memoryBudget->info.pUserData);
+        }
+
+        // only device local heaps hold streamed resources
+        if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            worstPressure = std::max(worstPressure, heap.pressure);
+        }
+    }
+
+    memoryBudget->pressure = worstPressure;
+
+    if (worstPressure != VULKRON_MEMORY_PRESSURE_NONE && frameNumber >= memoryBudget->nextEvictionFrame) {
+        evictLeastRecentlyUsed();
+    }
+
+    updateDefragmentation();
+}
+
+bool hasMemoryPressure(VulkronMemoryPressure pressure) {
+    return memoryBudget->pressure >= pressure;
+}
+
+static VulkronMemoryPressure getPressure(const VulkronMemoryHeapBudget& heap) {
+
+    if (heap.budget == 0) {
+        return VULKRON_MEMORY_PRESSURE_NONE;
+    }
+
+    float usedFraction = static_cast<float>(heap.usage) / static_cast<float>(heap.budget);
+
+    if (usedFraction >= memoryBudget->info.criticalThreshold) {
+        return VULKRON_MEMORY_PRESSURE_CRITICAL;
+    }
+
+    if (usedFraction >= memoryBudget->info.evictionThreshold) {
+        return VULKRON_MEMORY_PRESSURE_HIGH;
+    }
+
+    return VULKRON_MEMORY_PRESSURE_NONE;
+}
+
+// Least recently used first, textures drop to their mip tail and meshes drop their buffers until every
+// heap is back under the target. Anything used in the last minUnusedFrames is left alone, if that's
+// not enough the pressure callback is the application's cue to release something itself.
+static void evictLeastRecentlyUsed() {
+
+    std::vector<EvictionCandidate> candidateList;
+    getTextureEvictionCandidates(candidateList);
+    getMeshEvictionCandidates(candidateList);
+
+    std::sort(candidateList.begin(), candidateList.end(), [](const EvictionCandidate& a, const EvictionCandidate& b) {
+        return a.lastUsedFrame < b.lastUsedFrame;
+    });
+
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> excessList = {};
+    bool hasExcess = false;
+
+    for (uint32_t i = 0; i < deviceInternal->gpuMemoryProperties.memoryHeapCount; i++) {
+        const VulkronMemoryHeapBudget& heap = memoryBudget->heapList[i];
+        VkDeviceSize target = static_cast<VkDeviceSize>(heap.budget * std::max(0.0f, memoryBudget->info.evictionThreshold - EVICTION_HEADROOM));
+
+        if (heap.pressure != VULKRON_MEMORY_PRESSURE_NONE && heap.usage > target) {
+            excessList[i] = heap.usage - target;
+            hasExcess = true;
+        }
+    }
+
+    uint64_t minUnusedFrames = memoryBudget->info.minUnusedFrames;
+    bool hasEvicted = false;
+
+    // bytes this pass releases per block, a block only goes back to the driver once all of it is released
+    std::map<const MemoryBlock*, VkDeviceSize> releasedMap;
+
+    for (const EvictionCandidate& candidate : candidateList) {
+
+        if (!hasExcess || candidate.lastUsedFrame + minUnusedFrames > frameNumber) {
+            break;
+        }
+
+        if (excessList[candidate.heapIndex] == 0) {
+            continue;
+        }
+
+        if (nullptr != candidate.texture) {
+            if (!demoteTexture(candidate.texture)) {
+                continue;
+            }
+        }
+        else {
+            evictMesh(candidate.mesh);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(memoryAllocator->mutex);
+
+            for (const MemoryAllocation& allocation : candidate.memoryList) {
+                if (allocation.memory == VULKRON_NULL_HANDLE) {
+                    continue;
+                }
+
+                VkDeviceSize& excess = excessList[deviceInternal->gpuMemoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex];
+                excess -= std::min(excess, getReturnedSize(allocation, releasedMap));
+            }
+        }
+
+        hasEvicted = true;
+
+        hasExcess = std::any_of(excessList.begin(), excessList.end(), [](VkDeviceSize value) { return value > 0; });
+    }
+
+    // memory comes back once the deferred deletions run, the budget can't show it before then
+    if (hasEvicted) {
+        memoryBudget->nextEvictionFrame = frameNumber + MAX_FRAMES_IN_FLIGHT + 1;
+    }
+}
+
+// What the heap usage drops by once an evicted allocation is freed, a block counts when the last of it goes.
+// Called with the allocator mutex held.
+static VkDeviceSize getReturnedSize(const MemoryAllocation& allocation, std::map<const MemoryBlock*, VkDeviceSize>& releasedMap) {
+
+    if (nullptr == allocation.block) {
+        return allocation.size;
+    }
+
+    VkDeviceSize& releasedSize = releasedMap[allocation.block];
+    releasedSize += allocation.size;
+
+    return releasedSize == allocation.block->usedSize ? allocation.block->size : 0;
+}
+
+std::vector<VulkronMemoryHeapBudget> vulkronGetMemoryBudget() {
+
+    uint32_t heapCount = deviceInternal->gpuMemoryProperties.memoryHeapCount;
+
+    return std::vector<VulkronMemoryHeapBudget>(memoryBudget->heapList.begin(), memoryBudget->heapList.begin() + heapCount);
+}
+
+VulkronResult vulkronSetMemoryBudgetInfo(VulkronMemoryBudgetInfo* info) {
+
+    if (nullptr == info || info->evictionThreshold <= 0.0f || info->criticalThreshold < info->evictionThreshold) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    memoryBudget->info = *info;
+
+    return VULKRON_SUCCESS;
+}
@@ -0,0 +1,590 @@
+#include "VulkronInternal.h"
+
+#ifdef _WIN64
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MeshStreamingInternal*  meshStreaming   = new MeshStreamingInternal();
+
+static const size_t                         PAGE_TOUCH_STRIDE       = 4096;
+static const VkBufferUsageFlags             VERTEX_BUFFER_USAGE     = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+static const VkBufferUsageFlags             INDEX_BUFFER_USAGE      = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+static bool mapFile(const std::string& filePath, MappedFile* file);
+static void unmapFile(MappedFile* file);
+static void mapMesh(MeshInternal* mesh);
+static bool validateMeshHeader(const MappedFile& file, const VulkronMeshFileHeader& header);
+static bool isRangeInFile(const MappedFile& file, uint64_t offset, uint64_t size);
+static void createMeshBuffers(MeshInternal* mesh);
+static bool uploadMeshChunk(MeshInternal* mesh);
+static void destroyMeshInternal(MeshInternal* mesh);
+static void relocateMeshBuffer(BufferAllocation* buffer, VkBufferUsageFlags usage);
+
+//-------------------------------------------------------------------------------------
+// SECTION [MAPPED FILE] --------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static bool mapFile(const std::string& filePath, MappedFile* file) {
+#ifdef _WIN64
+    HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(fileHandle);
+
+    if (nullptr == mappingHandle) {
+        return false;
+    }
+
+    // the view keeps the mapping alive, both handles can go
+    void* pData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mappingHandle);
+
+    if (nullptr == pData) {
+        return false;
+    }
+
+    file->pData = static_cast<const uint8_t*>(pData);
+    file->size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fileDescriptor = open(filePath.c_str(), O_RDONLY);
+    if (fileDescriptor < 0) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fileDescriptor);
+        return false;
+    }
+
+    void* pData = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+    close(fileDescriptor);
+
+    if (pData == MAP_FAILED) {
+        return false;
+    }
+
+    // advice values are enumerators, not flags, each one needs its own call
+    madvise(pData, static_cast<size_t>(fileStat.st_size), MADV_SEQUENTIAL);
+    madvise(pData, static_cast<size_t>(fileStat.st_size), MADV_WILLNEED);
+
+    file->pData = static_cast<const uint8_t*>(pData);
+    file->size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+static void unmapFile(MappedFile* file) {
+    if (nullptr == file->pData) {
+        return;
+    }
+
+#ifdef _WIN64
+    UnmapViewOfFile(file->pData);
+#else
+    munmap(const_cast<uint8_t*>(file->pData), file->size);
+#endif
+
+    *file = {};
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [STREAMING] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Runs on a worker thread. Nothing is parsed, the header is checked and every page is touched
+// so the render thread only ever copies from the page cache.
+static void mapMesh(MeshInternal* mesh) {
+    VULKRON_TRACE_SCOPE("upload", "mapMesh");
+
+    if (mapFile(mesh->filePath, &mesh->file)) {
+
+        memcpy(&mesh->header, mesh->file.pData, std::min(mesh->file.size, sizeof(VulkronMeshFileHeader)));
+
+        // fields appended after version 1
+        if (mesh->header.version == 1) {
+            for (uint32_t c = 0; c < 3; c++) {
+                mesh->header.positionScale[c] = 1.0f;
+                mesh->header.positionBias[c] = 0.0f;
+            }
+        }
+
+        if (validateMeshHeader(mesh->file, mesh->header)) {
+            const VulkronMeshFileLod* pLods = reinterpret_cast<const VulkronMeshFileLod*>(mesh->file.pData + mesh->header.lodTableOffset);
+            mesh->lodList.assign(pLods, pLods + mesh->header.lodCount);
+
+            volatile uint8_t sink = 0;
+            for (size_t offset = 0; offset < mesh->file.size; offset += PAGE_TOUCH_STRIDE) {
+                sink = sink + mesh->file.pData[offset];
+            }
+            (void)sink;
+        }
+        else {
+            unmapFile(&mesh->file);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(meshStreaming->mappedMutex);
+    meshStreaming->mappedList.push_back(mesh);
+}
+
+static bool validateMeshHeader(const MappedFile& file, const VulkronMeshFileHeader& header) {
+
+    if (file.size < VULKRON_MESH_HEADER_SIZE_V1 || header.magic != VULKRON_MESH_MAGIC || header.version == 0 || header.version > VULKRON_MESH_VERSION) {
+        return false;
+    }
+
+    if (header.version > 1 && file.size < sizeof(VulkronMeshFileHeader)) {
+        return false;
+    }
+
+    if (!(header.vertexFormat == VULKRON_MESH_VERTEX_FORMAT_FLOAT && header.vertexStride == sizeof(VulkronMeshFileVertex)) &&
+        !(header.vertexFormat == VULKRON_MESH_VERTEX_FORMAT_QUANTIZED && header.vertexStride == sizeof(VulkronMeshPackedVertex))) {
+        return false;
+    }
+
+    if (header.fileSize != file.size || header.lodCount == 0 || header.lodCount > VULKRON_MESH_MAX_LODS ||
+        header.vertexCount == 0 || header.indexCount == 0) {
+        return false;
+    }
+
+    uint64_t indexSize = header.indexType == VULKRON_MESH_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    if (header.vertexDataSize != static_cast<uint64_t>(header.vertexCount) * header.vertexStride ||
+        header.indexDataSize != static_cast<uint64_t>(header.indexCount) * indexSize) {
+        return false;
+    }
+
+    // every table and blob has to be inside the file, the blobs are copied as they are so they keep their alignment
+    if (!isRangeInFile(file, header.lodTableOffset, header.lodCount * sizeof(VulkronMeshFileLod)) ||
+        !isRangeInFile(file, header.vertexDataOffset, header.vertexDataSize) ||
+        !isRangeInFile(file, header.indexDataOffset, header.indexDataSize)) {
+        return false;
+    }
+
+    if (header.lodTableOffset % alignof(VulkronMeshFileLod) != 0 ||
+        header.vertexDataOffset % VULKRON_MESH_BLOB_ALIGNMENT != 0 ||
+        header.indexDataOffset % VULKRON_MESH_BLOB_ALIGNMENT != 0) {
+        return false;
+    }
+
+    const VulkronMeshFileLod* pLods = reinterpret_cast<const VulkronMeshFileLod*>(file.pData + header.lodTableOffset);
+    for (uint32_t i = 0; i < header.lodCount; i++) {
+        if (static_cast<uint64_t>(pLods[i].indexOffset) + pLods[i].indexCount > header.indexCount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Written so a corrupt offset near UINT64_MAX can't wrap around
+static bool isRangeInFile(const MappedFile& file, uint64_t offset, uint64_t size) {
+    return offset <= file.size && size <= file.size - offset;
+}
+
+// Called once per frame before the transfer batch is submitted, shares the upload ring and frame budget with textures
+void updateMeshStreaming() {
+    VULKRON_TRACE_SCOPE("upload", "updateMeshStreaming");
+
+    std::vector<MeshInternal*> mappedList;
+    {
+        std::lock_guard<std::mutex> lock(meshStreaming->mappedMutex);
+        mappedList.swap(meshStreaming->mappedList);
+    }
+
+    // evicted meshes that were visible since are mapped and uploaded again like a new load
+    for (auto mesh : meshStreaming->meshList) {
+        if (mesh->state == VULKRON_MESH_STATE_EVICTED && mesh->lastUsedFrame.load(std::memory_order_relaxed) > mesh->evictedFrame &&
+            !hasMemoryPressure(VULKRON_MEMORY_PRESSURE_HIGH)) {
+            mesh->state = VULKRON_MESH_STATE_PENDING;
+            mesh->isLoading = true;
+
+            workerThreadPool->addJob([mesh] { mapMesh(mesh); });
+        }
+    }
+
+    for (auto mesh : mappedList) {
+        mesh->isLoading = false;
+
+        if (mesh->destroyRequested) {
+            destroyMeshInternal(mesh);
+            continue;
+        }
+
+        if (nullptr == mesh->file.pData) {
+            mesh->state = VULKRON_MESH_STATE_FAILED;
+#if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
+            LOG("failed to load mesh: " << mesh->filePath)
+#endif
+            continue;
+        }
+
+        createMeshBuffers(mesh);
+        mesh->state = VULKRON_MESH_STATE_UPLOADING;
+        meshStreaming->uploadQueue.push_back(mesh);
+    }
+
+    while (!meshStreaming->uploadQueue.empty()) {
+        MeshInternal* mesh = meshStreaming->uploadQueue.front();
+
+        if (!uploadMeshChunk(mesh)) {
+            return;
+        }
+
+        if (nullptr == mesh->file.pData) {
+            meshStreaming->uploadQueue.pop_front();
+        }
+    }
+}
+
+static void createMeshBuffers(MeshInternal* mesh) {
+    createBuffer(mesh->header.vertexDataSize, VERTEX_BUFFER_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->vertexBuffer, true);
+    createBuffer(mesh->header.indexDataSize, INDEX_BUFFER_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &mesh->indexBuffer, true);
+
+    mesh->indexType = mesh->header.indexType == VULKRON_MESH_INDEX_TYPE_UINT16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+// The blobs go from the mapping to the upload ring with a single memcpy, vertices first then indices
+static bool uploadMeshChunk(MeshInternal* mesh) {
+
+    bool isVertexData = mesh->vertexBytesUploaded < mesh->header.vertexDataSize;
+
+    const BufferAllocation& dstBuffer = isVertexData ? mesh->vertexBuffer : mesh->indexBuffer;
+    uint64_t blobOffset = isVertexData ? mesh->header.vertexDataOffset : mesh->header.indexDataOffset;
+    VkDeviceSize blobSize = isVertexData ? mesh->header.vertexDataSize : mesh->header.indexDataSize;
+    VkDeviceSize* pUploaded = isVertexData ? &mesh->vertexBytesUploaded : &mesh->indexBytesUploaded;
+
+    VkDeviceSize remainingBudget = transferInternal->frameBudget > transferInternal->frameBytesRecorded ? transferInternal->frameBudget - transferInternal->frameBytesRecorded : 0;
+    VkDeviceSize size = std::min(blobSize - *pUploaded, remainingBudget);
+
+    if (size == 0) {
+        if (transferInternal->frameBytesRecorded != 0) {
+            return false;
+        }
+        size = std::min<VkDeviceSize>(blobSize - *pUploaded, uploadRing->staging.size / 2);
+    }
+
+    VkDeviceSize ringOffset = 0;
+    while (!uploadRingAllocate(size, &ringOffset)) {
+        if (size <= uploadRing->alignment) {
+            return false;
+        }
+        size /= 2;
+    }
+
+    memcpy(uploadRing->pMappedData + ringOffset, mesh->file.pData + blobOffset + *pUploaded, size);
+
+    TransferBatch* batch = getTransferBatch();
+    transferInternal->frameBytesRecorded += size;
+
+    VkBufferCopy region = {};
+    region.srcOffset = ringOffset;
+    region.dstOffset = *pUploaded;
+    region.size = size;
+
+    vkCmdCopyBuffer(batch->transferCommandBuffer, uploadRing->staging.buffer, dstBuffer.buffer, 1, &region);
+
+    *pUploaded += size;
+
+    if (mesh->vertexBytesUploaded < mesh->header.vertexDataSize || mesh->indexBytesUploaded < mesh->header.indexDataSize) {
+        return true;
+    }
+
+    recordQueueOwnershipTransfer(batch, mesh->vertexBuffer.buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    recordQueueOwnershipTransfer(batch, mesh->indexBuffer.buffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+
+    // everything is in staging memory, the file isn't needed anymore
+    unmapFile(&mesh->file);
+
+    batch->onSubmitList.push_back([mesh] { mesh->state = VULKRON_MESH_STATE_RESIDENT; });
+
+    return true;
+}
+
+void recordMeshDraw(VkCommandBuffer commandBuffer, const VulkronBaseObject& object) {
+    MeshInternal* mesh = object.mesh;
+
+    if (object.isCulled || isDrawnIndirect(object) || nullptr == mesh || mesh->state != VULKRON_MESH_STATE_RESIDENT) {
+        return;
+    }
+
+    const VulkronMeshFileLod& lod = mesh->lodList[std::min(object.lodIndex, static_cast<uint32_t>(mesh->lodList.size()) - 1)];
+    VkDeviceSize vertexOffset = 0;
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->vertexBuffer.buffer, &vertexOffset);
+    vkCmdBindIndexBuffer(commandBuffer, mesh->indexBuffer.buffer, 0, mesh->indexType);
+    vkCmdDrawIndexed(commandBuffer, lod.indexCount, object.instances, lod.indexOffset, 0, 0);
+}
+
+static void destroyMeshInternal(MeshInternal* mesh) {
+    auto& meshList = meshStreaming->meshList;
+    meshList.erase(std::remove(meshList.begin(), meshList.end(), mesh), meshList.end());
+
+    unmapFile(&mesh->file);
+
+    BufferAllocation vertexBuffer = mesh->vertexBuffer;
+    BufferAllocation indexBuffer = mesh->indexBuffer;
+
+    // in flight frames and transfer batches may still use the buffers
+    enqueueFrameDeletion([vertexBuffer, indexBuffer] {
+        BufferAllocation vertex = vertexBuffer;
+        BufferAllocation index = indexBuffer;
+        destroyBuffer(&vertex);
+        destroyBuffer(&index);
+    });
+
+    delete mesh;
+}
+
+void getMeshEvictionCandidates(std::vector<EvictionCandidate>& candidateList) {
+
+    for (auto mesh : meshStreaming->meshList) {
+        if (mesh->state != VULKRON_MESH_STATE_RESIDENT || mesh->destroyRequested) {
+            continue;
+        }
+
+        EvictionCandidate candidate = {};
+        candidate.lastUsedFrame = mesh->lastUsedFrame.load(std::memory_order_relaxed);
+        candidate.memoryList = { mesh->vertexBuffer.memory, mesh->indexBuffer.memory };
+        candidate.heapIndex = deviceInternal->gpuMemoryProperties.memoryTypes[mesh->vertexBuffer.memory.memoryTypeIndex].heapIndex;
+        candidate.mesh = mesh;
+
+        candidateList.push_back(candidate);
+    }
+}
+
+// The header and lod table stay so culling keeps running on it, that is what tells
+// updateMeshStreaming to bring it back
+void evictMesh(MeshInternal* mesh) {
+
+    BufferAllocation vertexBuffer = mesh->vertexBuffer;
+    BufferAllocation indexBuffer = mesh->indexBuffer;
+
+    enqueueFrameDeletion([vertexBuffer, indexBuffer] {
+        BufferAllocation vertex = vertexBuffer;
+        BufferAllocation index = indexBuffer;
+        destroyBuffer(&vertex);
+        destroyBuffer(&index);
+    });
+
+    mesh->vertexBuffer = {};
+    mesh->indexBuffer = {};
+    mesh->vertexBytesUploaded = 0;
+    mesh->indexBytesUploaded = 0;
+    mesh->state = VULKRON_MESH_STATE_EVICTED;
+    mesh->evictedFrame = frameNumber;
+}
+
+// Resident meshes with a buffer in the block being drained get that buffer copied somewhere else
+void moveMeshes(const MemoryBlock* block, VkDeviceSize* pBudget) {
+
+    for (auto mesh : meshStreaming->meshList) {
+        if (*pBudget == 0) {
+            return;
+        }
+
+        if (mesh->state != VULKRON_MESH_STATE_RESIDENT || mesh->destroyRequested) {
+            continue;
+        }
+
+        if (mesh->vertexBuffer.memory.block == block) {
+            *pBudget -= std::min(*pBudget, mesh->vertexBuffer.memory.size);
+            relocateMeshBuffer(&mesh->vertexBuffer, VERTEX_BUFFER_USAGE);
+        }
+
+        if (mesh->indexBuffer.memory.block == block) {
+            *pBudget -= std::min(*pBudget, mesh->indexBuffer.memory.size);
+            relocateMeshBuffer(&mesh->indexBuffer, INDEX_BUFFER_USAGE);
+        }
+    }
+}
+
+// The copy goes out with the transfer batch ahead of this frame, so the new buffer can be swapped
+// in right away. Frames still in flight keep drawing from the old one until it is deleted.
+static void relocateMeshBuffer(BufferAllocation* buffer, VkBufferUsageFlags usage) {
+
+    BufferAllocation oldBuffer = *buffer;
+    BufferAllocation newBuffer;
+    createBuffer(oldBuffer.size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &newBuffer, true);
+
+    TransferBatch* batch = getTransferBatch();
+
+    // earlier draws only read the old buffer, waiting on them is enough
+    vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region = {};
+    region.size = oldBuffer.size;
+
+    vkCmdCopyBuffer(batch->graphicsCommandBuffer, oldBuffer.buffer, newBuffer.buffer, 1, &region);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+    vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    enqueueFrameDeletion([oldBuffer] {
+        BufferAllocation allocation = oldBuffer;
+        destroyBuffer(&allocation);
+    });
+
+    *buffer = newBuffer;
+}
+
+void destroyMeshes() {
+    for (auto mesh : meshStreaming->meshList) {
+        unmapFile(&mesh->file);
+        destroyBuffer(&mesh->vertexBuffer);
+        destroyBuffer(&mesh->indexBuffer);
+
+        delete mesh;
+    }
+
+    delete meshStreaming;
+    meshStreaming = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [MESH] ---------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronLoadMesh(VulkronMeshCreateInfo* info) {
+
+    if (nullptr == info || nullptr == info->pMesh || info->filePath.empty()) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    MeshInternal* mesh = new MeshInternal();
+    mesh->filePath = info->filePath;
+    mesh->isLoading = true;
+
+    meshStreaming->meshList.push_back(mesh);
+    *info->pMesh = mesh;
+
+    workerThreadPool->addJob([mesh] { mapMesh(mesh); });
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronGetMeshInfo(VulkronMesh mesh, VulkronMeshInfo* pInfo) {
+
+    if (nullptr == mesh || nullptr == pInfo) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pInfo = {};
+    pInfo->state = mesh->state;
+
+    if (mesh->isLoading || mesh->state == VULKRON_MESH_STATE_FAILED) {
+        return VULKRON_SUCCESS;
+    }
+
+    const VulkronMeshFileHeader& header = mesh->header;
+    pInfo->vertexFormat = static_cast<VulkronMeshVertexFormat>(header.vertexFormat);
+    pInfo->vertexCount = header.vertexCount;
+    pInfo->indexCount = header.indexCount;
+    pInfo->lodCount = header.lodCount;
+    pInfo->boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    pInfo->boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    pInfo->boundingSphere = glm::vec4(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2], header.sphereRadius);
+
+    pInfo->dequantizeMatrix = glm::mat4(1.0f);
+    pInfo->dequantizeMatrix[0][0] = header.positionScale[0];
+    pInfo->dequantizeMatrix[1][1] = header.positionScale[1];
+    pInfo->dequantizeMatrix[2][2] = header.positionScale[2];
+    pInfo->dequantizeMatrix[3] = glm::vec4(header.positionBias[0], header.positionBias[1], header.positionBias[2], 1.0f);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDestroyMesh(VulkronMesh mesh) {
+
+    if (nullptr == mesh) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // a worker thread still owns it, it is destroyed when it comes back from mapping
+    if (mesh->isLoading) {
+        mesh->destroyRequested = true;
+        return VULKRON_SUCCESS;
+    }
+
+    auto& uploadQueue = meshStreaming->uploadQueue;
+    uploadQueue.erase(std::remove(uploadQueue.begin(), uploadQueue.end(), mesh), uploadQueue.end());
+
+    // the batch being recorded may reference the buffers, let it go out first
+    TransferBatch* batch = &transferInternal->batchList[transferInternal->currentBatch];
+    if (batch->isRecording) {
+        mesh->destroyRequested = true;
+        batch->onSubmitList.push_back([mesh] { destroyMeshInternal(mesh); });
+        return VULKRON_SUCCESS;
+    }
+
+    destroyMeshInternal(mesh);
+
+    return VULKRON_SUCCESS;
+}
+
+// Pipelines can be built before any mesh has loaded, the layout only depends on the vertex format
+VulkronResult vulkronGetVertexDescriptions(VulkronMeshVertexFormat format, VulkronVertexDescriptions* pDescriptions) {
+
+    if (nullptr == pDescriptions) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    static const VkVertexInputBindingDescription floatBinding = { 0, sizeof(VulkronMeshFileVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+    static const VkVertexInputAttributeDescription floatAttributes[] = {
+        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkronMeshFileVertex, position) },
+        { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkronMeshFileVertex, normal) },
+        { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VulkronMeshFileVertex, color) },
+        { 3, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(VulkronMeshFileVertex, uv) }
+    };
+
+    static const VkVertexInputBindingDescription packedBinding = { 0, sizeof(VulkronMeshPackedVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+    static const VkVertexInputAttributeDescription packedAttributes[] = {
+        { 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(VulkronMeshPackedVertex, position) },
+        { 1, 0, VK_FORMAT_R16G16_SNORM,       offsetof(VulkronMeshPackedVertex, normal) },
+        { 2, 0, VK_FORMAT_R8G8B8A8_UNORM,     offsetof(VulkronMeshPackedVertex, color) },
+        { 3, 0, VK_FORMAT_R16G16_SFLOAT,      offsetof(VulkronMeshPackedVertex, uv) }
+    };
+
+    switch (format) {
+    case VULKRON_MESH_VERTEX_FORMAT_FLOAT:
+        pDescriptions->pBindings = &floatBinding;
+        pDescriptions->pAttributes = floatAttributes;
+        pDescriptions->attributesCount = static_cast<uint32_t>(std::size(floatAttributes));
+        break;
+    case VULKRON_MESH_VERTEX_FORMAT_QUANTIZED:
+        pDescriptions->pBindings = &packedBinding;
+        pDescriptions->pAttributes = packedAttributes;
+        pDescriptions->attributesCount = static_cast<uint32_t>(std::size(packedAttributes));
+        break;
+    default:
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    pDescriptions->bindingsCount = 1;
+
+    return VULKRON_SUCCESS;
+}
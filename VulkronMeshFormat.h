@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef VULKRON_MESH_FORMAT
+#define VULKRON_MESH_FORMAT
+
+#include <stdint.h>
+
+/*
+
+	Binary mesh container (.vmesh), shared by the runtime loader and Tools/MeshConverter.
+
+	The file is laid out so it can be memory mapped and copied straight into staging memory:
+
+	[VulkronMeshFileHeader][VulkronMeshFileLod * lodCount][pad][vertex blob][pad][index blob]
+
+	Every blob starts on a VULKRON_MESH_BLOB_ALIGNMENT boundary and is stored exactly as the gpu reads it.
+	Any change to the layout bumps VULKRON_MESH_VERSION, the loader rejects versions it doesn't know.
+	New header fields are only ever appended so older files can still be read.
+
+	Version history
+	1 - float vertices, 128 byte header
+	2 - quantized vertices, position scale and bias appended to the header
+
+*/
+
+#define VULKRON_MESH_MAGIC				0x48534D56u		// "VMSH"
+#define VULKRON_MESH_VERSION			2
+#define VULKRON_MESH_HEADER_SIZE_V1		128
+#define VULKRON_MESH_BLOB_ALIGNMENT		64
+#define VULKRON_MESH_MAX_LODS			8
+
+typedef enum VulkronMeshVertexFormat {
+	VULKRON_MESH_VERTEX_FORMAT_FLOAT = 0,			// VulkronMeshFileVertex
+	VULKRON_MESH_VERTEX_FORMAT_QUANTIZED			// VulkronMeshPackedVertex
+} VulkronMeshVertexFormat;
+
+typedef enum VulkronMeshIndexType {
+	VULKRON_MESH_INDEX_TYPE_UINT16 = 0,
+	VULKRON_MESH_INDEX_TYPE_UINT32
+} VulkronMeshIndexType;
+
+// Matches the shader inputs, location 0 vPosition, 1 vNormal, 2 vColor, 3 vTexCoord
+typedef struct VulkronMeshFileVertex {
+	float									position[3];
+	float									normal[3];
+	float									color[3];
+	float									uv[2];
+} VulkronMeshFileVertex;
+
+// 20 bytes instead of 44, same shader locations
+typedef struct VulkronMeshPackedVertex {
+	int16_t									position[4];			// R16G16B16A16_SNORM, object space = position * positionScale + positionBias
+	int16_t									normal[2];				// R16G16_SNORM, octahedral encoded
+	uint8_t									color[4];				// R8G8B8A8_UNORM
+	uint16_t								uv[2];					// R16G16_SFLOAT
+} VulkronMeshPackedVertex;
+
+typedef struct VulkronMeshFileLod {
+	uint32_t								indexOffset;			// first index of the lod in the index blob
+	uint32_t								indexCount;
+	float									error;					// object space deviation from lod 0
+	uint32_t								reserved;
+} VulkronMeshFileLod;
+
+typedef struct VulkronMeshFileHeader {
+	uint32_t								magic;
+	uint32_t								version;
+	uint32_t								vertexFormat;			// VulkronMeshVertexFormat
+	uint32_t								vertexStride;
+	uint32_t								indexType;				// VulkronMeshIndexType
+	uint32_t								vertexCount;
+	uint32_t								indexCount;				// every lod together
+	uint32_t								lodCount;
+	float									boundsMin[3];
+	float									boundsMax[3];
+	float									sphereCenter[3];
+	float									sphereRadius;
+	uint64_t								lodTableOffset;
+	uint64_t								vertexDataOffset;
+	uint64_t								vertexDataSize;
+	uint64_t								indexDataOffset;
+	uint64_t								indexDataSize;
+	uint64_t								fileSize;
+	uint64_t								reserved;
+	// version 2
+	float									positionScale[3];		// identity for float vertices
+	float									positionBias[3];
+	uint64_t								reserved2;
+} VulkronMeshFileHeader;
+
+static_assert(sizeof(VulkronMeshFileVertex) == 44, "VulkronMeshFileVertex layout changed, bump VULKRON_MESH_VERSION");
+static_assert(sizeof(VulkronMeshPackedVertex) == 20, "VulkronMeshPackedVertex layout changed, bump VULKRON_MESH_VERSION");
+static_assert(sizeof(VulkronMeshFileLod) == 16, "VulkronMeshFileLod layout changed, bump VULKRON_MESH_VERSION");
+static_assert(sizeof(VulkronMeshFileHeader) == 160, "VulkronMeshFileHeader layout changed, bump VULKRON_MESH_VERSION");
+
+#endif // !VULKRON_MESH_FORMAT
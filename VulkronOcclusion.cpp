@@ -0,0 +1,658 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Hi-Z occlusion culling, for objects with occlusionCulling set
+
+    1. the depth attachment still holds the previous frame, it's reduced into a max depth pyramid
+    2. a compute pass projects every object's bounding sphere with the previous frame's camera and
+       compares it against the pyramid, surviving draws are compacted per draw group into an
+       indirect buffer
+    3. each draw group (same pipeline and mesh) is a single vkCmdDrawIndexedIndirectCount
+
+    The cpu visibility pass still does frustum culling and lod selection, only objects that
+    survive it are sent to the gpu. Objects hidden last frame but visible now show up a frame
+    late, that's the cost of reusing the previous depth instead of a depth prepass.
+
+*/
+
+OcclusionInternal*  occlusionInternal   = new OcclusionInternal();
+
+static const uint32_t                       CULL_GROUP_SIZE         = 64;       // occlusion_cull.comp local_size_x
+static const uint32_t                       REDUCE_GROUP_SIZE       = 8;        // depth_reduce.comp local_size_x and y
+static const uint32_t                       MAX_PYRAMID_LEVELS      = 16;
+static const uint32_t                       MIN_OBJECT_CAPACITY     = 256;
+static const uint32_t                       CULL_FLAG_DEPTH_HISTORY = 0x1;
+static const uint32_t                       CULL_FLAG_COMPACT       = 0x2;
+
+typedef struct CullConstants {
+    glm::mat4                               viewProjection;
+    uint32_t                                objectCount;
+    uint32_t                                pyramidWidth;
+    uint32_t                                pyramidHeight;
+    uint32_t                                flags;
+} CullConstants;
+
+typedef struct ReduceConstants {
+    uint32_t                                sourceWidth;
+    uint32_t                                sourceHeight;
+    uint32_t                                destinationWidth;
+    uint32_t                                destinationHeight;
+} ReduceConstants;
+
+static void createOcclusionLayouts();
+static void createOcclusionPyramid();
+static void growOcclusionFrame(OcclusionFrame* frame, uint32_t objectCount);
+static void recordDepthPyramid(VkCommandBuffer commandBuffer);
+
+VulkronResult vulkronEnableOcclusionCulling(VulkronOcclusionCullingCreateInfo* info) {
+
+    if (nullptr == info) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (occlusionInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    createOcclusionLayouts();
+
+    occlusionInternal->reducePipeline = createComputePipeline(info->depthReduceShaderPath, occlusionInternal->reducePipelineLayout);
+    occlusionInternal->cullPipeline = createComputePipeline(info->cullShaderPath, occlusionInternal->cullPipelineLayout);
+
+    // compacted draws go through one multi draw per group, otherwise every object keeps its slot
+    // and hidden ones are drawn with zero instances
+    occlusionInternal->isCompacting = deviceInternal->hasDrawIndirectCount && device->gpuEnabledFeatures.multiDrawIndirect;
+
+    occlusionInternal->frameList.resize(MAX_FRAMES_IN_FLIGHT);
+
+    std::vector<VkDescriptorSetLayout> setLayoutList(MAX_FRAMES_IN_FLIGHT, occlusionInternal->cullSetLayout);
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = occlusionInternal->descriptorPool;
+    allocateInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+    allocateInfo.pSetLayouts = setLayoutList.data();
+
+    std::vector<VkDescriptorSet> setList(MAX_FRAMES_IN_FLIGHT);
+
+    if (vkAllocateDescriptorSets(deviceInternal->logicalDevice, &allocateInfo, setList.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate occlusion descriptor sets!");
+    }
+
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        occlusionInternal->frameList[i].cullSet = setList[i];
+        growOcclusionFrame(&occlusionInternal->frameList[i], MIN_OBJECT_CAPACITY);
+    }
+
+    occlusionInternal->isEnabled = true;
+    occlusionInternal->hasDepthHistory = false;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDisableOcclusionCulling() {
+
+    if (!occlusionInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    vkDeviceWaitIdle(deviceInternal->logicalDevice);
+    destroyOcclusionCulling();
+
+    return VULKRON_SUCCESS;
+}
+
+void destroyOcclusionCulling() {
+
+    if (!occlusionInternal->isEnabled) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    destroyOcclusionPyramid();
+
+    for (auto& frame : occlusionInternal->frameList) {
+        destroyBuffer(&frame.objectBuffer);
+        destroyBuffer(&frame.commandBuffer);
+        destroyBuffer(&frame.countBuffer);
+    }
+
+    vkDestroyPipeline(logicalDevice, occlusionInternal->reducePipeline, nullptr);
+    vkDestroyPipeline(logicalDevice, occlusionInternal->cullPipeline, nullptr);
+    vkDestroyPipelineLayout(logicalDevice, occlusionInternal->reducePipelineLayout, nullptr);
+    vkDestroyPipelineLayout(logicalDevice, occlusionInternal->cullPipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(logicalDevice, occlusionInternal->reduceSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(logicalDevice, occlusionInternal->cullSetLayout, nullptr);
+    vkDestroyDescriptorPool(logicalDevice, occlusionInternal->descriptorPool, nullptr);
+    vkDestroySampler(logicalDevice, occlusionInternal->sampler, nullptr);
+
+    *occlusionInternal = OcclusionInternal();
+}
+
+// The next frame treats every object as visible instead of testing against depth it didn't render
+void resetOcclusionHistory() {
+    occlusionInternal->hasDepthHistory = false;
+}
+
+bool isDrawnIndirect(const VulkronBaseObject& object) {
+    return occlusionInternal->isEnabled && object.occlusionCulling;
+}
+
+bool hasOcclusionDraws(uint32_t frameIndex) {
+    return occlusionInternal->isEnabled && !occlusionInternal->frameList[frameIndex].drawGroupList.empty();
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [SETUP] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static void createOcclusionLayouts() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    // depth_reduce.comp, 0 previous level (or the depth attachment), 1 level being written
+    VkDescriptorSetLayoutBinding reduceBindingList[2] = {};
+    reduceBindingList[0].binding = 0;
+    reduceBindingList[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    reduceBindingList[0].descriptorCount = 1;
+    reduceBindingList[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    reduceBindingList[1].binding = 1;
+    reduceBindingList[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    reduceBindingList[1].descriptorCount = 1;
+    reduceBindingList[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    // occlusion_cull.comp, 0 objects, 1 draw commands, 2 draw counts, 3 depth pyramid
+    VkDescriptorSetLayoutBinding cullBindingList[4] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        cullBindingList[i].binding = i;
+        cullBindingList[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindingList[i].descriptorCount = 1;
+        cullBindingList[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cullBindingList[3].binding = 3;
+    cullBindingList[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    cullBindingList[3].descriptorCount = 1;
+    cullBindingList[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = 2;
+    setLayoutInfo.pBindings = reduceBindingList;
+
+    if (vkCreateDescriptorSetLayout(logicalDevice, &setLayoutInfo, nullptr, &occlusionInternal->reduceSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create occlusion descriptor set layout!");
+    }
+
+    setLayoutInfo.bindingCount = 4;
+    setLayoutInfo.pBindings = cullBindingList;
+
+    if (vkCreateDescriptorSetLayout(logicalDevice, &setLayoutInfo, nullptr, &occlusionInternal->cullSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create occlusion descriptor set layout!");
+    }
+
+    VkPushConstantRange reduceRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceConstants) };
+    VkPushConstantRange cullRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants) };
+
+    VkPipelineLayoutCreateInfo reduceLayoutInfo = vulkronPipelineLayoutInfo(1, &occlusionInternal->reduceSetLayout, 1, &reduceRange);
+    VkPipelineLayoutCreateInfo cullLayoutInfo = vulkronPipelineLayoutInfo(1, &occlusionInternal->cullSetLayout, 1, &cullRange);
+
+    if (vkCreatePipelineLayout(logicalDevice, &reduceLayoutInfo, nullptr, &occlusionInternal->reducePipelineLayout) != VK_SUCCESS ||
+        vkCreatePipelineLayout(logicalDevice, &cullLayoutInfo, nullptr, &occlusionInternal->cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create occlusion pipeline layout!");
+    }
+
+    VkDescriptorPoolSize poolSizeList[3] = {};
+    poolSizeList[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizeList[0].descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
+    poolSizeList[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizeList[1].descriptorCount = MAX_FRAMES_IN_FLIGHT + MAX_PYRAMID_LEVELS;
+    poolSizeList[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizeList[2].descriptorCount = MAX_PYRAMID_LEVELS;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;      // pyramid sets are replaced on resize
+    poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT + MAX_PYRAMID_LEVELS;
+    poolInfo.poolSizeCount = 3;
+    poolInfo.pPoolSizes = poolSizeList;
+
+    if (vkCreateDescriptorPool(logicalDevice, &poolInfo, nullptr, &occlusionInternal->descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create occlusion descriptor pool!");
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &occlusionInternal->sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create occlusion sampler!");
+    }
+}
+
+// The pyramid is the largest power of two that fits in the depth attachment so every level
+// after the first halves exactly, the first level takes the max over a 2x2 to 3x3 footprint
+static void createOcclusionPyramid() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+    VkExtent2D extent = swapchainInternal->swapChainExtent;
+
+    uint32_t width = 1;
+    uint32_t height = 1;
+    while (width * 2 <= extent.width) width *= 2;
+    while (height * 2 <= extent.height) height *= 2;
+
+    uint32_t mipLevels = 1;
+    while ((std::max(width, height) >> mipLevels) > 0 && mipLevels < MAX_PYRAMID_LEVELS) {
+        mipLevels++;
+    }
+
+    occlusionInternal->pyramidWidth = width;
+    occlusionInternal->pyramidHeight = height;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R32_SFLOAT;
+    imageInfo.extent = { width, height, 1 };
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    // rebuilt from the depth attachment every frame, other transient images can use its memory after culling
+    occlusionInternal->pyramidImage = createTransientImage(imageInfo, TRANSIENT_PASS_OCCLUSION, TRANSIENT_PASS_OCCLUSION,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = occlusionInternal->pyramidImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = mipLevels;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &occlusionInternal->pyramidView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid view!");
+    }
+
+    occlusionInternal->pyramidMipViewList.resize(mipLevels);
+    viewInfo.subresourceRange.levelCount = 1;
+
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        viewInfo.subresourceRange.baseMipLevel = level;
+
+        if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &occlusionInternal->pyramidMipViewList[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view!");
+        }
+    }
+
+    std::vector<VkDescriptorSetLayout> setLayoutList(mipLevels, occlusionInternal->reduceSetLayout);
+    occlusionInternal->reduceSetList.resize(mipLevels);
+
+    VkDescriptorSetAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocateInfo.descriptorPool = occlusionInternal->descriptorPool;
+    allocateInfo.descriptorSetCount = mipLevels;
+    allocateInfo.pSetLayouts = setLayoutList.data();
+
+    if (vkAllocateDescriptorSets(logicalDevice, &allocateInfo, occlusionInternal->reduceSetList.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+    }
+
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        VkDescriptorImageInfo sourceInfo = {};
+        sourceInfo.sampler = occlusionInternal->sampler;
+        sourceInfo.imageView = level == 0 ? swapchainInternal->depthView : occlusionInternal->pyramidMipViewList[level - 1];
+        sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+        VkDescriptorImageInfo destinationInfo = {};
+        destinationInfo.imageView = occlusionInternal->pyramidMipViewList[level];
+        destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkWriteDescriptorSet writeList[2] = {};
+        writeList[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeList[0].dstSet = occlusionInternal->reduceSetList[level];
+        writeList[0].dstBinding = 0;
+        writeList[0].descriptorCount = 1;
+        writeList[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writeList[0].pImageInfo = &sourceInfo;
+        writeList[1] = writeList[0];
+        writeList[1].dstBinding = 1;
+        writeList[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeList[1].pImageInfo = &destinationInfo;
+
+        vkUpdateDescriptorSets(logicalDevice, 2, writeList, 0, nullptr);
+    }
+
+    // the cull sets of every frame point at the new pyramid, nothing is in flight when it's rebuilt
+    VkDescriptorImageInfo pyramidInfo = {};
+    pyramidInfo.sampler = occlusionInternal->sampler;
+    pyramidInfo.imageView = occlusionInternal->pyramidView;
+    pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    for (auto& frame : occlusionInternal->frameList) {
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = frame.cullSet;
+        write.dstBinding = 3;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &pyramidInfo;
+
+        vkUpdateDescriptorSets(logicalDevice, 1, &write, 0, nullptr);
+    }
+
+    occlusionInternal->hasDepthHistory = false;
+}
+
+// Called with the depth attachment, the swapchain recreation already waited for the device
+void destroyOcclusionPyramid() {
+
+    if (occlusionInternal->pyramidImage == VK_NULL_HANDLE) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    vkFreeDescriptorSets(logicalDevice, occlusionInternal->descriptorPool, static_cast<uint32_t>(occlusionInternal->reduceSetList.size()), occlusionInternal->reduceSetList.data());
+
+    for (VkImageView view : occlusionInternal->pyramidMipViewList) {
+        vkDestroyImageView(logicalDevice, view, nullptr);
+    }
+
+    vkDestroyImageView(logicalDevice, occlusionInternal->pyramidView, nullptr);
+    destroyTransientImage(occlusionInternal->pyramidImage);
+
+    occlusionInternal->reduceSetList.clear();
+    occlusionInternal->pyramidMipViewList.clear();
+    occlusionInternal->pyramidView = VK_NULL_HANDLE;
+    occlusionInternal->pyramidImage = VK_NULL_HANDLE;
+    occlusionInternal->hasDepthHistory = false;
+}
+
+// Only called for the frame whose fence was just waited on, its buffers are idle
+static void growOcclusionFrame(OcclusionFrame* frame, uint32_t objectCount) {
+
+    if (objectCount <= frame->capacity) {
+        return;
+    }
+
+    uint32_t capacity = std::max(frame->capacity, MIN_OBJECT_CAPACITY);
+    while (capacity < objectCount) {
+        capacity *= 2;
+    }
+
+    if (frame->capacity > 0) {
+        BufferAllocation objectBuffer = frame->objectBuffer;
+        BufferAllocation commandBuffer = frame->commandBuffer;
+        BufferAllocation countBuffer = frame->countBuffer;
+
+        enqueueFrameDeletion([objectBuffer, commandBuffer, countBuffer]() mutable {
+            destroyBuffer(&objectBuffer);
+            destroyBuffer(&commandBuffer);
+            destroyBuffer(&countBuffer);
+        });
+    }
+
+    // every object can be its own draw group in the worst case
+    createBuffer(capacity * sizeof(OcclusionObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame->objectBuffer);
+    createBuffer(capacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->commandBuffer);
+    createBuffer(capacity * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &frame->countBuffer);
+
+    frame->capacity = capacity;
+
+    VkDescriptorBufferInfo bufferInfoList[3] = {};
+    bufferInfoList[0] = { frame->objectBuffer.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfoList[1] = { frame->commandBuffer.buffer, 0, VK_WHOLE_SIZE };
+    bufferInfoList[2] = { frame->countBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet writeList[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        writeList[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeList[i].dstSet = frame->cullSet;
+        writeList[i].dstBinding = i;
+        writeList[i].descriptorCount = 1;
+        writeList[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeList[i].pBufferInfo = &bufferInfoList[i];
+    }
+
+    vkUpdateDescriptorSets(deviceInternal->logicalDevice, 3, writeList, 0, nullptr);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [CULLING] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Runs after the visibility pass, objects it culled or that aren't resident never reach the gpu
+void updateOcclusionCulling(std::vector<VulkronBaseObject>& staticObjectsList, std::vector<VulkronBaseObject>& dynamicObjectsList, uint32_t frameIndex) {
+    VULKRON_TRACE_SCOPE("frame", "updateOcclusionCulling");
+
+    if (!occlusionInternal->isEnabled) {
+        return;
+    }
+
+    OcclusionFrame& frame = occlusionInternal->frameList[frameIndex];
+    auto& objectList = occlusionInternal->objectList;
+
+    objectList.clear();
+    frame.drawGroupList.clear();
+
+    // the visibility pass already dropped what's outside the frustum
+    for (auto [list, visibleList] : { std::make_pair(&staticObjectsList, &cullingInternal->visibleStaticList), std::make_pair(&dynamicObjectsList, &cullingInternal->visibleDynamicList) }) {
+        for (uint32_t index : *visibleList) {
+            const VulkronBaseObject& object = (*list)[index];
+            MeshInternal* mesh = object.mesh;
+
+            if (!object.occlusionCulling || !object.isVisible || object.isCulled || nullptr == object.pPipeline ||
+                nullptr == mesh || mesh->state != VULKRON_MESH_STATE_RESIDENT) {
+                continue;
+            }
+
+            objectList.push_back(&object);
+        }
+    }
+
+    std::sort(objectList.begin(), objectList.end(), [](const VulkronBaseObject* a, const VulkronBaseObject* b) {
+        return std::make_pair(*a->pPipeline, a->mesh) < std::make_pair(*b->pPipeline, b->mesh);
+    });
+
+    uint32_t objectCount = static_cast<uint32_t>(objectList.size());
+    growOcclusionFrame(&frame, objectCount);
+
+    OcclusionObject* pObjects = static_cast<OcclusionObject*>(frame.objectBuffer.memory.pMappedData);
+
+    for (uint32_t i = 0; i < objectCount; i++) {
+        const VulkronBaseObject& object = *objectList[i];
+        MeshInternal* mesh = object.mesh;
+
+        if (frame.drawGroupList.empty() || frame.drawGroupList.back().pipeline != *object.pPipeline || frame.drawGroupList.back().mesh != mesh) {
+            frame.drawGroupList.push_back({ *object.pPipeline, mesh, i, 0 });
+        }
+
+        frame.drawGroupList.back().commandCount++;
+
+        const VulkronMeshFileHeader& header = mesh->header;
+        const VulkronMeshFileLod& lod = mesh->lodList[std::min(object.lodIndex, static_cast<uint32_t>(mesh->lodList.size()) - 1)];
+
+        glm::vec4 center = getObjectMatrix(object) * glm::vec4(header.sphereCenter[0], header.sphereCenter[1], header.sphereCenter[2], 1.0f);
+
+        OcclusionObject& gpuObject = pObjects[i];
+        gpuObject.sphere = glm::vec4(glm::vec3(center), header.sphereRadius * object.scale);
+        gpuObject.indexCount = lod.indexCount;
+        gpuObject.instanceCount = object.instances;
+        gpuObject.firstIndex = lod.indexOffset;
+        gpuObject.drawGroup = static_cast<uint32_t>(frame.drawGroupList.size()) - 1;
+        gpuObject.commandIndex = i;
+        gpuObject.groupFirstCommand = frame.drawGroupList.back().firstCommand;
+    }
+
+    frame.objectCount = objectCount;
+}
+
+// Recorded on the primary command buffer before the render pass begins
+void recordOcclusionCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+
+    if (!occlusionInternal->isEnabled) {
+        return;
+    }
+
+    OcclusionFrame& frame = occlusionInternal->frameList[frameIndex];
+
+    if (occlusionInternal->pyramidImage == VK_NULL_HANDLE) {
+        createOcclusionPyramid();
+    }
+
+    bool hasDepthHistory = occlusionInternal->hasDepthHistory && cullingInternal->hasCamera;
+
+    recordDepthPyramid(commandBuffer);
+
+    if (frame.objectCount > 0) {
+        vkCmdFillBuffer(commandBuffer, frame.countBuffer.buffer, 0, frame.drawGroupList.size() * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier clearBarrier = {};
+        clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+        CullConstants constants = {};
+        constants.viewProjection = occlusionInternal->previousViewProjection;
+        constants.objectCount = frame.objectCount;
+        constants.pyramidWidth = occlusionInternal->pyramidWidth;
+        constants.pyramidHeight = occlusionInternal->pyramidHeight;
+        constants.flags = (hasDepthHistory ? CULL_FLAG_DEPTH_HISTORY : 0) | (occlusionInternal->isCompacting ? CULL_FLAG_COMPACT : 0);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionInternal->cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionInternal->cullPipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, occlusionInternal->cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+        vkCmdDispatch(commandBuffer, (frame.objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+
+    // draws read the compacted commands, and the render pass clears the depth the pyramid was just built from
+    VkMemoryBarrier drawBarrier = {};
+    drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+        0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+
+    // the depth this frame renders is tested against next frame
+    if (cullingInternal->hasCamera) {
+        occlusionInternal->previousViewProjection = cullingInternal->camera.projection * cullingInternal->camera.view;
+    }
+
+    occlusionInternal->hasDepthHistory = true;
+}
+
+static void recordDepthPyramid(VkCommandBuffer commandBuffer) {
+
+    uint32_t mipLevels = static_cast<uint32_t>(occlusionInternal->pyramidMipViewList.size());
+
+    // the pyramid is rebuilt every frame, the previous contents are discarded
+    VkImageMemoryBarrier barrierList[2] = {};
+    barrierList[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrierList[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrierList[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrierList[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrierList[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrierList[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrierList[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrierList[0].image = occlusionInternal->pyramidImage;
+    barrierList[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+    if (!occlusionInternal->hasDepthHistory) {
+        // nothing to reduce yet, the cull shader treats everything as visible
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, barrierList);
+        return;
+    }
+
+    barrierList[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrierList[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    barrierList[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrierList[1].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    barrierList[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrierList[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrierList[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrierList[1].image = swapchainInternal->depthImage;
+    barrierList[1].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, nullptr, 0, nullptr, 2, barrierList);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionInternal->reducePipeline);
+
+    VkExtent2D sourceExtent = swapchainInternal->swapChainExtent;
+
+    for (uint32_t level = 0; level < mipLevels; level++) {
+        ReduceConstants constants = {};
+        constants.sourceWidth = sourceExtent.width;
+        constants.sourceHeight = sourceExtent.height;
+        constants.destinationWidth = std::max(occlusionInternal->pyramidWidth >> level, 1u);
+        constants.destinationHeight = std::max(occlusionInternal->pyramidHeight >> level, 1u);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusionInternal->reducePipelineLayout, 0, 1, &occlusionInternal->reduceSetList[level], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, occlusionInternal->reducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceConstants), &constants);
+        vkCmdDispatch(commandBuffer, (constants.destinationWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (constants.destinationHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+        VkImageMemoryBarrier levelBarrier = barrierList[0];
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        levelBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        levelBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &levelBarrier);
+
+        sourceExtent = { constants.destinationWidth, constants.destinationHeight };
+    }
+}
+
+// Recorded into the static secondary command buffer, viewport and scissor are already set
+void recordOcclusionDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+
+    if (!occlusionInternal->isEnabled) {
+        return;
+    }
+
+    OcclusionFrame& frame = occlusionInternal->frameList[frameIndex];
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    for (uint32_t groupIndex = 0; groupIndex < frame.drawGroupList.size(); groupIndex++) {
+        const OcclusionDrawGroup& group = frame.drawGroupList[groupIndex];
+        VkDeviceSize vertexOffset = 0;
+        VkDeviceSize commandOffset = group.firstCommand * stride;
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, group.pipeline);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &group.mesh->vertexBuffer.buffer, &vertexOffset);
+        vkCmdBindIndexBuffer(commandBuffer, group.mesh->indexBuffer.buffer, 0, group.mesh->indexType);
+
+        if (occlusionInternal->isCompacting) {
+            deviceInternal->pfnCmdDrawIndexedIndirectCount(commandBuffer, frame.commandBuffer.buffer, commandOffset, frame.countBuffer.buffer, groupIndex * sizeof(uint32_t), group.commandCount, stride);
+        }
+        else if (device->gpuEnabledFeatures.multiDrawIndirect) {
+            vkCmdDrawIndexedIndirect(commandBuffer, frame.commandBuffer.buffer, commandOffset, group.commandCount, stride);
+        }
+        else {
+            for (uint32_t i = 0; i < group.commandCount; i++) {
+                vkCmdDrawIndexedIndirect(commandBuffer, frame.commandBuffer.buffer, commandOffset + i * stride, 1, stride);
+            }
+        }
+    }
+}
@@ -0,0 +1,311 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Asynchronous readback
+
+    1. a request only reserves a ticket, nothing is recorded until the next frame
+    2. the frame copies every request that fits the readback ring at the end of its command buffer,
+       after everything it rendered or dispatched
+    3. once that frame's fence has been waited on, MAX_FRAMES_IN_FLIGHT frames later, the data is copied
+       out of the ring and the space is handed back
+    4. results wait in a map until the caller takes them with their ticket
+
+    The ring is host cached when the device has such memory, reading uncached memory from the cpu is slow.
+    A request that doesn't fit waits for a later frame instead of stalling the queue.
+
+*/
+
+#include <numeric>
+
+ReadbackInternal*   readbackInternal    = new ReadbackInternal();
+
+static bool hasMemoryType(VkMemoryPropertyFlags propertyFlags);
+static void recordImageReadback(VkCommandBuffer commandBuffer, VkImage image, const PendingReadback& readback);
+static VulkronReadbackTicket queueReadback(PendingReadback readback);
+
+//-------------------------------------------------------------------------------------
+// SECTION [READBACK RING] ------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+void createReadbackRing(VkDeviceSize size) {
+
+    UploadRing& ring = readbackInternal->ring;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, getReadbackMemoryFlags(), &ring.staging);
+
+    ring.pMappedData = static_cast<uint8_t*>(ring.staging.memory.pMappedData);
+    ring.alignment = std::max<VkDeviceSize>(16, deviceInternal->gpuProperties.limits.optimalBufferCopyOffsetAlignment);
+    ring.head = 0;
+    ring.tail = 0;
+
+    VkMemoryPropertyFlags typeFlags = deviceInternal->gpuMemoryProperties.memoryTypes[ring.staging.memory.memoryTypeIndex].propertyFlags;
+    readbackInternal->isCoherent = (typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    readbackInternal->frameList.resize(MAX_FRAMES_IN_FLIGHT);
+    readbackInternal->frameRingHead.assign(MAX_FRAMES_IN_FLIGHT, 0);
+}
+
+// Requests still waiting are dropped, their tickets never become ready
+void destroyReadbackRing() {
+    destroyBuffer(&readbackInternal->ring.staging);
+
+    delete readbackInternal;
+    readbackInternal = nullptr;
+}
+
+// Host cached when the device has it, plain host visible memory otherwise
+VkMemoryPropertyFlags getReadbackMemoryFlags() {
+
+    VkMemoryPropertyFlags propertyFlags = getMemoryPropertyFlags(VULKRON_MEMORY_USAGE_GPU_WRITE_CPU_READ);
+
+    if (!hasMemoryType(propertyFlags)) {
+        propertyFlags = getMemoryPropertyFlags(VULKRON_MEMORY_USAGE_STAGING_TO_VRAM);
+    }
+
+    return propertyFlags;
+}
+
+static bool hasMemoryType(VkMemoryPropertyFlags propertyFlags) {
+
+    for (uint32_t i = 0; i < deviceInternal->gpuMemoryProperties.memoryTypeCount; i++) {
+        if ((deviceInternal->gpuMemoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [REQUESTS] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronReadbackBuffer(const VulkronBufferReadbackInfo* pInfo, VulkronReadbackTicket* pTicket) {
+
+    if (nullptr == pInfo || nullptr == pTicket || VK_NULL_HANDLE == pInfo->buffer || pInfo->size == 0 ||
+        pInfo->size > readbackInternal->ring.staging.size) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    PendingReadback readback = {};
+    readback.buffer = pInfo->buffer;
+    readback.bufferOffset = pInfo->offset;
+    readback.size = pInfo->size;
+
+    *pTicket = queueReadback(readback);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronReadbackImage(const VulkronImageReadbackInfo* pInfo, VulkronReadbackTicket* pTicket) {
+
+    if (nullptr == pInfo || nullptr == pTicket || pInfo->texelSize == 0) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    PendingReadback readback = {};
+    readback.image = *pInfo;
+
+    // the swapchain image is always read whole and in the layout the frame leaves it in
+    if (VK_NULL_HANDLE == pInfo->image) {
+        if (!readbackInternal->canReadSwapchain) {
+            return VULKRON_ERROR_INVALID_ARGUMENT;
+        }
+
+        readback.image.layout = deviceInternal->hasDynamicRendering ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        readback.image.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        readback.image.mipLevel = 0;
+        readback.image.arrayLayer = 0;
+        readback.image.offset = { 0, 0, 0 };
+        readback.image.extent = { swapchainInternal->swapChainExtent.width, swapchainInternal->swapChainExtent.height, 1 };
+    }
+
+    const VkExtent3D& extent = readback.image.extent;
+    readback.size = static_cast<VkDeviceSize>(extent.width) * extent.height * extent.depth * readback.image.texelSize;
+
+    if (readback.size == 0 || readback.size > readbackInternal->ring.staging.size) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pTicket = queueReadback(readback);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronGetReadbackResult(VulkronReadbackTicket ticket, std::vector<uint8_t>* pData) {
+
+    if (nullptr == pData) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    auto it = readbackInternal->resultMap.find(ticket);
+
+    if (it == readbackInternal->resultMap.end()) {
+        return ticket != 0 && ticket < readbackInternal->nextTicket ? VULKRON_NOT_READY : VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pData = std::move(it->second);
+    readbackInternal->resultMap.erase(it);
+
+    return VULKRON_SUCCESS;
+}
+
+static VulkronReadbackTicket queueReadback(PendingReadback readback) {
+
+    readback.ticket = readbackInternal->nextTicket++;
+    readbackInternal->pendingList.push_back(readback);
+
+    return readback.ticket;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [FRAME] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called after the frame's fence was waited on, everything it copied has landed
+void retireReadbacks(uint32_t frameIndex) {
+
+    UploadRing& ring = readbackInternal->ring;
+    std::vector<PendingReadback>& frameList = readbackInternal->frameList[frameIndex];
+
+    for (const PendingReadback& readback : frameList) {
+        std::vector<uint8_t>& data = readbackInternal->resultMap[readback.ticket];
+
+        // resized away from under the request, it finishes empty
+        if (readback.ringOffset == UINT64_MAX) {
+            continue;
+        }
+
+        if (!readbackInternal->isCoherent) {
+            invalidateMemory(ring.staging.memory, readback.ringOffset, readback.size);
+        }
+
+        data.assign(ring.pMappedData + readback.ringOffset, ring.pMappedData + readback.ringOffset + readback.size);
+    }
+
+    frameList.clear();
+    ring.tail = std::max(ring.tail, readbackInternal->frameRingHead[frameIndex]);
+}
+
+// Recorded last in the frame's command buffer, after the main pass. presentImage is null for offscreen frames.
+void recordReadbacks(VkCommandBuffer commandBuffer, VkImage presentImage, uint32_t frameIndex) {
+
+    UploadRing& ring = readbackInternal->ring;
+    std::vector<PendingReadback>& frameList = readbackInternal->frameList[frameIndex];
+
+    // in request order, a request that doesn't fit holds back the ones after it
+    while (!readbackInternal->pendingList.empty()) {
+        PendingReadback& readback = readbackInternal->pendingList.front();
+        bool isSwapchainRead = VK_NULL_HANDLE == readback.buffer && VK_NULL_HANDLE == readback.image.image;
+
+        // image copies need bufferOffset to be a multiple of the texel size, 12 byte texels aren't covered by the ring's alignment
+        VkDeviceSize alignment = VK_NULL_HANDLE == readback.buffer ? std::lcm(ring.alignment, static_cast<VkDeviceSize>(readback.image.texelSize)) : ring.alignment;
+
+        if ((isSwapchainRead && VK_NULL_HANDLE == presentImage) || !ringAllocate(&ring, readback.size, alignment, &readback.ringOffset)) {
+            break;
+        }
+
+        frameList.push_back(readback);
+        readbackInternal->pendingList.pop_front();
+    }
+
+    readbackInternal->frameRingHead[frameIndex] = ring.head;
+
+    if (frameList.empty()) {
+        return;
+    }
+
+    // whatever the frame wrote before it is read
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    for (PendingReadback& readback : frameList) {
+        if (VK_NULL_HANDLE != readback.buffer) {
+            VkBufferCopy region = {};
+            region.srcOffset = readback.bufferOffset;
+            region.dstOffset = readback.ringOffset;
+            region.size = readback.size;
+
+            vkCmdCopyBuffer(commandBuffer, readback.buffer, ring.staging.buffer, 1, &region);
+            continue;
+        }
+
+        VkImage image = readback.image.image;
+
+        if (VK_NULL_HANDLE == image) {
+            const VkExtent3D& extent = readback.image.extent;
+
+            if (extent.width > swapchainInternal->swapChainExtent.width || extent.height > swapchainInternal->swapChainExtent.height) {
+                readback.ringOffset = UINT64_MAX;
+                continue;
+            }
+
+            image = presentImage;
+        }
+
+        recordImageReadback(commandBuffer, image, readback);
+    }
+
+    // makes the copies visible to the host once the fence has signaled
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// GENERAL can be copied from as it is, anything else goes to TRANSFER_SRC and back
+static void recordImageReadback(VkCommandBuffer commandBuffer, VkImage image, const PendingReadback& readback) {
+
+    const VulkronImageReadbackInfo& info = readback.image;
+    bool isTransitioned = info.layout != VK_IMAGE_LAYOUT_GENERAL;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = info.aspect;
+    barrier.subresourceRange.baseMipLevel = info.mipLevel;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = info.arrayLayer;
+    barrier.subresourceRange.layerCount = 1;
+
+    if (isTransitioned) {
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = info.layout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = readback.ringOffset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = info.aspect;
+    region.imageSubresource.mipLevel = info.mipLevel;
+    region.imageSubresource.baseArrayLayer = info.arrayLayer;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = info.offset;
+    region.imageExtent = info.extent;
+
+    vkCmdCopyImageToBuffer(commandBuffer, image, isTransitioned ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+        readbackInternal->ring.staging.buffer, 1, &region);
+
+    if (isTransitioned) {
+        // back in the layout whoever uses the image next expects it in
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = info.layout;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
@@ -0,0 +1,789 @@
+#include "VulkronInternal.h"
+
+/*
+
+    SPIR-V reflection and the layout cache
+
+    1. every module createShaderModule builds is reflected while its code is still around, only
+       the descriptor bindings, the push constant block, the vertex inputs and the spec constant sizes are kept.
+       A module the reflection can't handle still loads, the error is only thrown by vulkronReflectPipelineLayout
+    2. a pipeline layout is reflected by merging its stages, bindings used by several stages get every stage's flag
+    3. set layouts and pipeline layouts are cached by their full description, identical ones are created once
+
+    Since identical descriptions return the same handles, two pipelines reflected from shaders with the same
+    interface share a VkPipelineLayout, and descriptor sets bound for one stay valid when switching to the other.
+
+*/
+
+LayoutCacheInternal*    layoutCache     = new LayoutCacheInternal();
+
+static const uint32_t                       SPIRV_MAGIC             = 0x07230203;
+static const uint32_t                       SPIRV_HEADER_WORDS      = 5;
+
+// opcodes, decorations and storage classes the reflection looks at, numbered as in the SPIR-V spec
+enum SpirvOp {
+    SPIRV_OP_ENTRY_POINT            = 15,
+    SPIRV_OP_TYPE_BOOL              = 20,
+    SPIRV_OP_TYPE_INT               = 21,
+    SPIRV_OP_TYPE_FLOAT             = 22,
+    SPIRV_OP_TYPE_VECTOR            = 23,
+    SPIRV_OP_TYPE_MATRIX            = 24,
+    SPIRV_OP_TYPE_IMAGE             = 25,
+    SPIRV_OP_TYPE_SAMPLER           = 26,
+    SPIRV_OP_TYPE_SAMPLED_IMAGE     = 27,
+    SPIRV_OP_TYPE_ARRAY             = 28,
+    SPIRV_OP_TYPE_RUNTIME_ARRAY     = 29,
+    SPIRV_OP_TYPE_STRUCT            = 30,
+    SPIRV_OP_TYPE_POINTER           = 32,
+    SPIRV_OP_TYPE_FORWARD_POINTER   = 39,
+    SPIRV_OP_CONSTANT               = 43,
+    SPIRV_OP_SPEC_CONSTANT_TRUE     = 48,
+    SPIRV_OP_SPEC_CONSTANT_FALSE    = 49,
+    SPIRV_OP_SPEC_CONSTANT          = 50,
+    SPIRV_OP_VARIABLE               = 59,
+    SPIRV_OP_DECORATE               = 71,
+    SPIRV_OP_MEMBER_DECORATE        = 72
+};
+
+enum SpirvDecoration {
+    SPIRV_DECORATION_SPEC_ID        = 1,
+    SPIRV_DECORATION_BUFFER_BLOCK   = 3,
+    SPIRV_DECORATION_ARRAY_STRIDE   = 6,
+    SPIRV_DECORATION_MATRIX_STRIDE  = 7,
+    SPIRV_DECORATION_BUILT_IN       = 11,
+    SPIRV_DECORATION_LOCATION       = 30,
+    SPIRV_DECORATION_BINDING        = 33,
+    SPIRV_DECORATION_DESCRIPTOR_SET = 34,
+    SPIRV_DECORATION_OFFSET         = 35
+};
+
+enum SpirvStorageClass {
+    SPIRV_STORAGE_UNIFORM_CONSTANT  = 0,
+    SPIRV_STORAGE_INPUT             = 1,
+    SPIRV_STORAGE_UNIFORM           = 2,
+    SPIRV_STORAGE_PUSH_CONSTANT     = 9,
+    SPIRV_STORAGE_STORAGE_BUFFER    = 12
+};
+
+static const uint32_t                       SPIRV_EXECUTION_MODEL_VERTEX = 0;
+static const uint32_t                       SPIRV_DIM_BUFFER        = 5;
+static const uint32_t                       SPIRV_DIM_SUBPASS_DATA  = 6;
+
+// Everything known about one result id, only what the reflection needs
+typedef struct SpirvId {
+    uint32_t                                opcode              = 0;
+    std::vector<uint32_t>                   operandList;                    // the instruction's words after the result id
+    uint32_t                                set                 = UINT32_MAX;
+    uint32_t                                binding             = UINT32_MAX;
+    uint32_t                                location            = UINT32_MAX;
+    uint32_t                                specId              = UINT32_MAX;
+    uint32_t                                arrayStride         = 0;
+    bool                                    isBuiltIn           = false;
+    bool                                    isBufferBlock       = false;
+    std::vector<uint32_t>                   memberOffsetList;
+    std::vector<uint32_t>                   memberMatrixStrideList;
+} SpirvId;
+
+static void releaseShaderCode(const ShaderReflection& reflection);
+static ShaderReflection parseSpirv(const uint32_t* pCode, size_t wordCount);
+static const SpirvId& getSpirvType(const std::vector<SpirvId>& idList, uint32_t typeId);
+static uint32_t getSpirvArrayLength(const std::vector<SpirvId>& idList, const SpirvId& arrayType);
+static uint32_t getSpirvTypeSize(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t matrixStride);
+static VkDescriptorType getSpirvDescriptorType(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t storageClass);
+static VkFormat getSpirvInputFormat(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t* pSize);
+static VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindingList);
+static VkPipelineLayout getPipelineLayout(const VkPipelineLayoutCreateInfo& layoutInfo);
+
+//-------------------------------------------------------------------------------------
+// SECTION [REFLECTION] ---------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called by createShaderModule for every module on the engine's device
+void reflectShaderModule(VkShaderModule shaderModule, const uint32_t* pCode, size_t wordCount) {
+
+    ShaderReflection reflection = {};
+
+    // valid shaders the reflection doesn't cover (runtime arrays, 16 bit inputs, ...) are only marked,
+    // they fail in vulkronReflectPipelineLayout instead of at load
+    try {
+        reflection = parseSpirv(pCode, wordCount);
+    }
+    catch (const std::runtime_error& error) {
+        reflection = {};
+        reflection.error = error.what();
+    }
+
+    std::vector<uint32_t> code(pCode, pCode + wordCount);
+    reflection.codeHash = LayoutKeyHash()(code);
+
+    std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+    // lets pipelines built from separately loaded copies of the same shader match, the code is compared
+    // within the bucket so two shaders can't share an id through a hash collision
+    std::vector<ShaderCode>& codeList = layoutCache->codeMap[reflection.codeHash];
+    auto entry = std::find_if(codeList.begin(), codeList.end(), [&code](const ShaderCode& shaderCode) { return shaderCode.code == code; });
+
+    if (entry == codeList.end()) {
+        codeList.push_back({ std::move(code), layoutCache->nextCodeId++, 0 });
+        entry = codeList.end() - 1;
+    }
+
+    entry->moduleCount++;
+    reflection.codeId = entry->id;
+
+    layoutCache->reflectionMap[shaderModule] = std::move(reflection);
+}
+
+// 0 for modules that weren't built by createShaderModule
+uint64_t getShaderCodeId(VkShaderModule shaderModule) {
+
+    std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+    auto it = layoutCache->reflectionMap.find(shaderModule);
+    return it == layoutCache->reflectionMap.end() ? 0 : it->second.codeId;
+}
+
+// False for modules that weren't built by createShaderModule or couldn't be reflected, their constants can't be checked
+bool getShaderSpecConstants(VkShaderModule shaderModule, std::map<uint32_t, uint32_t>* pSizeMap) {
+
+    std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+    auto it = layoutCache->reflectionMap.find(shaderModule);
+
+    if (it == layoutCache->reflectionMap.end() || !it->second.error.empty()) {
+        return false;
+    }
+
+    *pSizeMap = it->second.specConstantSizeMap;
+    return true;
+}
+
+// Handles are reused once destroyed, the reflection has to go with the module
+void destroyShaderModule(VkShaderModule shaderModule) {
+
+    {
+        std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+        auto iterator = layoutCache->reflectionMap.find(shaderModule);
+
+        if (iterator != layoutCache->reflectionMap.end()) {
+            releaseShaderCode(iterator->second);
+            layoutCache->reflectionMap.erase(iterator);
+        }
+    }
+
+    vkDestroyShaderModule(deviceInternal->logicalDevice, shaderModule, nullptr);
+}
+
+// The code is only kept while a module built from it exists, called with the mutex held
+static void releaseShaderCode(const ShaderReflection& reflection) {
+
+    auto bucket = layoutCache->codeMap.find(reflection.codeHash);
+
+    if (bucket == layoutCache->codeMap.end()) {
+        return;
+    }
+
+    std::vector<ShaderCode>& codeList = bucket->second;
+
+    for (auto entry = codeList.begin(); entry != codeList.end(); entry++) {
+        if (entry->id == reflection.codeId) {
+            if (--entry->moduleCount == 0) {
+                codeList.erase(entry);
+            }
+            break;
+        }
+    }
+
+    if (codeList.empty()) {
+        layoutCache->codeMap.erase(bucket);
+    }
+}
+
+// Only the types and decorations reachable from descriptor, push constant, input variables and spec constants are used,
+// the function bodies are skipped
+static ShaderReflection parseSpirv(const uint32_t* pCode, size_t wordCount) {
+
+    if (wordCount < SPIRV_HEADER_WORDS || pCode[0] != SPIRV_MAGIC) {
+        throw std::runtime_error("failed to reflect shader module!");
+    }
+
+    std::vector<SpirvId> idList(pCode[3]);
+    std::vector<uint32_t> variableList;
+    std::vector<uint32_t> specConstantList;
+    bool isVertexShader = false;
+
+    for (size_t offset = SPIRV_HEADER_WORDS; offset < wordCount;) {
+        uint32_t opcode = pCode[offset] & 0xFFFF;
+        uint32_t length = pCode[offset] >> 16;
+
+        if (length == 0 || offset + length > wordCount) {
+            throw std::runtime_error("failed to reflect shader module!");
+        }
+
+        const uint32_t* pWords = pCode + offset + 1;
+        uint32_t operandCount = length - 1;
+
+        switch (opcode) {
+        // only a vertex stage's inputs are vertex attributes
+        case SPIRV_OP_ENTRY_POINT:
+            if (operandCount >= 1 && pWords[0] == SPIRV_EXECUTION_MODEL_VERTEX) {
+                isVertexShader = true;
+            }
+            break;
+
+        case SPIRV_OP_TYPE_BOOL:
+        case SPIRV_OP_TYPE_INT:
+        case SPIRV_OP_TYPE_FLOAT:
+        case SPIRV_OP_TYPE_VECTOR:
+        case SPIRV_OP_TYPE_MATRIX:
+        case SPIRV_OP_TYPE_IMAGE:
+        case SPIRV_OP_TYPE_SAMPLER:
+        case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        case SPIRV_OP_TYPE_ARRAY:
+        case SPIRV_OP_TYPE_RUNTIME_ARRAY:
+        case SPIRV_OP_TYPE_STRUCT:
+        case SPIRV_OP_TYPE_POINTER: {
+            // operands after the result id, the leading ones name earlier declarations
+            uint32_t minOperandCount = 0;
+            uint32_t idOperandCount = 0;
+
+            switch (opcode) {
+            case SPIRV_OP_TYPE_INT:             minOperandCount = 2;                            break;
+            case SPIRV_OP_TYPE_FLOAT:           minOperandCount = 1;                            break;
+            case SPIRV_OP_TYPE_VECTOR:
+            case SPIRV_OP_TYPE_MATRIX:          minOperandCount = 2;    idOperandCount = 1;     break;
+            case SPIRV_OP_TYPE_IMAGE:           minOperandCount = 7;                            break;
+            case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+            case SPIRV_OP_TYPE_RUNTIME_ARRAY:   minOperandCount = 1;    idOperandCount = 1;     break;
+            case SPIRV_OP_TYPE_ARRAY:           minOperandCount = 2;    idOperandCount = 1;     break;  // the length is checked when it's read
+            case SPIRV_OP_TYPE_STRUCT:          idOperandCount = operandCount > 0 ? operandCount - 1 : 0;   break;
+            case SPIRV_OP_TYPE_POINTER:         minOperandCount = 2;                            break;  // may point at a later type
+            }
+
+            if (operandCount < 1 + minOperandCount || pWords[0] >= idList.size()) {
+                throw std::runtime_error("failed to reflect shader module!");
+            }
+
+            bool isForwardDeclared = opcode == SPIRV_OP_TYPE_POINTER && idList[pWords[0]].opcode == SPIRV_OP_TYPE_FORWARD_POINTER;
+
+            if (idList[pWords[0]].opcode != 0 && !isForwardDeclared) {
+                throw std::runtime_error("failed to reflect shader module!");
+            }
+
+            // only what was declared before, so the type walks below can't loop
+            for (uint32_t i = 1; i <= idOperandCount; i++) {
+                if (pWords[i] >= idList.size() || idList[pWords[i]].opcode == 0) {
+                    throw std::runtime_error("failed to reflect shader module!");
+                }
+            }
+
+            idList[pWords[0]].opcode = opcode;
+            idList[pWords[0]].operandList.assign(pWords + 1, pWords + operandCount);
+            break;
+        }
+
+        // buffer references name their pointer type before it's declared
+        case SPIRV_OP_TYPE_FORWARD_POINTER:
+            if (operandCount >= 1 && pWords[0] < idList.size() && idList[pWords[0]].opcode == 0) {
+                idList[pWords[0]].opcode = opcode;
+            }
+            break;
+
+        // result type comes first for these two
+        case SPIRV_OP_CONSTANT:
+        case SPIRV_OP_VARIABLE:
+            if (operandCount >= 3 && pWords[1] < idList.size()) {
+                idList[pWords[1]].opcode = opcode;
+                idList[pWords[1]].operandList = { pWords[0], pWords[2] };
+
+                if (opcode == SPIRV_OP_VARIABLE) {
+                    variableList.push_back(pWords[1]);
+                }
+            }
+            break;
+
+        // laid out like a constant, arrays sized by one reflect with its default
+        case SPIRV_OP_SPEC_CONSTANT_TRUE:
+        case SPIRV_OP_SPEC_CONSTANT_FALSE:
+        case SPIRV_OP_SPEC_CONSTANT:
+            if (operandCount >= 2 && pWords[1] < idList.size()) {
+                idList[pWords[1]].opcode = opcode;
+                idList[pWords[1]].operandList = { pWords[0], opcode == SPIRV_OP_SPEC_CONSTANT && operandCount >= 3 ? pWords[2] : (opcode == SPIRV_OP_SPEC_CONSTANT_TRUE ? 1u : 0u) };
+                specConstantList.push_back(pWords[1]);
+            }
+            break;
+
+        case SPIRV_OP_DECORATE:
+            if (operandCount >= 2 && pWords[0] < idList.size()) {
+                SpirvId& target = idList[pWords[0]];
+                uint32_t literal = operandCount >= 3 ? pWords[2] : 0;
+
+                switch (pWords[1]) {
+                case SPIRV_DECORATION_BUFFER_BLOCK:     target.isBufferBlock = true;    break;
+                case SPIRV_DECORATION_ARRAY_STRIDE:     target.arrayStride = literal;   break;
+                case SPIRV_DECORATION_BUILT_IN:         target.isBuiltIn = true;        break;
+                case SPIRV_DECORATION_LOCATION:         target.location = literal;      break;
+                case SPIRV_DECORATION_BINDING:          target.binding = literal;       break;
+                case SPIRV_DECORATION_DESCRIPTOR_SET:   target.set = literal;           break;
+                case SPIRV_DECORATION_SPEC_ID:          target.specId = literal;        break;
+                }
+            }
+            break;
+
+        case SPIRV_OP_MEMBER_DECORATE:
+            if (operandCount >= 4 && pWords[0] < idList.size()) {
+                SpirvId& target = idList[pWords[0]];
+                uint32_t member = pWords[1];
+
+                // the struct comes later, but it can't have more members than the module has words
+                if (member >= wordCount) {
+                    throw std::runtime_error("failed to reflect shader module!");
+                }
+
+                if (pWords[2] == SPIRV_DECORATION_OFFSET) {
+                    target.memberOffsetList.resize(std::max<size_t>(target.memberOffsetList.size(), member + 1), 0);
+                    target.memberOffsetList[member] = pWords[3];
+                }
+                else if (pWords[2] == SPIRV_DECORATION_MATRIX_STRIDE) {
+                    target.memberMatrixStrideList.resize(std::max<size_t>(target.memberMatrixStrideList.size(), member + 1), 0);
+                    target.memberMatrixStrideList[member] = pWords[3];
+                }
+            }
+            break;
+        }
+
+        offset += length;
+    }
+
+    ShaderReflection reflection = {};
+    uint32_t pushConstantEnd = 0;
+    reflection.pushConstantOffset = UINT32_MAX;
+
+    for (uint32_t variableId : variableList) {
+        const SpirvId& variable = idList[variableId];
+        uint32_t storageClass = variable.operandList[1];
+        const SpirvId& pointer = getSpirvType(idList, variable.operandList[0]);
+
+        if (pointer.opcode != SPIRV_OP_TYPE_POINTER) {
+            continue;
+        }
+
+        uint32_t typeId = pointer.operandList[1];
+
+        switch (storageClass) {
+        case SPIRV_STORAGE_UNIFORM_CONSTANT:
+        case SPIRV_STORAGE_UNIFORM:
+        case SPIRV_STORAGE_STORAGE_BUFFER: {
+            if (variable.set == UINT32_MAX || variable.binding == UINT32_MAX) {
+                break;
+            }
+
+            // arrays of descriptors, sized arrays only
+            uint32_t descriptorCount = 1;
+            while (getSpirvType(idList, typeId).opcode == SPIRV_OP_TYPE_ARRAY || getSpirvType(idList, typeId).opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+                const SpirvId& array = getSpirvType(idList, typeId);
+
+                if (array.opcode == SPIRV_OP_TYPE_RUNTIME_ARRAY) {
+                    throw std::runtime_error("failed to reflect shader module, runtime descriptor arrays need a hand built layout!");
+                }
+
+                descriptorCount *= getSpirvArrayLength(idList, array);
+                typeId = array.operandList[0];
+            }
+
+            reflection.bindingList.push_back({ variable.set, variable.binding, getSpirvDescriptorType(idList, typeId, storageClass), descriptorCount });
+            break;
+        }
+
+        case SPIRV_STORAGE_PUSH_CONSTANT: {
+            const SpirvId& block = getSpirvType(idList, typeId);
+
+            for (size_t i = 0; i < block.operandList.size(); i++) {
+                uint32_t memberOffset = i < block.memberOffsetList.size() ? block.memberOffsetList[i] : 0;
+                uint32_t matrixStride = i < block.memberMatrixStrideList.size() ? block.memberMatrixStrideList[i] : 0;
+
+                reflection.pushConstantOffset = std::min(reflection.pushConstantOffset, memberOffset);
+                pushConstantEnd = std::max(pushConstantEnd, memberOffset + getSpirvTypeSize(idList, block.operandList[i], matrixStride));
+            }
+            break;
+        }
+
+        case SPIRV_STORAGE_INPUT: {
+            if (!isVertexShader || variable.isBuiltIn || variable.location == UINT32_MAX) {
+                break;
+            }
+
+            // a matrix input takes one location per column
+            uint32_t columnCount = 1;
+            if (getSpirvType(idList, typeId).opcode == SPIRV_OP_TYPE_MATRIX) {
+                columnCount = idList[typeId].operandList[1];
+                typeId = idList[typeId].operandList[0];
+            }
+
+            uint32_t size = 0;
+            VkFormat format = getSpirvInputFormat(idList, typeId, &size);
+
+            for (uint32_t column = 0; column < columnCount; column++) {
+                // the offset holds the size until the stages are merged and the binding is packed
+                reflection.inputList.push_back({ variable.location + column, 0, format, size });
+            }
+            break;
+        }
+        }
+    }
+
+    if (reflection.pushConstantOffset == UINT32_MAX) {
+        reflection.pushConstantOffset = 0;
+    }
+
+    reflection.pushConstantSize = pushConstantEnd - reflection.pushConstantOffset;
+
+    // spec constants without a SpecId are plain constants to the driver
+    for (uint32_t constantId : specConstantList) {
+        const SpirvId& constant = idList[constantId];
+
+        if (constant.specId != UINT32_MAX) {
+            reflection.specConstantSizeMap[constant.specId] = getSpirvTypeSize(idList, constant.operandList[0], 0);
+        }
+    }
+
+    return reflection;
+}
+
+// Ids taken from operands, the declaration has to be the kind the operand names.
+// Types were checked for their operand count when they were parsed.
+static const SpirvId& getSpirvType(const std::vector<SpirvId>& idList, uint32_t typeId) {
+
+    if (typeId >= idList.size() || idList[typeId].opcode < SPIRV_OP_TYPE_BOOL || idList[typeId].opcode > SPIRV_OP_TYPE_POINTER) {
+        throw std::runtime_error("failed to reflect shader module!");
+    }
+
+    return idList[typeId];
+}
+
+// A length from OpSpecConstantOp has no literal to read, those arrays aren't reflected
+static uint32_t getSpirvArrayLength(const std::vector<SpirvId>& idList, const SpirvId& arrayType) {
+
+    uint32_t lengthId = arrayType.operandList[1];
+    bool isLiteral = lengthId < idList.size() && (idList[lengthId].opcode == SPIRV_OP_CONSTANT || idList[lengthId].opcode == SPIRV_OP_SPEC_CONSTANT);
+
+    if (!isLiteral) {
+        throw std::runtime_error("failed to reflect shader module!");
+    }
+
+    return idList[lengthId].operandList[1];
+}
+
+// Explicit layout sizes, the offsets and strides the compiler decorated the block with
+static uint32_t getSpirvTypeSize(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t matrixStride) {
+
+    const SpirvId& type = getSpirvType(idList, typeId);
+
+    switch (type.opcode) {
+    case SPIRV_OP_TYPE_BOOL:
+        return sizeof(VkBool32);
+
+    case SPIRV_OP_TYPE_INT:
+    case SPIRV_OP_TYPE_FLOAT:
+        return type.operandList[0] / 8;
+
+    case SPIRV_OP_TYPE_VECTOR:
+        return type.operandList[1] * getSpirvTypeSize(idList, type.operandList[0], 0);
+
+    case SPIRV_OP_TYPE_MATRIX:
+        return type.operandList[1] * (matrixStride != 0 ? matrixStride : getSpirvTypeSize(idList, type.operandList[0], 0));
+
+    case SPIRV_OP_TYPE_ARRAY: {
+        uint32_t length = getSpirvArrayLength(idList, type);
+        uint32_t stride = type.arrayStride != 0 ? type.arrayStride : getSpirvTypeSize(idList, type.operandList[0], matrixStride);
+        return length * stride;
+    }
+
+    case SPIRV_OP_TYPE_STRUCT: {
+        uint32_t size = 0;
+
+        for (size_t i = 0; i < type.operandList.size(); i++) {
+            uint32_t memberOffset = i < type.memberOffsetList.size() ? type.memberOffsetList[i] : 0;
+            uint32_t memberStride = i < type.memberMatrixStrideList.size() ? type.memberMatrixStrideList[i] : 0;
+            size = std::max(size, memberOffset + getSpirvTypeSize(idList, type.operandList[i], memberStride));
+        }
+
+        return size;
+    }
+    }
+
+    return 0;
+}
+
+static VkDescriptorType getSpirvDescriptorType(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t storageClass) {
+
+    const SpirvId& type = getSpirvType(idList, typeId);
+
+    if (storageClass == SPIRV_STORAGE_STORAGE_BUFFER) {
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+
+    // older compilers mark storage buffers as uniform blocks with BufferBlock
+    if (storageClass == SPIRV_STORAGE_UNIFORM) {
+        return type.isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    }
+
+    switch (type.opcode) {
+    case SPIRV_OP_TYPE_SAMPLER:
+        return VK_DESCRIPTOR_TYPE_SAMPLER;
+
+    case SPIRV_OP_TYPE_SAMPLED_IMAGE:
+        return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+    case SPIRV_OP_TYPE_IMAGE: {
+        // sampled type, dim, depth, arrayed, multisampled, sampled
+        uint32_t dim = type.operandList[1];
+        bool isStorage = type.operandList[5] == 2;
+
+        if (dim == SPIRV_DIM_BUFFER) {
+            return isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        }
+
+        if (dim == SPIRV_DIM_SUBPASS_DATA) {
+            return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        }
+
+        return isStorage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    }
+    }
+
+    throw std::runtime_error("failed to reflect shader module, unsupported descriptor type!");
+}
+
+static VkFormat getSpirvInputFormat(const std::vector<SpirvId>& idList, uint32_t typeId, uint32_t* pSize) {
+
+    static const VkFormat floatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+    static const VkFormat intFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+    static const VkFormat uintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+    uint32_t componentCount = 1;
+    if (getSpirvType(idList, typeId).opcode == SPIRV_OP_TYPE_VECTOR) {
+        componentCount = idList[typeId].operandList[1];
+        typeId = idList[typeId].operandList[0];
+    }
+
+    const SpirvId& component = getSpirvType(idList, typeId);
+
+    if (componentCount == 0 || componentCount > 4 || component.operandList.empty() || component.operandList[0] != 32) {
+        throw std::runtime_error("failed to reflect shader module, unsupported vertex input!");
+    }
+
+    *pSize = componentCount * sizeof(uint32_t);
+
+    if (component.opcode == SPIRV_OP_TYPE_FLOAT) {
+        return floatFormats[componentCount - 1];
+    }
+
+    bool isSigned = component.operandList.size() > 1 && component.operandList[1] != 0;
+
+    return isSigned ? intFormats[componentCount - 1] : uintFormats[componentCount - 1];
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [LAYOUT CACHE] -------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronReflectPipelineLayout(const VkPipelineShaderStageCreateInfo* pStages, uint32_t stageCount, VulkronPipelineLayoutReflection* pReflection) {
+
+    if (nullptr == pStages || stageCount == 0 || nullptr == pReflection) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // set, binding -> merged over every stage
+    std::map<std::pair<uint32_t, uint32_t>, VkDescriptorSetLayoutBinding> bindingMap;
+    VkPushConstantRange pushConstantRange = { 0, UINT32_MAX, 0 };
+    uint32_t pushConstantEnd = 0;
+    std::vector<VkVertexInputAttributeDescription> inputList;
+
+    {
+        std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+        for (uint32_t i = 0; i < stageCount; i++) {
+            auto iterator = layoutCache->reflectionMap.find(pStages[i].module);
+
+            if (iterator == layoutCache->reflectionMap.end()) {
+                throw std::runtime_error("failed to reflect pipeline layout, the shader module wasn't created by the engine!");
+            }
+
+            const ShaderReflection& reflection = iterator->second;
+            VkShaderStageFlags stage = pStages[i].stage;
+
+            if (!reflection.error.empty()) {
+                throw std::runtime_error(reflection.error);
+            }
+
+            for (const ReflectedBinding& reflectedBinding : reflection.bindingList) {
+                auto [entry, isNew] = bindingMap.try_emplace({ reflectedBinding.set, reflectedBinding.binding },
+                    VkDescriptorSetLayoutBinding{ reflectedBinding.binding, reflectedBinding.type, reflectedBinding.count, 0, nullptr });
+
+                if (!isNew && (entry->second.descriptorType != reflectedBinding.type || entry->second.descriptorCount != reflectedBinding.count)) {
+                    throw std::runtime_error("failed to reflect pipeline layout, stages disagree on a binding!");
+                }
+
+                entry->second.stageFlags |= stage;
+            }
+
+            if (reflection.pushConstantSize != 0) {
+                pushConstantRange.stageFlags |= stage;
+                pushConstantRange.offset = std::min(pushConstantRange.offset, reflection.pushConstantOffset);
+                pushConstantEnd = std::max(pushConstantEnd, reflection.pushConstantOffset + reflection.pushConstantSize);
+            }
+
+            if (stage == VK_SHADER_STAGE_VERTEX_BIT) {
+                inputList = reflection.inputList;
+            }
+        }
+    }
+
+    *pReflection = {};
+
+    // sets below the highest one used still need a layout, an empty one
+    uint32_t setCount = bindingMap.empty() ? 0 : bindingMap.rbegin()->first.first + 1;
+    std::vector<std::vector<VkDescriptorSetLayoutBinding>> setBindingList(setCount);
+
+    for (const auto& [key, binding] : bindingMap) {
+        setBindingList[key.first].push_back(binding);
+    }
+
+    for (const auto& bindingList : setBindingList) {
+        pReflection->setLayoutList.push_back(getSetLayout(bindingList));
+    }
+
+    if (pushConstantRange.stageFlags != 0) {
+        pushConstantRange.size = pushConstantEnd - pushConstantRange.offset;
+        pReflection->pushConstantRangeList.push_back(pushConstantRange);
+    }
+
+    // float vertices packed in location order, the engine's mesh formats come from vulkronGetVertexDescriptions instead
+    std::sort(inputList.begin(), inputList.end(), [](const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b) {
+        return a.location < b.location;
+    });
+
+    uint32_t stride = 0;
+    for (VkVertexInputAttributeDescription& attribute : inputList) {
+        uint32_t size = attribute.offset;
+        attribute.offset = stride;
+        stride += size;
+    }
+
+    pReflection->vertexAttributeList = inputList;
+    pReflection->vertexBinding = { 0, stride, VK_VERTEX_INPUT_RATE_VERTEX };
+
+    VkPipelineLayoutCreateInfo layoutInfo = vulkronPipelineLayoutInfo(static_cast<uint32_t>(pReflection->setLayoutList.size()), pReflection->setLayoutList.data(),
+        static_cast<uint32_t>(pReflection->pushConstantRangeList.size()), pReflection->pushConstantRangeList.data());
+
+    pReflection->pipelineLayout = getPipelineLayout(layoutInfo);
+
+    return VULKRON_SUCCESS;
+}
+
+// Hand built layouts share the cache, the set layouts in pInfo have to outlive the returned layout
+VulkronResult vulkronGetCachedPipelineLayout(const VkPipelineLayoutCreateInfo* pInfo, VkPipelineLayout* pLayout) {
+
+    if (nullptr == pInfo || nullptr == pLayout) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pLayout = getPipelineLayout(*pInfo);
+
+    return VULKRON_SUCCESS;
+}
+
+void destroyLayoutCache() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    for (const auto& [key, pipelineLayout] : layoutCache->pipelineLayoutMap) {
+        vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+    }
+
+    for (const auto& [key, setLayout] : layoutCache->setLayoutMap) {
+        vkDestroyDescriptorSetLayout(logicalDevice, setLayout, nullptr);
+    }
+
+    delete layoutCache;
+    layoutCache = nullptr;
+}
+
+static VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindingList) {
+
+    std::vector<uint32_t> key;
+    key.reserve(bindingList.size() * 4);
+
+    for (const VkDescriptorSetLayoutBinding& binding : bindingList) {
+        key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags });
+    }
+
+    std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+    auto iterator = layoutCache->setLayoutMap.find(key);
+    if (iterator != layoutCache->setLayoutMap.end()) {
+        return iterator->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+    setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.bindingCount = static_cast<uint32_t>(bindingList.size());
+    setLayoutInfo.pBindings = bindingList.data();
+
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(deviceInternal->logicalDevice, &setLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    layoutCache->setLayoutMap.emplace(std::move(key), setLayout);
+
+    return setLayout;
+}
+
+static VkPipelineLayout getPipelineLayout(const VkPipelineLayoutCreateInfo& layoutInfo) {
+
+    std::vector<uint32_t> key;
+    key.push_back(layoutInfo.flags);
+
+    for (uint32_t i = 0; i < layoutInfo.setLayoutCount; i++) {
+        appendHandle(key, layoutInfo.pSetLayouts[i]);
+    }
+
+    // set layout handles and push ranges can't be told apart otherwise
+    key.push_back(UINT32_MAX);
+
+    for (uint32_t i = 0; i < layoutInfo.pushConstantRangeCount; i++) {
+        const VkPushConstantRange& range = layoutInfo.pPushConstantRanges[i];
+        key.insert(key.end(), { range.stageFlags, range.offset, range.size });
+    }
+
+    std::lock_guard<std::mutex> lock(layoutCache->mutex);
+
+    auto iterator = layoutCache->pipelineLayoutMap.find(key);
+    if (iterator != layoutCache->pipelineLayoutMap.end()) {
+        return iterator->second;
+    }
+
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(deviceInternal->logicalDevice, &layoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+
+    layoutCache->pipelineLayoutMap.emplace(std::move(key), pipelineLayout);
+
+    return pipelineLayout;
+}
+
+size_t LayoutKeyHash::operator()(const std::vector<uint32_t>& key) const {
+
+    uint64_t hash = key.size();
+
+    for (uint32_t value : key) {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    }
+
+    return static_cast<size_t>(hash);
+}
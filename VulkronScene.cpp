@@ -0,0 +1,188 @@
+#include "VulkronInternal.h"
+
+/*
+    Objects live in two dense lists, static and dynamic, so culling and recording walk contiguous memory.
+    Handles go through a slot map instead of pointing into the lists:
+
+    1. a slot holds where its object currently sits and a generation, the handle carries both halves
+    2. removing swaps the last object into the hole and points its slot there, nothing else moves
+    3. the freed slot bumps its generation and goes on a free list, old handles to it stop matching
+
+    Add, update and remove are O(1), the lists only grow when the scene is bigger than it ever was.
+    Removed objects stay in the culling trees until their next build, resolving the handle skips them.
+*/
+
+SceneInternal*  sceneInternal   = new SceneInternal();
+
+static ObjectSlot* getObjectSlot(VulkronObjectHandle handle);
+static void insertObject(uint32_t slotIndex, const VulkronBaseObject& object);
+static void eraseObject(uint32_t slotIndex);
+static bool isPlacementChanged(const VulkronBaseObject& a, const VulkronBaseObject& b);
+
+//-------------------------------------------------------------------------------------
+// SECTION [SCENE] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronAddObject(VulkronBaseObject* pObject, VulkronObjectHandle* pHandle) {
+
+    if (nullptr == pObject || nullptr == pHandle) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint32_t slotIndex = sceneInternal->freeSlot;
+
+    if (slotIndex == UINT32_MAX) {
+        slotIndex = static_cast<uint32_t>(sceneInternal->slotList.size());
+        sceneInternal->slotList.push_back({});
+    }
+    else {
+        sceneInternal->freeSlot = sceneInternal->slotList[slotIndex].objectIndex;
+    }
+
+    insertObject(slotIndex, *pObject);
+
+    pHandle->index = slotIndex;
+    pHandle->generation = sceneInternal->slotList[slotIndex].generation;
+
+    return VULKRON_SUCCESS;
+}
+
+// Changing isStatic moves the object to the other list, the handle stays the same
+VulkronResult vulkronUpdateObject(VulkronObjectHandle handle, VulkronBaseObject* pObject) {
+
+    ObjectSlot* slot = getObjectSlot(handle);
+
+    if (nullptr == slot || nullptr == pObject) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (slot->isStatic != pObject->isStatic) {
+        eraseObject(handle.index);
+        insertObject(handle.index, *pObject);
+        return VULKRON_SUCCESS;
+    }
+
+    auto& objectList = slot->isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+
+    // dynamic objects are refit every frame anyway, a moved static object needs a new tree
+    if (slot->isStatic && isPlacementChanged(objectList[slot->objectIndex], *pObject)) {
+        sceneInternal->staticVersion++;
+    }
+
+    objectList[slot->objectIndex] = *pObject;
+
+    return VULKRON_SUCCESS;
+}
+
+// Recorded frames only hold copies of what they drew, the object can go right away
+VulkronResult vulkronRemoveObject(VulkronObjectHandle handle) {
+
+    ObjectSlot* slot = getObjectSlot(handle);
+
+    if (nullptr == slot) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    eraseObject(handle.index);
+
+    // generation 0 is reserved for invalid handles
+    slot->generation = slot->generation == UINT32_MAX ? 1 : slot->generation + 1;
+    slot->isUsed = false;
+    slot->objectIndex = sceneInternal->freeSlot;
+    sceneInternal->freeSlot = handle.index;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronBaseObject* vulkronGetObject(VulkronObjectHandle handle) {
+
+    ObjectSlot* slot = getObjectSlot(handle);
+
+    if (nullptr == slot) {
+        return nullptr;
+    }
+
+    auto& objectList = slot->isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+
+    return &objectList[slot->objectIndex];
+}
+
+// Same as vulkronGetObject, but only finds objects in the given list
+VulkronBaseObject* getSceneObject(VulkronObjectHandle handle, bool isStatic) {
+
+    ObjectSlot* slot = getObjectSlot(handle);
+
+    if (nullptr == slot || slot->isStatic != isStatic) {
+        return nullptr;
+    }
+
+    auto& objectList = isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+
+    return &objectList[slot->objectIndex];
+}
+
+void destroyScene() {
+    delete sceneInternal;
+    sceneInternal = nullptr;
+}
+
+static ObjectSlot* getObjectSlot(VulkronObjectHandle handle) {
+
+    if (handle.index >= sceneInternal->slotList.size()) {
+        return nullptr;
+    }
+
+    ObjectSlot* slot = &sceneInternal->slotList[handle.index];
+
+    if (!slot->isUsed || slot->generation != handle.generation) {
+        return nullptr;
+    }
+
+    return slot;
+}
+
+static void insertObject(uint32_t slotIndex, const VulkronBaseObject& object) {
+
+    auto& objectList = object.isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+    auto& slotIndexList = object.isStatic ? sceneInternal->staticSlotList : sceneInternal->dynamicSlotList;
+
+    ObjectSlot& slot = sceneInternal->slotList[slotIndex];
+    slot.objectIndex = static_cast<uint32_t>(objectList.size());
+    slot.isStatic = object.isStatic;
+    slot.isUsed = true;
+
+    objectList.push_back(object);
+    slotIndexList.push_back(slotIndex);
+
+    if (object.isStatic) {
+        sceneInternal->staticVersion++;
+    }
+    else {
+        sceneInternal->dynamicVersion++;
+    }
+}
+
+// The last object fills the hole, only its slot has to be pointed at the new place
+static void eraseObject(uint32_t slotIndex) {
+
+    ObjectSlot& slot = sceneInternal->slotList[slotIndex];
+
+    auto& objectList = slot.isStatic ? sceneInternal->staticObjectsList : sceneInternal->dynamicObjectsList;
+    auto& slotIndexList = slot.isStatic ? sceneInternal->staticSlotList : sceneInternal->dynamicSlotList;
+
+    uint32_t objectIndex = slot.objectIndex;
+    uint32_t lastIndex = static_cast<uint32_t>(objectList.size()) - 1;
+
+    if (objectIndex != lastIndex) {
+        objectList[objectIndex] = std::move(objectList[lastIndex]);
+        slotIndexList[objectIndex] = slotIndexList[lastIndex];
+        sceneInternal->slotList[slotIndexList[objectIndex]].objectIndex = objectIndex;
+    }
+
+    objectList.pop_back();
+    slotIndexList.pop_back();
+}
+
+static bool isPlacementChanged(const VulkronBaseObject& a, const VulkronBaseObject& b) {
+    return a.position != b.position || a.rotation != b.rotation || a.scale != b.scale || a.mesh != b.mesh || a.frustumCulling != b.frustumCulling;
+}
@@ -0,0 +1,843 @@
+#include "VulkronInternal.h"
+
+#include "glm/gtc/matrix_transform.hpp"
+
+/*
+
+    Cascaded shadow maps for objects with castShadow, sampled by objects with receiveShadow
+
+    1. the camera frustum up to maxDistance is split into cascades, each one is a fixed size sphere
+       around its slice whose center snaps to a coarse grid of whole texels in light space
+    2. casters are culled per cascade through the same BVHs as the camera, static ones are drawn into
+       a cached layer that is only redrawn when the light, the cascade or one of its static casters moved
+    3. every frame the cached layer is copied into the transient shadow map and dynamic casters are drawn on top
+
+    Cascades no visible receiver overlaps are cleared instead of drawn, their cached layer waits until
+    they're needed again. Because the cascade only moves once the camera has crossed a grid cell, a
+    mostly static scene redraws its static shadows every few seconds of movement instead of every frame.
+
+*/
+
+ShadowInternal*     shadowInternal      = new ShadowInternal();
+
+static const float                          CASCADE_SNAP_MARGIN     = 0.25f;    // of the cascade radius, how far the camera moves before the cascade does
+static const float                          MIN_NEAR_DISTANCE       = 0.01f;
+static const uint32_t                       SHADOW_FORMAT_COUNT     = 2;        // VulkronMeshVertexFormat values with a pipeline
+
+static void createShadowImages();
+static void createShadowRenderPasses();
+static void createShadowPipelines();
+static void updateCascades();
+static void updateActiveCascades();
+static void gatherCasters(ShadowCascade& cascade, bool isStatic, uint64_t* pKey);
+static uint32_t selectShadowLod(const MeshInternal* mesh, float objectScale, float texelSize);
+static void hashCombine(uint64_t* pHash, const void* pData, size_t size);
+static void beginShadowRendering(VkCommandBuffer commandBuffer, VkImageView view, VkFramebuffer frameBuffer, bool isClear);
+static void endShadowRendering(VkCommandBuffer commandBuffer);
+static void recordShadowDraws(VkCommandBuffer commandBuffer, const std::vector<ShadowDraw>& drawList);
+static void recordShadowBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLayer, uint32_t layerCount, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+//-------------------------------------------------------------------------------------
+// SECTION [SHADOWS] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called once the graphics pipeline exists, the cascades use the same depth format as the depth attachment
+VulkronResult vulkronEnableShadows(VulkronShadowCreateInfo* info) {
+
+    if (nullptr == info || info->cascadeCount == 0 || info->cascadeCount > VULKRON_MAX_SHADOW_CASCADES || info->resolution == 0) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (shadowInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    shadowInternal->info = *info;
+    shadowInternal->hasDepthClamp = device->gpuEnabledFeatures.depthClamp;
+
+    createShadowImages();
+    createShadowRenderPasses();
+    createShadowPipelines();
+
+    shadowInternal->isEnabled = true;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDisableShadows() {
+
+    if (!shadowInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    vkDeviceWaitIdle(deviceInternal->logicalDevice);
+    destroyShadows();
+
+    return VULKRON_SUCCESS;
+}
+
+// Every cached layer is redrawn with the new direction, lights that move every frame get no caching
+void vulkronSetLightDirection(glm::vec3 direction) {
+
+    float length = glm::length(direction);
+
+    if (length > 0.0f) {
+        shadowInternal->lightDirection = direction / length;
+    }
+}
+
+VulkronResult vulkronGetShadowInfo(VulkronShadowInfo* pInfo) {
+
+    if (nullptr == pInfo) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pInfo = {};
+    pInfo->isEnabled = shadowInternal->isEnabled;
+
+    if (!shadowInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    pInfo->view = shadowInternal->shadowView;
+    pInfo->sampler = shadowInternal->sampler;
+    pInfo->cascadeCount = shadowInternal->info.cascadeCount;
+    pInfo->activeCascadeMask = shadowInternal->activeCascadeMask;
+
+    for (uint32_t i = 0; i < shadowInternal->info.cascadeCount; i++) {
+        pInfo->viewProjection[i] = shadowInternal->cascadeList[i].viewProjection;
+        pInfo->splitDistance[i] = shadowInternal->cascadeList[i].splitDistance;
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+void destroyShadows() {
+
+    if (!shadowInternal->isEnabled) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    for (ShadowCascade& cascade : shadowInternal->cascadeList) {
+        vkDestroyFramebuffer(logicalDevice, cascade.staticFrameBuffer, nullptr);
+        vkDestroyFramebuffer(logicalDevice, cascade.shadowFrameBuffer, nullptr);
+        vkDestroyImageView(logicalDevice, cascade.staticView, nullptr);
+        vkDestroyImageView(logicalDevice, cascade.shadowView, nullptr);
+    }
+
+    vkDestroyImageView(logicalDevice, shadowInternal->shadowView, nullptr);
+    destroyTransientImage(shadowInternal->shadowImage);
+    vkDestroyImage(logicalDevice, shadowInternal->staticImage, nullptr);
+    freeMemory(&shadowInternal->staticMemory);
+
+    for (VkPipeline shadowPipeline : shadowInternal->pipelineList) {
+        vkDestroyPipeline(logicalDevice, shadowPipeline, nullptr);
+    }
+
+    vkDestroyPipelineLayout(logicalDevice, shadowInternal->pipelineLayout, nullptr);
+    vkDestroyRenderPass(logicalDevice, shadowInternal->clearRenderPass, nullptr);
+    vkDestroyRenderPass(logicalDevice, shadowInternal->loadRenderPass, nullptr);
+    vkDestroySampler(logicalDevice, shadowInternal->sampler, nullptr);
+
+    // the light outlives the shadow maps, enabling them again keeps the direction
+    glm::vec3 lightDirection = shadowInternal->lightDirection;
+
+    *shadowInternal = ShadowInternal();
+    shadowInternal->lightDirection = lightDirection;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [SETUP] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// The cached static layers are a normal image, the shadow map the main pass samples is transient
+// and only holds memory from the shadow pass until the main pass is done with it
+static void createShadowImages() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+    const VulkronShadowCreateInfo& info = shadowInternal->info;
+    VkFormat depthFormat = swapchainInternal->depthFormat;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = depthFormat;
+    imageInfo.extent = { info.resolution, info.resolution, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = info.cascadeCount;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(logicalDevice, &imageInfo, nullptr, &shadowInternal->staticImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create static shadow image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(logicalDevice, shadowInternal->staticImage, &requirements);
+    allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &shadowInternal->staticMemory);
+    vkBindImageMemory(logicalDevice, shadowInternal->staticImage, shadowInternal->staticMemory.memory, shadowInternal->staticMemory.offset);
+
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    shadowInternal->shadowImage = createTransientImage(imageInfo, TRANSIENT_PASS_SHADOW, TRANSIENT_PASS_MAIN,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = shadowInternal->shadowImage;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = depthFormat;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, info.cascadeCount };
+
+    if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &shadowInternal->shadowView) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow image view!");
+    }
+
+    // one view per layer to render into
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    for (uint32_t i = 0; i < info.cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+        viewInfo.subresourceRange.baseArrayLayer = i;
+
+        viewInfo.image = shadowInternal->staticImage;
+        if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &cascade.staticView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow image view!");
+        }
+
+        viewInfo.image = shadowInternal->shadowImage;
+        if (vkCreateImageView(logicalDevice, &viewInfo, nullptr, &cascade.shadowView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow image view!");
+        }
+    }
+
+    // hardware compare, linear filtering turns it into 2x2 pcf where the format allows it
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(deviceInternal->gpu, depthFormat, &formatProperties);
+    VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = filter;
+    samplerInfo.minFilter = filter;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;     // outside the cascade is lit
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.maxLod = 0.0f;
+
+    if (vkCreateSampler(logicalDevice, &samplerInfo, nullptr, &shadowInternal->sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow sampler!");
+    }
+}
+
+// Only needed without dynamic rendering, the framebuffers work with both passes since they're compatible
+static void createShadowRenderPasses() {
+
+    if (deviceInternal->hasDynamicRendering) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    // layouts are changed with barriers around the passes, the passes themselves keep the attachment layout
+    VkAttachmentDescription attachment = {};
+    attachment.format = swapchainInternal->depthFormat;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthReference = { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthReference;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &shadowInternal->clearRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow render pass!");
+    }
+
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+    if (vkCreateRenderPass(logicalDevice, &renderPassInfo, nullptr, &shadowInternal->loadRenderPass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow render pass!");
+    }
+
+    VkFramebufferCreateInfo frameBufferInfo = {};
+    frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    frameBufferInfo.renderPass = shadowInternal->clearRenderPass;
+    frameBufferInfo.attachmentCount = 1;
+    frameBufferInfo.width = shadowInternal->info.resolution;
+    frameBufferInfo.height = shadowInternal->info.resolution;
+    frameBufferInfo.layers = 1;
+
+    for (uint32_t i = 0; i < shadowInternal->info.cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+        frameBufferInfo.pAttachments = &cascade.staticView;
+        if (vkCreateFramebuffer(logicalDevice, &frameBufferInfo, nullptr, &cascade.staticFrameBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow framebuffer!");
+        }
+
+        frameBufferInfo.pAttachments = &cascade.shadowView;
+        if (vkCreateFramebuffer(logicalDevice, &frameBufferInfo, nullptr, &cascade.shadowFrameBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow framebuffer!");
+        }
+    }
+}
+
+// One depth only pipeline per vertex format, only the position attribute is read
+static void createShadowPipelines() {
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+    const VulkronShadowCreateInfo& info = shadowInternal->info;
+
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) };
+    VkPipelineLayoutCreateInfo layoutInfo = vulkronPipelineLayoutInfo(0, nullptr, 1, &pushConstantRange);
+
+    if (vkCreatePipelineLayout(logicalDevice, &layoutInfo, nullptr, &shadowInternal->pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shadow pipeline layout!");
+    }
+
+    VkShaderModule shaderModule = createShaderModule(info.depthShaderPath);
+
+    VkPipelineShaderStageCreateInfo shaderStage = {};
+    shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStage.module = shaderModule;
+    shaderStage.pName = "main";
+
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    const VkDynamicState dynamicStateList[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    float blendConstants[4] = {};
+
+    // no culling, open meshes still cast, the bias keeps the receivers' own faces from shadowing themselves
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vulkronInputAssemblyState(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VULKRON_FALSE);
+    VkPipelineRasterizationStateCreateInfo rasterizationState = vulkronRasterizationState(shadowInternal->hasDepthClamp ? VK_TRUE : VULKRON_FALSE, VULKRON_FALSE,
+        VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, VK_TRUE, 1.0f, info.depthBiasConstant, 0.0f, info.depthBiasSlope);
+    VkPipelineMultisampleStateCreateInfo multisampleState = vulkronMultisampleState(VK_SAMPLE_COUNT_1_BIT, VULKRON_FALSE);
+    VkPipelineDepthStencilStateCreateInfo depthStencilState = vulkronDepthStencilState(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL, VULKRON_FALSE, VULKRON_FALSE, {}, {}, 0.0f, 1.0f);
+    VkPipelineColorBlendStateCreateInfo colorBlendState = vulkronColorBlendState(nullptr, 0, VULKRON_FALSE, blendConstants);
+    VkPipelineDynamicStateCreateInfo dynamicState = vulkronDynamicState(static_cast<uint32_t>(std::size(dynamicStateList)), dynamicStateList);
+
+    VkPipelineRenderingCreateInfo renderingInfo = {};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.depthAttachmentFormat = swapchainInternal->depthFormat;
+
+    for (uint32_t format = 0; format < SHADOW_FORMAT_COUNT; format++) {
+        VulkronVertexDescriptions descriptions = {};
+        vulkronGetVertexDescriptions(static_cast<VulkronMeshVertexFormat>(format), &descriptions);
+
+        // location 0 is the position in both formats
+        VkPipelineVertexInputStateCreateInfo vertexInputState = vulkronVertexInputState(1, descriptions.pBindings, 1, descriptions.pAttributes);
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = deviceInternal->hasDynamicRendering ? &renderingInfo : nullptr;
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &shaderStage;
+        pipelineInfo.pVertexInputState = &vertexInputState;
+        pipelineInfo.pInputAssemblyState = &inputAssemblyState;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizationState;
+        pipelineInfo.pMultisampleState = &multisampleState;
+        pipelineInfo.pDepthStencilState = &depthStencilState;
+        pipelineInfo.pColorBlendState = &colorBlendState;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = shadowInternal->pipelineLayout;
+        pipelineInfo.renderPass = shadowInternal->clearRenderPass;
+        pipelineInfo.subpass = 0;
+
+        if (vkCreateGraphicsPipelines(logicalDevice, VULKRON_NULL_HANDLE, 1, &pipelineInfo, nullptr, &shadowInternal->pipelineList[format]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow pipeline!");
+        }
+    }
+
+    destroyShaderModule(shaderModule);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [CASCADES] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Runs after the visibility pass, receivers are taken from what the camera sees
+void updateShadows() {
+    VULKRON_TRACE_SCOPE("frame", "updateShadows");
+
+    if (!shadowInternal->isEnabled) {
+        return;
+    }
+
+    uint32_t cascadeCount = shadowInternal->info.cascadeCount;
+
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+        cascade.isActive = false;
+        cascade.isStaticStale = false;
+        cascade.staticDrawList.clear();
+        cascade.dynamicDrawList.clear();
+    }
+
+    shadowInternal->activeCascadeMask = 0;
+
+    // without a camera there's nothing to fit the cascades to, every layer is cleared
+    if (!cullingInternal->hasCamera) {
+        return;
+    }
+
+    updateCascades();
+    updateActiveCascades();
+
+    frameThreadPool->parallelFor(cascadeCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+            if (!cascade.isActive) {
+                continue;
+            }
+
+            // the key covers the light, where the cascade sits and every static caster drawn into it
+            uint64_t staticKey = 0;
+            hashCombine(&staticKey, &shadowInternal->lightDirection, sizeof(glm::vec3));
+            hashCombine(&staticKey, &cascade.lightCenter, sizeof(glm::vec3));
+            hashCombine(&staticKey, &cascade.halfExtent, sizeof(float));
+
+            gatherCasters(cascade, true, &staticKey);
+            gatherCasters(cascade, false, nullptr);
+
+            staticKey = std::max(staticKey, uint64_t(1));
+            cascade.isStaticStale = staticKey != cascade.staticKey;
+            cascade.staticKey = staticKey;
+
+            if (!cascade.isStaticStale) {
+                cascade.staticDrawList.clear();
+            }
+        }
+    });
+}
+
+// Cascades are fitted around slices of the camera frustum. Their size only depends on the projection,
+// so turning the camera never changes it, and their position only changes once the camera has moved a
+// whole grid cell.
+static void updateCascades() {
+
+    const VulkronCamera& camera = cullingInternal->camera;
+    const VulkronShadowCreateInfo& info = shadowInternal->info;
+
+    // vulkan depth 0..1 perspective projection, the near plane is where depth is 0
+    float nearDistance = camera.projection[2][2] != 0.0f ? camera.projection[3][2] / camera.projection[2][2] : MIN_NEAR_DISTANCE;
+    nearDistance = std::max(nearDistance, MIN_NEAR_DISTANCE);
+    float farDistance = std::max(info.maxDistance, nearDistance * 2.0f);
+
+    // squared distance of a frustum corner from the view axis, per unit of depth
+    float tanX = 1.0f / std::abs(camera.projection[0][0]);
+    float tanY = 1.0f / std::abs(camera.projection[1][1]);
+    float cornerSlope = tanX * tanX + tanY * tanY;
+
+    glm::vec3 forward = -glm::normalize(glm::vec3(glm::inverse(camera.view)[2]));
+    glm::vec3 lightDirection = shadowInternal->lightDirection;
+    glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+    float sliceNear = nearDistance;
+
+    for (uint32_t i = 0; i < info.cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+        float ratio = static_cast<float>(i + 1) / info.cascadeCount;
+        float logSplit = nearDistance * std::pow(farDistance / nearDistance, ratio);
+        float uniformSplit = nearDistance + (farDistance - nearDistance) * ratio;
+        float sliceFar = info.splitLambda * logSplit + (1.0f - info.splitLambda) * uniformSplit;
+
+        // smallest sphere around the slice, its center is on the view axis where the near and far corners are equally far
+        float centerDistance = std::min((sliceNear + sliceFar) * (1.0f + cornerSlope) * 0.5f, sliceFar);
+        float radius = std::sqrt((sliceFar - centerDistance) * (sliceFar - centerDistance) + sliceFar * sliceFar * cornerSlope);
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 center = cullingInternal->cameraPosition + forward * centerDistance;
+
+        // the cascade is a margin wider than the sphere, so its center can snap to a grid of whole texels
+        // a margin wide and the sphere still fits
+        float halfExtent = radius * (1.0f + CASCADE_SNAP_MARGIN);
+        float texelSize = 2.0f * halfExtent / info.resolution;
+        float gridSize = std::max(texelSize, std::floor(radius * CASCADE_SNAP_MARGIN / texelSize) * texelSize);
+
+        glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        lightCenter = glm::floor(lightCenter / gridSize + 0.5f) * gridSize;
+
+        // casters up to casterDistance towards the light still land in the depth range
+        glm::mat4 cascadeView = glm::translate(glm::mat4(1.0f), -lightCenter) * lightView;
+        glm::mat4 projection = glm::orthoRH_ZO(-halfExtent, halfExtent, -halfExtent, halfExtent, -(halfExtent + info.casterDistance), halfExtent);
+
+        cascade.viewProjection = projection * cascadeView;
+        cascade.sphere = glm::vec4(center, radius);
+        cascade.lightCenter = lightCenter;
+        cascade.halfExtent = halfExtent;
+        cascade.texelSize = texelSize;
+        cascade.splitDistance = sliceFar;
+
+        extractFrustumPlanes(cascade.viewProjection, cascade.planeList);
+
+        // with depth clamp casters past the near plane are flattened onto it instead of clipped, they still cast
+        if (shadowInternal->hasDepthClamp) {
+            cascade.planeList[4] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+
+        sliceNear = sliceFar;
+    }
+}
+
+// A cascade is only drawn when a receiver the camera sees overlaps its slice
+static void updateActiveCascades() {
+
+    uint32_t cascadeCount = shadowInternal->info.cascadeCount;
+    uint32_t allMask = (1u << cascadeCount) - 1;
+    uint32_t activeMask = 0;
+
+    for (auto [list, visibleList] : { std::make_pair(&sceneInternal->staticObjectsList, &cullingInternal->visibleStaticList), std::make_pair(&sceneInternal->dynamicObjectsList, &cullingInternal->visibleDynamicList) }) {
+        for (uint32_t index : *visibleList) {
+            const VulkronBaseObject& object = (*list)[index];
+            glm::vec4 sphere;
+
+            if (!object.receiveShadow || !object.isVisible || object.isCulled || !getObjectSphere(object, &sphere)) {
+                continue;
+            }
+
+            for (uint32_t i = 0; i < cascadeCount; i++) {
+                const glm::vec4& cascadeSphere = shadowInternal->cascadeList[i].sphere;
+
+                if (glm::distance(glm::vec3(sphere), glm::vec3(cascadeSphere)) < sphere.w + cascadeSphere.w) {
+                    activeMask |= 1u << i;
+                }
+            }
+
+            if (activeMask == allMask) {
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        shadowInternal->cascadeList[i].isActive = (activeMask & (1u << i)) != 0;
+    }
+
+    shadowInternal->activeCascadeMask = activeMask;
+}
+
+// Casters from the BVH and the objects tested one by one, pKey is hashed with every static caster drawn
+static void gatherCasters(ShadowCascade& cascade, bool isStatic, uint64_t* pKey) {
+
+    const Bvh& bvh = isStatic ? cullingInternal->staticBvh : cullingInternal->dynamicBvh;
+    const auto& linearList = isStatic ? cullingInternal->staticLinearList : cullingInternal->dynamicLinearList;
+    auto& drawList = isStatic ? cascade.staticDrawList : cascade.dynamicDrawList;
+
+    auto addCaster = [&](VulkronObjectHandle handle, const VulkronBaseObject& object) {
+        MeshInternal* mesh = object.mesh;
+
+        // being in a shadow keeps the mesh resident and streams it back in, same as being on screen
+        mesh->lastUsedFrame.store(frameNumber, std::memory_order_relaxed);
+
+        if (mesh->state != VULKRON_MESH_STATE_RESIDENT || mesh->header.vertexFormat >= SHADOW_FORMAT_COUNT) {
+            return;
+        }
+
+        const VulkronMeshFileHeader& header = mesh->header;
+        uint32_t lodIndex = selectShadowLod(mesh, object.scale, cascade.texelSize);
+        const VulkronMeshFileLod& lod = mesh->lodList[lodIndex];
+
+        glm::mat4 dequantizeMatrix = glm::mat4(1.0f);
+        dequantizeMatrix[0][0] = header.positionScale[0];
+        dequantizeMatrix[1][1] = header.positionScale[1];
+        dequantizeMatrix[2][2] = header.positionScale[2];
+        dequantizeMatrix[3] = glm::vec4(header.positionBias[0], header.positionBias[1], header.positionBias[2], 1.0f);
+
+        drawList.push_back({ cascade.viewProjection * getObjectMatrix(object) * dequantizeMatrix, mesh, lod.indexOffset, lod.indexCount, object.instances });
+
+        if (nullptr != pKey) {
+            hashCombine(pKey, &handle, sizeof(handle));
+            hashCombine(pKey, &object.position, sizeof(glm::vec3));
+            hashCombine(pKey, &object.rotation, sizeof(glm::vec3));
+            hashCombine(pKey, &object.scale, sizeof(float));
+            hashCombine(pKey, &object.instances, sizeof(uint32_t));
+            hashCombine(pKey, &mesh, sizeof(mesh));
+            hashCombine(pKey, &lodIndex, sizeof(uint32_t));
+        }
+    };
+
+    cascade.hitList.clear();
+    queryBvhFrustum(bvh, cascade.planeList, 0x3F, cascade.hitList);
+
+    for (const BvhHit& hit : cascade.hitList) {
+        VulkronObjectHandle handle = bvh.itemList[hit.item];
+        const VulkronBaseObject* object = getSceneObject(handle, isStatic);
+
+        if (nullptr == object || !object->castShadow || !object->isVisible || nullptr == object->mesh) {
+            continue;
+        }
+
+        if (hit.isInside || isSphereInFrustum(bvh.sphereList[hit.item], cascade.planeList)) {
+            addCaster(handle, *object);
+        }
+    }
+
+    // not in the tree because they aren't frustum culled or had no bounds when it was built
+    for (VulkronObjectHandle handle : linearList) {
+        const VulkronBaseObject* object = getSceneObject(handle, isStatic);
+        glm::vec4 sphere;
+
+        if (nullptr == object || !object->castShadow || !object->isVisible || nullptr == object->mesh || !getObjectSphere(*object, &sphere)) {
+            continue;
+        }
+
+        if (isSphereInFrustum(sphere, cascade.planeList)) {
+            addCaster(handle, *object);
+        }
+    }
+
+    // fewer vertex buffer binds, the order doesn't matter for depth
+    std::sort(drawList.begin(), drawList.end(), [](const ShadowDraw& a, const ShadowDraw& b) {
+        return a.mesh < b.mesh;
+    });
+}
+
+// Coarsest lod whose error stays under a texel of the cascade, fixed per cascade so the cache doesn't follow the camera
+static uint32_t selectShadowLod(const MeshInternal* mesh, float objectScale, float texelSize) {
+
+    for (uint32_t i = static_cast<uint32_t>(mesh->lodList.size()) - 1; i > 0; i--) {
+        if (mesh->lodList[i].error * objectScale <= texelSize) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+static void hashCombine(uint64_t* pHash, const void* pData, size_t size) {
+
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+
+    for (size_t i = 0; i < size; i++) {
+        *pHash ^= pBytes[i] + 0x9e3779b97f4a7c15ull + (*pHash << 6) + (*pHash >> 2);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [RECORDING] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Recorded on the primary command buffer after occlusion culling, the main pass samples the result
+void recordShadows(VkCommandBuffer commandBuffer) {
+
+    if (!shadowInternal->isEnabled) {
+        return;
+    }
+
+    uint32_t cascadeCount = shadowInternal->info.cascadeCount;
+    uint32_t resolution = shadowInternal->info.resolution;
+
+    recordTransientBarriers(commandBuffer, TRANSIENT_PASS_SHADOW);
+
+    // stale static layers are redrawn, earlier frames may still be copying out of them
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+        if (!cascade.isStaticStale) {
+            continue;
+        }
+
+        recordShadowBarrier(commandBuffer, shadowInternal->staticImage, i, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+        beginShadowRendering(commandBuffer, cascade.staticView, cascade.staticFrameBuffer, true);
+        recordShadowDraws(commandBuffer, cascade.staticDrawList);
+        endShadowRendering(commandBuffer);
+
+        recordShadowBarrier(commandBuffer, shadowInternal->staticImage, i, 1, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    }
+
+    // the previous frame's main pass is done sampling once this runs, the old contents are discarded
+    recordShadowBarrier(commandBuffer, shadowInternal->shadowImage, 0, cascadeCount, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+    bool hasDynamicDraws = false;
+
+    for (uint32_t i = 0; i < cascadeCount; i++) {
+        ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+        if (!cascade.isActive) {
+            VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+            VkImageSubresourceRange range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, i, 1 };
+
+            vkCmdClearDepthStencilImage(commandBuffer, shadowInternal->shadowImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &range);
+            continue;
+        }
+
+        VkImageCopy region = {};
+        region.srcSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, i, 1 };
+        region.extent = { resolution, resolution, 1 };
+
+        vkCmdCopyImage(commandBuffer, shadowInternal->staticImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadowInternal->shadowImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        hasDynamicDraws |= !cascade.dynamicDrawList.empty();
+    }
+
+    VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    VkPipelineStageFlags stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkAccessFlags access = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    // dynamic casters are drawn over the copied static depth
+    if (hasDynamicDraws) {
+        recordShadowBarrier(commandBuffer, shadowInternal->shadowImage, 0, cascadeCount, stage, access,
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            layout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+        for (uint32_t i = 0; i < cascadeCount; i++) {
+            ShadowCascade& cascade = shadowInternal->cascadeList[i];
+
+            if (!cascade.isActive || cascade.dynamicDrawList.empty()) {
+                continue;
+            }
+
+            beginShadowRendering(commandBuffer, cascade.shadowView, cascade.shadowFrameBuffer, false);
+            recordShadowDraws(commandBuffer, cascade.dynamicDrawList);
+            endShadowRendering(commandBuffer);
+        }
+
+        layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        stage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    }
+
+    recordShadowBarrier(commandBuffer, shadowInternal->shadowImage, 0, cascadeCount, stage, access,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, layout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+static void beginShadowRendering(VkCommandBuffer commandBuffer, VkImageView view, VkFramebuffer frameBuffer, bool isClear) {
+
+    uint32_t resolution = shadowInternal->info.resolution;
+
+    VkClearValue clearValue = {};
+    clearValue.depthStencil = { 1.0f, 0 };
+
+    if (deviceInternal->hasDynamicRendering) {
+        VkRenderingAttachmentInfo depthAttachment = {};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = view;
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = isClear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.clearValue = clearValue;
+
+        VkRenderingInfo renderingInfo = {};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.offset = { 0, 0 };
+        renderingInfo.renderArea.extent = { resolution, resolution };
+        renderingInfo.layerCount = 1;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+
+        vkCmdBeginRendering(commandBuffer, &renderingInfo);
+    }
+    else {
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = isClear ? shadowInternal->clearRenderPass : shadowInternal->loadRenderPass;
+        renderPassInfo.framebuffer = frameBuffer;
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = { resolution, resolution };
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
+
+    VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(resolution), static_cast<float>(resolution), 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { resolution, resolution } };
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+static void endShadowRendering(VkCommandBuffer commandBuffer) {
+
+    if (deviceInternal->hasDynamicRendering) {
+        vkCmdEndRendering(commandBuffer);
+    }
+    else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+static void recordShadowDraws(VkCommandBuffer commandBuffer, const std::vector<ShadowDraw>& drawList) {
+
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    MeshInternal* boundMesh = nullptr;
+
+    for (const ShadowDraw& draw : drawList) {
+        VkPipeline shadowPipeline = shadowInternal->pipelineList[draw.mesh->header.vertexFormat];
+
+        if (shadowPipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+            boundPipeline = shadowPipeline;
+        }
+
+        if (draw.mesh != boundMesh) {
+            VkDeviceSize vertexOffset = 0;
+
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw.mesh->vertexBuffer.buffer, &vertexOffset);
+            vkCmdBindIndexBuffer(commandBuffer, draw.mesh->indexBuffer.buffer, 0, draw.mesh->indexType);
+            boundMesh = draw.mesh;
+        }
+
+        vkCmdPushConstants(commandBuffer, shadowInternal->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &draw.matrix);
+        vkCmdDrawIndexed(commandBuffer, draw.indexCount, draw.instanceCount, draw.firstIndex, 0, 0);
+    }
+}
+
+static void recordShadowBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLayer, uint32_t layerCount, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess, VkImageLayout oldLayout, VkImageLayout newLayout) {
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, baseLayer, layerCount };
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,351 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Per pass frame statistics
+
+    1. every frame in flight owns one range of queries per pass, reset at the start of its command buffer
+    2. each pass is wrapped in a timestamp pair, a pipeline statistics query and, for graphics passes,
+       a precise occlusion query, whichever the device has
+    3. once the frame's fence has been waited on the results are read without waiting, a query that
+       isn't available is skipped instead of stalling
+    4. the last frame read back is what vulkronGetFrameStatistics hands out
+
+    The main pass executes secondary command buffers, queries can only stay active over them with
+    inheritedQueries, without it the main pass only gets its timestamps.
+
+*/
+
+StatisticsInternal* statisticsInternal  = new StatisticsInternal();
+
+static const VkQueryPipelineStatisticFlags  PIPELINE_STATISTICS     = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                                      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+                                                                      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                                      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+                                                                      VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+static const uint32_t                       PIPELINE_STATISTIC_COUNT = 5;       // results come back in bit order
+#ifdef VULKRON_TRACING
+static const char* const                    TRACE_PASS_NAMES[VULKRON_FRAME_PASS_COUNT] = { "compute", "occlusion", "shadow", "main", "copy" };
+#endif // VULKRON_TRACING
+
+static VkQueryPool createQueryPool(VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics);
+static bool canQueryPass(VulkronFramePass pass);
+static double getTimestampMilliseconds(uint64_t begin, uint64_t end);
+
+//-------------------------------------------------------------------------------------
+// SECTION [QUERY POOLS] --------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronEnableFrameStatistics() {
+
+    if (statisticsInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    uint32_t queryCount = MAX_FRAMES_IN_FLIGHT * VULKRON_FRAME_PASS_COUNT;
+    uint32_t timestampValidBits = deviceInternal->queuefamily.queueFamilyPropertiesList[deviceInternal->queuefamily.graphicsQueueIndex].timestampValidBits;
+
+    if (timestampValidBits > 0) {
+        statisticsInternal->timestampPool = createQueryPool(VK_QUERY_TYPE_TIMESTAMP, queryCount * 2, 0);
+        statisticsInternal->timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (uint64_t(1) << timestampValidBits) - 1;
+        statisticsInternal->timestampPeriod = deviceInternal->gpuProperties.limits.timestampPeriod;
+    }
+
+    if (device->gpuEnabledFeatures.pipelineStatisticsQuery) {
+        statisticsInternal->pipelineStatisticsPool = createQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, queryCount, PIPELINE_STATISTICS);
+    }
+
+    // imprecise occlusion queries only say whether anything passed
+    if (device->gpuEnabledFeatures.occlusionQueryPrecise) {
+        statisticsInternal->occlusionPool = createQueryPool(VK_QUERY_TYPE_OCCLUSION, queryCount, 0);
+    }
+
+    statisticsInternal->hasInheritedQueries = device->gpuEnabledFeatures.inheritedQueries;
+    statisticsInternal->frameList.assign(MAX_FRAMES_IN_FLIGHT, StatisticsFrame());
+    statisticsInternal->lastRecordStart = std::chrono::steady_clock::now();
+    statisticsInternal->hasResult = false;
+    statisticsInternal->isEnabled = true;
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronDisableFrameStatistics() {
+
+    if (!statisticsInternal->isEnabled) {
+        return VULKRON_SUCCESS;
+    }
+
+    vkDeviceWaitIdle(deviceInternal->logicalDevice);
+    destroyFrameStatistics();
+
+    return VULKRON_SUCCESS;
+}
+
+void destroyFrameStatistics() {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+
+    vkDestroyQueryPool(logicalDevice, statisticsInternal->timestampPool, nullptr);
+    vkDestroyQueryPool(logicalDevice, statisticsInternal->pipelineStatisticsPool, nullptr);
+    vkDestroyQueryPool(logicalDevice, statisticsInternal->occlusionPool, nullptr);
+
+    statisticsInternal->timestampPool = VK_NULL_HANDLE;
+    statisticsInternal->pipelineStatisticsPool = VK_NULL_HANDLE;
+    statisticsInternal->occlusionPool = VK_NULL_HANDLE;
+    statisticsInternal->frameList.clear();
+    statisticsInternal->isEnabled = false;
+}
+
+static VkQueryPool createQueryPool(VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics) {
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = queryType;
+    queryPoolInfo.queryCount = queryCount;
+    queryPoolInfo.pipelineStatistics = pipelineStatistics;
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+
+    if (vkCreateQueryPool(deviceInternal->logicalDevice, &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create statistics query pool!");
+    }
+
+    return queryPool;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [RECORDING] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Right after vkBeginCommandBuffer, resets are transfer commands and can't go inside a render pass
+void beginFrameStatistics(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D extent) {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    StatisticsFrame& frame = statisticsInternal->frameList[frameIndex];
+    auto now = std::chrono::steady_clock::now();
+
+    frame.isRecorded = true;
+    frame.frameNumber = frameNumber;
+    frame.statisticsPassMask = 0;
+    frame.occlusionPassMask = 0;
+    frame.cpuFrameMilliseconds = std::chrono::duration<double, std::milli>(now - statisticsInternal->lastRecordStart).count();
+    frame.recordStart = now;
+    frame.extent = extent;
+
+    statisticsInternal->lastRecordStart = now;
+
+    uint32_t firstQuery = frameIndex * VULKRON_FRAME_PASS_COUNT;
+
+    if (VK_NULL_HANDLE != statisticsInternal->timestampPool) {
+        vkCmdResetQueryPool(commandBuffer, statisticsInternal->timestampPool, firstQuery * 2, VULKRON_FRAME_PASS_COUNT * 2);
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->pipelineStatisticsPool) {
+        vkCmdResetQueryPool(commandBuffer, statisticsInternal->pipelineStatisticsPool, firstQuery, VULKRON_FRAME_PASS_COUNT);
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->occlusionPool) {
+        vkCmdResetQueryPool(commandBuffer, statisticsInternal->occlusionPool, firstQuery, VULKRON_FRAME_PASS_COUNT);
+    }
+}
+
+// Right before vkEndCommandBuffer
+void endFrameStatistics(uint32_t frameIndex) {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    StatisticsFrame& frame = statisticsInternal->frameList[frameIndex];
+    frame.cpuRecordMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.recordStart).count();
+}
+
+// Passes follow each other, so only one query of each type is ever active
+void beginPassStatistics(VkCommandBuffer commandBuffer, VulkronFramePass pass, uint32_t frameIndex) {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    StatisticsFrame& frame = statisticsInternal->frameList[frameIndex];
+    uint32_t query = frameIndex * VULKRON_FRAME_PASS_COUNT + pass;
+
+    if (VK_NULL_HANDLE != statisticsInternal->timestampPool) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, statisticsInternal->timestampPool, query * 2);
+    }
+
+    if (!canQueryPass(pass)) {
+        return;
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->pipelineStatisticsPool) {
+        vkCmdBeginQuery(commandBuffer, statisticsInternal->pipelineStatisticsPool, query, 0);
+        frame.statisticsPassMask |= 1u << pass;
+    }
+
+    // compute and copies don't rasterize anything
+    bool isGraphicsPass = pass == VULKRON_FRAME_PASS_SHADOW || pass == VULKRON_FRAME_PASS_MAIN;
+
+    if (VK_NULL_HANDLE != statisticsInternal->occlusionPool && isGraphicsPass) {
+        vkCmdBeginQuery(commandBuffer, statisticsInternal->occlusionPool, query, VK_QUERY_CONTROL_PRECISE_BIT);
+        frame.occlusionPassMask |= 1u << pass;
+    }
+}
+
+void endPassStatistics(VkCommandBuffer commandBuffer, VulkronFramePass pass, uint32_t frameIndex) {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    StatisticsFrame& frame = statisticsInternal->frameList[frameIndex];
+    uint32_t query = frameIndex * VULKRON_FRAME_PASS_COUNT + pass;
+
+    if (frame.occlusionPassMask & (1u << pass)) {
+        vkCmdEndQuery(commandBuffer, statisticsInternal->occlusionPool, query);
+    }
+
+    if (frame.statisticsPassMask & (1u << pass)) {
+        vkCmdEndQuery(commandBuffer, statisticsInternal->pipelineStatisticsPool, query);
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->timestampPool) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, statisticsInternal->timestampPool, query * 2 + 1);
+    }
+}
+
+// Secondaries executed while a query is active have to say so, the flags must cover the active queries
+void setStatisticsInheritance(VkCommandBufferInheritanceInfo* inheritanceInfo) {
+
+    if (!statisticsInternal->isEnabled || !canQueryPass(VULKRON_FRAME_PASS_MAIN)) {
+        return;
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->pipelineStatisticsPool) {
+        inheritanceInfo->pipelineStatistics = PIPELINE_STATISTICS;
+    }
+
+    if (VK_NULL_HANDLE != statisticsInternal->occlusionPool) {
+        inheritanceInfo->occlusionQueryEnable = VK_TRUE;
+        inheritanceInfo->queryFlags = VK_QUERY_CONTROL_PRECISE_BIT;
+    }
+}
+
+static bool canQueryPass(VulkronFramePass pass) {
+    return pass != VULKRON_FRAME_PASS_MAIN || statisticsInternal->hasInheritedQueries;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [RESULTS] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called once the frame's fence was waited on, before it records again
+void retireFrameStatistics(uint32_t frameIndex) {
+
+    if (!statisticsInternal->isEnabled) {
+        return;
+    }
+
+    StatisticsFrame& frame = statisticsInternal->frameList[frameIndex];
+
+    if (!frame.isRecorded) {
+        return;
+    }
+
+    frame.isRecorded = false;
+
+    VkDevice logicalDevice = deviceInternal->logicalDevice;
+    uint32_t firstQuery = frameIndex * VULKRON_FRAME_PASS_COUNT;
+
+    VulkronFrameStatistics result = {};
+    result.frameNumber = frame.frameNumber;
+    result.cpuFrameMilliseconds = frame.cpuFrameMilliseconds;
+    result.cpuRecordMilliseconds = frame.cpuRecordMilliseconds;
+    result.extent = frame.extent;
+
+    // no wait bit, whatever the gpu didn't write is left at 0 instead of stalling the frame
+    if (VK_NULL_HANDLE != statisticsInternal->timestampPool) {
+        std::array<uint64_t, VULKRON_FRAME_PASS_COUNT * 2> timestampList = {};
+
+        VkResult queryResult = vkGetQueryPoolResults(logicalDevice, statisticsInternal->timestampPool, firstQuery * 2, VULKRON_FRAME_PASS_COUNT * 2,
+            sizeof(timestampList), timestampList.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+        if (queryResult == VK_SUCCESS) {
+            for (uint32_t pass = 0; pass < VULKRON_FRAME_PASS_COUNT; pass++) {
+                result.passList[pass].gpuMilliseconds = getTimestampMilliseconds(timestampList[pass * 2], timestampList[pass * 2 + 1]);
+            }
+
+            result.gpuMilliseconds = getTimestampMilliseconds(timestampList.front(), timestampList.back());
+
+#ifdef VULKRON_TRACING
+            calibrateTraceGpuClock(timestampList.back());
+
+            for (uint32_t pass = 0; pass < VULKRON_FRAME_PASS_COUNT; pass++) {
+                writeTraceGpuEvent(TRACE_PASS_NAMES[pass], timestampList[pass * 2], timestampList[pass * 2 + 1]);
+            }
+#endif // VULKRON_TRACING
+        }
+    }
+
+    for (uint32_t pass = 0; pass < VULKRON_FRAME_PASS_COUNT; pass++) {
+        VulkronPassStatistics& passStatistics = result.passList[pass];
+
+        if (frame.statisticsPassMask & (1u << pass)) {
+            std::array<uint64_t, PIPELINE_STATISTIC_COUNT> counterList = {};
+
+            VkResult queryResult = vkGetQueryPoolResults(logicalDevice, statisticsInternal->pipelineStatisticsPool, firstQuery + pass, 1,
+                sizeof(counterList), counterList.data(), sizeof(counterList), VK_QUERY_RESULT_64_BIT);
+
+            if (queryResult == VK_SUCCESS) {
+                passStatistics.vertexInvocations = counterList[0];
+                passStatistics.clippingInvocations = counterList[1];
+                passStatistics.clippingPrimitives = counterList[2];
+                passStatistics.fragmentInvocations = counterList[3];
+                passStatistics.computeInvocations = counterList[4];
+            }
+        }
+
+        if (frame.occlusionPassMask & (1u << pass)) {
+            uint64_t samplesPassed = 0;
+
+            VkResult queryResult = vkGetQueryPoolResults(logicalDevice, statisticsInternal->occlusionPool, firstQuery + pass, 1,
+                sizeof(samplesPassed), &samplesPassed, sizeof(samplesPassed), VK_QUERY_RESULT_64_BIT);
+
+            if (queryResult == VK_SUCCESS) {
+                passStatistics.samplesPassed = samplesPassed;
+            }
+        }
+    }
+
+    statisticsInternal->result = result;
+    statisticsInternal->hasResult = true;
+}
+
+VulkronResult vulkronGetFrameStatistics(VulkronFrameStatistics* pStatistics) {
+
+    if (nullptr == pStatistics) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (!statisticsInternal->isEnabled || !statisticsInternal->hasResult) {
+        return VULKRON_NOT_READY;
+    }
+
+    *pStatistics = statisticsInternal->result;
+
+    return VULKRON_SUCCESS;
+}
+
+// Timestamps wrap at timestampValidBits, masking the difference keeps it right across a wrap
+static double getTimestampMilliseconds(uint64_t begin, uint64_t end) {
+    return double((end - begin) & statisticsInternal->timestampMask) * statisticsInternal->timestampPeriod * 1e-6;
+}
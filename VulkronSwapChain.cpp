@@ -29,8 +29,15 @@ void destroySwapchain() {
 //-------------------------------------------------------------------------------------
 
 void cleanUpSwapchain() {
+    destroyOcclusionPyramid(); // built from the depth attachment
+    destroyDepthAttachment();
+
     if (swapchainInternal->swapChain != VULKRON_NULL_HANDLE) {
         for (uint32_t i = 0; i < swapchainInternal->imageCount; i++) {
+            if (swapchainInternal->bufferList[i].frameBuffer != VK_NULL_HANDLE) {
+                vkDestroyFramebuffer(deviceInternal->logicalDevice, swapchainInternal->bufferList[i].frameBuffer, nullptr);
+            }
+
             vkDestroyImageView(deviceInternal->logicalDevice, swapchainInternal->bufferList[i].view, nullptr);
         }
     }
@@ -97,6 +104,12 @@ void createSwapchain(uint32_t* width, uint32_t* height, bool vsync) {
     swapchainCreateInfo.imageExtent = swapchainInternal->swapChainExtent;
     swapchainCreateInfo.imageArrayLayers = 1;
     swapchainCreateInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    // screenshots copy straight out of the presented image
+    readbackInternal->canReadSwapchain = (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (readbackInternal->canReadSwapchain) {
+        swapchainCreateInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     swapchainCreateInfo.preTransform = swapChainSupport.capabilities.currentTransform;
     swapchainCreateInfo.imageArrayLayers = 1;
     swapchainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -0,0 +1,861 @@
+#include "VulkronInternal.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb/stb_image.h"
+
+#include <cmath>
+
+TextureStreamingInternal*   textureStreaming    = new TextureStreamingInternal();
+VulkronThreadPool*          workerThreadPool    = nullptr;
+
+static const uint32_t                       TAIL_MAX_DIMENSION      = 64;      // mips this size and smaller are built on the cpu and uploaded first
+static const uint32_t                       TEXEL_SIZE              = 4;       // everything is expanded to rgba8
+
+static void decodeTexture(TextureInternal* texture, std::string filePath, bool generateMipmaps, bool srgb);
+static void startTextureDecode(TextureInternal* texture);
+static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb);
+static void createTextureImage(TextureInternal* texture, uint32_t baseMipLevel, VkImage* pImage, MemoryAllocation* pMemory);
+static void destroyTextureInternal(TextureInternal* texture);
+static bool uploadTextureTail(TextureInternal* texture);
+static bool uploadTextureBaseChunk(TextureInternal* texture);
+static void updateTextureResidency(TextureInternal* texture, uint32_t residentMipLevel);
+static void relocateTexture(TextureInternal* texture, uint32_t firstMipLevel);
+
+//-------------------------------------------------------------------------------------
+// SECTION [DECODE] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Runs on a worker thread. Never touches the texture, the render thread reads it meanwhile,
+// the result goes back through decodedList.
+static void decodeTexture(TextureInternal* texture, std::string filePath, bool generateMipmaps, bool srgb) {
+    VULKRON_TRACE_SCOPE("upload", "decodeTexture");
+
+    DecodedTexture decoded = {};
+    decoded.texture = texture;
+
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+
+    stbi_uc* pixels = stbi_load(filePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+    if (nullptr != pixels) {
+        decoded.width = static_cast<uint32_t>(width);
+        decoded.height = static_cast<uint32_t>(height);
+
+        if (generateMipmaps) {
+            decoded.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        }
+
+        // the tail is every level that fits in TAIL_MAX_DIMENSION, when nothing fits the tail is empty
+        decoded.tailMipLevel = decoded.mipLevels;
+        for (uint32_t level = 0; level < decoded.mipLevels; level++) {
+            if (std::max(decoded.width >> level, decoded.height >> level) <= TAIL_MAX_DIMENSION) {
+                decoded.tailMipLevel = level;
+                break;
+            }
+        }
+
+        size_t tailSize = 0;
+        for (uint32_t level = decoded.tailMipLevel; level < decoded.mipLevels; level++) {
+            MipLevelData mip = {};
+            mip.width = std::max(1u, decoded.width >> level);
+            mip.height = std::max(1u, decoded.height >> level);
+            mip.offset = tailSize;
+            mip.size = static_cast<size_t>(mip.width) * mip.height * TEXEL_SIZE;
+
+            tailSize += mip.size;
+            decoded.tailMipList.push_back(mip);
+        }
+
+        decoded.tailPixels.resize(tailSize);
+
+        size_t baseSize = static_cast<size_t>(decoded.width) * decoded.height * TEXEL_SIZE;
+
+        const uint8_t* previous = pixels;
+        uint32_t previousWidth = decoded.width;
+        uint32_t previousHeight = decoded.height;
+
+        // the first tail level is filtered straight from level 0, the rest from the level above them
+        for (auto& mip : decoded.tailMipList) {
+            uint8_t* current = decoded.tailPixels.data() + mip.offset;
+
+            if (mip.width == decoded.width && mip.height == decoded.height) {
+                memcpy(current, pixels, baseSize);
+            }
+            else {
+                downsample(previous, previousWidth, previousHeight, current, mip.width, mip.height, srgb);
+            }
+
+            previous = current;
+            previousWidth = mip.width;
+            previousHeight = mip.height;
+        }
+
+        if (decoded.tailMipLevel > 0) {
+            decoded.basePixels.assign(pixels, pixels + baseSize);
+        }
+
+        stbi_image_free(pixels);
+    }
+    else {
+        decoded.isFailed = true;
+    }
+
+    std::lock_guard<std::mutex> lock(textureStreaming->decodedMutex);
+    textureStreaming->decodedList.push_back(std::move(decoded));
+}
+
+// The decode only reads what it is handed, never the texture
+static void startTextureDecode(TextureInternal* texture) {
+    texture->isDecoding = true;
+
+    std::string filePath = texture->filePath;
+    bool generateMipmaps = texture->generateMipmaps;
+    bool srgb = texture->format == VK_FORMAT_R8G8B8A8_SRGB;
+
+    workerThreadPool->addJob([texture, filePath, generateMipmaps, srgb] { decodeTexture(texture, filePath, generateMipmaps, srgb); });
+}
+
+static float srgbToLinear(uint8_t value) {
+    float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb(float value) {
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+// Box filter, every destination texel averages the block of source texels it covers.
+// sRGB colour is averaged in linear space so the mips don't darken, alpha is always linear.
+static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb) {
+
+    static float srgbTable[256];
+    static bool isTableReady = [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            srgbTable[i] = srgbToLinear(static_cast<uint8_t>(i));
+        }
+        return true;
+    }();
+    (void)isTableReady;
+
+    for (uint32_t y = 0; y < dstHeight; y++) {
+        uint32_t y0 = y * srcHeight / dstHeight;
+        uint32_t y1 = std::max(y0 + 1, (y + 1) * srcHeight / dstHeight);
+
+        for (uint32_t x = 0; x < dstWidth; x++) {
+            uint32_t x0 = x * srcWidth / dstWidth;
+            uint32_t x1 = std::max(x0 + 1, (x + 1) * srcWidth / dstWidth);
+
+            float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for (uint32_t sy = y0; sy < y1; sy++) {
+                const uint8_t* row = src + (static_cast<size_t>(sy) * srcWidth) * TEXEL_SIZE;
+
+                for (uint32_t sx = x0; sx < x1; sx++) {
+                    const uint8_t* texel = row + sx * TEXEL_SIZE;
+
+                    for (uint32_t c = 0; c < 3; c++) {
+                        sum[c] += srgb ? srgbTable[texel[c]] : texel[c] / 255.0f;
+                    }
+                    sum[3] += texel[3] / 255.0f;
+                }
+            }
+
+            float count = static_cast<float>((y1 - y0) * (x1 - x0));
+            uint8_t* out = dst + (static_cast<size_t>(y) * dstWidth + x) * TEXEL_SIZE;
+
+            for (uint32_t c = 0; c < 3; c++) {
+                float average = sum[c] / count;
+                out[c] = srgb ? linearToSrgb(average) : static_cast<uint8_t>(std::clamp(average * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+            out[3] = static_cast<uint8_t>(std::clamp(sum[3] / count * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [STREAMING] ----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called once per frame before the transfer batch is submitted.
+// Every texture gets its small mip tail first so it can be sampled early, full resolution
+// levels are only streamed once no tails are waiting. Both stop when the frame budget or the ring is used up.
+void updateTextureStreaming() {
+    VULKRON_TRACE_SCOPE("upload", "updateTextureStreaming");
+
+    std::vector<DecodedTexture> decodedList;
+    {
+        std::lock_guard<std::mutex> lock(textureStreaming->decodedMutex);
+        decodedList.swap(textureStreaming->decodedList);
+    }
+
+    for (auto& decoded : decodedList) {
+        TextureInternal* texture = decoded.texture;
+        texture->isDecoding = false;
+
+        if (texture->destroyRequested) {
+            destroyTextureInternal(texture);
+            continue;
+        }
+
+        if (decoded.isFailed) {
+#if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
+            LOG("failed to load texture: " << texture->filePath)
+#endif
+            // a demoted texture keeps its mip tail when it can't be promoted again
+            if (texture->image == VULKRON_NULL_HANDLE) {
+                texture->state = VULKRON_TEXTURE_STATE_FAILED;
+            }
+            continue;
+        }
+
+        // promoting a demoted texture, the tail only image is sampled until the new tail is resident
+        if (texture->image != VULKRON_NULL_HANDLE) {
+            texture->previousImage = texture->image;
+            texture->previousMemory = texture->memory;
+            texture->image = VULKRON_NULL_HANDLE;
+            texture->memory = {};
+            texture->imageMipOffset = 0;
+        }
+        else {
+            texture->state = VULKRON_TEXTURE_STATE_DECODED;
+        }
+
+        texture->width = decoded.width;
+        texture->height = decoded.height;
+        texture->mipLevels = decoded.mipLevels;
+        texture->tailMipLevel = decoded.tailMipLevel;
+        texture->basePixels = std::move(decoded.basePixels);
+        texture->tailPixels = std::move(decoded.tailPixels);
+        texture->tailMipList = std::move(decoded.tailMipList);
+
+        createTextureImage(texture, 0, &texture->image, &texture->memory);
+
+        if (texture->tailMipList.empty()) {
+            textureStreaming->baseQueue.push_back(texture);
+        }
+        else {
+            textureStreaming->tailQueue.push_back(texture);
+        }
+    }
+
+    while (!textureStreaming->tailQueue.empty()) {
+        TextureInternal* texture = textureStreaming->tailQueue.front();
+
+        if (!uploadTextureTail(texture)) {
+            return;
+        }
+
+        textureStreaming->tailQueue.pop_front();
+
+        if (texture->tailMipLevel > 0) {
+            textureStreaming->baseQueue.push_back(texture);
+        }
+    }
+
+    // full resolution levels are what pushes a heap over its budget, they wait until there is room again
+    if (hasMemoryPressure(VULKRON_MEMORY_PRESSURE_CRITICAL)) {
+        return;
+    }
+
+    while (!textureStreaming->baseQueue.empty()) {
+        TextureInternal* texture = textureStreaming->baseQueue.front();
+
+        if (!uploadTextureBaseChunk(texture)) {
+            return;
+        }
+
+        if (texture->baseRowsUploaded == texture->height) {
+            textureStreaming->baseQueue.pop_front();
+        }
+    }
+}
+
+// Image holding levels baseMipLevel.. mipLevels - 1, baseMipLevel is only above 0 for demoted textures
+static void createTextureImage(TextureInternal* texture, uint32_t baseMipLevel, VkImage* pImage, MemoryAllocation* pMemory) {
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = texture->format;
+    imageInfo.extent = { std::max(1u, texture->width >> baseMipLevel), std::max(1u, texture->height >> baseMipLevel), 1 };
+    imageInfo.mipLevels = texture->mipLevels - baseMipLevel;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(deviceInternal->logicalDevice, &imageInfo, nullptr, pImage) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture image!");
+    }
+
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(deviceInternal->logicalDevice, *pImage, &memoryRequirements);
+
+    allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pMemory, true);
+
+    if (vkBindImageMemory(deviceInternal->logicalDevice, *pImage, pMemory->memory, pMemory->offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind texture image memory!");
+    }
+}
+
+static bool uploadTextureTail(TextureInternal* texture) {
+
+    VkDeviceSize size = texture->tailPixels.size();
+    VkDeviceSize ringOffset = 0;
+
+    if (!hasTransferBudget(size) || !uploadRingAllocate(size, &ringOffset)) {
+        return false;
+    }
+
+    memcpy(uploadRing->pMappedData + ringOffset, texture->tailPixels.data(), size);
+
+    TransferBatch* batch = getTransferBatch();
+    transferInternal->frameBytesRecorded += size;
+
+    VkImageSubresourceRange range = {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = texture->tailMipLevel;
+    range.levelCount = texture->mipLevels - texture->tailMipLevel;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture->image;
+    barrier.subresourceRange = range;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(batch->transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    std::vector<VkBufferImageCopy> regionList;
+    for (uint32_t i = 0; i < texture->tailMipList.size(); i++) {
+        const MipLevelData& mip = texture->tailMipList[i];
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = ringOffset + mip.offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = texture->tailMipLevel + i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { mip.width, mip.height, 1 };
+
+        regionList.push_back(region);
+    }
+
+    vkCmdCopyBufferToImage(batch->transferCommandBuffer, uploadRing->staging.buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regionList.size()), regionList.data());
+
+    recordQueueOwnershipTransfer(batch, texture->image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+    uint32_t residentMipLevel = texture->tailMipLevel;
+    batch->onSubmitList.push_back([texture, residentMipLevel] { updateTextureResidency(texture, residentMipLevel); });
+
+    texture->tailPixels.clear();
+    texture->tailPixels.shrink_to_fit();
+    texture->tailMipList.clear();
+
+    return true;
+}
+
+// Level 0 is copied in row chunks so a single large texture can't blow the frame budget.
+// Once the last row is in, the graphics queue blits the chain down to the tail that is already resident.
+static bool uploadTextureBaseChunk(TextureInternal* texture) {
+
+    VkDeviceSize rowSize = static_cast<VkDeviceSize>(texture->width) * TEXEL_SIZE;
+    uint32_t remainingRows = texture->height - texture->baseRowsUploaded;
+
+    VkDeviceSize remainingBudget = transferInternal->frameBudget > transferInternal->frameBytesRecorded ? transferInternal->frameBudget - transferInternal->frameBytesRecorded : 0;
+    uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(remainingRows, remainingBudget / rowSize));
+
+    if (rows == 0) {
+        if (transferInternal->frameBytesRecorded != 0) {
+            return false;
+        }
+        rows = 1;
+    }
+
+    // the ring may be too full for the whole chunk, fall back to smaller chunks before giving up on this frame
+    VkDeviceSize ringOffset = 0;
+    while (!uploadRingAllocate(rows * rowSize, &ringOffset)) {
+        if (rows == 1) {
+            return false;
+        }
+        rows /= 2;
+    }
+
+    VkDeviceSize size = rows * rowSize;
+    memcpy(uploadRing->pMappedData + ringOffset, texture->basePixels.data() + texture->baseRowsUploaded * rowSize, size);
+
+    TransferBatch* batch = getTransferBatch();
+    transferInternal->frameBytesRecorded += size;
+
+    VkImageSubresourceRange range = {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = 0;
+    range.levelCount = 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    if (texture->baseRowsUploaded == 0) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = texture->image;
+        barrier.subresourceRange = range;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(batch->transferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = ringOffset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, static_cast<int32_t>(texture->baseRowsUploaded), 0 };
+    region.imageExtent = { texture->width, rows, 1 };
+
+    vkCmdCopyBufferToImage(batch->transferCommandBuffer, uploadRing->staging.buffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    texture->baseRowsUploaded += rows;
+
+    if (texture->baseRowsUploaded < texture->height) {
+        return true;
+    }
+
+    texture->basePixels.clear();
+    texture->basePixels.shrink_to_fit();
+
+    if (texture->tailMipLevel <= 1) {
+        recordQueueOwnershipTransfer(batch, texture->image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+    }
+    else {
+        recordQueueOwnershipTransfer(batch, texture->image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(deviceInternal->gpu, texture->format, &formatProperties);
+
+        VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = texture->image;
+        barrier.subresourceRange = range;
+
+        for (uint32_t level = 1; level < texture->tailMipLevel; level++) {
+            barrier.subresourceRange.baseMipLevel = level;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+            vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+            blit.srcOffsets[1] = { static_cast<int32_t>(std::max(1u, texture->width >> (level - 1))), static_cast<int32_t>(std::max(1u, texture->height >> (level - 1))), 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            blit.dstOffsets[1] = { static_cast<int32_t>(std::max(1u, texture->width >> level)), static_cast<int32_t>(std::max(1u, texture->height >> level)), 1 };
+
+            vkCmdBlitImage(batch->graphicsCommandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+            vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = texture->tailMipLevel;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    batch->onSubmitList.push_back([texture] { updateTextureResidency(texture, 0); });
+
+    return true;
+}
+
+// The view only covers resident levels so samplers never read mips that haven't arrived yet.
+// A previous image is swapped out here as well, the view moving to the new image is what releases it.
+static void updateTextureResidency(TextureInternal* texture, uint32_t residentMipLevel) {
+
+    if (residentMipLevel >= texture->residentMipLevel && texture->previousImage == VULKRON_NULL_HANDLE) {
+        return;
+    }
+
+    if (texture->previousImage != VULKRON_NULL_HANDLE) {
+        VkImage previousImage = texture->previousImage;
+        MemoryAllocation previousMemory = texture->previousMemory;
+
+        enqueueFrameDeletion([previousImage, previousMemory] {
+            MemoryAllocation allocation = previousMemory;
+            vkDestroyImage(deviceInternal->logicalDevice, previousImage, nullptr);
+            freeMemory(&allocation);
+        });
+
+        texture->previousImage = VULKRON_NULL_HANDLE;
+        texture->previousMemory = {};
+    }
+
+    if (texture->view != VULKRON_NULL_HANDLE) {
+        VkImageView oldView = texture->view;
+        enqueueFrameDeletion([oldView] { vkDestroyImageView(deviceInternal->logicalDevice, oldView, nullptr); });
+    }
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = texture->format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = residentMipLevel - texture->imageMipOffset;
+    viewInfo.subresourceRange.levelCount = texture->mipLevels - residentMipLevel;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(deviceInternal->logicalDevice, &viewInfo, nullptr, &texture->view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture image view!");
+    }
+
+    texture->residentMipLevel = residentMipLevel;
+    texture->state = residentMipLevel == 0 ? VULKRON_TEXTURE_STATE_RESIDENT : VULKRON_TEXTURE_STATE_PARTIALLY_RESIDENT;
+
+    if (nullptr != texture->pfnResidencyCallback) {
+        texture->pfnResidencyCallback(texture, residentMipLevel, texture->pUserData);
+    }
+}
+
+static void destroyTextureInternal(TextureInternal* texture) {
+    auto& textureList = textureStreaming->textureList;
+    textureList.erase(std::remove(textureList.begin(), textureList.end(), texture), textureList.end());
+
+    VkImageView view = texture->view;
+    VkImage image = texture->image;
+    MemoryAllocation memory = texture->memory;
+    VkImage previousImage = texture->previousImage;
+    MemoryAllocation previousMemory = texture->previousMemory;
+
+    // in flight frames and transfer batches may still use the image
+    enqueueFrameDeletion([view, image, memory, previousImage, previousMemory] {
+        MemoryAllocation allocation = memory;
+        MemoryAllocation previousAllocation = previousMemory;
+        if (view != VULKRON_NULL_HANDLE) {
+            vkDestroyImageView(deviceInternal->logicalDevice, view, nullptr);
+        }
+        if (image != VULKRON_NULL_HANDLE) {
+            vkDestroyImage(deviceInternal->logicalDevice, image, nullptr);
+        }
+        if (previousImage != VULKRON_NULL_HANDLE) {
+            vkDestroyImage(deviceInternal->logicalDevice, previousImage, nullptr);
+        }
+        freeMemory(&allocation);
+        freeMemory(&previousAllocation);
+    });
+
+    delete texture;
+}
+
+void destroyTextures() {
+    for (auto texture : textureStreaming->textureList) {
+        if (texture->view != VULKRON_NULL_HANDLE) {
+            vkDestroyImageView(deviceInternal->logicalDevice, texture->view, nullptr);
+        }
+        if (texture->image != VULKRON_NULL_HANDLE) {
+            vkDestroyImage(deviceInternal->logicalDevice, texture->image, nullptr);
+        }
+        if (texture->previousImage != VULKRON_NULL_HANDLE) {
+            vkDestroyImage(deviceInternal->logicalDevice, texture->previousImage, nullptr);
+        }
+        freeMemory(&texture->memory);
+        freeMemory(&texture->previousMemory);
+
+        delete texture;
+    }
+
+    delete textureStreaming;
+    textureStreaming = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [EVICTION] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+static bool isTextureDemotable(const TextureInternal* texture) {
+    return texture->state == VULKRON_TEXTURE_STATE_RESIDENT && !texture->isDecoding && !texture->destroyRequested &&
+        texture->tailMipLevel > 0 && texture->tailMipLevel < texture->mipLevels && texture->previousImage == VULKRON_NULL_HANDLE;
+}
+
+void getTextureEvictionCandidates(std::vector<EvictionCandidate>& candidateList) {
+
+    for (auto texture : textureStreaming->textureList) {
+        if (!isTextureDemotable(texture)) {
+            continue;
+        }
+
+        EvictionCandidate candidate = {};
+        candidate.lastUsedFrame = texture->lastUsedFrame.load(std::memory_order_relaxed);
+        candidate.memoryList[0] = texture->memory;
+        candidate.heapIndex = deviceInternal->gpuMemoryProperties.memoryTypes[texture->memory.memoryTypeIndex].heapIndex;
+        candidate.texture = texture;
+
+        candidateList.push_back(candidate);
+    }
+}
+
+// Drops every level above the mip tail, the full chain is released with the frames that still sample it
+bool demoteTexture(TextureInternal* texture) {
+
+    if (!isTextureDemotable(texture)) {
+        return false;
+    }
+
+    relocateTexture(texture, texture->tailMipLevel);
+    texture->baseRowsUploaded = 0;
+
+    return true;
+}
+
+// Textures whose image is fully resident are moved out of the block being drained
+void moveTextures(const MemoryBlock* block, VkDeviceSize* pBudget) {
+
+    for (auto texture : textureStreaming->textureList) {
+        if (*pBudget == 0) {
+            return;
+        }
+
+        bool isMovable = texture->memory.block == block && texture->residentMipLevel == texture->imageMipOffset &&
+            !texture->isDecoding && !texture->destroyRequested && texture->previousImage == VULKRON_NULL_HANDLE;
+
+        if (!isMovable) {
+            continue;
+        }
+
+        *pBudget -= std::min(*pBudget, texture->memory.size);
+
+        relocateTexture(texture, texture->imageMipOffset);
+    }
+}
+
+// Copies levels firstMipLevel.. mipLevels - 1 on the gpu into a new image that starts at firstMipLevel.
+// Once the copy is submitted the view moves over and the old image becomes the previous one.
+static void relocateTexture(TextureInternal* texture, uint32_t firstMipLevel) {
+
+    uint32_t levelCount = texture->mipLevels - firstMipLevel;
+
+    VkImage newImage = VK_NULL_HANDLE;
+    MemoryAllocation newMemory;
+    createTextureImage(texture, firstMipLevel, &newImage, &newMemory);
+
+    TransferBatch* batch = getTransferBatch();
+
+    VkImageMemoryBarrier barrierList[2] = {};
+    for (auto& barrier : barrierList) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+    }
+
+    barrierList[0].image = texture->image;
+    barrierList[0].subresourceRange.baseMipLevel = firstMipLevel - texture->imageMipOffset;
+    barrierList[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrierList[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrierList[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrierList[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    barrierList[1].image = newImage;
+    barrierList[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrierList[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrierList[1].srcAccessMask = 0;
+    barrierList[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 2, barrierList);
+
+    std::vector<VkImageCopy> regionList;
+    for (uint32_t i = 0; i < levelCount; i++) {
+        uint32_t level = firstMipLevel + i;
+
+        VkImageCopy region = {};
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - texture->imageMipOffset, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+        region.extent = { std::max(1u, texture->width >> level), std::max(1u, texture->height >> level), 1 };
+
+        regionList.push_back(region);
+    }
+
+    vkCmdCopyImage(batch->graphicsCommandBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regionList.size()), regionList.data());
+
+    // the old image goes back to being sampled until this frame's command buffers pick up the new view
+    barrierList[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrierList[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrierList[0].srcAccessMask = 0;
+    barrierList[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    barrierList[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrierList[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrierList[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrierList[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barrierList);
+
+    texture->previousImage = texture->image;
+    texture->previousMemory = texture->memory;
+    texture->image = newImage;
+    texture->memory = newMemory;
+    texture->imageMipOffset = firstMipLevel;
+
+    batch->onSubmitList.push_back([texture, firstMipLevel] { updateTextureResidency(texture, firstMipLevel); });
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [TEXTURE] ------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronCreateTexture(VulkronTextureCreateInfo* info) {
+
+    if (nullptr == info || nullptr == info->pTexture || info->filePath.empty()) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    TextureInternal* texture = new TextureInternal();
+    texture->filePath = info->filePath;
+    texture->format = info->srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    texture->generateMipmaps = info->generateMipmaps;
+    texture->pfnResidencyCallback = info->pfnResidencyCallback;
+    texture->pUserData = info->pUserData;
+
+    textureStreaming->textureList.push_back(texture);
+    *info->pTexture = texture;
+
+    startTextureDecode(texture);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronGetTextureInfo(VulkronTexture texture, VulkronTextureInfo* pInfo) {
+
+    if (nullptr == texture || nullptr == pInfo) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    pInfo->state = texture->state;
+    pInfo->image = texture->image;
+    pInfo->view = texture->view;
+    pInfo->width = texture->state == VULKRON_TEXTURE_STATE_PENDING ? 0 : texture->width;
+    pInfo->height = texture->state == VULKRON_TEXTURE_STATE_PENDING ? 0 : texture->height;
+    pInfo->mipLevels = texture->state == VULKRON_TEXTURE_STATE_PENDING ? 0 : texture->mipLevels;
+    pInfo->residentMipLevel = texture->residentMipLevel;
+
+    return VULKRON_SUCCESS;
+}
+
+void vulkronTouchTexture(VulkronTexture texture) {
+
+    if (nullptr == texture) {
+        return;
+    }
+
+    texture->lastUsedFrame.store(frameNumber, std::memory_order_relaxed);
+
+    // demoted textures come back once nothing is under pressure, the decode starts over from the file
+    bool isDemoted = texture->imageMipOffset > 0 && texture->previousImage == VULKRON_NULL_HANDLE;
+
+    if (isDemoted && !texture->isDecoding && !texture->destroyRequested && !hasMemoryPressure(VULKRON_MEMORY_PRESSURE_HIGH)) {
+        startTextureDecode(texture);
+    }
+}
+
+VulkronResult vulkronDestroyTexture(VulkronTexture texture) {
+
+    if (nullptr == texture) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // a worker thread is still decoding it, it is destroyed when the result comes back
+    if (texture->isDecoding) {
+        texture->destroyRequested = true;
+        return VULKRON_SUCCESS;
+    }
+
+    auto& tailQueue = textureStreaming->tailQueue;
+    auto& baseQueue = textureStreaming->baseQueue;
+    tailQueue.erase(std::remove(tailQueue.begin(), tailQueue.end(), texture), tailQueue.end());
+    baseQueue.erase(std::remove(baseQueue.begin(), baseQueue.end(), texture), baseQueue.end());
+
+    // the batch being recorded may reference the image, let it go out first
+    TransferBatch* batch = &transferInternal->batchList[transferInternal->currentBatch];
+    if (batch->isRecording) {
+        texture->destroyRequested = true;
+        batch->onSubmitList.push_back([texture] { destroyTextureInternal(texture); });
+        return VULKRON_SUCCESS;
+    }
+
+    destroyTextureInternal(texture);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronCreateSampler(VulkronSamplerCreateInfo* info) {
+
+    if (nullptr == info || nullptr == info->pSampler) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = info->filter;
+    samplerInfo.minFilter = info->filter;
+    samplerInfo.mipmapMode = info->filter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = info->addressMode;
+    samplerInfo.addressModeV = info->addressMode;
+    samplerInfo.addressModeW = info->addressMode;
+    samplerInfo.anisotropyEnable = info->maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+    samplerInfo.maxAnisotropy = std::min(info->maxAnisotropy, deviceInternal->gpuProperties.limits.maxSamplerAnisotropy);
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;     // views already clamp to the resident mips
+
+    if (vkCreateSampler(deviceInternal->logicalDevice, &samplerInfo, nullptr, info->pSampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create texture sampler!");
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+void vulkronDestroySampler(VkSampler sampler) {
+    vkDestroySampler(deviceInternal->logicalDevice, sampler, nullptr);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "VulkronTrace.h"
+
+// Source
+// https://github.com/SaschaWillems/Vulkan/blob/master/base/threadpool.hpp
+
+class VulrkonThread {
+private:
+    bool destroying = false;
+    std::thread worker;
+    std::queue<std::function<void()>> jobQueue;
+    std::mutex queueMutex;
+    std::condition_variable condition;
+
+    // Loop through all remaining jobs
+    void queueLoop([[maybe_unused]] const char* name) {
+        VULKRON_TRACE_THREAD(name);
+
+        while (true) {
+
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                condition.wait(lock, [this] { return !jobQueue.empty() || destroying; });
+                if (destroying)
+                {
+                    break;
+                }
+                job = jobQueue.front();
+            }
+
+            {
+                VULKRON_TRACE_SCOPE("job", "job");
+                job();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                jobQueue.pop();
+                condition.notify_one();
+            }
+        }
+    }
+
+public:
+    // name is only used to label the thread in traces
+    VulrkonThread(const char* name) {
+        worker = std::thread(&VulrkonThread::queueLoop, this, name);
+    }
+
+    ~VulrkonThread() {
+        if (worker.joinable()) {
+            wait();
+            queueMutex.lock();
+            destroying = true;
+            condition.notify_one();
+            queueMutex.unlock();
+            worker.join();
+        }
+    }
+
+    // Add a new job to the thread's queue
+    void addJob(std::function<void()> function) {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        jobQueue.push(std::move(function));
+        condition.notify_one();
+    }
+
+    // Wait until all work items have been finished
+    void wait() {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        condition.wait(lock, [this]() { return jobQueue.empty(); });
+    }
+};
+
+struct VulkronThreadPool {
+    std::vector<std::unique_ptr<VulrkonThread>> threads;
+    std::atomic<uint32_t> nextThread = 0;
+
+    // Sets the number of threads to be allocated in this pool
+    VulkronThreadPool(const char* name) {
+        threads.clear();
+        for (auto i = 0; i < std::thread::hardware_concurrency(); i++) {
+            threads.push_back(std::make_unique<VulrkonThread>(name));
+        }
+    }
+
+    // Hand a job to the next thread in round robin order, used for fire and forget work (decoding, loading)
+    void addJob(std::function<void()> function) {
+        uint32_t threadIndex = nextThread.fetch_add(1) % static_cast<uint32_t>(threads.size());
+        threads[threadIndex]->addJob(std::move(function));
+    }
+
+    // Split [0, count) into one contiguous range per thread and wait for all of them.
+    // Small counts run on the calling thread, handing them out costs more than it saves.
+    void parallelFor(uint32_t count, uint32_t minRangeSize, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+        parallelForRanges(count, minRangeSize, [&function](uint32_t, uint32_t begin, uint32_t end) { function(begin, end); });
+    }
+
+    // Same split, range i always runs alone on thread i so rangeIndex can pick per thread state without locking
+    void parallelForRanges(uint32_t count, uint32_t minRangeSize, const std::function<void(uint32_t rangeIndex, uint32_t begin, uint32_t end)>& function) {
+        uint32_t rangeCount = std::min(static_cast<uint32_t>(threads.size()), (count + minRangeSize - 1) / std::max(minRangeSize, 1u));
+
+        if (rangeCount <= 1) {
+            function(0, 0, count);
+            return;
+        }
+
+        uint32_t rangeSize = (count + rangeCount - 1) / rangeCount;
+
+        for (uint32_t i = 0; i < rangeCount; i++) {
+            uint32_t begin = std::min(count, i * rangeSize);
+            uint32_t end = std::min(count, begin + rangeSize);
+            threads[i]->addJob([&function, i, begin, end] { function(i, begin, end); });
+        }
+
+        wait();
+    }
+
+    // Wait until all threads have finished their work items
+    void wait() {
+        for (auto& thread : threads) {
+            thread->wait();
+        }
+    }
+};
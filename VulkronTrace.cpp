@@ -0,0 +1,211 @@
+#include "VulkronInternal.h"
+
+/*
+
+    Timeline tracing, see VulkronTrace.h for the rings
+
+    1. scopes write one complete event when they end, into the ring of the thread they ran on
+    2. gpu passes come from the frame statistics timestamps, written into a ring of their own
+       once the frame's fence has been waited on
+    3. gpu ticks are turned into trace clock time through a calibration point, a gpu timestamp
+       sampled with VK_EXT_calibrated_timestamps between two reads of the trace clock. Without the
+       extension a frame can't have ended later than the moment it was seen done, the earliest
+       such bound is kept.
+    4. vulkronWriteTrace copies every ring and writes them as Chrome trace events
+
+    The trace outlives vulkronShutdown so it can still be written after it, threads keep
+    pointing at their rings until they exit.
+
+*/
+
+#ifdef VULKRON_TRACING
+
+#include <iomanip>
+
+TraceInternal*  traceInternal   = new TraceInternal();
+
+static thread_local TraceRing*  threadRing  = nullptr;
+
+static void copyTraceEvents(const TraceRing& ring, std::vector<TraceEvent>* pEventList);
+static int64_t getGpuTraceTime(uint64_t ticks);
+static void setGpuCalibration(int64_t time, uint64_t ticks);
+
+//-------------------------------------------------------------------------------------
+// SECTION [RINGS] --------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+TraceRing* getTraceRing() {
+
+    if (nullptr != threadRing) {
+        return threadRing;
+    }
+
+    std::lock_guard<std::mutex> lock(traceInternal->ringMutex);
+
+    // tid 0 is the gpu
+    traceInternal->ringList.push_back(std::make_unique<TraceRing>());
+    threadRing = traceInternal->ringList.back().get();
+    threadRing->threadIndex = static_cast<uint32_t>(traceInternal->ringList.size());
+
+    return threadRing;
+}
+
+void setTraceThreadName(const char* name) {
+    getTraceRing()->threadName.store(name, std::memory_order_relaxed);
+}
+
+// The writer doesn't wait for the copy, slots it reached again while they were copied are dropped
+static void copyTraceEvents(const TraceRing& ring, std::vector<TraceEvent>* pEventList) {
+
+    uint64_t endCount = ring.writeCount.load(std::memory_order_acquire);
+    uint64_t beginCount = endCount > TRACE_RING_SIZE ? endCount - TRACE_RING_SIZE : 0;
+    size_t firstEvent = pEventList->size();
+
+    for (uint64_t i = beginCount; i < endCount; i++) {
+        pEventList->push_back(ring.eventList[i % TRACE_RING_SIZE]);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t writeCount = ring.writeCount.load(std::memory_order_relaxed);
+
+    // the writer may already be in the middle of the slot after writeCount
+    if (writeCount + 1 > beginCount + TRACE_RING_SIZE) {
+        uint64_t overwrittenCount = std::min(writeCount + 1 - TRACE_RING_SIZE - beginCount, endCount - beginCount);
+        pEventList->erase(pEventList->begin() + firstEvent, pEventList->begin() + firstEvent + overwrittenCount);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [GPU] ----------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Called with the last timestamp of a frame whose fence was just waited on
+void calibrateTraceGpuClock(uint64_t frameEndTicks) {
+
+    if (deviceInternal->hasCalibratedTimestamps) {
+        VkCalibratedTimestampInfoEXT timestampInfo = {};
+        timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+        uint64_t ticks = 0;
+        uint64_t maxDeviation = 0;
+
+        int64_t beginTime = getTraceTime();
+        VkResult result = deviceInternal->pfnGetCalibratedTimestamps(deviceInternal->logicalDevice, 1, &timestampInfo, &ticks, &maxDeviation);
+        int64_t endTime = getTraceTime();
+
+        if (result == VK_SUCCESS) {
+            setGpuCalibration(beginTime + (endTime - beginTime) / 2, ticks);
+            return;
+        }
+    }
+
+    int64_t time = getTraceTime();
+
+    if (!traceInternal->hasGpuCalibration || time < getGpuTraceTime(frameEndTicks)) {
+        setGpuCalibration(time, frameEndTicks);
+    }
+}
+
+void writeTraceGpuEvent(const char* name, uint64_t beginTicks, uint64_t endTicks) {
+
+    if (!traceInternal->hasGpuCalibration) {
+        return;
+    }
+
+    writeTraceEvent(&traceInternal->gpuRing, "gpu", name, getGpuTraceTime(beginTicks), getGpuTraceTime(endTicks));
+}
+
+static void setGpuCalibration(int64_t time, uint64_t ticks) {
+    traceInternal->gpuCalibrationTime = time;
+    traceInternal->gpuCalibrationTicks = ticks;
+    traceInternal->hasGpuCalibration = true;
+}
+
+// Ticks only have timestampValidBits, the difference is sign extended so earlier ticks come out before the calibration
+static int64_t getGpuTraceTime(uint64_t ticks) {
+
+    uint64_t mask = statisticsInternal->timestampMask;
+    uint64_t delta = (ticks - traceInternal->gpuCalibrationTicks) & mask;
+
+    if (mask != UINT64_MAX && (delta & ((mask >> 1) + 1))) {
+        delta |= ~mask;
+    }
+
+    return traceInternal->gpuCalibrationTime + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(delta)) * statisticsInternal->timestampPeriod);
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [EXPORT] -------------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+VulkronResult vulkronWriteTrace(const std::string& filePath) {
+
+    if (filePath.empty()) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    std::ofstream file(filePath, std::ios::trunc);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open trace file!");
+    }
+
+    std::vector<const TraceRing*> ringList;
+    {
+        std::lock_guard<std::mutex> lock(traceInternal->ringMutex);
+
+        ringList.push_back(&traceInternal->gpuRing);
+
+        for (const auto& ring : traceInternal->ringList) {
+            ringList.push_back(ring.get());
+        }
+    }
+
+    // one list per ring, the copies are taken before anything is written so they cover about the same time
+    std::vector<std::vector<TraceEvent>> eventLists(ringList.size());
+    int64_t startTime = INT64_MAX;
+
+    for (size_t i = 0; i < ringList.size(); i++) {
+        copyTraceEvents(*ringList[i], &eventLists[i]);
+
+        for (const TraceEvent& event : eventLists[i]) {
+            startTime = std::min(startTime, event.beginTime);
+        }
+    }
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool isFirst = true;
+
+    for (size_t i = 0; i < ringList.size(); i++) {
+        const char* threadName = ringList[i]->threadName.load(std::memory_order_relaxed);
+
+        if (i == 0) {
+            threadName = "gpu graphics queue";
+        }
+
+        file << (isFirst ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ringList[i]->threadIndex
+            << ",\"args\":{\"name\":\"" << (nullptr == threadName ? "thread" : threadName) << "\"}}";
+        isFirst = false;
+
+        // ts and dur are microseconds
+        for (const TraceEvent& event : eventLists[i]) {
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ringList[i]->threadIndex
+                << ",\"ts\":" << (event.beginTime - startTime) / 1000.0 << ",\"dur\":" << (event.endTime - event.beginTime) / 1000.0 << "}";
+        }
+    }
+
+    file << "\n]}\n";
+
+    if (!file) {
+        throw std::runtime_error("failed to write trace file!");
+    }
+
+    return VULKRON_SUCCESS;
+}
+
+#endif // VULKRON_TRACING
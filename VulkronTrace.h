@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef VULKRON_TRACE
+#define VULKRON_TRACE
+
+/*
+
+    Timeline tracing, only compiled in when VULKRON_TRACING is defined for the engine and the application.
+    Without it the macros below expand to nothing and vulkronWriteTrace doesn't exist.
+
+    Every thread writes its events into its own ring, the last TRACE_RING_SIZE of them are kept.
+    Writing never locks, only a thread's first event registers its ring. Names and categories
+    must be string literals, only the pointer is stored.
+
+*/
+
+#ifdef VULKRON_TRACING
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#define VULKRON_TRACE_CONCAT_INNER(a, b)    a##b
+#define VULKRON_TRACE_CONCAT(a, b)          VULKRON_TRACE_CONCAT_INNER(a, b)
+#define VULKRON_TRACE_SCOPE(category, name) TraceScope VULKRON_TRACE_CONCAT(traceScope, __LINE__)(category, name)
+#define VULKRON_TRACE_THREAD(name)          setTraceThreadName(name)
+
+static const uint32_t                       TRACE_RING_SIZE     = 8192;     // events per thread, 256 KB
+
+typedef struct TraceEvent {
+    const char*                             category;
+    const char*                             name;
+    int64_t                                 beginTime;                      // nanoseconds, trace clock
+    int64_t                                 endTime;
+} TraceEvent;
+
+// One writer, its thread. A dump reads it while it's written and drops whatever was overwritten meanwhile.
+typedef struct TraceRing {
+    std::array<TraceEvent, TRACE_RING_SIZE> eventList;
+    std::atomic<uint64_t>                   writeCount          = 0;
+    std::atomic<const char*>                threadName          = nullptr;
+    uint32_t                                threadIndex         = 0;        // tid in the trace
+} TraceRing;
+
+TraceRing* getTraceRing();
+void setTraceThreadName(const char* name);
+
+// steady_clock, the clock gpu timestamps are calibrated against
+inline int64_t getTraceTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void writeTraceEvent(TraceRing* ring, const char* category, const char* name, int64_t beginTime, int64_t endTime) {
+    uint64_t index = ring->writeCount.load(std::memory_order_relaxed);
+    ring->eventList[index % TRACE_RING_SIZE] = { category, name, beginTime, endTime };
+    ring->writeCount.store(index + 1, std::memory_order_release);
+}
+
+// Traces the enclosing scope on the calling thread
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name) : category(category), name(name), beginTime(getTraceTime()) {}
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() { writeTraceEvent(getTraceRing(), category, name, beginTime, getTraceTime()); }
+
+private:
+    const char*                             category;
+    const char*                             name;
+    int64_t                                 beginTime;
+};
+
+#else
+
+#define VULKRON_TRACE_SCOPE(category, name)
+#define VULKRON_TRACE_THREAD(name)
+
+#endif // VULKRON_TRACING
+
+#endif // VULKRON_TRACE
@@ -0,0 +1,439 @@
+#include "VulkronInternal.h"
+
+TransferInternal*   transferInternal    = new TransferInternal();
+
+static const uint32_t                       TRANSFER_BATCH_COUNT    = 4;
+
+static void beginTransferBatch(TransferBatch* batch);
+static void completeTransferBatch(TransferBatch* batch);
+static VkDeviceSize allocateUploadBatchStaging(VkDeviceSize size);
+
+void createTransferBatches() {
+
+    VkCommandPoolCreateInfo commandPoolInfo = {};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.transferQueueIndex;
+
+    if (vkCreateCommandPool(deviceInternal->logicalDevice, &commandPoolInfo, nullptr, &transferInternal->transferCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool");
+    }
+
+    commandPoolInfo.queueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+
+    if (vkCreateCommandPool(deviceInternal->logicalDevice, &commandPoolInfo, nullptr, &transferInternal->graphicsCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool");
+    }
+
+    transferInternal->batchList.resize(TRANSFER_BATCH_COUNT);
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (auto& batch : transferInternal->batchList) {
+        VkCommandBufferAllocateInfo commandBufferAllocate = {};
+        commandBufferAllocate.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferAllocate.commandPool = transferInternal->transferCommandPool;
+        commandBufferAllocate.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferAllocate.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandBufferAllocate, &batch.transferCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
+
+        commandBufferAllocate.commandPool = transferInternal->graphicsCommandPool;
+
+        if (vkAllocateCommandBuffers(deviceInternal->logicalDevice, &commandBufferAllocate, &batch.graphicsCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
+
+        if (vkCreateSemaphore(deviceInternal->logicalDevice, &semaphoreInfo, nullptr, &batch.transferFinishedSemaphore) != VK_SUCCESS ||
+            vkCreateFence(deviceInternal->logicalDevice, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a transfer batch!");
+        }
+    }
+
+    transferInternal->currentBatch = 0;
+    transferInternal->frameBytesRecorded = 0;
+}
+
+void destroyTransferBatches() {
+    for (auto& batch : transferInternal->batchList) {
+        vkDestroySemaphore(deviceInternal->logicalDevice, batch.transferFinishedSemaphore, nullptr);
+        vkDestroyFence(deviceInternal->logicalDevice, batch.fence, nullptr);
+    }
+
+    vkDestroyCommandPool(deviceInternal->logicalDevice, transferInternal->transferCommandPool, nullptr);
+    vkDestroyCommandPool(deviceInternal->logicalDevice, transferInternal->graphicsCommandPool, nullptr);
+
+    delete transferInternal;
+    transferInternal = nullptr;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [TRANSFER] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Every streamed upload records into the current batch. A batch is two command buffers:
+// the copies run on the transfer queue, then the graphics queue waits on the semaphore to take
+// ownership of the resources and do anything the transfer queue can't (layout changes for sampling, blits).
+
+TransferBatch* getTransferBatch() {
+    TransferBatch* batch = &transferInternal->batchList[transferInternal->currentBatch];
+
+    if (batch->isInFlight) {
+        vkWaitForFences(deviceInternal->logicalDevice, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+        retireTransferBatches();
+    }
+
+    if (!batch->isRecording) {
+        beginTransferBatch(batch);
+    }
+
+    return batch;
+}
+
+bool hasTransferBudget(VkDeviceSize size) {
+    // always let one upload through per frame so items bigger than the budget still make progress
+    if (transferInternal->frameBytesRecorded == 0) {
+        return true;
+    }
+
+    return transferInternal->frameBytesRecorded + size <= transferInternal->frameBudget;
+}
+
+void submitTransferBatch() {
+    VULKRON_TRACE_SCOPE("upload", "submitTransferBatch");
+
+    TransferBatch* batch = &transferInternal->batchList[transferInternal->currentBatch];
+
+    transferInternal->frameBytesRecorded = 0;
+
+    if (!batch->isRecording) {
+        return;
+    }
+
+    if (vkEndCommandBuffer(batch->transferCommandBuffer) != VK_SUCCESS || vkEndCommandBuffer(batch->graphicsCommandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record transfer command buffer!");
+    }
+
+    VkSubmitInfo transferSubmit = {};
+    transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferSubmit.commandBufferCount = 1;
+    transferSubmit.pCommandBuffers = &batch->transferCommandBuffer;
+    transferSubmit.signalSemaphoreCount = 1;
+    transferSubmit.pSignalSemaphores = &batch->transferFinishedSemaphore;
+
+    if (queueSubmit(getThreadQueue(VULKRON_QUEUE_TRANSFER_BIT), 1, &transferSubmit, VULKRON_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo graphicsSubmit = {};
+    graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    graphicsSubmit.waitSemaphoreCount = 1;
+    graphicsSubmit.pWaitSemaphores = &batch->transferFinishedSemaphore;
+    graphicsSubmit.pWaitDstStageMask = &waitStage;
+    graphicsSubmit.commandBufferCount = 1;
+    graphicsSubmit.pCommandBuffers = &batch->graphicsCommandBuffer;
+
+    vkResetFences(deviceInternal->logicalDevice, 1, &batch->fence);
+
+    if (queueSubmit(getThreadQueue(VULKRON_QUEUE_GRAPHICS_BIT), 1, &graphicsSubmit, batch->fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit transfer command buffer!");
+    }
+
+    batch->isRecording = false;
+    batch->isInFlight = true;
+    batch->ringHead = uploadRing->head;
+
+    // anything submitted to the graphics queue after this point is ordered after the batch
+    for (auto& onSubmit : batch->onSubmitList) {
+        onSubmit();
+    }
+    batch->onSubmitList.clear();
+
+    transferInternal->inFlightBatchList.push_back(transferInternal->currentBatch);
+    transferInternal->currentBatch = (transferInternal->currentBatch + 1) % TRANSFER_BATCH_COUNT;
+}
+
+void retireTransferBatches() {
+    while (!transferInternal->inFlightBatchList.empty()) {
+        TransferBatch* batch = &transferInternal->batchList[transferInternal->inFlightBatchList.front()];
+
+        if (vkGetFenceStatus(deviceInternal->logicalDevice, batch->fence) != VK_SUCCESS) {
+            break; // batches finish in submission order, nothing after this one is done either
+        }
+
+        completeTransferBatch(batch);
+        transferInternal->inFlightBatchList.pop_front();
+    }
+}
+
+void recordQueueOwnershipTransfer(TransferBatch* batch, VkImage image, VkImageSubresourceRange range, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.image = image;
+    barrier.subresourceRange = range;
+
+    if (deviceInternal->queuefamily.transferQueueIndex != deviceInternal->queuefamily.graphicsQueueIndex) {
+        barrier.srcQueueFamilyIndex = deviceInternal->queuefamily.transferQueueIndex;
+        barrier.dstQueueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+
+        // release on the transfer queue
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        vkCmdPipelineBarrier(batch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        // acquire on the graphics queue, the semaphore wait already made the writes available
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    else {
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
+
+void recordQueueOwnershipTransfer(TransferBatch* batch, VkBuffer buffer, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+
+    if (deviceInternal->queuefamily.transferQueueIndex == deviceInternal->queuefamily.graphicsQueueIndex) {
+        return; // same family, the semaphore is all the synchronization a buffer needs
+    }
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = deviceInternal->queuefamily.transferQueueIndex;
+    barrier.dstQueueFamilyIndex = deviceInternal->queuefamily.graphicsQueueIndex;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(batch->transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(batch->graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [UPLOAD BATCH] -------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Small writes (materials, bone palettes, instance data) are kept on the cpu until the frame flushes them.
+// Writes to the same buffer that touch or overlap become one region, every region is packed into one staging
+// allocation and each buffer gets one vkCmdCopyBuffer with all of its regions. The copies go into the graphics
+// half of the transfer batch between two barriers, so the whole batch is one sync point ahead of the frame.
+
+VulkronResult vulkronUploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* pData, VkDeviceSize size) {
+
+    // bigger writes would starve the ring, they belong on the streaming path
+    if (VK_NULL_HANDLE == buffer || nullptr == pData || size == 0 || size > uploadRing->staging.size / 2) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    // record what's pending early rather than let one flush outgrow the ring
+    if (transferInternal->pendingUploadData.size() + size > uploadRing->staging.size / 2) {
+        flushUploadBatch(false);
+    }
+
+    PendingUpload upload = {};
+    upload.buffer = buffer;
+    upload.offset = offset;
+    upload.size = size;
+    upload.dataOffset = transferInternal->pendingUploadData.size();
+
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    transferInternal->pendingUploadData.insert(transferInternal->pendingUploadData.end(), pBytes, pBytes + size);
+    transferInternal->pendingUploadList.push_back(upload);
+
+    return VULKRON_SUCCESS;
+}
+
+VulkronResult vulkronGetUploadBatchInfo(VulkronUploadBatchInfo* pInfo) {
+
+    if (nullptr == pInfo) {
+        return VULKRON_ERROR_INVALID_ARGUMENT;
+    }
+
+    *pInfo = transferInternal->lastUploadBatchInfo;
+
+    return VULKRON_SUCCESS;
+}
+
+// Called by vulkronDrawFrame before streaming records anything, and by vulkronUploadBuffer when too much is pending
+void flushUploadBatch(bool isEndOfFrame) {
+    VULKRON_TRACE_SCOPE("upload", "flushUploadBatch");
+
+    std::vector<PendingUpload>& uploadList = transferInternal->pendingUploadList;
+    VulkronUploadBatchInfo& info = transferInternal->uploadBatchInfo;
+
+    if (uploadList.empty()) {
+        if (isEndOfFrame) {
+            transferInternal->lastUploadBatchInfo = info;
+            info = {};
+        }
+        return;
+    }
+
+    // by buffer then offset, equal offsets keep the order they were written in
+    std::vector<uint32_t> orderList(uploadList.size());
+    for (uint32_t i = 0; i < orderList.size(); i++) {
+        orderList[i] = i;
+    }
+
+    std::stable_sort(orderList.begin(), orderList.end(), [&](uint32_t a, uint32_t b) {
+        if (uploadList[a].buffer != uploadList[b].buffer) {
+            return uploadList[a].buffer < uploadList[b].buffer;
+        }
+        return uploadList[a].offset < uploadList[b].offset;
+    });
+
+    std::vector<VkBufferCopy> regionList;
+    std::vector<VkBuffer> regionBufferList;
+    std::vector<uint32_t> uploadRegionList(uploadList.size());
+    VkDeviceSize stagingSize = 0;
+
+    for (uint32_t index : orderList) {
+        const PendingUpload& upload = uploadList[index];
+
+        bool isMerged = !regionList.empty() && regionBufferList.back() == upload.buffer &&
+            upload.offset <= regionList.back().dstOffset + regionList.back().size;
+
+        if (isMerged) {
+            VkBufferCopy& region = regionList.back();
+            VkDeviceSize end = std::max(region.dstOffset + region.size, upload.offset + upload.size);
+
+            stagingSize += end - (region.dstOffset + region.size);
+            region.size = end - region.dstOffset;
+        }
+        else {
+            VkBufferCopy region = {};
+            region.srcOffset = stagingSize;
+            region.dstOffset = upload.offset;
+            region.size = upload.size;
+
+            regionList.push_back(region);
+            regionBufferList.push_back(upload.buffer);
+            stagingSize += upload.size;
+        }
+
+        uploadRegionList[index] = static_cast<uint32_t>(regionList.size() - 1);
+    }
+
+    VkDeviceSize ringOffset = allocateUploadBatchStaging(stagingSize);
+
+    // in the order they were written, so where writes overlap the later one ends up in staging
+    for (uint32_t i = 0; i < uploadList.size(); i++) {
+        const PendingUpload& upload = uploadList[i];
+        const VkBufferCopy& region = regionList[uploadRegionList[i]];
+
+        memcpy(uploadRing->pMappedData + ringOffset + region.srcOffset + (upload.offset - region.dstOffset),
+            transferInternal->pendingUploadData.data() + upload.dataOffset, upload.size);
+    }
+
+    for (VkBufferCopy& region : regionList) {
+        region.srcOffset += ringOffset;
+    }
+
+    TransferBatch* batch = getTransferBatch();
+    VkCommandBuffer commandBuffer = batch->graphicsCommandBuffer;
+
+    // earlier frames on the graphics queue may still read what's about to be overwritten
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    // regions of one buffer are next to each other after the sort
+    for (size_t first = 0; first < regionList.size();) {
+        size_t last = first + 1;
+        while (last < regionList.size() && regionBufferList[last] == regionBufferList[first]) {
+            last++;
+        }
+
+        vkCmdCopyBuffer(commandBuffer, uploadRing->staging.buffer, regionBufferList[first], static_cast<uint32_t>(last - first), regionList.data() + first);
+
+        info.copyCount++;
+        first = last;
+    }
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // counts against the frame's budget so streaming backs off instead of the writes
+    transferInternal->frameBytesRecorded += stagingSize;
+
+    info.writeCount += static_cast<uint32_t>(uploadList.size());
+    info.regionCount += static_cast<uint32_t>(regionList.size());
+    info.byteCount += stagingSize;
+
+    uploadList.clear();
+    transferInternal->pendingUploadData.clear();
+
+    if (isEndOfFrame) {
+        transferInternal->lastUploadBatchInfo = info;
+        info = {};
+    }
+}
+
+// The writes can't be dropped like a streaming chunk, wait for in flight batches to hand their space back
+static VkDeviceSize allocateUploadBatchStaging(VkDeviceSize size) {
+
+    VkDeviceSize ringOffset = 0;
+
+    while (!uploadRingAllocate(size, &ringOffset)) {
+        if (transferInternal->inFlightBatchList.empty()) {
+            throw std::runtime_error("failed to allocate staging memory for buffer uploads!");
+        }
+
+        TransferBatch* batch = &transferInternal->batchList[transferInternal->inFlightBatchList.front()];
+        vkWaitForFences(deviceInternal->logicalDevice, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+        retireTransferBatches();
+    }
+
+    return ringOffset;
+}
+
+static void beginTransferBatch(TransferBatch* batch) {
+    VkCommandBufferBeginInfo commandBufferBegin = {};
+    commandBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    commandBufferBegin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(batch->transferCommandBuffer, &commandBufferBegin) != VK_SUCCESS ||
+        vkBeginCommandBuffer(batch->graphicsCommandBuffer, &commandBufferBegin) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording transfer command buffer!");
+    }
+
+    batch->isRecording = true;
+}
+
+static void completeTransferBatch(TransferBatch* batch) {
+    batch->isInFlight = false;
+
+    // staging space consumed by this batch can be reused
+    uploadRing->tail = std::max(uploadRing->tail, batch->ringHead);
+
+    for (auto& onComplete : batch->onCompleteList) {
+        onComplete();
+    }
+    batch->onCompleteList.clear();
+}
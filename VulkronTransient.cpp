@@ -0,0 +1,226 @@
+#include "VulkronInternal.h"
+
+/*
+    Transient images only hold data for part of a frame. Each one declares the first and last pass
+    it is used in, images whose pass ranges don't overlap are placed in the same memory range:
+
+    1. a transient heap is a plain device local allocation, images are bound straight into it
+    2. a new image takes the lowest offset that doesn't intersect any image alive in the same passes,
+       only when no heap has room a new one is allocated
+    3. before every pass recordTransientBarriers waits for everything that used the memory of the
+       images starting in it, the owner still discards the old contents with its own UNDEFINED barrier
+*/
+
+TransientInternal*  transientInternal   = new TransientInternal();
+
+static const VkDeviceSize                   TRANSIENT_HEAP_SIZE         = 32 * 1024 * 1024;    // smallest heap, larger images get a heap of their own size
+static const VkDeviceSize                   TRANSIENT_HEAP_ALIGNMENT    = 64 * 1024;            // of the heap start, covers the usual image alignments
+
+static bool placeTransientImage(TransientHeap* heap, TransientImage* image, const VkMemoryRequirements& requirements);
+static VkDeviceSize alignHeapOffset(const TransientHeap* heap, VkDeviceSize offset, VkDeviceSize alignment);
+static TransientHeap* createTransientHeap(VkDeviceSize size, uint32_t memoryTypeBits);
+static bool isLifetimeOverlapping(const TransientImage* a, const TransientImage* b);
+static bool isMemoryOverlapping(const TransientImage* a, const TransientImage* b);
+
+//-------------------------------------------------------------------------------------
+// SECTION [TRANSIENT IMAGES] ---------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// stageMask and accessMask cover every use of the image, other images sharing its memory wait on them
+VkImage createTransientImage(const VkImageCreateInfo& imageInfo, TransientPass firstPass, TransientPass lastPass, VkPipelineStageFlags stageMask, VkAccessFlags accessMask) {
+
+    std::unique_ptr<TransientImage> image = std::make_unique<TransientImage>();
+    image->firstPass = firstPass;
+    image->lastPass = lastPass;
+    image->stageMask = stageMask;
+    image->accessMask = accessMask;
+
+    if (vkCreateImage(deviceInternal->logicalDevice, &imageInfo, nullptr, &image->image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transient image!");
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(deviceInternal->logicalDevice, image->image, &requirements);
+
+    image->size = requirements.size;
+
+    for (auto& heap : transientInternal->heapList) {
+        if ((requirements.memoryTypeBits & (1u << heap->memory.memoryTypeIndex)) && placeTransientImage(heap.get(), image.get(), requirements)) {
+            image->heap = heap.get();
+            break;
+        }
+    }
+
+    if (nullptr == image->heap) {
+        image->heap = createTransientHeap(std::max(TRANSIENT_HEAP_SIZE, requirements.size), requirements.memoryTypeBits);
+        placeTransientImage(image->heap, image.get(), requirements);
+    }
+
+    const MemoryAllocation& memory = image->heap->memory;
+
+    if (vkBindImageMemory(deviceInternal->logicalDevice, image->image, memory.memory, memory.offset + image->offset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to bind transient image memory!");
+    }
+
+    image->heap->imageList.push_back(image.get());
+
+#if defined _DEBUG || defined VULKRON_ENGINE_DEBUGGING
+    VkDeviceSize imageBytes = 0;
+    VkDeviceSize heapBytes = 0;
+    for (auto& transientImage : transientInternal->imageList) {
+        imageBytes += transientImage->size;
+    }
+    for (auto& heap : transientInternal->heapList) {
+        heapBytes += heap->memory.size;
+    }
+    LOG("transient images: " << (imageBytes + image->size) / 1024 << " KB placed in " << heapBytes / 1024 << " KB")
+#endif
+
+    VkImage handle = image->image;
+    transientInternal->imageList.push_back(std::move(image));
+
+    return handle;
+}
+
+// The caller makes sure the gpu is done with it, the heap goes once its last image does
+void destroyTransientImage(VkImage image) {
+
+    auto& imageList = transientInternal->imageList;
+    auto it = std::find_if(imageList.begin(), imageList.end(), [image](const std::unique_ptr<TransientImage>& candidate) {
+        return candidate->image == image;
+    });
+
+    if (it == imageList.end()) {
+        return;
+    }
+
+    TransientHeap* heap = (*it)->heap;
+    heap->imageList.erase(std::remove(heap->imageList.begin(), heap->imageList.end(), it->get()), heap->imageList.end());
+
+    vkDestroyImage(deviceInternal->logicalDevice, image, nullptr);
+    imageList.erase(it);
+
+    if (heap->imageList.empty()) {
+        freeMemory(&heap->memory);
+
+        auto& heapList = transientInternal->heapList;
+        heapList.erase(std::remove_if(heapList.begin(), heapList.end(), [heap](const std::unique_ptr<TransientHeap>& candidate) {
+            return candidate.get() == heap;
+        }), heapList.end());
+    }
+}
+
+// Lowest offset that doesn't intersect an image whose passes overlap this one
+static bool placeTransientImage(TransientHeap* heap, TransientImage* image, const VkMemoryRequirements& requirements) {
+
+    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> busyList;
+    for (TransientImage* other : heap->imageList) {
+        if (isLifetimeOverlapping(image, other)) {
+            busyList.push_back({ other->offset, other->offset + other->size });
+        }
+    }
+
+    std::sort(busyList.begin(), busyList.end());
+
+    VkDeviceSize offset = 0;
+
+    for (const auto& busy : busyList) {
+        if (alignHeapOffset(heap, offset, requirements.alignment) + requirements.size <= busy.first) {
+            break;
+        }
+
+        offset = std::max(offset, busy.second);
+    }
+
+    offset = alignHeapOffset(heap, offset, requirements.alignment);
+
+    if (offset + requirements.size > heap->memory.size) {
+        return false;
+    }
+
+    image->offset = offset;
+
+    return true;
+}
+
+// The heap may be placed in a shared block, the image is bound at the heap's offset plus its own
+// so the alignment has to hold for the sum
+static VkDeviceSize alignHeapOffset(const TransientHeap* heap, VkDeviceSize offset, VkDeviceSize alignment) {
+    VkDeviceSize memoryOffset = heap->memory.offset + offset;
+    return (memoryOffset + alignment - 1) / alignment * alignment - heap->memory.offset;
+}
+
+static TransientHeap* createTransientHeap(VkDeviceSize size, uint32_t memoryTypeBits) {
+
+    VkMemoryRequirements requirements = {};
+    requirements.size = size;
+    requirements.alignment = TRANSIENT_HEAP_ALIGNMENT;
+    requirements.memoryTypeBits = memoryTypeBits;
+
+    std::unique_ptr<TransientHeap> heap = std::make_unique<TransientHeap>();
+    allocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &heap->memory);
+
+    transientInternal->heapList.push_back(std::move(heap));
+
+    return transientInternal->heapList.back().get();
+}
+
+static bool isLifetimeOverlapping(const TransientImage* a, const TransientImage* b) {
+    return a->firstPass <= b->lastPass && b->firstPass <= a->lastPass;
+}
+
+static bool isMemoryOverlapping(const TransientImage* a, const TransientImage* b) {
+    return a->heap == b->heap && a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+
+//-------------------------------------------------------------------------------------
+// SECTION [ALIASING] -----------------------------------------------------------------
+//-------------------------------------------------------------------------------------
+
+// Recorded in front of each pass. Images starting in it wait on every other image sharing their memory,
+// earlier passes of this frame and later passes of the previous one alike since both come before in
+// submission order.
+void recordTransientBarriers(VkCommandBuffer commandBuffer, TransientPass pass) {
+
+    VkPipelineStageFlags srcStage = 0;
+    VkPipelineStageFlags dstStage = 0;
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+    for (auto& image : transientInternal->imageList) {
+        if (image->firstPass != pass) {
+            continue;
+        }
+
+        for (TransientImage* other : image->heap->imageList) {
+            if (other != image.get() && isMemoryOverlapping(image.get(), other)) {
+                srcStage |= other->stageMask;
+                barrier.srcAccessMask |= other->accessMask;
+                dstStage |= image->stageMask;
+                barrier.dstAccessMask |= image->accessMask;
+            }
+        }
+    }
+
+    if (srcStage == 0) {
+        return;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void destroyTransientHeaps() {
+
+    for (auto& image : transientInternal->imageList) {
+        vkDestroyImage(deviceInternal->logicalDevice, image->image, nullptr);
+    }
+
+    for (auto& heap : transientInternal->heapList) {
+        freeMemory(&heap->memory);
+    }
+
+    delete transientInternal;
+    transientInternal = nullptr;
+}